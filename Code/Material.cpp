@@ -60,6 +60,26 @@ namespace FF {
         mDescriptorSet = Wrapper::DescriptorSet::create(device, params, mDescriptorLayout, mDescriptorPool, frameCount);
     }
 
+    void Material::attachToBindlessTable(const BindlessTextureTable::Ptr& table,
+        const std::vector<Wrapper::Image::Ptr>& mapImages,
+        const Wrapper::Sampler::Ptr& sampler) {
+        if (mapImages.size() > 8) {
+            throw std::runtime_error("Error: bindless material supports at most 8 maps!");
+        }
+
+        MaterialParameters params{};
+        for (size_t i = 0; i < mapImages.size(); ++i) {
+            int slot = mapImages[i] ? static_cast<int>(table->addImage(mapImages[i], sampler)) : -1;
+            if (i < 4) {
+                params.mMapIndices0[static_cast<int>(i)] = slot;
+            }
+            else {
+                params.mMapIndices1[static_cast<int>(i - 4)] = slot;
+            }
+        }
+        mMaterialIndex = table->addMaterial(params);
+    }
+
     Material::~Material() {
         // Resource release if needed (smart pointers usually handle this)
     }
@@ -5,6 +5,7 @@
 #include "vulkanWrapper/descriptorSet.h"
 #include "vulkanWrapper/device.h"
 #include "vulkanWrapper/commandPool.h"
+#include "bindlessTextureTable.h"
 
 namespace FF {
     class Material {
@@ -27,6 +28,16 @@ namespace FF {
 
         void attachImages(const std::vector<Wrapper::Image::Ptr>& perFrameImages);
 
+        // Bindless path: register the maps in the global table instead of building a per-material set
+        // Map order: albedo, normal, emissive, ao, metallic, roughness, metalRoughness
+        void attachToBindlessTable(const BindlessTextureTable::Ptr& table,
+            const std::vector<Wrapper::Image::Ptr>& mapImages,
+            const Wrapper::Sampler::Ptr& sampler);
+
+        [[nodiscard]] auto getMaterialIndex() const {
+            return mMaterialIndex;
+        }
+
         [[nodiscard]] auto getDescriptorLayout() const {
             return mDescriptorLayout;
         }
@@ -45,6 +56,7 @@ namespace FF {
         Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
         Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
         Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+        uint32_t mMaterialIndex{ 0 }; // index into the bindless material parameter buffer
     };
 }
 
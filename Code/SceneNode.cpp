@@ -26,7 +26,7 @@ namespace FF {
 		mScale = glm::vec4(x, y, z, 1.0f);
 		memberNeedUpdate = true;
 	}
-	void SceneNode::draw(const Wrapper::CommandBuffer::Ptr& cmdBuf) {
+	void SceneNode::draw(const Wrapper::CommandBuffer::Ptr& cmdBuf, uint32_t firstInstance) {
 		if (memberNeedUpdate) {
 			Update();
 			memberNeedUpdate = false;
@@ -35,10 +35,13 @@ namespace FF {
 			if (model) {
 				//model->setModelMatrix(mModelMatrix);
 				//model->getUniform().mModelMatrix = mModelMatrix;
-				model->draw(cmdBuf);
+				model->draw(cmdBuf, 1, firstInstance);
 			}
 		}
 	}
+	void SceneNode::invalidateDraw() {
+		mDrawRevision++;
+	}
 	void SceneNode::Update() {
 
 		glm::vec3 position(mPosition);
@@ -20,12 +20,17 @@ namespace FF {
 		glm::vec4 mRotation;
 		glm::vec4 mScale;
 		bool memberNeedUpdate{ false };
+		uint64_t mDrawRevision{ 0 };
 		glm::mat4 mModelMatrix{ 1.0f };
 		glm::mat4 mNormalMatrix{ 1.0f };
 		void SetPosition(float x, float y, float z);
 		void SetRotation(float x, float y, float z);
 		void SetScale(float x, float y, float z);
-		void draw(const Wrapper::CommandBuffer::Ptr& cmdBuf);
+		// firstInstance: object index of the draw in the per object data of the shaders, see ReflectionProbeSet
+		void draw(const Wrapper::CommandBuffer::Ptr& cmdBuf, uint32_t firstInstance = 0);
+		// Cached draw commands of the node are recorded again when mDrawRevision moves:
+		// call it after changing the pipeline, material, geometry or descriptor bindings, not for per frame uniform data
+		void invalidateDraw();
 		void Update();// Optional: js, C#, python,etc.  have this function
 
 
@@ -150,6 +150,7 @@ namespace FF {
 
         // Bind pipeline
         vkCmdBindPipeline(cmdBuf->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline->getPipeline());
+        cmdBuf->setViewportAndScissor(mOutputTarget->getWidth(), mOutputTarget->getHeight());
 
         // Bind descriptor
         VkDescriptorSet ds = mDescriptorSet->getDescriptorSet(0); // 1 frame by default
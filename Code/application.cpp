@@ -1,14 +1,133 @@
 #include "application.h"
+#include "vulkanWrapper/cpuProfiler.h"
+#include "texture/imageWriter.h"
+#include <filesystem>
+#include <cmath>
 
 namespace FF {
 
+	// Centered square grid in the xy plane, the cells closest to the origin first
+	static std::vector<glm::vec3> makeHelmetGrid(uint32_t count, float spacing) {
+		count = std::max(count, 1u);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+		const float center = 0.5f * static_cast<float>(side - 1);
+		std::vector<glm::vec3> positions{};
+		for (uint32_t row = 0; row < side; row++) {
+			for (uint32_t column = 0; column < side; column++) {
+				positions.push_back(glm::vec3((static_cast<float>(column) - center) * spacing, (static_cast<float>(row) - center) * spacing, 0.0f));
+			}
+		}
+		std::stable_sort(positions.begin(), positions.end(),
+			[](const glm::vec3& a, const glm::vec3& b) { return glm::dot(a, a) < glm::dot(b, b); });
+		positions.resize(count);
+		return positions;
+	}
+
 	void Application::run() {
+		FF_CPU_THREAD_NAME("Main");
+		Wrapper::CPUProfiler::setEnabled(useCPUProfiler);
 		initWindow();
 		initVulkan();
 		mainLoop();
 		cleanUp();
 	}
 
+	void Application::runHeadless(uint32_t frameCount, const std::string& outputPath) {
+		initHeadless();
+
+		// Fixed step, the same frames come out on every machine however fast it renders them
+		const float frameTime = 1.0f / 60.0f;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; frame++) {
+			renderHeadlessFrame(frameTime);
+		}
+		vkDeviceWaitIdle(mDevice->getDevice());
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Headless: " << frameCount << " frames in " << seconds << " s" << std::endl;
+
+		finishHeadless(frameCount > 0 ? outputPath : "");
+	}
+
+	void Application::initHeadless() {
+		FF_CPU_THREAD_NAME("Main");
+		Wrapper::CPUProfiler::setEnabled(useCPUProfiler);
+		mHeadless = true;
+		createSceneNodes();
+		initVulkan();
+	}
+
+	void Application::renderHeadlessFrame(float frameTime) {
+		FF_CPU_ZONE("Frame");
+		{
+			FF_CPU_ZONE("WaitForFrameFence");
+			mFences[mCurrentFrame]->waitForFence();
+		}
+		updateUniforms(frameTime);
+		renderHeadless();
+	}
+
+	void Application::finishHeadless(const std::string& outputPath) {
+		vkDeviceWaitIdle(mDevice->getDevice());
+		if (!outputPath.empty()) {
+			writeHeadlessOutput(outputPath);
+		}
+		cleanUp();
+	}
+
+	void Application::setResolution(uint32_t width, uint32_t height) {
+		mWidth = static_cast<int>(std::max(width, 1u));
+		mHeight = static_cast<int>(std::max(height, 1u));
+	}
+
+	void Application::setHelmetGrid(uint32_t count, float spacing) {
+		helmetGridCount = std::max(count, 1u);
+		helmetGridSpacing = spacing;
+	}
+
+	void Application::setInstancing(bool instancing) {
+		useInstancing = instancing;
+	}
+
+	void Application::setCameraPath(const CameraPath::Ptr& cameraPath) {
+		mCameraPath = cameraPath;
+		mCameraPathTime = 0.0f;
+	}
+
+	void Application::setProfiling(bool cpuZones, bool gpuZones, uint32_t gpuFrames) {
+		useCPUProfiler = cpuZones;
+		useGPUProfiler = gpuZones;
+		gpuProfilerFrames = std::max(gpuFrames, 1u);
+	}
+
+	uint32_t Application::getDrawCallCount() const {
+		// The scene draws and the screen quad
+		uint32_t drawCount = 1;
+		for (const auto& draw : mSceneDraws) {
+			for (const auto& model : draw.mNode->mModels) {
+				drawCount += model->getDrawCount();
+			}
+		}
+		return drawCount;
+	}
+
+	std::vector<double> Application::getGPUFrameTimes() {
+		if (mGPUProfiler == nullptr) {
+			return {};
+		}
+		// The frames still in flight are read once they completed
+		vkDeviceWaitIdle(mDevice->getDevice());
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			mGPUProfiler->collect(i);
+		}
+		return mGPUProfiler->getZoneSamples("Frame");
+	}
+
+	void Application::markStartupPhase(const std::string& name) {
+		const auto now = std::chrono::steady_clock::now();
+		mStartupPhases.push_back({ name, std::chrono::duration<double, std::milli>(now - mStartupPhaseStart).count() });
+		mStartupPhaseStart = now;
+	}
+
 	void Application::onMouseMove(double xpos, double ypos) {
 		mSphereNode->mCamera.onMouseMove(xpos, ypos);
 		mOffscreenSphereNode->mCamera.onMouseMove(xpos, ypos);
@@ -21,6 +140,71 @@ namespace FF {
 		mSkyBoxNode->mCamera.move(moveDirection);
 	}
 
+	void Application::createIBLRebaker() {
+		if (mIBLRebaker != nullptr) {
+			return;
+		}
+		// Same resolutions and sampling as the startup bake
+		IBLRebaker::Settings settings{};
+		settings.mFilteredSampling = useFilteredPrefilter;
+		settings.mSHIrradiance = useSHIrradiance;
+		mIBLRebaker = IBLRebaker::create(mDevice, mCommandPool, settings);
+		mIBLRebaker->setFrameBudget(iblRebakeBudgetMs);
+		// The maps come out in the format the startup bake samples
+		mIBLRebaker->setCompressor(mHDRCompressor);
+	}
+
+	void Application::requestEnvironment(const std::string& hdrPath) {
+		createIBLRebaker();
+		// An HDRI replaces the procedural sky until the next restart
+		useProceduralSky = false;
+		std::cout << "Rebaking environment " << hdrPath << std::endl;
+		mIBLRebaker->requestEnvironment(hdrPath);
+	}
+
+	void Application::stepTimeOfDay(float degrees) {
+		if (!useProceduralSky) {
+			std::cout << "Time of day needs the procedural sky (useProceduralSky)" << std::endl;
+			return;
+		}
+		// The sun moves on a great circle through the zenith, past 90 degrees it goes down on the other side
+		mSunElevation = std::fmod(mSunElevation + degrees + 180.0f, 360.0f) - 180.0f;
+		mSkyDirty = true;
+	}
+
+	void Application::cycleEnvironment() {
+		std::vector<std::string> hdrPaths{};
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator("assets", ec)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".hdr") {
+				hdrPaths.push_back(entry.path().generic_string());
+			}
+		}
+		if (hdrPaths.empty()) {
+			std::cout << "No .hdr environment in assets" << std::endl;
+			return;
+		}
+		std::sort(hdrPaths.begin(), hdrPaths.end());
+		auto current = std::find(hdrPaths.begin(), hdrPaths.end(), mEnvironmentPath);
+		auto next = (current == hdrPaths.end() || current + 1 == hdrPaths.end()) ? hdrPaths.begin() : current + 1;
+		requestEnvironment(*next);
+	}
+
+	void Application::dumpProfile() {
+		if (!Wrapper::CPUProfiler::isEnabled() && mGPUProfiler == nullptr) {
+			std::cout << "Profilers are off (useCPUProfiler, useGPUProfiler)" << std::endl;
+			return;
+		}
+		if (Wrapper::CPUProfiler::isEnabled()) {
+			Wrapper::CPUProfiler::exportChromeTrace("cpuTrace.json");
+		}
+		if (mGPUProfiler != nullptr) {
+			mGPUProfiler->printZoneStats();
+			mGPUProfiler->exportCSV("gpuTimings.csv");
+			mGPUProfiler->exportChromeTrace("gpuTrace.json");
+		}
+	}
+
 	float Application::GetFrameTime() {
 		static double lastTime = 0.0;
 		double currentTime = glfwGetTime();
@@ -33,6 +217,10 @@ namespace FF {
 		mWindow = Wrapper::Window::create(mWidth, mHeight);
 		mWindow->setApplication(shared_from_this());
 
+		createSceneNodes();
+	}
+
+	void Application::createSceneNodes() {
 		mSphereNode = SceneNode::create();
 		mOffscreenSphereNode = OffscreenSceneNode::create();
 		mSkyBoxNode = OffscreenSceneNode::create();
@@ -58,80 +246,232 @@ namespace FF {
 	}
 
 	void Application::initVulkan() {
-		mInstance = Wrapper::Instance::create(true);
-		mSurface = Wrapper::WindowSurface::create(mInstance, mWindow);
+		FF_CPU_ZONE("Application::initVulkan");
+		mStartupPhases.clear();
+		mStartupPhaseStart = std::chrono::steady_clock::now();
+		mInstance = Wrapper::Instance::create(true, mHeadless);
+		if (!mHeadless) {
+			mSurface = Wrapper::WindowSurface::create(mInstance, mWindow);
+		}
 		mDevice = Wrapper::Device::create(mInstance,mSurface);
 
 		mCommandPool = Wrapper::CommandPool::create(mDevice);
+		framesInFlight = std::max(1u, framesInFlight);
+
+		FramePacer::Settings pacerSettings{};
+		pacerSettings.mFrameRateLimit = frameRateLimit;
+		pacerSettings.mMaxQueuedPresents = maxQueuedPresents;
+		pacerSettings.mReportLatency = reportPresentLatency;
+		mFramePacer = FramePacer::create(mDevice, pacerSettings);
+		if (maxQueuedPresents > 0 && !mFramePacer->isPresentWaitEnabled() && !mHeadless) {
+			std::cout << "VK_KHR_present_wait not supported, presents are not paced" << std::endl;
+		}
 
+		if (useBindlessMaterials && !mDevice->isDescriptorIndexingSupported()) {
+			std::cout << "Descriptor indexing not supported, using per-binding material textures" << std::endl;
+			useBindlessMaterials = false;
+		}
+
+		if (useReflectionProbes && !mDevice->isImageCubeArraySupported()) {
+			std::cout << "imageCubeArray not supported, reflection probes disabled, pbr1 only sees the global environment" << std::endl;
+			useReflectionProbes = false;
+		}
 
-		mSwapChain = Wrapper::SwapChain::create(mDevice, mWindow, mSurface, mCommandPool);
+		if (useGPUProfiler) {
+			Wrapper::GPUProfiler::Settings profilerSettings{};
+			profilerSettings.mAverageFrames = gpuProfilerFrames;
+			mGPUProfiler = Wrapper::GPUProfiler::create(mDevice, framesInFlight + 1, profilerSettings);
+			if (sceneRecording != SceneRecording::Inline) {
+				std::cout << "GPU profiler: scene draws in secondaries are only measured as a whole, record inline for the per pipeline zones" << std::endl;
+			}
+		}
+
+		if (mHeadless) {
+			createHeadlessTargets();
+		}
+		else {
+			mSwapChain = Wrapper::SwapChain::create(mDevice, mWindow, mSurface, mCommandPool, presentMode);
+		}
 		//mWidth = mSwapChain->getSwapChainExtent().width;
 		//mHeight = mSwapChain->getSwapChainExtent().height;
 		
-		mRenderPass = Wrapper::RenderPass::create(mDevice);
-		mRenderPass = createRenderPassForSwapChain();
-		//createRenderPass();
-
-		mSwapChain->createFrameBuffers(mRenderPass);
-		mOffscreenRenderTarget = OffscreenRenderTarget::create(
-			mDevice, mCommandPool,
-			mWidth, mHeight,
-			mSwapChain->getImageCount(),
-			VK_FORMAT_R32G32B32A32_SFLOAT, // Color format
-			VK_FORMAT_D24_UNORM_S8_UINT // Depth format
-		);
+		createFrameGraph();
+		markStartupPhase("Device");
 
 		
 		HDRI::Ptr hdri = HDRI::create(mDevice, mCommandPool);
-		// HDRI cubemap
-		Wrapper::Image::Ptr HDRICubemap = hdri->LoadHDRICubeMapFromFile(
-			mDevice, mCommandPool,
-			"assets/1.hdr",
-			512, 512,
-			"shaders/HDRI2CubemapVert.spv", "shaders/HDRI2CubemapFrag.spv"
-		);
-		// // Diffuse irradiance map
-		Wrapper::Image::Ptr diffuseIrradianceMap = hdri->generateDiffuseIrradianceMap(
-			HDRICubemap,
-			mDevice, mCommandPool,
-			32, 32,
-			"shaders/SkyboxVert.spv", "shaders/CaptureDiffuseIrradianceFrag.spv"
-		);
+		IBLComputeBaker::Ptr computeBaker = IBLComputeBaker::create(mDevice, mCommandPool);
+		computeBaker->setProfiler(mGPUProfiler, framesInFlight);
+		CPUIBLBaker::Ptr cpuBaker = (useCPUIBLBake || validateIBLBake) ? CPUIBLBaker::create() : nullptr;
+		// Baked IBL resources are cached on disk, keyed by source content, resolutions, sample counts and shader binaries
+		if (useProceduralSky) {
+			mSkyAtmosphere = SkyAtmosphere::create(mDevice, mCommandPool);
+			mSkyAtmosphere->setSunAngles(mSunElevation, mSunAzimuth);
+		}
+		IBLCache::Ptr iblCache = IBLCache::create(mDevice, mCommandPool);
+		const IBLCacheKeys iblKeys = makeIBLCacheKeys(iblCache);
+		// CPU copy of the environment, only filled when a cpu bake needs it
+		IBLImageData environmentData{};
+
+		// HDRI cubemap, or the procedural sky: a few small dispatches, never cached
+		Wrapper::Image::Ptr HDRICubemap = useProceduralSky ? mSkyAtmosphere->renderEnvironment() : iblCache->load("environment", iblKeys.mEnvironment);
+		if (HDRICubemap == nullptr) {
+			if (useCPUIBLBake) {
+				environmentData = cpuBaker->equirectToCubeMapFromFile(mEnvironmentPath, 512);
+				HDRICubemap = iblCache->upload(environmentData);
+				iblCache->store("environment", iblKeys.mEnvironment, environmentData);
+			}
+			else {
+				if (useComputeIBLBake) {
+					HDRICubemap = computeBaker->equirectToCubeMap(mEnvironmentPath, 512);
+				}
+				else {
+					HDRICubemap = hdri->LoadHDRICubeMapFromFile(
+						mDevice, mCommandPool,
+						mEnvironmentPath,
+						512, 512,
+						"shaders/CubeMapCaptureVert.spv", "shaders/HDRI2CubemapFrag.spv"
+					);
+				}
+				iblCache->store("environment", iblKeys.mEnvironment, HDRICubemap);
+			}
+		}
+		auto getEnvironmentData = [&]() -> const IBLImageData& {
+			if (environmentData.empty()) {
+				environmentData = iblCache->download(HDRICubemap);
+			}
+			return environmentData;
+		};
+		// // Diffuse irradiance: 9 SH coefficients projected on the CPU, or the baked irradiance cubemap
+		SH9Irradiance diffuseIrradianceSH{};
+		Wrapper::Image::Ptr diffuseIrradianceMap{ nullptr };
+		if (useSHIrradiance) {
+			diffuseIrradianceSH = useProceduralSky
+				? projectSkyIrradiance(iblCache)
+				: SphericalHarmonics::projectEquirectIrradianceFromFile(mEnvironmentPath);
+		}
+		else {
+			diffuseIrradianceMap = iblCache->load("diffuseIrradiance", iblKeys.mDiffuseIrradiance);
+			if (diffuseIrradianceMap == nullptr) {
+				if (useCPUIBLBake) {
+					IBLImageData irradianceData = cpuBaker->generateDiffuseIrradianceMap(getEnvironmentData(), 32);
+					diffuseIrradianceMap = iblCache->upload(irradianceData);
+					iblCache->store("diffuseIrradiance", iblKeys.mDiffuseIrradiance, irradianceData);
+				}
+				else {
+					diffuseIrradianceMap = useComputeIBLBake
+						? computeBaker->generateDiffuseIrradianceMap(HDRICubemap, 32)
+						: hdri->generateDiffuseIrradianceMap(
+							HDRICubemap,
+							mDevice, mCommandPool,
+							32, 32,
+							"shaders/CubeMapCaptureVert.spv", "shaders/CaptureDiffuseIrradianceFrag.spv"
+						);
+					iblCache->store("diffuseIrradiance", iblKeys.mDiffuseIrradiance, diffuseIrradianceMap);
+				}
+			}
+		}
 		 // Specular prefilter map
-		Wrapper::Image::Ptr specularPrefilterMap = hdri->generateSpecularPrefilterMap(
-			HDRICubemap,
-			mDevice, mCommandPool,
-			128, 128,
-			"shaders/SkyboxVert.spv", "shaders/CaptureSpecularPrefilterFrag.spv"
-		);
-		// // BRDF LUT
-		Wrapper::Image::Ptr brdfLUT = hdri->generateBRDFLUT(
-			mDevice, mCommandPool,
-			512, 512,
-			"shaders/full_screen_triangle.spv", "shaders/generateBRDFFrag.spv"
-		);
+		Wrapper::Image::Ptr specularPrefilterMap = iblCache->load("specularPrefilter", iblKeys.mSpecularPrefilter);
+		if (specularPrefilterMap == nullptr) {
+			if (useCPUIBLBake) {
+				IBLImageData prefilterData = cpuBaker->generateSpecularPrefilterMap(getEnvironmentData(), 128, HDRI::SpecularPrefilterMipLevels, useFilteredPrefilter);
+				specularPrefilterMap = iblCache->upload(prefilterData);
+				iblCache->store("specularPrefilter", iblKeys.mSpecularPrefilter, prefilterData);
+			}
+			else {
+				specularPrefilterMap = useComputeIBLBake
+					? computeBaker->generateSpecularPrefilterMap(HDRICubemap, 128, HDRI::SpecularPrefilterMipLevels, useFilteredPrefilter)
+					: hdri->generateSpecularPrefilterMap(
+						HDRICubemap,
+						mDevice, mCommandPool,
+						128, 128,
+						"shaders/CubeMapCaptureVert.spv", "shaders/CaptureSpecularPrefilterFrag.spv",
+						useFilteredPrefilter
+					);
+				iblCache->store("specularPrefilter", iblKeys.mSpecularPrefilter, specularPrefilterMap);
+			}
+		}
+		// // BRDF LUT, not needed at all by the analytic env BRDF variant
+		Wrapper::Image::Ptr brdfLUT{ nullptr };
+		if (!useAnalyticEnvBRDF) {
+			brdfLUT = iblCache->load("brdfLUT", iblKeys.mBRDFLUT);
+		}
+		if (brdfLUT == nullptr && !useAnalyticEnvBRDF) {
+			if (useCPUIBLBake) {
+				IBLImageData lutData = cpuBaker->generateBRDFLUT(512);
+				brdfLUT = iblCache->upload(lutData);
+				iblCache->store("brdfLUT", iblKeys.mBRDFLUT, lutData);
+			}
+			else {
+				brdfLUT = useComputeIBLBake
+					? computeBaker->generateBRDFLUT(512)
+					: hdri->generateBRDFLUT(
+						mDevice, mCommandPool,
+						512, 512,
+						"shaders/full_screen_triangle.spv", "shaders/generateBRDFFrag.spv"
+					);
+				iblCache->store("brdfLUT", iblKeys.mBRDFLUT, brdfLUT);
+			}
+		}
+
+		// Read the gpu bakes back and compare them with the cpu kernels run on the same inputs
+		if (validateIBLBake && !useCPUIBLBake) {
+			if (!useProceduralSky) {
+				CPUIBLBaker::printComparison("environment",
+					CPUIBLBaker::compare(getEnvironmentData(), cpuBaker->equirectToCubeMapFromFile(mEnvironmentPath, 512)));
+			}
+			if (diffuseIrradianceMap != nullptr) {
+				CPUIBLBaker::printComparison("diffuseIrradiance",
+					CPUIBLBaker::compare(iblCache->download(diffuseIrradianceMap), cpuBaker->generateDiffuseIrradianceMap(getEnvironmentData(), 32)));
+			}
+			CPUIBLBaker::printComparison("specularPrefilter",
+				CPUIBLBaker::compare(iblCache->download(specularPrefilterMap),
+					cpuBaker->generateSpecularPrefilterMap(getEnvironmentData(), 128, HDRI::SpecularPrefilterMipLevels, useFilteredPrefilter)));
+			if (brdfLUT != nullptr) {
+				CPUIBLBaker::printComparison("brdfLUT",
+					CPUIBLBaker::compare(iblCache->download(brdfLUT), cpuBaker->generateBRDFLUT(512)));
+			}
+		}
+		// Error of the analytic env BRDF against the baked LUT, whichever variant is shading
+		if (validateIBLBake) {
+			IBLImageData lutData{};
+			if (brdfLUT != nullptr) {
+				lutData = iblCache->download(brdfLUT);
+			}
+			else if (!iblCache->loadData("brdfLUT", iblKeys.mBRDFLUT, lutData)) {
+				lutData = cpuBaker->generateBRDFLUT(512);
+			}
+			const CPUIBLBaker::EnvBRDFError envBRDFError = CPUIBLBaker::compareAnalyticEnvBRDF(lutData);
+			CPUIBLBaker::printComparison("analyticEnvBRDF", { envBRDFError.mScaleBias });
+			std::cout << "IBL validation: analyticEnvBRDF dielectric rmse " << envBRDFError.mDielectricRMSE
+				<< " max abs " << envBRDFError.mMaxDielectricError << std::endl;
+			if (!envBRDFError.mPassed) {
+				throw std::runtime_error("Error: analytic env BRDF is past its tolerance against the BRDF LUT!");
+			}
+		}
+
+		// Sampled copies in BC6H (B10G11R11 without BC support), the RGBA32F bakes stay for the probe and volume captures below
+		if (useCompressedIBL) {
+			mHDRCompressor = HDRCompressor::create(mDevice, mCommandPool);
+		}
+		const Wrapper::Image::Ptr environmentMap = compressIBLMap(HDRICubemap, iblCache, "environment", iblKeys.mEnvironment);
+		const Wrapper::Image::Ptr prefilterMap = compressIBLMap(specularPrefilterMap, iblCache, "specularPrefilter", iblKeys.mSpecularPrefilter);
+		if (diffuseIrradianceMap != nullptr) {
+			diffuseIrradianceMap = compressIBLMap(diffuseIrradianceMap, iblCache, "diffuseIrradiance", iblKeys.mDiffuseIrradiance);
+		}
 
 
 		mSphereNode->mUniformManager = UniformManager::create();
-		mSphereNode->mUniformManager->init(mDevice,mCommandPool, mSwapChain->getImageCount());
+		mSphereNode->mUniformManager->init(mDevice,mCommandPool, framesInFlight);
 		mSphereNode->mUniformManager->build();
 
 		mSkyBoxNode->mUniformManager = UniformManager::create();
-		mSkyBoxNode->mUniformManager->init(mDevice, mCommandPool, mSwapChain->getImageCount());
-		mSkyBoxNode->mUniformManager->attachCubeMap(HDRICubemap);
+		mSkyBoxNode->mUniformManager->init(mDevice, mCommandPool, framesInFlight);
+		mSkyBoxNode->mUniformManager->attachCubeMap(environmentMap);
 		mSkyBoxNode->mUniformManager->build();
 
-		/*
-		*	layout(set =0, binding = 4) uniform samplerCube U_prefilteredColor;
-		*	layout(set = 0, binding = 5) uniform samplerCube U_DiffuseIrradiance;
-		*	layout(set = 0, binding = 6) uniform sampler2D U_BRDFLUT;
-		*/
-		mOffscreenSphereNode->mUniformManager = UniformManager::create();
-		mOffscreenSphereNode->mUniformManager->init(mDevice, mCommandPool, mSwapChain->getImageCount());
-		mOffscreenSphereNode->mUniformManager->attachCubeMap(specularPrefilterMap);
-		mOffscreenSphereNode->mUniformManager->attachCubeMap(diffuseIrradianceMap);
-		mOffscreenSphereNode->mUniformManager->attachImage(brdfLUT);
+		markStartupPhase("IBL");
 
 		//Helmet Images
 		Wrapper::Image::Ptr Albedo = Wrapper::Image::createFromFile(mDevice, mCommandPool,"assets/DamagedHelmet/Default_albedo.jpg",VK_FORMAT_R8G8B8A8_UNORM);
@@ -141,37 +481,70 @@ namespace FF {
 		Wrapper::Image::Ptr AO = Wrapper::Image::createFromFile(mDevice, mCommandPool, "assets/DamagedHelmet/Default_AO.jpg", VK_FORMAT_R8G8B8A8_UNORM);
 		Wrapper::Image::Ptr Emissive = Wrapper::Image::createFromFile(mDevice, mCommandPool, "assets/DamagedHelmet/Default_emissive.jpg", VK_FORMAT_R8G8B8A8_UNORM);
 		Wrapper::Image::Ptr Default_metalRoughness = Wrapper::Image::createFromFile(mDevice, mCommandPool, "assets/DamagedHelmet/Default_metalRoughness.jpg", VK_FORMAT_R8G8B8A8_UNORM);
-		
 
-		//Helmet Images
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Albedo);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Normal);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Emissive);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(AO);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Metallic);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Roughness);
-		mOffscreenSphereNode->mUniformManager->attachMapImage(Default_metalRoughness);
-	
-
-		mOffscreenSphereNode->mUniformManager->build();
-
-
-		
-		std::vector<std::string> textureFiles;
-		textureFiles.push_back("assets/book.jpg");
-		textureFiles.push_back("assets/diffuse.jpg");
-		textureFiles.push_back("assets/metal.jpg");
+		// Set 0 of a helmet: its transforms, the IBL maps and, without bindless, the helmet maps.
+		// Every helmet of the grid gets its own, they differ in the model matrix only
+		/*
+		*	layout(set =0, binding = 4) uniform samplerCube U_prefilteredColor;
+		*	layout(set = 0, binding = 5) uniform samplerCube U_DiffuseIrradiance; (uniform DiffuseIrradianceSH with IRRADIANCE_SH)
+		*	layout(set = 0, binding = 6) uniform sampler2D U_BRDFLUT;
+		*/
+		auto createHelmetUniformManager = [&]() {
+			UniformManager::Ptr uniformManager = UniformManager::create();
+			uniformManager->init(mDevice, mCommandPool, framesInFlight);
+			uniformManager->attachCubeMap(prefilterMap);
+			if (useSHIrradiance) {
+				uniformManager->attachUniformData(&diffuseIrradianceSH, sizeof(SH9Irradiance));
+			}
+			else {
+				uniformManager->attachCubeMap(diffuseIrradianceMap);
+			}
+			if (useAnalyticEnvBRDF) {
+				uniformManager->reserveImageBinding();
+			}
+			else {
+				uniformManager->attachImage(brdfLUT);
+			}
+			if (!useBindlessMaterials) {
+				uniformManager->attachMapImage(Albedo);
+				uniformManager->attachMapImage(Normal);
+				uniformManager->attachMapImage(Emissive);
+				uniformManager->attachMapImage(AO);
+				uniformManager->attachMapImage(Metallic);
+				uniformManager->attachMapImage(Roughness);
+				uniformManager->attachMapImage(Default_metalRoughness);
+			}
+			uniformManager->build();
+			return uniformManager;
+		};
 
+		mOffscreenSphereNode->mMaterial = Material::create();
+		if (useBindlessMaterials) {
+			// Helmet maps live in the global table, set 0 only keeps the scene and IBL bindings (0-6)
+			mBindlessTextureTable = BindlessTextureTable::create(mDevice, framesInFlight);
+			auto mapSampler = Wrapper::Sampler::create(mDevice, false, true);
+			mOffscreenSphereNode->mMaterial->attachToBindlessTable(
+				mBindlessTextureTable,
+				{ Albedo, Normal, Emissive, AO, Metallic, Roughness, Default_metalRoughness },
+				mapSampler);
+		}
+		else {
+			std::vector<std::string> textureFiles;
+			textureFiles.push_back("assets/book.jpg");
+			textureFiles.push_back("assets/diffuse.jpg");
+			textureFiles.push_back("assets/metal.jpg");
 
+			mOffscreenSphereNode->mMaterial->attachTexturePaths(textureFiles);
+			mOffscreenSphereNode->mMaterial->init(mDevice, mCommandPool, framesInFlight);
+		}
 
-		mOffscreenSphereNode->mMaterial = Material::create();
-		mOffscreenSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mOffscreenSphereNode->mMaterial->init(mDevice, mCommandPool, mSwapChain->getImageCount());
+		mOffscreenSphereNode->mUniformManager = createHelmetUniformManager();
 
 		mSphereNode->mMaterial = Material::create();
 		//mSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mSphereNode->mMaterial->attachImages(mOffscreenRenderTarget->getRenderTargetImages()); // Attach the offscreen render target images to the material
-		mSphereNode->mMaterial->init(mDevice, mCommandPool,mSwapChain->getImageCount());
+		// The resolved scene of the frame graph, one image shared by the frames in flight
+		mSphereNode->mMaterial->attachImages(std::vector<Wrapper::Image::Ptr>(framesInFlight, mFrameGraph->getImage(mSceneColor)));
+		mSphereNode->mMaterial->init(mDevice, mCommandPool,framesInFlight);
 
 		//No material for the skybox, just use the cubemap texture
 
@@ -180,6 +553,21 @@ namespace FF {
 		mPushConstantManager = PushConstantManager::create();
 		mPushConstantManager->init();
 
+		// Set 2 of the PBR pipeline, holds a placeholder until the probes are baked.
+		// Without probes the pbr1 variant declares no set 2, an empty layout keeps set 3 at its index
+		if (useReflectionProbes) {
+			// One probe selection per helmet of the grid
+			ReflectionProbeSet::Settings probeSettings{};
+			probeSettings.mObjectCount = helmetGridCount;
+			mReflectionProbes = ReflectionProbeSet::create(mDevice, mCommandPool, framesInFlight, probeSettings);
+		}
+		else {
+			mEmptySetLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+			mEmptySetLayout->build({});
+		}
+		// Set 3, the global irradiance is used until the volume is baked
+		mIrradianceVolume = IrradianceVolume::create(mDevice, mCommandPool, framesInFlight);
+
 		// Create a model
 		Model::Ptr commonModel = Model::create(mDevice);
 		Model::Ptr offscreenModel = Model::create(mDevice);
@@ -198,7 +586,35 @@ namespace FF {
 			mSkyBoxNode->mModels.push_back(skyboxModel);
 			mSkyBoxNode->mModels[0]->setModelMatrix(glm::mat4(1.0f));
 
-			mPipeline = createPipeline("shaders/pbr1Vert.spv", "shaders/pbr1Frag.spv");
+			// The probes and the irradiance volume capture the helmet itself
+			mProbeCaptureMeshes.push_back({ offscreenModel, "assets/DamagedHelmet.staticmesh", glm::mat4(1.0f), glm::vec4(0.5f, 0.5f, 0.5f, 1.0f) });
+
+			if (useReflectionProbes) {
+				// Two demo probes on either side of the helmet, one per proxy shape
+				ReflectionProbe boxProbe{};
+				boxProbe.mPosition = glm::vec3(0.0f, 0.0f, 2.5f);
+				boxProbe.mProxy = ReflectionProbeProxy::Box;
+				boxProbe.mBoxHalfExtent = glm::vec3(4.0f);
+				boxProbe.mBlendDistance = 1.0f;
+				mReflectionProbes->addProbe(boxProbe);
+
+				ReflectionProbe sphereProbe{};
+				sphereProbe.mPosition = glm::vec3(0.0f, 0.0f, -2.5f);
+				sphereProbe.mProxy = ReflectionProbeProxy::Sphere;
+				sphereProbe.mRadius = 5.0f;
+				sphereProbe.mBlendDistance = 1.0f;
+				mReflectionProbes->addProbe(sphereProbe);
+
+				mReflectionProbes->bake(HDRICubemap, mProbeCaptureMeshes, iblCache, iblKeys.mEnvironment);
+			}
+			if (useIrradianceVolume) {
+				mIrradianceVolume->bake(HDRICubemap, mProbeCaptureMeshes, iblCache, iblKeys.mEnvironment);
+			}
+
+			mPipeline = createPipeline("shaders/pbr1Vert.spv", getPBRFragShaderPath());
+			if (useInstancing) {
+				mInstancedPipeline = createPipeline("shaders/pbr1InstancedVert.spv", getPBRFragShaderPath(), true);
+			}
 		}
 		else {
 			commonModel->loadModel("assets/book.obj", mDevice);
@@ -211,10 +627,30 @@ namespace FF {
 
 			mPipeline = createPipeline("shaders/vs.spv","shaders/fs.spv");
 		}
-		mScreenQuadPipeline = createScreenQuadPipeline(mRenderPass);
+		// The other helmets of the grid share the model and the material of the first one.
+		// Instanced, they only add their transform to the group of the first one and need no set 0 of their own
+		const std::vector<glm::vec3> helmetPositions = makeHelmetGrid(helmetGridCount, helmetGridSpacing);
+		mHelmetNodes = { mOffscreenSphereNode };
+		for (size_t i = 1; i < helmetPositions.size(); i++) {
+			OffscreenSceneNode::Ptr helmetNode = OffscreenSceneNode::create();
+			helmetNode->mModels = mOffscreenSphereNode->mModels;
+			helmetNode->mMaterial = mOffscreenSphereNode->mMaterial;
+			if (mInstancedPipeline == nullptr) {
+				helmetNode->mUniformManager = createHelmetUniformManager();
+			}
+			mHelmetNodes.push_back(helmetNode);
+		}
+		for (size_t i = 0; i < mHelmetNodes.size(); i++) {
+			// Placed once, draw never updates them again from the worker threads
+			mHelmetNodes[i]->SetPosition(helmetPositions[i].x, helmetPositions[i].y, helmetPositions[i].z);
+			mHelmetNodes[i]->Update();
+		}
+		markStartupPhase("Scene");
+
+		mScreenQuadPipeline = createScreenQuadPipeline(mFrameGraph->getRenderPass(mScreenQuadPass));
 		mSkyBoxPipeline = OffscreenPipeline::create(mDevice);
 		mSkyBoxPipeline->build(
-			mOffscreenRenderTarget->getRenderPass(),
+			mFrameGraph->getRenderPass(mScenePass),
 			mWidth, mHeight,
 			"shaders/SkyboxVert.spv", "shaders/SkyBoxFrag.spv",
 			{ mSkyBoxNode->mUniformManager->getDescriptorLayout()->getLayout() },
@@ -225,9 +661,28 @@ namespace FF {
 			VK_FRONT_FACE_CLOCKWISE
 		);
 
+		// Same order as the draws were recorded inline, the ranges keep it
+		mSceneDraws = { { mSkyBoxNode, SceneDrawState::SkyBox } };
+		if (mInstancedPipeline != nullptr) {
+			mInstanceBatcher = InstanceBatcher::create(mDevice, framesInFlight);
+			mInstanceBatcher->build(std::vector<SceneNode::Ptr>(mHelmetNodes.begin(), mHelmetNodes.end()));
+			for (uint32_t i = 0; i < mInstanceBatcher->getGroups().size(); i++) {
+				const auto& group = mInstanceBatcher->getGroups()[i];
+				mSceneDraws.push_back({ group.mNodes[0], SceneDrawState::PBRInstanced, i });
+				mSceneObjects.insert(mSceneObjects.end(), group.mNodes.begin(), group.mNodes.end());
+			}
+		}
+		else {
+			for (const auto& helmetNode : mHelmetNodes) {
+				mSceneDraws.push_back({ helmetNode, SceneDrawState::PBR, 0, static_cast<uint32_t>(mSceneObjects.size()) });
+				mSceneObjects.push_back(helmetNode);
+			}
+		}
+
 		createCommandBuffers();
 
 		createSyncObjects();
+		markStartupPhase("Pipelines");
 
 		//createTexture();
 		
@@ -235,12 +690,117 @@ namespace FF {
 
 	}
 
+	std::string Application::getPBRFragShaderPath() const {
+		// One variant per combination of the BINDLESS_MATERIALS, IRRADIANCE_SH and REFLECTION_PROBES defines, see shaders/compile.bat
+		std::string path = "shaders/pbr1";
+		if (useBindlessMaterials) {
+			path += "Bindless";
+		}
+		if (useSHIrradiance) {
+			path += "SH";
+		}
+		if (mReflectionProbes != nullptr) {
+			path += "Probes";
+		}
+		return path + "Frag.spv";
+	}
+
 	// Create a pipeline
-	Wrapper::Pipeline::Ptr  Application::createPipeline(const std::string& vertexShaderFile,const std::string& fragShaderFile) {
+	Application::IBLCacheKeys Application::makeIBLCacheKeys(const IBLCache::Ptr& iblCache) const {
+		// Each producer hashes its own kernels: shader binaries for the gpu bakers, CPUIBLBaker::Version for the cpu one
+		auto bakeInputs = [this](std::vector<std::string> inputs, const std::vector<std::string>& computeShaders, const std::vector<std::string>& rasterShaders) {
+			if (!useCPUIBLBake) {
+				const auto& shaders = useComputeIBLBake ? computeShaders : rasterShaders;
+				inputs.insert(inputs.end(), shaders.begin(), shaders.end());
+			}
+			return inputs;
+		};
+		auto bakeParameters = [this](std::vector<uint32_t> parameters) {
+			if (useCPUIBLBake) {
+				parameters.push_back(CPUIBLBaker::Version);
+			}
+			return parameters;
+		};
+
+		IBLCacheKeys keys{};
+		const uint32_t environmentMipLevels = Wrapper::Image::getMaxMipLevels(512, 512);
+		if (useProceduralSky && mSkyAtmosphere != nullptr) {
+			// The sky is not cached itself, its key covers the atmosphere, the sun and the kernels for everything baked from it
+			keys.mEnvironment = iblCache->makeKey(
+				std::vector<std::string>(std::begin(SkyAtmosphere::ShaderPaths), std::end(SkyAtmosphere::ShaderPaths)),
+				mSkyAtmosphere->getKeyParameters());
+		}
+		else {
+			keys.mEnvironment = iblCache->makeKey(
+				bakeInputs({ mEnvironmentPath }, { "shaders/EquirectToCubeComp.spv" }, { "shaders/CubeMapCaptureVert.spv", "shaders/HDRI2CubemapFrag.spv" }),
+				bakeParameters({ 512, 512, environmentMipLevels }));
+		}
+		keys.mDiffuseIrradiance = iblCache->makeKey(
+			bakeInputs({}, { "shaders/DiffuseIrradianceComp.spv" }, { "shaders/CubeMapCaptureVert.spv", "shaders/CaptureDiffuseIrradianceFrag.spv" }),
+			bakeParameters({ 32, 32, HDRI::DiffuseIrradianceSampleCount }),
+			keys.mEnvironment);
+		keys.mSpecularPrefilter = iblCache->makeKey(
+			bakeInputs({}, { "shaders/SpecularPrefilterComp.spv" }, { "shaders/CubeMapCaptureVert.spv", "shaders/CaptureSpecularPrefilterFrag.spv" }),
+			bakeParameters({ 128, 128, HDRI::SpecularPrefilterMipLevels,
+				useFilteredPrefilter ? HDRI::FilteredPrefilterSampleCount : HDRI::SpecularPrefilterSampleCount, useFilteredPrefilter ? 1u : 0u }),
+			keys.mEnvironment);
+		// The BRDF LUT does not depend on the environment
+		keys.mBRDFLUT = iblCache->makeKey(
+			bakeInputs({}, { "shaders/BRDFLUTComp.spv" }, { "shaders/full_screen_triangle.spv", "shaders/generateBRDFFrag.spv" }),
+			bakeParameters({ 512, 512, HDRI::BRDFLUTSampleCount }));
+		return keys;
+	}
+
+	void Application::bakeIBLOffline() {
+		// No window or device: cpu kernels only, written with the same keys initVulkan uses when useCPUIBLBake is set
+		useCPUIBLBake = true;
+		IBLCache::Ptr iblCache = IBLCache::create(nullptr, nullptr);
+		CPUIBLBaker::Ptr cpuBaker = CPUIBLBaker::create();
+		const IBLCacheKeys iblKeys = makeIBLCacheKeys(iblCache);
+		std::cout << "IBL offline bake on " << cpuBaker->getThreadCount() << " threads" << std::endl;
+
+		IBLImageData environmentData{};
+		if (!iblCache->loadData("environment", iblKeys.mEnvironment, environmentData)) {
+			environmentData = cpuBaker->equirectToCubeMapFromFile(mEnvironmentPath, 512);
+			iblCache->store("environment", iblKeys.mEnvironment, environmentData);
+		}
+		IBLImageData irradianceData{};
+		if (!useSHIrradiance && !iblCache->loadData("diffuseIrradiance", iblKeys.mDiffuseIrradiance, irradianceData)) {
+			irradianceData = cpuBaker->generateDiffuseIrradianceMap(environmentData, 32);
+			iblCache->store("diffuseIrradiance", iblKeys.mDiffuseIrradiance, irradianceData);
+		}
+		IBLImageData prefilterData{};
+		if (!iblCache->loadData("specularPrefilter", iblKeys.mSpecularPrefilter, prefilterData)) {
+			prefilterData = cpuBaker->generateSpecularPrefilterMap(environmentData, 128, HDRI::SpecularPrefilterMipLevels, useFilteredPrefilter);
+			iblCache->store("specularPrefilter", iblKeys.mSpecularPrefilter, prefilterData);
+		}
+		IBLImageData cachedData{};
+		if (!useAnalyticEnvBRDF && !iblCache->loadData("brdfLUT", iblKeys.mBRDFLUT, cachedData)) {
+			iblCache->store("brdfLUT", iblKeys.mBRDFLUT, cpuBaker->generateBRDFLUT(512));
+		}
+
+		// BC6H copies, what initVulkan loads on devices with BC support. The others encode B10G11R11 on their first run
+		if (useCompressedIBL) {
+			HDRCompressor::Ptr compressor = HDRCompressor::create(nullptr, nullptr);
+			const VkFormat format = VK_FORMAT_BC6H_UFLOAT_BLOCK;
+			auto cookCompressed = [&](const std::string& name, uint64_t key, const IBLImageData& data) {
+				const uint64_t compressedKey = iblCache->makeKey({}, HDRCompressor::getKeyParameters(format), key);
+				IBLCompressedImageData compressedData{};
+				if (!data.empty() && !iblCache->loadData(name + "Compressed", compressedKey, compressedData)) {
+					iblCache->store(name + "Compressed", compressedKey, compressor->encode(data, format));
+				}
+			};
+			cookCompressed("environment", iblKeys.mEnvironment, environmentData);
+			cookCompressed("specularPrefilter", iblKeys.mSpecularPrefilter, prefilterData);
+			cookCompressed("diffuseIrradiance", iblKeys.mDiffuseIrradiance, irradianceData);
+		}
+	}
+
+	Wrapper::Pipeline::Ptr  Application::createPipeline(const std::string& vertexShaderFile,const std::string& fragShaderFile, bool instanced) {
 		// Create a pipeline using the shader
 		// mPipeline = Wrapper::Pipeline::create(mDevice, mSwapChain, mShader);
 
-		Wrapper::Pipeline::Ptr mPipeline = Wrapper::Pipeline::create(mDevice, mOffscreenRenderTarget->getRenderPass());
+		Wrapper::Pipeline::Ptr mPipeline = Wrapper::Pipeline::create(mDevice, mFrameGraph->getRenderPass(mScenePass));
 
 		// Set up viewport and scissor
 		VkViewport viewport{};
@@ -263,6 +823,8 @@ namespace FF {
 		auto vertexShader = Wrapper::Shader::create(mDevice, vertexShaderFile, VK_SHADER_STAGE_VERTEX_BIT, "main");
 		shaderGroup.push_back(vertexShader);
 		auto fragmentShader = Wrapper::Shader::create(mDevice, fragShaderFile, VK_SHADER_STAGE_FRAGMENT_BIT, "main");
+		// constant_id 0 of the pbr1 variants, ignored by shaders that do not declare it
+		fragmentShader->setSpecializationConstant(0, useAnalyticEnvBRDF ? VK_TRUE : VK_FALSE);
 		shaderGroup.push_back(fragmentShader);
 
 		mPipeline->setShaderGroup(shaderGroup);
@@ -275,14 +837,17 @@ namespace FF {
 		mPipeline->mViewportState.scissorCount = static_cast<uint32_t>(mPipeline->mScissors.size());
 		mPipeline->mViewportState.pScissors = mPipeline->mScissors.data();
 
-		//Dynamic state if needed
-		mPipeline->mDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		mPipeline->mDynamicState.dynamicStateCount = 0; // No dynamic state for now
-		mPipeline->mDynamicState.pDynamicStates = nullptr; // No dynamic state for now
+		// Viewport and scissor are dynamic (Wrapper::Pipeline default), set when recording
 
 		// Layout of vertex data
 		auto bindingDescriptions = mOffscreenSphereNode->mModels[0]->getVertexInputBindingDescriptions();
 		auto attributeDescriptions = mOffscreenSphereNode->mModels[0]->getAttributeDescriptions();
+		if (instanced) {
+			const auto instanceBindings = InstanceBatcher::getInstanceBindingDescriptions();
+			const auto instanceAttributes = InstanceBatcher::getInstanceAttributeDescriptions();
+			bindingDescriptions.insert(bindingDescriptions.end(), instanceBindings.begin(), instanceBindings.end());
+			attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+		}
 
 		// Vertex input state
 		mPipeline->mVertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -366,15 +931,30 @@ namespace FF {
 		mPipeline->mPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		
 		auto layout0 = mOffscreenSphereNode->mUniformManager->getDescriptorLayout()->getLayout();
-		auto layout1 = mOffscreenSphereNode->mMaterial->getDescriptorLayout()->getLayout();
+		// Bindless: every material shares the table layout, so this layout never changes with the material
+		auto layout1 = useBindlessMaterials ? mBindlessTextureTable->getDescriptorLayout()->getLayout() : mOffscreenSphereNode->mMaterial->getDescriptorLayout()->getLayout();
 
-		std::vector<VkDescriptorSetLayout> layouts = { layout0, layout1 };
+		// Local reflection probes
+		auto layout2 = mReflectionProbes != nullptr ? mReflectionProbes->getDescriptorLayout()->getLayout() : mEmptySetLayout->getLayout();
+
+		// Irradiance volume
+		auto layout3 = mIrradianceVolume->getDescriptorLayout()->getLayout();
+
+		std::vector<VkDescriptorSetLayout> layouts = { layout0, layout1, layout2, layout3 };
 		mPipeline->mPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
 		mPipeline->mPipelineLayoutInfo.pSetLayouts = layouts.data();
-		auto pushConstantRange = mPushConstantManager->getPushConstantRanges()->getPushConstantRange();
 		// Transform the push constant ranges to VkPushConstantRange
-		mPipeline->mPipelineLayoutInfo.pushConstantRangeCount = 1;
-		mPipeline->mPipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		std::vector<VkPushConstantRange> pushConstantRanges = { mPushConstantManager->getPushConstantRanges()->getPushConstantRange() };
+		if (useBindlessMaterials) {
+			// Material index for the fragment stage, right after the vertex constants
+			VkPushConstantRange materialRange{};
+			materialRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			materialRange.offset = mPushConstantManager->getConstantParam().offset + mPushConstantManager->getConstantParam().size;
+			materialRange.size = sizeof(uint32_t);
+			pushConstantRanges.push_back(materialRange);
+		}
+		mPipeline->mPipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		mPipeline->mPipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
 		mPipeline->build();
 
@@ -411,10 +991,7 @@ namespace FF {
 		screenQuadPipeline->mViewportState.pScissors = screenQuadPipeline->mScissors.data();
 
 
-		//Dynamic state if needed
-		screenQuadPipeline->mDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		screenQuadPipeline->mDynamicState.dynamicStateCount = 0; // No dynamic state for now
-		screenQuadPipeline->mDynamicState.pDynamicStates = nullptr; // No dynamic state for now
+		// Viewport and scissor are dynamic (Wrapper::Pipeline default), set when recording
 
 		// shader
 		auto vs = Wrapper::Shader::create(mDevice, "shaders/full_screen_triangle.spv", VK_SHADER_STAGE_VERTEX_BIT, "main");
@@ -444,7 +1021,8 @@ namespace FF {
 
 		screenQuadPipeline->mMultisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 		screenQuadPipeline->mMultisampleState.sampleShadingEnable = VK_FALSE;
-		screenQuadPipeline->mMultisampleState.rasterizationSamples = mDevice->getMaxUsableSampleCount();
+		// Straight into the swap chain image, a full screen triangle has no edges to antialias
+		screenQuadPipeline->mMultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
 		screenQuadPipeline->mDepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		screenQuadPipeline->mDepthStencilState.depthTestEnable = VK_FALSE;
@@ -484,20 +1062,134 @@ namespace FF {
 		mFences.clear();
 
 		// Release command buffers
+		mSceneCommandCache.reset();
+		mCommandRecorder.reset();
 		mCommandBuffers.clear();
+		mFrameCommandPools.clear();
 
 		mBattleFirePipeline.reset();
-		mRenderPass.reset();
 		mSwapChain.reset();
 		mCurrentFrame = 0;
 
 	}
 	void Application::cleanUpOffScreenResources() {
-		mOffscreenRenderTarget.reset();
-		mScreenQuadPipeline.reset();
-		mSkyBoxPipeline.reset();
-		mPipeline.reset();
+		// The graph holds framebuffers of the swap chain image views, it goes first
 		mSphereNode->mMaterial.reset();
+		mFrameGraph.reset();
+	}
+
+	SH9Irradiance Application::projectSkyIrradiance(const IBLCache::Ptr& iblCache) {
+		// A 32x32 mip carries more than the three SH bands need
+		const IBLImageData environmentData = iblCache->download(mSkyAtmosphere->getEnvironment());
+		const uint32_t level = std::min(2u, environmentData.mMipLevels - 1);
+		return SphericalHarmonics::projectCubeMapIrradiance(environmentData, level);
+	}
+
+	void Application::applyProceduralSky() {
+		FF_CPU_ZONE("Application::applyProceduralSky");
+		// The running bake still has to copy the sky out of its render target, the latest sun goes once it is done
+		if (mIBLRebaker != nullptr && mIBLRebaker->isBusy()) {
+			return;
+		}
+		createIBLRebaker();
+		// The sky renders into its own target, the skybox and the helmets keep sampling the current maps until the bake is swapped in
+		mSkyAtmosphere->setSunAngles(mSunElevation, mSunAzimuth);
+		mSkyAtmosphere->submitEnvironment();
+		mIBLRebaker->requestCubeMap(mSkyAtmosphere->getEnvironment());
+		mSkyDirty = false;
+		std::cout << "Sun elevation " << mSunElevation << " degrees" << std::endl;
+	}
+
+	Wrapper::Image::Ptr Application::compressIBLMap(const Wrapper::Image::Ptr& image, const IBLCache::Ptr& iblCache, const std::string& name, uint64_t key) {
+		if (mHDRCompressor == nullptr || mHDRCompressor->getFormat() == VK_FORMAT_UNDEFINED) {
+			return image;
+		}
+
+		const VkFormat format = mHDRCompressor->getFormat();
+		const uint64_t compressedKey = iblCache->makeKey({}, HDRCompressor::getKeyParameters(format), key);
+		IBLCompressedImageData data{};
+		if (!iblCache->loadData(name + "Compressed", compressedKey, data)) {
+			data = mHDRCompressor->encode(iblCache->download(image), format);
+			iblCache->store(name + "Compressed", compressedKey, data);
+		}
+		return iblCache->upload(data);
+	}
+
+	void Application::applyRebakedEnvironment(const IBLRebaker::Result& result, bool rebakeLocalLighting) {
+		FF_CPU_ZONE("Application::applyRebakedEnvironment");
+		// The frames in flight bind the current sets: each frame switches once its own fence signaled, see applyPendingEnvironment.
+		// The maps arrive compressed from the rebaker with useCompressedIBL, the old ones are released with the last set using them.
+		mPendingEnvironment = std::make_unique<PendingEnvironment>();
+		mPendingEnvironment->mEnvironment = result.mEnvironment;
+		mPendingEnvironment->mDiffuseIrradiance = result.mDiffuseIrradiance;
+		mPendingEnvironment->mSpecularPrefilter = result.mSpecularPrefilter;
+		mPendingEnvironment->mIrradianceSH = result.mIrradianceSH;
+		mPendingEnvironment->mPendingFrames.assign(framesInFlight, true);
+
+		if (!useProceduralSky) {
+			mEnvironmentPath = result.mSourcePath;
+		}
+		// The probes and the volume captured the old environment around the scene, they are captured again a step per frame
+		// and keep lighting the scene with the old environment until then
+		const bool hasProbes = mReflectionProbes != nullptr && !mReflectionProbes->getProbes().empty();
+		const bool hasVolume = mIrradianceVolume != nullptr && mIrradianceVolume->isBaked();
+		if (rebakeLocalLighting && (hasProbes || hasVolume)) {
+			if (mLocalLightingRebaker == nullptr) {
+				mLocalLightingRebaker = LocalLightingRebaker::create(mDevice, mCommandPool, mReflectionProbes, mIrradianceVolume, mProbeCaptureMeshes);
+			}
+			mLocalLightingRebaker->requestEnvironment(result.mEnvironment);
+		}
+
+		if (!useProceduralSky) {
+			std::cout << "Environment switched to " << mEnvironmentPath << std::endl;
+		}
+	}
+
+	void Application::applyPendingEnvironment() {
+		bool localLightingChanged = false;
+		if (mReflectionProbes != nullptr) {
+			localLightingChanged |= mReflectionProbes->applyPendingBindings(mCurrentFrame);
+		}
+		if (mIrradianceVolume != nullptr) {
+			localLightingChanged |= mIrradianceVolume->applyPendingBindings(mCurrentFrame);
+		}
+
+		const bool environmentChanged = mPendingEnvironment != nullptr && mPendingEnvironment->mPendingFrames[mCurrentFrame];
+		if (environmentChanged) {
+			const PendingEnvironment& pending = *mPendingEnvironment;
+			mSkyBoxNode->mUniformManager->replaceImage(4, pending.mEnvironment, mCurrentFrame);
+			mSkyBoxNode->invalidateDraw();
+		}
+		if (!environmentChanged && !localLightingChanged) {
+			return;
+		}
+
+		for (const auto& draw : mSceneDraws) {
+			if (draw.mState == SceneDrawState::SkyBox) {
+				continue;
+			}
+			const SceneNode::Ptr& helmetNode = draw.mNode;
+			if (environmentChanged) {
+				// Bindings 4 and 5 of the PBR set 0 of every helmet draw, see initVulkan
+				const PendingEnvironment& pending = *mPendingEnvironment;
+				helmetNode->mUniformManager->replaceImage(4, pending.mSpecularPrefilter, mCurrentFrame);
+				if (useSHIrradiance) {
+					helmetNode->mUniformManager->updateUniformData(5, &pending.mIrradianceSH, sizeof(SH9Irradiance), mCurrentFrame);
+				}
+				else {
+					helmetNode->mUniformManager->replaceImage(5, pending.mDiffuseIrradiance, mCurrentFrame);
+				}
+			}
+			// A set was rewritten, which invalidates the cached secondaries binding it
+			helmetNode->invalidateDraw();
+		}
+
+		if (environmentChanged) {
+			mPendingEnvironment->mPendingFrames[mCurrentFrame] = false;
+			if (std::none_of(mPendingEnvironment->mPendingFrames.begin(), mPendingEnvironment->mPendingFrames.end(), [](bool pendingFrame) { return pendingFrame; })) {
+				mPendingEnvironment.reset();
+			}
+		}
 	}
 
 	void Application::createUniformParameters() {
@@ -507,6 +1199,7 @@ namespace FF {
 
 
 	void Application::recreateSwapChain() {
+		FF_CPU_ZONE("Application::recreateSwapChain");
 
 		int width = 0, height = 0;
 		glfwGetFramebufferSize(mWindow->getWindow(), &width, &height);
@@ -517,226 +1210,104 @@ namespace FF {
 
 		vkDeviceWaitIdle(mDevice->getDevice());
 
-		cleanUpSwapChain();
 		cleanUpOffScreenResources();
+		cleanUpSwapChain();
+		mFramePacer->resetSwapChain();
 
-		mSwapChain = Wrapper::SwapChain::create(mDevice, mWindow, mSurface, mCommandPool);
+		mSwapChain = Wrapper::SwapChain::create(mDevice, mWindow, mSurface, mCommandPool, presentMode);
 		mWidth = mSwapChain->getSwapChainExtent().width;
 		mHeight = mSwapChain->getSwapChainExtent().height;
 
-		mRenderPass = Wrapper::RenderPass::create(mDevice);
-		mRenderPass = createRenderPassForSwapChain();
-		//mRenderPass = createRenderPass();
-
-
-		mOffscreenRenderTarget = OffscreenRenderTarget::create(
-			mDevice, mCommandPool,
-			mWidth, mHeight,
-			mSwapChain->getImageCount(),
-			VK_FORMAT_R32G32B32A32_SFLOAT, // Color format
-			VK_FORMAT_D24_UNORM_S8_UINT // Depth format
-		);
+		createFrameGraph();
 
 		mSphereNode->mMaterial = Material::create();
 		//mSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mSphereNode->mMaterial->attachImages(mOffscreenRenderTarget->getRenderTargetImages()); // Attach the offscreen render target images to the material
-		mSphereNode->mMaterial->init(mDevice, mCommandPool, mSwapChain->getImageCount());
-
-		mPipeline = createPipeline("shaders/pbr1Vert.spv", "shaders/pbr1Frag.spv");
-		mScreenQuadPipeline = createScreenQuadPipeline(mRenderPass);
-		mSkyBoxPipeline = OffscreenPipeline::create(mDevice);
-		mSkyBoxPipeline->build(
-			mOffscreenRenderTarget->getRenderPass(),
-			mWidth, mHeight,
-			"shaders/SkyboxVert.spv", "shaders/SkyBoxFrag.spv",
-			{ mSkyBoxNode->mUniformManager->getDescriptorLayout()->getLayout() },
-			mSkyBoxNode->mModels[0]->getVertexInputBindingDescriptions(),
-			mSkyBoxNode->mModels[0]->getAttributeDescriptions(),
-			nullptr, // No push constants
-			mDevice->getMaxUsableSampleCount(),
-			VK_FRONT_FACE_CLOCKWISE
-		);
-
-
-		mSwapChain->createFrameBuffers(mRenderPass);
+		mSphereNode->mMaterial->attachImages(std::vector<Wrapper::Image::Ptr>(framesInFlight, mFrameGraph->getImage(mSceneColor)));
+		mSphereNode->mMaterial->init(mDevice, mCommandPool, framesInFlight);
 
+		// Pipelines are kept: viewport/scissor are dynamic and the new render passes are compatible (same formats and samples)
 
 		createCommandBuffers();
 
 		createSyncObjects();
 	}
 
-	Wrapper::RenderPass::Ptr Application::createRenderPassForSwapChain() {
-		auto swapChainRenderPass = Wrapper::RenderPass::create(mDevice);
-		// Create a render pass
-		// 
-		// 0: Final output color attachment -> PRESENT
-		// 1: Resolve image(MultiSample) (render here)
-		// 2: Depth attachment
-
-		// 0: Final output color attachment, created by the swap chain, target of resolve operation, is also the target to be set in subpass
-		// Description of input canvas
-		VkAttachmentDescription finalAttachment{};
-		finalAttachment.format = mSwapChain->getSwapChainImageFormat();
-		finalAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		finalAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		finalAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		finalAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		finalAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		finalAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		finalAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		swapChainRenderPass->addAttachment(finalAttachment);
-
-		// Description of indexes and format of the attachments
-		VkAttachmentReference finalAttachmentRef{};
-		finalAttachmentRef.attachment = 0;
-		finalAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		// 1: Resolve image(MultiSample), source of multisample operation
-		VkAttachmentDescription multiAttachment{};
-		multiAttachment.format = mSwapChain->getSwapChainImageFormat();
-		multiAttachment.samples = mDevice->getMaxUsableSampleCount();
-		multiAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		multiAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		multiAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		multiAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		multiAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		multiAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // The final layout of the multisample image is color attachment optimal
-		swapChainRenderPass->addAttachment(multiAttachment);
-
-		VkAttachmentReference multiAttachmentRef{};
-		multiAttachmentRef.attachment = 1; // The multisample image is the second attachment
-		multiAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // The layout of the multisample image is color attachment optimal
-
-
-		// 3: Depth attachment
-		// Description of depth canvas
-		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = Wrapper::Image::findDepthFormat(mDevice);
-		depthAttachment.samples = mDevice->getMaxUsableSampleCount();
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		swapChainRenderPass->addAttachment(depthAttachment);
-
-		VkAttachmentReference depthAttachmentRef{};
-		depthAttachmentRef.attachment = 2;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-
-
-		// Create subpass
-		Wrapper::SubPass subpass{};
-		subpass.addColorAttachmentReference(multiAttachmentRef);
-		subpass.setDepthStencilAttachmentReference(depthAttachmentRef);
-		subpass.setResolveAttachmentReference(finalAttachmentRef);
-		/*subpass.buildSubPassDescription();*/
-
-		swapChainRenderPass->addSubpass(subpass);
-
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-		swapChainRenderPass->addDependency(dependency);
-		swapChainRenderPass->buildRenderPass();
-		return swapChainRenderPass;
-	}
-
-	void Application::createRenderPass() {
-		// Create a render pass
-		// 
-		// 0: Final output color attachment
-		// 1: Resolve image(MultiSample)
-		// 2: Depth attachment
-		
-		// 0: Final output color attachment, created by the swap chain, target of resolve operation, is also the target to be set in subpass
-		// Description of input canvas
-		VkAttachmentDescription finalAttachment{};
-		finalAttachment.format = mSwapChain->getSwapChainImageFormat();
-		finalAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		finalAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		finalAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		finalAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		finalAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		finalAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		finalAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		mRenderPass->addAttachment(finalAttachment);
-
-		// Description of indexes and format of the attachments
-		VkAttachmentReference finalAttachmentRef{};
-		finalAttachmentRef.attachment = 0;
-		finalAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		// 1: Resolve image(MultiSample), source of multisample operation
-		VkAttachmentDescription multiAttachment{};
-		multiAttachment.format = mSwapChain->getSwapChainImageFormat();
-		multiAttachment.samples = mDevice->getMaxUsableSampleCount();
-		multiAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		multiAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		multiAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		multiAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		multiAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		multiAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // The final layout of the multisample image is color attachment optimal
-		mRenderPass->addAttachment(multiAttachment);
-
-		VkAttachmentReference multiAttachmentRef{};
-		multiAttachmentRef.attachment = 1; // The multisample image is the second attachment
-		multiAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // The layout of the multisample image is color attachment optimal
-
-
-		// 3: Depth attachment
-		// Description of depth canvas
-		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = Wrapper::Image::findDepthFormat(mDevice);
-		depthAttachment.samples = mDevice->getMaxUsableSampleCount();
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		mRenderPass->addAttachment(depthAttachment);
-
-		VkAttachmentReference depthAttachmentRef{};
-		depthAttachmentRef.attachment = 2;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-
-
-		// Create subpass
-		Wrapper::SubPass subpass{};
-		subpass.addColorAttachmentReference(multiAttachmentRef);
-		subpass.setDepthStencilAttachmentReference(depthAttachmentRef);
-		subpass.setResolveAttachmentReference(finalAttachmentRef);
-		/*subpass.buildSubPassDescription();*/
-
-		mRenderPass->addSubpass(subpass);
-
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-		mRenderPass->addDependency(dependency);
-		mRenderPass->buildRenderPass();
+	void Application::createFrameGraph() {
+		mFrameGraph = RenderGraph::create(mDevice);
+		mFrameGraph->setProfiler(mGPUProfiler);
+
+		// HDR scene, multisampled and resolved for the screen quad. The multisampled color and the depth are not stored
+		const VkSampleCountFlagBits samples = mDevice->getMaxUsableSampleCount();
+		const uint32_t width = static_cast<uint32_t>(mWidth);
+		const uint32_t height = static_cast<uint32_t>(mHeight);
+		const RenderGraph::ResourceHandle sceneColorMS = mFrameGraph->createImage("SceneColorMS", { width, height, VK_FORMAT_R32G32B32A32_SFLOAT, samples });
+		const RenderGraph::ResourceHandle sceneDepth = mFrameGraph->createImage("SceneDepth", { width, height, Wrapper::Image::findDepthFormat(mDevice), samples });
+		// Headless runs read it back for the .exr output
+		mSceneColor = mFrameGraph->createImage("SceneColor", { width, height, VK_FORMAT_R32G32B32A32_SFLOAT, VK_SAMPLE_COUNT_1_BIT,
+			mHeadless ? static_cast<VkImageUsageFlags>(VK_IMAGE_USAGE_TRANSFER_SRC_BIT) : 0u });
+
+		// Written from scratch every frame, the first barrier waits where the acquire semaphore is waited on.
+		// Headless targets are left ready for the readback copy
+		if (mHeadless) {
+			mSwapChainTarget = mFrameGraph->importImage("HeadlessTarget", { width, height, mHeadlessTargets[0]->getFormat(), VK_SAMPLE_COUNT_1_BIT },
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		}
+		else {
+			const VkExtent2D extent = mSwapChain->getSwapChainExtent();
+			mSwapChainTarget = mFrameGraph->importImage("SwapChain", { extent.width, extent.height, mSwapChain->getSwapChainImageFormat(), VK_SAMPLE_COUNT_1_BIT },
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
+
+		RenderGraph::RasterPass scenePass{};
+		scenePass.mName = "Scene";
+		VkClearValue clearColor{};
+		clearColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		VkClearValue clearDepth{};
+		clearDepth.depthStencil = { 1.0f, 0 };
+		scenePass.mColorAttachments = { { sceneColorMS, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor } };
+		scenePass.mResolveAttachment = mSceneColor;
+		scenePass.mDepthAttachment = { sceneDepth, VK_ATTACHMENT_LOAD_OP_CLEAR, clearDepth };
+		// The cached and the worker thread secondaries continue the pass
+		scenePass.mContents = sceneRecording != SceneRecording::Inline ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+		scenePass.mExecute = [this](const RenderGraph::PassContext& context) {
+			recordScenePass(context);
+		};
+		mScenePass = mFrameGraph->addRasterPass(scenePass);
+
+		// The full screen triangle covers every pixel, nothing to clear
+		RenderGraph::RasterPass screenQuadPass{};
+		screenQuadPass.mName = "ScreenQuad";
+		screenQuadPass.mColorAttachments = { { mSwapChainTarget, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {} } };
+		screenQuadPass.mSampledImages = { mSceneColor };
+		screenQuadPass.mExecute = [this](const RenderGraph::PassContext& context) {
+			recordScreenQuadPass(context.mCommandBuffer);
+		};
+		mScreenQuadPass = mFrameGraph->addRasterPass(screenQuadPass);
+
+		mFrameGraph->compile();
 	}
 
 	void Application::mainLoop() {
 		while (!mWindow->shouldClose()) {
+			FF_CPU_ZONE("Frame");
+			// Limiter and present pacing before the input, so what the frame shows is sampled as late as possible
+			{
+				FF_CPU_ZONE("FramePacer::waitForNextFrame");
+				mFramePacer->waitForNextFrame(mSwapChain->getSwapChain());
+			}
 			mWindow->pollEvents();
 			mWindow->processEvents();
+			mFramePacer->markInputSample();
 			float frameTime = GetFrameTime();
 			//mModel->update();
 
+			// The slot's previous submission has to be done before its uniform buffers, descriptor sets and command pools are touched.
+			// The other slots keep the gpu busy meanwhile, the cpu runs at most framesInFlight frames ahead
+			{
+				FF_CPU_ZONE("WaitForFrameFence");
+				mFences[mCurrentFrame]->waitForFence();
+			}
+
 			//mOffscreenSphereNode->mCamera.horizontalRoundRotate(GetFrameTime(), glm::vec3(0.0f), 5.0f, 30.0f);
 			//mNVPMatrices.mViewMatrix = mSphereNode->mCamera.getViewMatrix();
 			//mNVPMatrices.mProjectionMatrix = mSphereNode->mCamera.getProjectMatrix();
@@ -746,157 +1317,260 @@ namespace FF {
 
 			//mSphereNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mSphereNode->mModels[0]->getUniform(), mCameraParameters,mCurrentFrame);
 
-			mOffscreenSphereNode->mCamera.horizontalRoundRotate(frameTime, glm::vec3(0.0f), 5.0f, 30.0f);
-			mNVPMatrices.mViewMatrix = mOffscreenSphereNode->mCamera.getViewMatrix();
-			mNVPMatrices.mProjectionMatrix = mOffscreenSphereNode->mCamera.getProjectMatrix();
-			mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mOffscreenSphereNode->mModels[0]->getUniform().mModelMatrix));
-			mCameraParameters.CameraWorldPosition = mOffscreenSphereNode->mCamera.getCamPosition();
-
-			mOffscreenSphereNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mOffscreenSphereNode->mModels[0]->getUniform(), mCameraParameters, mCurrentFrame);
-
-
-			mSkyBoxNode->mCamera.horizontalRoundRotate(frameTime, glm::vec3(0.0f), 5.0f, 30.0f);
-			// Skybox node should always in the center of object
-			mNVPMatrices.mViewMatrix = mSkyBoxNode->mCamera.getViewMatrix();
-			mNVPMatrices.mProjectionMatrix = mSkyBoxNode->mCamera.getProjectMatrix();
-			mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mSkyBoxNode->mModels[0]->getUniform().mModelMatrix));
-			mCameraParameters.CameraWorldPosition = mSkyBoxNode->mCamera.getCamPosition();
-			mSkyBoxNode->mModels[0]->setModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(mSkyBoxNode->mCamera.getCamPosition()))); // Keep skybox at camera position to remove parallax
-
-			mSkyBoxNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mSkyBoxNode->mModels[0]->getUniform(), mCameraParameters, mCurrentFrame);
+			updateUniforms(frameTime);
 
 
 			render();
+
+			// Background environment bake: slices go after the frame, finished maps swap in between two frames
+			if (mIBLRebaker != nullptr) {
+				mIBLRebaker->update();
+				if (mIBLRebaker->hasResult()) {
+					// The probes and the irradiance volume keep the previous time of day, a full capture per sun step would never settle
+					applyRebakedEnvironment(*mIBLRebaker->takeResult(), !useProceduralSky);
+				}
+			}
+			if (mLocalLightingRebaker != nullptr) {
+				mLocalLightingRebaker->update();
+			}
+			if (mSkyDirty) {
+				applyProceduralSky();
+			}
 		}
 
 		vkDeviceWaitIdle(mDevice->getDevice());
 	}
 
-	void Application::createCommandBuffers() {
-		// Create command buffers
-		mCommandBuffers.resize(mSwapChain->getImageCount());
-		for (size_t i = 0; i < mSwapChain->getImageCount(); i++) {
-			mCommandBuffers[i] = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+	void Application::updateUniforms(float frameTime) {
+		FF_CPU_ZONE("Application::updateUniforms");
+		// The fence of mCurrentFrame signaled, its sets are no longer in use
+		applyPendingEnvironment();
+		if (mCameraPath != nullptr && !mCameraPath->isEmpty()) {
+			// Scripted: the path time only moves with frameTime, a fixed step replays the same frames
+			mCameraPathTime += frameTime;
+			glm::vec3 position{};
+			glm::vec3 target{};
+			mCameraPath->sample(mCameraPathTime, position, target);
+			mOffscreenSphereNode->mCamera.lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+			mSkyBoxNode->mCamera.lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		else {
+			mOffscreenSphereNode->mCamera.horizontalRoundRotate(frameTime, glm::vec3(0.0f), 5.0f, 30.0f);
+			mSkyBoxNode->mCamera.horizontalRoundRotate(frameTime, glm::vec3(0.0f), 5.0f, 30.0f);
+		}
+		mNVPMatrices.mViewMatrix = mOffscreenSphereNode->mCamera.getViewMatrix();
+		mNVPMatrices.mProjectionMatrix = mOffscreenSphereNode->mCamera.getProjectMatrix();
+		mCameraParameters.CameraWorldPosition = mOffscreenSphereNode->mCamera.getCamPosition();
+
+		// The helmets of the grid place the shared model with their node transform.
+		// Instanced, pbr1 applies the node transforms of the group itself and the set holds the model transform only
+		for (const auto& draw : mSceneDraws) {
+			if (draw.mState == SceneDrawState::SkyBox) {
+				continue;
+			}
+			ObjectUniform objectUniform = draw.mNode->mModels[0]->getUniform();
+			if (draw.mState == SceneDrawState::PBR) {
+				objectUniform.mModelMatrix = draw.mNode->mModelMatrix * objectUniform.mModelMatrix;
+			}
+			mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(objectUniform.mModelMatrix));
+			draw.mNode->mUniformManager->updateUniformBuffer(mNVPMatrices, objectUniform, mCameraParameters, mCurrentFrame);
+		}
+		if (mInstanceBatcher != nullptr) {
+			mInstanceBatcher->update(mCurrentFrame);
+		}
+		if (mBindlessTextureTable != nullptr) {
+			mBindlessTextureTable->update(mCurrentFrame);
+		}
+		// Probes blended for each helmet, picked from its position
+		if (mReflectionProbes != nullptr) {
+			std::vector<glm::vec3> objectPositions{};
+			for (const auto& node : mSceneObjects) {
+				objectPositions.push_back(glm::vec3(node->mModelMatrix * node->mModels[0]->getUniform().mModelMatrix[3]));
+			}
+			mReflectionProbes->updateSelection(mCurrentFrame, objectPositions);
 		}
-		for (size_t i = 0; i < mSwapChain->getImageCount(); i++) {
-			
-			// Render HDR to offscreen render target
-			// Offscreen render pass
-			VkRenderPassBeginInfo offScreenRenderPassBeginInfo{};
-			offScreenRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			offScreenRenderPassBeginInfo.renderPass = mOffscreenRenderTarget->getRenderPass()->getRenderPass();
-			offScreenRenderPassBeginInfo.framebuffer = mOffscreenRenderTarget->getOffScreenFramebuffers()[i];
-			offScreenRenderPassBeginInfo.renderArea.offset = { 0, 0 };
-			offScreenRenderPassBeginInfo.renderArea.extent = mSwapChain->getSwapChainExtent(); // should be consistent with the swap chain extent
-			std::vector<VkClearValue> cvs;
-			//0: final output color attachment 1:multisample image 2: depth attachment
-			VkClearValue offScreenClearFinalColor{};
-			offScreenClearFinalColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			cvs.push_back(offScreenClearFinalColor);
-
-			//1: Multisample image
-			VkClearValue offScreenClearMultiSample{};
-			offScreenClearMultiSample.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			cvs.push_back(offScreenClearMultiSample);
-
-			//2: Depth attachment
-				VkClearValue offScreenClearDepth{};
-			offScreenClearDepth.depthStencil = { 1.0f, 0 };
-			cvs.push_back(offScreenClearDepth);
-
-			offScreenRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(cvs.size());
-			offScreenRenderPassBeginInfo.pClearValues = cvs.data();
-
-
-			// swapchain render pass
-			VkRenderPassBeginInfo renderPassBeginInfo{};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = mRenderPass->getRenderPass();
-			renderPassBeginInfo.framebuffer = mSwapChain->getSwapChainFramebuffers()[i];
-			renderPassBeginInfo.renderArea.offset = { 0, 0 };
-			renderPassBeginInfo.renderArea.extent = mSwapChain->getSwapChainExtent();
-
-			std::vector<VkClearValue> clearValues;
-
-
-			//0: final output color attachment 1:multisample image 2: depth attachment
-			VkClearValue clearFinalColor{};
-			clearFinalColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			clearValues.push_back(clearFinalColor);
-
-			//1: Multisample image
-			VkClearValue clearMultiSample{};
-			clearMultiSample.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			clearValues.push_back(clearMultiSample);
-
-			//2: Depth attachment
-			VkClearValue clearDepth{};
-			clearDepth.depthStencil = { 1.0f, 0 };
-			clearValues.push_back(clearDepth);
-
-			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassBeginInfo.pClearValues = clearValues.data();
-
 
-			// Begin command buffer
-			mCommandBuffers[i]->beginCommandBuffer();
 
-			// Begin offscreen render pass
-			mCommandBuffers[i]->beginRenderPass(offScreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Skybox node should always in the center of object
+		mNVPMatrices.mViewMatrix = mSkyBoxNode->mCamera.getViewMatrix();
+		mNVPMatrices.mProjectionMatrix = mSkyBoxNode->mCamera.getProjectMatrix();
+		mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mSkyBoxNode->mModels[0]->getUniform().mModelMatrix));
+		mCameraParameters.CameraWorldPosition = mSkyBoxNode->mCamera.getCamPosition();
+		mSkyBoxNode->mModels[0]->setModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(mSkyBoxNode->mCamera.getCamPosition()))); // Keep skybox at camera position to remove parallax
 
-			// Draw the skybox
-			mCommandBuffers[i]->bindGraphicPipeline(mSkyBoxPipeline->getPipeline());
-			std::vector<VkDescriptorSet> skyBoxDescriptorSets = { mSkyBoxNode->mUniformManager->getDescriptorSet(mCurrentFrame) };
-			mCommandBuffers[i]->bindDescriptorSets(mSkyBoxPipeline->getPipeline()->getPipelineLayout(), 0, skyBoxDescriptorSets.size(), skyBoxDescriptorSets.data());
-			mSkyBoxNode->draw(mCommandBuffers[i]);
-			// End skybox draw
+		mSkyBoxNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mSkyBoxNode->mModels[0]->getUniform(), mCameraParameters, mCurrentFrame);
+	}
 
-			// Draw the offscreen sphere
-			mCommandBuffers[i]->bindGraphicPipeline(mPipeline);
-			std::vector<VkDescriptorSet> offscreenDescriptorSets = { mOffscreenSphereNode->mUniformManager->getDescriptorSet(mCurrentFrame) , mOffscreenSphereNode->mMaterial->getDescriptorSet(mCurrentFrame) };
-			mCommandBuffers[i]->bindDescriptorSets(mPipeline->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
+	void Application::createCommandBuffers() {
+		// One transient pool per frame in flight, reset as a whole before the frame records into it again
+		mFrameCommandPools.resize(framesInFlight);
+		mCommandBuffers.resize(framesInFlight);
+		for (size_t i = 0; i < framesInFlight; i++) {
+			mFrameCommandPools[i] = Wrapper::CommandPool::create(mDevice, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			mCommandBuffers[i] = Wrapper::CommandBuffer::create(mDevice, mFrameCommandPools[i]);
+		}
 
-			mCommandBuffers[i]->pushConstants(mPipeline->getPipelineLayout(), mPushConstantManager->getConstantParam().stageFlags,
-			mPushConstantManager->getConstantParam().offset, mPushConstantManager->getConstantParam().size, &mPushConstantManager->getConstantData());
+		// Secondary buffers of the worker threads, with their own pools per frame in flight
+		if (sceneRecording != SceneRecording::Inline) {
+			if (!mRecordThreadPool) {
+				mRecordThreadPool = ThreadPool::create();
+			}
+		}
+		if (sceneRecording == SceneRecording::Parallel) {
+			mCommandRecorder = ParallelCommandRecorder::create(mDevice, mRecordThreadPool, framesInFlight);
+		}
+		if (sceneRecording == SceneRecording::Cached) {
+			mSceneCommandCache = SceneCommandCache::create(mDevice, mRecordThreadPool, framesInFlight);
+		}
+	}
 
-			mOffscreenSphereNode->draw(mCommandBuffers[i]);
-			//
+	void Application::recordCommandBuffer(uint32_t imageIndex) {
+		FF_CPU_ZONE("Application::recordCommandBuffer");
+		// The fence of mCurrentFrame has signaled, nothing recorded from its pool is pending any more.
+		// Per frame resources (descriptor sets, uniforms) follow mCurrentFrame, the swap chain target follows the acquired image
+		mFrameCommandPools[mCurrentFrame]->reset();
+		const Wrapper::CommandBuffer::Ptr& commandBuffer = mCommandBuffers[mCurrentFrame];
 
-			mCommandBuffers[i]->endRenderPass();
-			// End offscreen render pass
+		if (mHeadless) {
+			mFrameGraph->setImportedImage(mSwapChainTarget, mHeadlessTargets[imageIndex]->getImage(), mHeadlessTargets[imageIndex]->getImageView());
+		}
+		else {
+			mFrameGraph->setImportedImage(mSwapChainTarget, mSwapChain->getSwapChainImages()[imageIndex], mSwapChain->getSwapChainImageViews()[imageIndex]);
+		}
 
-			// Begin swapchain render pass
-			mCommandBuffers[i]->beginRenderPass(renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Recorded for this submission only
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		if (mGPUProfiler != nullptr) {
+			// Reads what this slot measured framesInFlight frames ago, its fence has signaled
+			mGPUProfiler->beginFrame(commandBuffer, mCurrentFrame);
+		}
+		// Scene pass, then the screen quad, each behind the barriers the graph derived for it
+		{
+			Wrapper::GPUZone frameZone(mGPUProfiler, commandBuffer, "Frame");
+			mFrameGraph->execute(commandBuffer);
+		}
+		commandBuffer->endCommandBuffer();
+	}
 
+	void Application::recordScenePass(const RenderGraph::PassContext& context) {
+		const Wrapper::CommandBuffer::Ptr& commandBuffer = context.mCommandBuffer;
+		if (sceneRecording == SceneRecording::Cached) {
+			// Unchanged draws execute the secondaries recorded by an earlier frame, per frame data comes through their uniform buffers
+			std::vector<uint64_t> revisions(mSceneDraws.size());
+			for (size_t i = 0; i < mSceneDraws.size(); i++) {
+				revisions[i] = mSceneDraws[i].mNode->mDrawRevision;
+			}
+			commandBuffer->executeCommands(mSceneCommandCache->update(mCurrentFrame, context.mInheritance, revisions,
+				[this](const Wrapper::CommandBuffer::Ptr& secondary, uint32_t item) {
+					recordSceneDraws(secondary, item, item + 1);
+				}));
+		}
+		else if (sceneRecording == SceneRecording::Parallel) {
+			// The scene draws are split across the worker threads, each range in a secondary continuing this subpass
+			mCommandRecorder->beginFrame(mCurrentFrame);
+			commandBuffer->executeCommands(mCommandRecorder->record(mCurrentFrame, context.mInheritance, static_cast<uint32_t>(mSceneDraws.size()),
+				[this](const Wrapper::CommandBuffer::Ptr& secondary, uint32_t begin, uint32_t end) {
+					recordSceneDraws(secondary, begin, end);
+				}));
+		}
+		else {
+			recordSceneDraws(commandBuffer, 0, static_cast<uint32_t>(mSceneDraws.size()), mGPUProfiler);
+		}
+	}
 
-			mCommandBuffers[i]->bindGraphicPipeline(mScreenQuadPipeline);
+	void Application::recordScreenQuadPass(const Wrapper::CommandBuffer::Ptr& commandBuffer) {
+		commandBuffer->bindGraphicPipeline(mScreenQuadPipeline);
+		commandBuffer->setViewportAndScissor(mWidth, mHeight);
 
-			std::vector<VkDescriptorSet> descriptorSets = { mSphereNode->mUniformManager->getDescriptorSet(mCurrentFrame) , mSphereNode->mMaterial->getDescriptorSet(mCurrentFrame) };
-			mCommandBuffers[i]->bindDescriptorSets(mScreenQuadPipeline->getPipelineLayout(), 0, descriptorSets.size(), descriptorSets.data());
+		std::vector<VkDescriptorSet> descriptorSets = { mSphereNode->mUniformManager->getDescriptorSet(mCurrentFrame) , mSphereNode->mMaterial->getDescriptorSet(mCurrentFrame) };
+		commandBuffer->bindDescriptorSets(mScreenQuadPipeline->getPipelineLayout(), 0, descriptorSets.size(), descriptorSets.data());
 
 
-			mCommandBuffers[i]->pushConstants(mScreenQuadPipeline->getPipelineLayout(), mPushConstantManager->getConstantParam().stageFlags,
-			mPushConstantManager->getConstantParam().offset, mPushConstantManager->getConstantParam().size, &mPushConstantManager->getConstantData());
+		commandBuffer->pushConstants(mScreenQuadPipeline->getPipelineLayout(), mPushConstantManager->getConstantParam().stageFlags,
+		mPushConstantManager->getConstantParam().offset, mPushConstantManager->getConstantParam().size, &mPushConstantManager->getConstantData());
 
 
 
-			//mModel->draw(mCommandBuffers[i]);
-			vkCmdDraw(mCommandBuffers[i]->getCommandBuffer(), 3, 1, 0, 0);
-			// End swapchain render pass
-			mCommandBuffers[i]->endRenderPass();
+		//mModel->draw(commandBuffer);
+		vkCmdDraw(commandBuffer->getCommandBuffer(), 3, 1, 0, 0);
+	}
 
 
-			mCommandBuffers[i]->endCommandBuffer();
+	void Application::recordSceneDraws(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t begin, uint32_t end, const Wrapper::GPUProfiler::Ptr& profiler) {
+		// Called from worker threads: only reads the draw list and the per frame sets of mCurrentFrame
+		bool stateBound = false;
+		SceneDrawState boundState = SceneDrawState::SkyBox;
+		uint32_t zone = Wrapper::GPUProfiler::InvalidZone;
+		for (uint32_t i = begin; i < end; i++) {
+			const SceneDraw& draw = mSceneDraws[i];
+			const Wrapper::Pipeline::Ptr& pipeline = draw.mState == SceneDrawState::SkyBox ? mSkyBoxPipeline->getPipeline()
+				: draw.mState == SceneDrawState::PBRInstanced ? mInstancedPipeline : mPipeline;
+			if (!stateBound || boundState != draw.mState) {
+				if (profiler != nullptr) {
+					// Timestamps only, the statistics of the scene pass are already counting
+					profiler->endZone(commandBuffer, zone);
+					zone = profiler->beginZone(commandBuffer, draw.mState == SceneDrawState::SkyBox ? "SkyBox"
+						: draw.mState == SceneDrawState::PBRInstanced ? "PBRInstanced" : "PBR");
+				}
+				commandBuffer->bindGraphicPipeline(pipeline);
+				commandBuffer->setViewportAndScissor(mWidth, mHeight, true);
+				if (draw.mState != SceneDrawState::SkyBox) {
+					commandBuffer->pushConstants(pipeline->getPipelineLayout(), mPushConstantManager->getConstantParam().stageFlags,
+						mPushConstantManager->getConstantParam().offset, mPushConstantManager->getConstantParam().size, &mPushConstantManager->getConstantData());
+				}
+				stateBound = true;
+				boundState = draw.mState;
+			}
+
+			if (draw.mState == SceneDrawState::SkyBox) {
+				std::vector<VkDescriptorSet> skyBoxDescriptorSets = { draw.mNode->mUniformManager->getDescriptorSet(mCurrentFrame) };
+				commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, skyBoxDescriptorSets.size(), skyBoxDescriptorSets.data());
+			}
+			else {
+				VkDescriptorSet materialSet = useBindlessMaterials ? mBindlessTextureTable->getDescriptorSet(mCurrentFrame) : draw.mNode->mMaterial->getDescriptorSet(mCurrentFrame);
+				if (mReflectionProbes != nullptr) {
+					std::vector<VkDescriptorSet> offscreenDescriptorSets = { draw.mNode->mUniformManager->getDescriptorSet(mCurrentFrame) , materialSet, mReflectionProbes->getDescriptorSet(mCurrentFrame), mIrradianceVolume->getDescriptorSet(mCurrentFrame) };
+					commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
+				}
+				else {
+					// Set 2 is empty in the layout and never used by the shader, it stays unbound
+					std::vector<VkDescriptorSet> offscreenDescriptorSets = { draw.mNode->mUniformManager->getDescriptorSet(mCurrentFrame) , materialSet };
+					commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
+					VkDescriptorSet volumeSet = mIrradianceVolume->getDescriptorSet(mCurrentFrame);
+					commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 3, 1, &volumeSet);
+				}
+
+				if (useBindlessMaterials) {
+					// Only the material index changes between materials, the table set stays bound
+					uint32_t materialIndex = draw.mNode->mMaterial->getMaterialIndex();
+					commandBuffer->pushConstants(pipeline->getPipelineLayout(), VK_SHADER_STAGE_FRAGMENT_BIT,
+						mPushConstantManager->getConstantParam().offset + mPushConstantManager->getConstantParam().size, sizeof(uint32_t), &materialIndex);
+				}
+			}
+
+			if (draw.mState == SceneDrawState::PBRInstanced) {
+				mInstanceBatcher->draw(commandBuffer, draw.mInstanceGroup, mCurrentFrame);
+			}
+			else {
+				draw.mNode->draw(commandBuffer, draw.mObjectIndex);
+			}
+		}
+		if (profiler != nullptr) {
+			profiler->endZone(commandBuffer, zone);
 		}
 	}
 
-
 	void Application::createSyncObjects() {
-		for (int i = 0; i < mSwapChain->getImageCount(); i++) {
+		// Acquire semaphores and fences belong to a frame in flight
+		for (uint32_t i = 0; i < framesInFlight; i++) {
 			mImageAvailableSemaphores.push_back(Wrapper::Semaphore::create(mDevice));
-			mRenderFinishedSemaphores.push_back(Wrapper::Semaphore::create(mDevice));
 			mFences.push_back(Wrapper::Fence::create(mDevice, true));
 		}
+		// The present of an image waits on its own semaphore: it is only signaled again once that image was acquired again,
+		// whereas a frame slot can come back before the presentation engine consumed the semaphore it signaled
+		for (uint32_t i = 0; mSwapChain != nullptr && i < mSwapChain->getImageCount(); i++) {
+			mRenderFinishedSemaphores.push_back(Wrapper::Semaphore::create(mDevice));
+		}
 	}
 	
 	//void Application::createTexture() {
@@ -907,9 +1581,8 @@ namespace FF {
 	//}
 
 	void Application::render() {
-
-		// Wait for the fence to be signaled
-		mFences[mCurrentFrame]->waitForFence();
+		FF_CPU_ZONE("Application::render");
+		// mainLoop waited for the fence of mCurrentFrame before writing its uniforms
 
 		// Acquire the next image from the swap chain
 		uint32_t imageIndex = 0;
@@ -931,7 +1604,7 @@ namespace FF {
 			throw std::runtime_error("Error: failed to acquire swap chain image!");
 		}
 
-		//recordCommandBuffer(imageIndex);
+		recordCommandBuffer(imageIndex);
 
 		// Submit the command buffer to the queue
 		VkSubmitInfo submitInfo{};
@@ -949,9 +1622,9 @@ namespace FF {
 		// Designate the command buffer to be submitted
 		submitInfo.commandBufferCount = 1;
 
-		submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex]->getCommandBuffer();
+		submitInfo.pCommandBuffers = &mCommandBuffers[mCurrentFrame]->getCommandBuffer();
 
-		VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame]->getSemaphore() };
+		VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[imageIndex]->getSemaphore() };
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
@@ -973,7 +1646,18 @@ namespace FF {
 
 		presentInfo.pImageIndices = &imageIndex;
 
+		// The id lets the frame pacer wait until this image is on screen
+		const uint64_t presentId = mFramePacer->beginPresent();
+		VkPresentIdKHR presentIdInfo{};
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = 1;
+		presentIdInfo.pPresentIds = &presentId;
+		if (presentId != 0) {
+			presentInfo.pNext = &presentIdInfo;
+		}
+
 		result = vkQueuePresentKHR(mDevice->getPresentQueue(), &presentInfo);
+		mFramePacer->endPresent(presentId);
 		//presentInfo.pResults = nullptr;
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || mWindow->mWindowResized) {
 			recreateSwapChain();
@@ -982,20 +1666,145 @@ namespace FF {
 		}else if (result != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to present swap chain image!");
 		}
-		mCurrentFrame = (mCurrentFrame + 1) % mSwapChain->getImageCount();
+		mCurrentFrame = (mCurrentFrame + 1) % framesInFlight;
+	}
+
+	void Application::createHeadlessTargets() {
+		// One per frame in flight, the slots never wait on each other's target
+		mHeadlessTargets.clear();
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			mHeadlessTargets.push_back(Wrapper::Image::create(
+				mDevice, mWidth, mHeight,
+				VK_FORMAT_R8G8B8A8_UNORM,
+				VK_IMAGE_TYPE_2D,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VK_SAMPLE_COUNT_1_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT));
+		}
+	}
+
+	void Application::renderHeadless() {
+		FF_CPU_ZONE("Application::renderHeadless");
+		// runHeadless waited for the fence of mCurrentFrame, the frame renders into the target of its slot
+		recordCommandBuffer(mCurrentFrame);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &mCommandBuffers[mCurrentFrame]->getCommandBuffer();
+
+		mFences[mCurrentFrame]->resetFence();
+		if (vkQueueSubmit(mDevice->getGraphicQueue(), 1, &submitInfo, mFences[mCurrentFrame]->getFence()) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to submit draw command buffer!");
+		}
+		mCurrentFrame = (mCurrentFrame + 1) % framesInFlight;
+	}
+
+	std::vector<uint8_t> Application::readbackImage(const Wrapper::Image::Ptr& image, VkImageLayout layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, uint32_t texelSize) {
+		const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(image->getWidth()) * image->getHeight() * texelSize;
+		auto readbackBuffer = Wrapper::Buffer::createReadbackBuffer(mDevice, bufferSize);
+
+		// The graph tracks the layouts itself, the image object does not know where the frame left it
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = layout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.image = image->getImage();
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { image->getWidth(), image->getHeight(), 1 };
+
+		auto commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		commandBuffer->transferImageLayout(barrier, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		commandBuffer->copyImageToBuffer(image->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer->getBuffer(), { region });
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+
+		std::vector<uint8_t> pixels(static_cast<size_t>(bufferSize));
+		readbackBuffer->readBufferByMap(pixels.data(), bufferSize);
+		return pixels;
+	}
+
+	void Application::writeHeadlessOutput(const std::string& outputPath) {
+		const std::string extension = std::filesystem::path(outputPath).extension().string();
+		bool written = false;
+		if (extension == ".exr") {
+			// The scene color of the last frame, before tonemapping. The screen quad sampled it last
+			const Wrapper::Image::Ptr sceneColor = mFrameGraph->getImage(mSceneColor);
+			const std::vector<uint8_t> pixels = readbackImage(sceneColor, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 4 * sizeof(float));
+			written = ImageWriter::writeEXR(outputPath, sceneColor->getWidth(), sceneColor->getHeight(), reinterpret_cast<const float*>(pixels.data()));
+		}
+		else {
+			if (extension != ".png") {
+				std::cout << "Headless: unknown output format " << extension << ", writing a png" << std::endl;
+			}
+			// The target of the last submitted frame, as the screen would have shown it
+			const Wrapper::Image::Ptr& target = mHeadlessTargets[(mCurrentFrame + framesInFlight - 1) % framesInFlight];
+			const std::vector<uint8_t> pixels = readbackImage(target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 4);
+			written = ImageWriter::writePNG(outputPath, target->getWidth(), target->getHeight(), pixels.data());
+		}
+		if (written) {
+			std::cout << "Headless: wrote " << outputPath << std::endl;
+		}
 	}
 
 	void Application::cleanUp() {
 		vkDeviceWaitIdle(mDevice->getDevice());
+		if (mGPUProfiler != nullptr) {
+			// The last frames completed with the wait above
+			for (uint32_t i = 0; i < framesInFlight; i++) {
+				mGPUProfiler->collect(i);
+			}
+		}
+		if (Wrapper::CPUProfiler::isEnabled() || mGPUProfiler != nullptr) {
+			dumpProfile();
+		}
+		mGPUProfiler.reset();
+		mIBLRebaker.reset();
+		mLocalLightingRebaker.reset();
+		mPendingEnvironment.reset();
+		mReflectionProbes.reset();
+		mEmptySetLayout.reset();
+		mIrradianceVolume.reset();
+		mSkyAtmosphere.reset();
+		mProbeCaptureMeshes.clear();
 		if (mPipeline) {
 			mPipeline.reset();
 		}
-		if (mRenderPass) {
-			mRenderPass.reset();
-		}
+		mInstancedPipeline.reset();
+		mSceneObjects.clear();
+		mInstanceBatcher.reset();
+		mFrameGraph.reset();
 		if (mSwapChain) {
 			mSwapChain.reset();
 		}
+		mHeadlessTargets.clear();
+		mSceneCommandCache.reset();
+		mCommandRecorder.reset();
+		mRecordThreadPool.reset();
+		mFramePacer.reset();
+		mCommandBuffers.clear();
+		mFrameCommandPools.clear();
+		mHDRCompressor.reset();
 		mCommandPool.reset();
 		mDevice.reset();
 		mSurface.reset();
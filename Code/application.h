@@ -20,18 +20,37 @@
 #include "vulkanWrapper/image.h"
 #include "vulkanWrapper/sampler.h"
 #include "vulkanWrapper/constantRange.h"
+#include "vulkanWrapper/gpuProfiler.h"
 
 #include "offscreenRender/offscreenRenderTarget.h"
 #include "offscreenRender/OffscreenSceneNode.h"
 #include "offscreenRender/offscreenPipeline.h"
 #include "texture/HDRI.h"
+#include "texture/iblCache.h"
+#include "texture/iblComputeBaker.h"
+#include "texture/cpuIBLBaker.h"
+#include "texture/iblRebaker.h"
+#include "texture/reflectionProbes.h"
+#include "texture/irradianceVolume.h"
+#include "texture/localLightingRebaker.h"
+#include "texture/skyAtmosphere.h"
+#include "texture/hdrCompressor.h"
+#include "texture/sphericalHarmonics.h"
 
 #include "texture/texture.h"
 #include "uniformManager.h"
 #include "pushConstantManager.h"
 #include "Camera.h"
 #include "SceneNode.h"
+#include "cameraPath.h"
 #include "model.h"
+#include "bindlessTextureTable.h"
+#include "threadPool.h"
+#include "parallelCommandRecorder.h"
+#include "sceneCommandCache.h"
+#include "instanceBatcher.h"
+#include "framePacer.h"
+#include "renderGraph/renderGraph.h"
 namespace FF {
 
 
@@ -43,13 +62,60 @@ namespace FF {
 
 		void run();
 
+		// Precompute the IBL cache with the cpu baker, without creating a window or a device (build machines)
+		void bakeIBLOffline();
+
+		/// @brief Render frameCount frames at a fixed 60 Hz step without a window, surface or swap chain (CI, render farms, lavapipe).
+		/// @param outputPath .png writes the last frame as tonemapped for the screen, .exr its HDR scene color, empty writes nothing.
+		void runHeadless(uint32_t frameCount, const std::string& outputPath = "");
+
+		// runHeadless in steps, for tools that measure every frame (vulkanFrameWorkBench): init, any number of frames, finish
+		void initHeadless();
+		void renderHeadlessFrame(float frameTime);
+		// Waits for the last frames, writes outputPath like runHeadless and releases everything
+		void finishHeadless(const std::string& outputPath = "");
+
+		// Scene and measurement setup, before run or initHeadless
+		void setResolution(uint32_t width, uint32_t height);
+		// count helmets on a square grid in the xy plane, spacing apart, sharing the model and the material
+		void setHelmetGrid(uint32_t count, float spacing);
+		// Helmets sharing models and material in one instanced draw per submesh, otherwise one draw each
+		void setInstancing(bool instancing);
+		// Replaces the auto rotating camera, nullptr goes back to it. The path plays with the frame times
+		void setCameraPath(const CameraPath::Ptr& cameraPath);
+		// gpuFrames: gpu samples kept per zone, the "Frame" zone of the last gpuFrames frames is what getGPUFrameTimes returns
+		void setProfiling(bool cpuZones, bool gpuZones, uint32_t gpuFrames = 120);
+
+		struct StartupPhase {
+			std::string mName;
+			double mMilliseconds{ 0.0 };
+		};
+		// Cpu time of the initVulkan phases, in order
+		[[nodiscard]] const std::vector<StartupPhase>& getStartupPhases() const { return mStartupPhases; }
+		// Draw calls of one frame
+		[[nodiscard]] uint32_t getDrawCallCount() const;
+		// Waits for the frames in flight, then the gpu time of every frame the profiler kept, oldest first. Empty without the gpu profiler
+		std::vector<double> getGPUFrameTimes();
+		[[nodiscard]] const Wrapper::Device::Ptr& getDevice() const { return mDevice; }
+
 		void onMouseMove(double xpos, double ypos);
 
 		void onKeyPress(CAMERA_MOVE moveDirection);
+
+		// Bake a new environment in the background, it replaces the current one when every map is done
+		void requestEnvironment(const std::string& hdrPath);
+		// Next .hdr file of the assets folder
+		void cycleEnvironment();
+		// Move the sun of the procedural sky, the environment maps follow once their background bake is done
+		void stepTimeOfDay(float degrees);
+		// Write the cpu and gpu traces of the enabled profilers, also done on exit
+		void dumpProfile();
 		float GetFrameTime();
 
 	private:
 		void initWindow();
+		// Scene nodes and their cameras, sized for mWidth x mHeight
+		void createSceneNodes();
 
 		void initScene();
 
@@ -58,15 +124,47 @@ namespace FF {
 		void mainLoop();
 
 		void render();
+		// Per frame camera and uniform updates of the frame in mCurrentFrame
+		void updateUniforms(float frameTime);
+
+		// Headless: the frame goes to mHeadlessTargets[mCurrentFrame], no acquire or present
+		void createHeadlessTargets();
+		void renderHeadless();
+		void writeHeadlessOutput(const std::string& outputPath);
+
+		// Adds the time since the previous phase (or the start of initVulkan) to mStartupPhases
+		void markStartupPhase(const std::string& name);
+		// Copies level 0 of a 2D image the graph left in layout after the last frame, waits for the copy
+		std::vector<uint8_t> readbackImage(const Wrapper::Image::Ptr& image, VkImageLayout layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, uint32_t texelSize);
 
 		void cleanUp();
 
 	private:
-		Wrapper::Pipeline::Ptr createPipeline(const std::string& vertexShaderFile, const std::string& fragShaderFile);
+		// instanced adds the per instance transforms of InstanceBatcher to the vertex input
+		Wrapper::Pipeline::Ptr createPipeline(const std::string& vertexShaderFile, const std::string& fragShaderFile, bool instanced = false);
+		// pbr1 fragment variant matching useBindlessMaterials and useSHIrradiance
+		std::string getPBRFragShaderPath() const;
+
+		// Cache keys of the baked IBL resources, they depend on which baker produces them
+		struct IBLCacheKeys {
+			uint64_t mEnvironment{ 0 };
+			uint64_t mDiffuseIrradiance{ 0 };
+			uint64_t mSpecularPrefilter{ 0 };
+			uint64_t mBRDFLUT{ 0 };
+		};
+		IBLCacheKeys makeIBLCacheKeys(const IBLCache::Ptr& iblCache) const;
 		Wrapper::Pipeline::Ptr createScreenQuadPipeline(Wrapper::RenderPass::Ptr inRenderpass);
-		Wrapper::RenderPass::Ptr createRenderPassForSwapChain();
-		void createRenderPass();
+		// Scene pass into the transient HDR targets, then the screen quad into the swap chain image
+		void createFrameGraph();
 		void createCommandBuffers();
+		// Record the frame of mCurrentFrame into its command buffer, drawing to the acquired swap chain image (the headless target of the frame)
+		void recordCommandBuffer(uint32_t imageIndex);
+		// Execute callbacks of the frame graph passes
+		void recordScenePass(const RenderGraph::PassContext& context);
+		void recordScreenQuadPass(const Wrapper::CommandBuffer::Ptr& commandBuffer);
+		// Draws [begin, end) of mSceneDraws, binding their own pipeline and sets: also the task of the secondary command buffers
+		// profiler splits the draws into a zone per pipeline, only for the primary (the zones of a frame are recorded in order)
+		void recordSceneDraws(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t begin, uint32_t end, const Wrapper::GPUProfiler::Ptr& profiler = nullptr);
 		void createSyncObjects();
 		void createUniformParameters();
 		//void createTexture();
@@ -76,6 +174,20 @@ namespace FF {
 		void cleanUpOffScreenResources();
 		void recreateSwapChain();
 
+		// Queue the rebaked maps for the skybox and PBR descriptor sets, applyPendingEnvironment binds them frame by frame
+		// rebakeLocalLighting also captures the reflection probes and the irradiance volume again, over the next frames
+		void applyRebakedEnvironment(const IBLRebaker::Result& result, bool rebakeLocalLighting = true);
+		// Rewrite the sets of mCurrentFrame for the maps, probes and volume waiting for it, once its fence signaled
+		void applyPendingEnvironment();
+		// Shared by the HDRI requests and the procedural sky, created by the first one
+		void createIBLRebaker();
+		// Render the sky for the current sun and hand it to mIBLRebaker, the bake swaps in like an HDRI one
+		void applyProceduralSky();
+		SH9Irradiance projectSkyIrradiance(const IBLCache::Ptr& iblCache);
+		// Sampled copy of a baked RGBA32F map in the compressed format, the input itself with useCompressedIBL off.
+		// The cpu encoder runs once per cache entry (<name>Compressed, child of key), runtime bakes encode on the gpu in IBLRebaker
+		Wrapper::Image::Ptr compressIBLMap(const Wrapper::Image::Ptr& image, const IBLCache::Ptr& iblCache, const std::string& name, uint64_t key);
+
 	private:
 		int mWidth{ 1280 };
 		int mHeight{ 720 };
@@ -90,18 +202,47 @@ namespace FF {
 		Wrapper::SwapChain::Ptr mSwapChain{ nullptr };
 
 		Wrapper::Pipeline::Ptr mPipeline{ nullptr };
+		Wrapper::Pipeline::Ptr mInstancedPipeline{ nullptr }; // pbr1 with the instance transforms, useInstancing
 		Wrapper::Pipeline::Ptr mScreenQuadPipeline{ nullptr }; // For rendering the offscreen render target to the screen
 		Wrapper::Pipeline::Ptr mBattleFirePipeline{ nullptr };
 
-		Wrapper::RenderPass::Ptr mRenderPass{ nullptr };
 		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
 		
 
+		// One primary command buffer per frame in flight, recorded every frame from its own transient pool
+		std::vector<Wrapper::CommandPool::Ptr> mFrameCommandPools{};
 		std::vector<Wrapper::CommandBuffer::Ptr> mCommandBuffers{};
-		std::vector<Wrapper::Semaphore::Ptr> mImageAvailableSemaphores{};
-		std::vector<Wrapper::Semaphore::Ptr> mRenderFinishedSemaphores{};
+		std::vector<Wrapper::Semaphore::Ptr> mImageAvailableSemaphores{}; // per frame in flight
+		std::vector<Wrapper::Semaphore::Ptr> mRenderFinishedSemaphores{}; // per swap chain image
 		std::vector<Wrapper::Fence::Ptr> mFences{};
 
+		// No window, surface or swap chain: the frames in flight render into their own target instead of a swap chain image
+		bool mHeadless{ false };
+		std::vector<Wrapper::Image::Ptr> mHeadlessTargets{};
+
+		// Draws of the offscreen pass in order, recorded in ranges on the worker threads with SceneRecording::Parallel
+		enum class SceneDrawState {
+			SkyBox,
+			PBR,
+			PBRInstanced
+		};
+		struct SceneDraw {
+			SceneNode::Ptr mNode{ nullptr }; // the first node of the group with PBRInstanced
+			SceneDrawState mState{ SceneDrawState::PBR };
+			uint32_t mInstanceGroup{ 0 }; // group of mInstanceBatcher with PBRInstanced
+			uint32_t mObjectIndex{ 0 }; // firstInstance of the draw with PBR, see mSceneObjects
+		};
+		std::vector<SceneDraw> mSceneDraws{};
+		// Nodes of the PBR draws by object index, the gl_InstanceIndex of their draws: the packed order of mInstanceBatcher when instanced
+		std::vector<SceneNode::Ptr> mSceneObjects{};
+		ThreadPool::Ptr mRecordThreadPool{ nullptr };
+		ParallelCommandRecorder::Ptr mCommandRecorder{ nullptr };
+		// One cached secondary per scene draw and frame, recorded again when the node's mDrawRevision moves
+		SceneCommandCache::Ptr mSceneCommandCache{ nullptr };
+
+		// Frame limiter, present pacing and latency measurement
+		FramePacer::Ptr mFramePacer{ nullptr };
+
 		UniformManager::Ptr mUniformManager{ nullptr };
 		PushConstantManager::Ptr mPushConstantManager{ nullptr };
 
@@ -114,12 +255,98 @@ namespace FF {
 		SceneNode::Ptr mSphereNode{ nullptr };
 		OffscreenSceneNode::Ptr mOffscreenSphereNode{ nullptr };
 		OffscreenSceneNode::Ptr mSkyBoxNode{ nullptr };
+		// Every helmet of the grid, mOffscreenSphereNode first
+		std::vector<OffscreenSceneNode::Ptr> mHelmetNodes{};
+		// Helmets sharing models and material, drawn once per group with useInstancing
+		InstanceBatcher::Ptr mInstanceBatcher{ nullptr };
+
+		CameraPath::Ptr mCameraPath{ nullptr };
+		float mCameraPathTime{ 0.0f };
+
+		std::vector<StartupPhase> mStartupPhases{};
+		std::chrono::steady_clock::time_point mStartupPhaseStart{};
 
 		OffscreenPipeline::Ptr mSkyBoxPipeline{ nullptr };
 
-		OffscreenRenderTarget::Ptr mOffscreenRenderTarget{ nullptr };
+		// Passes of a frame with their render passes, barriers and transient images, rebuilt with the swap chain
+		RenderGraph::Ptr mFrameGraph{ nullptr };
+		RenderGraph::PassHandle mScenePass{ 0 };
+		RenderGraph::PassHandle mScreenQuadPass{ 0 };
+		RenderGraph::ResourceHandle mSceneColor{ RenderGraph::InvalidResource }; // resolved HDR scene, sampled by the screen quad
+		RenderGraph::ResourceHandle mSwapChainTarget{ RenderGraph::InvalidResource };
+
+		// Gpu time and invocations of the graph passes, the scene pipelines and the IBL bakes, with useGPUProfiler.
+		// One slot per frame in flight, and the last one for the bakes
+		Wrapper::GPUProfiler::Ptr mGPUProfiler{ nullptr };
+
+		// Global texture table for materials, set 1 of the PBR pipeline when bindless is enabled
+		BindlessTextureTable::Ptr mBindlessTextureTable{ nullptr };
+
+		// Runtime environment switching, created by the first request
+		IBLRebaker::Ptr mIBLRebaker{ nullptr };
+		std::string mEnvironmentPath{ "assets/1.hdr" };
+		// Rebaked maps not yet bound by every frame, the frames in flight keep sampling the previous ones
+		struct PendingEnvironment {
+			Wrapper::Image::Ptr mEnvironment{ nullptr };
+			Wrapper::Image::Ptr mDiffuseIrradiance{ nullptr };
+			Wrapper::Image::Ptr mSpecularPrefilter{ nullptr };
+			SH9Irradiance mIrradianceSH{};
+			std::vector<bool> mPendingFrames{};
+		};
+		std::unique_ptr<PendingEnvironment> mPendingEnvironment{ nullptr };
+		// Captures the probes and the volume again after an environment switch, created by the first one
+		LocalLightingRebaker::Ptr mLocalLightingRebaker{ nullptr };
+
+		// Procedural sky, replaces mEnvironmentPath with useProceduralSky
+		SkyAtmosphere::Ptr mSkyAtmosphere{ nullptr };
+		float mSunElevation{ 30.0f };
+		float mSunAzimuth{ 90.0f };
+		bool mSkyDirty{ false };
+
+		// Baked local reflection probes, set 2 of the PBR pipeline
+		ReflectionProbeSet::Ptr mReflectionProbes{ nullptr };
+		// Set 2 of the PBR pipeline with useReflectionProbes off
+		Wrapper::DescriptorSetLayout::Ptr mEmptySetLayout{ nullptr };
+		// Grid of SH probes for the diffuse lighting, set 3 of the PBR pipeline
+		IrradianceVolume::Ptr mIrradianceVolume{ nullptr };
+		// Scene geometry seen by the probe captures
+		std::vector<ProbeCaptureMesh> mProbeCaptureMeshes{};
+
+		// BC6H / B10G11R11 encoder of the environment, prefilter and irradiance maps
+		HDRCompressor::Ptr mHDRCompressor{ nullptr };
+
+		// How the offscreen scene draws are recorded each frame
+		enum class SceneRecording {
+			Inline,   // straight into the frame's primary command buffer, measured per pipeline by the gpu profiler
+			Parallel, // into secondaries split in ranges across the worker threads, all recorded again every frame
+			Cached    // one secondary per draw reused across frames, only changed nodes are recorded again on the workers
+		};
 
 		bool useBattleFirePipeline{ true };
+		bool useBindlessMaterials{ true }; // falls back to per-binding textures if descriptor indexing is unavailable
+		bool useSHIrradiance{ true }; // diffuse IBL from SH9 coefficients instead of the irradiance cubemap
+		bool useComputeIBLBake{ true }; // bake IBL with compute kernels instead of the raster capture path
+		bool useFilteredPrefilter{ true }; // filtered importance sampling over the environment mip chain for the specular prefilter
+		bool useCPUIBLBake{ false }; // bake IBL with the multithreaded cpu baker and upload the results
+		bool validateIBLBake{ false }; // read the gpu bakes back and print their error against the cpu baker
+		bool useAnalyticEnvBRDF{ false }; // polynomial env BRDF in pbr1 (specialization constant), no BRDF LUT baked or bound
+		float iblRebakeBudgetMs{ 1.0f }; // gpu time per frame for runtime environment rebakes
+		bool useReflectionProbes{ false }; // bake the demo local probes (needs imageCubeArray), otherwise pbr1 only sees the global environment
+		bool useIrradianceVolume{ false }; // spatially varying diffuse ambient from an SH probe grid instead of the global irradiance
+		bool useProceduralSky{ false }; // atmospheric scattering sky as the environment instead of mEnvironmentPath, T steps the time of day
+		bool useCompressedIBL{ false }; // sample BC6H copies of the environment cubemaps (B10G11R11 without BC support) instead of RGBA32F
+		SceneRecording sceneRecording{ SceneRecording::Cached }; // Parallel to record every draw again each frame on the worker threads
+		uint32_t framesInFlight{ 2 }; // frames the cpu records ahead of the gpu, sizes every per frame resource (not the swap chain images)
+		VkPresentModeKHR presentMode{ VK_PRESENT_MODE_MAILBOX_KHR }; // MAILBOX / IMMEDIATE for low latency, FIFO / FIFO_RELAXED for stable pacing
+		float frameRateLimit{ 0.0f }; // cpu frame limiter in frames per second, 0 for none
+		uint32_t maxQueuedPresents{ 0 }; // with VK_KHR_present_wait, presents still pending when a frame starts its input, 0 for no pacing
+		bool reportPresentLatency{ false }; // print the input sample to present latency once per second
+		bool useGPUProfiler{ false }; // gpu zones per pass, printed and written to gpuTimings.csv and gpuTrace.json on exit
+		bool useCPUProfiler{ false }; // record the FF_CPU_ZONE scopes of every thread, written to cpuTrace.json with P and on exit
+		uint32_t gpuProfilerFrames{ 120 }; // gpu samples kept per zone for the averages
+		uint32_t helmetGridCount{ 1 }; // helmets drawn, copies of the first one on a grid
+		float helmetGridSpacing{ 2.5f }; // distance between two helmets of the grid
+		bool useInstancing{ true }; // one instanced draw per submesh for helmets sharing models and material, instead of one draw per helmet
 		//Camera mCamera{};
 	};
 }
\ No newline at end of file
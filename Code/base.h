@@ -9,6 +9,7 @@
 #include <fstream>
 #include <optional>
 #include <unordered_map>
+#include <algorithm>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
@@ -0,0 +1,66 @@
+#include <iostream>
+#include "benchmark.h"
+
+// vulkanFrameWorkBench [scene file] [--grid N] [--no-instancing] [--warmup N] [--frames N] [--output results.json] [--image last.png]
+// Without a scene file, the --grid stress scene (a single helmet by default). Runs from the directory holding assets/ and shaders/
+int main(int argc, char** argv) {
+	try {
+		std::string scenePath;
+		uint32_t gridCount = 1;
+		bool instancing = true;
+		int32_t warmupFrames = -1;
+		int32_t measuredFrames = -1;
+		std::string outputPath{ "benchResults.json" };
+		std::string imagePath;
+
+		for (int i = 1; i < argc; i++) {
+			const std::string argument = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (argument == "--grid" && hasValue) {
+				gridCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--no-instancing") {
+				instancing = false;
+			}
+			else if (argument == "--warmup" && hasValue) {
+				warmupFrames = std::stoi(argv[++i]);
+			}
+			else if (argument == "--frames" && hasValue) {
+				measuredFrames = std::stoi(argv[++i]);
+			}
+			else if (argument == "--output" && hasValue) {
+				outputPath = argv[++i];
+			}
+			else if (argument == "--image" && hasValue) {
+				imagePath = argv[++i];
+			}
+			else if (argument.rfind("--", 0) != 0 && scenePath.empty()) {
+				scenePath = argument;
+			}
+			else {
+				std::cout << "Unknown argument " << argument << std::endl;
+				return 1;
+			}
+		}
+
+		FF::BenchScene scene = scenePath.empty() ? FF::BenchScene::createGrid(gridCount) : FF::BenchScene::load(scenePath);
+		if (!instancing) {
+			scene.mInstancing = false;
+		}
+		if (warmupFrames >= 0) {
+			scene.mWarmupFrames = static_cast<uint32_t>(warmupFrames);
+		}
+		if (measuredFrames > 0) {
+			scene.mMeasuredFrames = static_cast<uint32_t>(measuredFrames);
+		}
+
+		const FF::Benchmark::Result result = FF::Benchmark::run(scene, imagePath);
+		FF::Benchmark::print(result);
+		FF::Benchmark::writeJSON(outputPath, result);
+	}
+	catch (const std::exception& e) {
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include "benchScene.h"
+#include <sstream>
+#include <cmath>
+
+namespace FF {
+
+	BenchScene BenchScene::load(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("Error: failed to open bench scene " + path);
+		}
+
+		BenchScene scene{};
+		scene.mName = path;
+		scene.mSource = path;
+		CameraPath::Ptr cameraPath = CameraPath::create();
+
+		std::string line;
+		uint32_t lineNumber = 0;
+		while (std::getline(file, line)) {
+			lineNumber++;
+			const size_t comment = line.find('#');
+			if (comment != std::string::npos) {
+				line.erase(comment);
+			}
+			std::istringstream stream(line);
+			std::string key;
+			if (!(stream >> key)) {
+				continue;
+			}
+
+			bool valid = true;
+			if (key == "name") {
+				valid = static_cast<bool>(stream >> scene.mName);
+			}
+			else if (key == "resolution") {
+				valid = static_cast<bool>(stream >> scene.mWidth >> scene.mHeight) && scene.mWidth > 0 && scene.mHeight > 0;
+			}
+			else if (key == "helmets") {
+				valid = static_cast<bool>(stream >> scene.mHelmetCount) && scene.mHelmetCount > 0;
+			}
+			else if (key == "spacing") {
+				valid = static_cast<bool>(stream >> scene.mHelmetSpacing);
+			}
+			else if (key == "instancing") {
+				valid = static_cast<bool>(stream >> scene.mInstancing);
+			}
+			else if (key == "timestep") {
+				valid = static_cast<bool>(stream >> scene.mTimestep) && scene.mTimestep > 0.0f;
+			}
+			else if (key == "warmup") {
+				valid = static_cast<bool>(stream >> scene.mWarmupFrames);
+			}
+			else if (key == "frames") {
+				valid = static_cast<bool>(stream >> scene.mMeasuredFrames) && scene.mMeasuredFrames > 0;
+			}
+			else if (key == "camera") {
+				CameraPath::Key cameraKey{};
+				valid = static_cast<bool>(stream >> cameraKey.mTime
+					>> cameraKey.mPosition.x >> cameraKey.mPosition.y >> cameraKey.mPosition.z
+					>> cameraKey.mTarget.x >> cameraKey.mTarget.y >> cameraKey.mTarget.z);
+				if (valid) {
+					cameraPath->addKey(cameraKey);
+				}
+			}
+			else if (key == "orbit") {
+				float radius = 0.0f;
+				float height = 0.0f;
+				float duration = 0.0f;
+				valid = static_cast<bool>(stream >> radius >> height >> duration) && duration > 0.0f;
+				if (valid) {
+					cameraPath = CameraPath::createOrbit(glm::vec3(0.0f), radius, height, duration);
+				}
+			}
+			else {
+				throw std::runtime_error("Error: " + path + ":" + std::to_string(lineNumber) + " unknown setting " + key);
+			}
+			if (!valid) {
+				throw std::runtime_error("Error: " + path + ":" + std::to_string(lineNumber) + " invalid " + key);
+			}
+		}
+
+		if (!cameraPath->isEmpty()) {
+			scene.mCameraPath = cameraPath;
+		}
+		return scene;
+	}
+
+	BenchScene BenchScene::createGrid(uint32_t helmetCount) {
+		BenchScene scene{};
+		scene.mHelmetCount = std::max(helmetCount, 1u);
+		scene.mName = "grid" + std::to_string(scene.mHelmetCount);
+
+		// Far enough for the whole grid to stay in the 45 degree field of view
+		const float gridSide = std::ceil(std::sqrt(static_cast<float>(scene.mHelmetCount))) * scene.mHelmetSpacing;
+		const float radius = std::max(5.0f, 1.5f * gridSide);
+		scene.mCameraPath = CameraPath::createOrbit(glm::vec3(0.0f), radius, 0.25f * radius, 10.0f);
+		return scene;
+	}
+}
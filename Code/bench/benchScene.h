@@ -0,0 +1,40 @@
+#pragma once
+#include "../base.h"
+#include "../cameraPath.h"
+
+namespace FF {
+	/*
+	* What vulkanFrameWorkBench renders and for how long. Loaded from a text file, one setting per line:
+	*
+	*	name helmetOrbit
+	*	resolution 1280 720
+	*	helmets 16              (copies of the helmet on a grid)
+	*	spacing 2.5
+	*	instancing 1            (0 draws every helmet on its own)
+	*	timestep 0.0166667      (seconds the camera path advances per frame)
+	*	warmup 60
+	*	frames 600              (measured frames, after the warmup)
+	*	camera 0 0 1 5 0 0 0    (key: time, eye xyz, target xyz)
+	*	orbit 6 1 10            (or an orbit around the origin: radius, height, duration)
+	*
+	* # starts a comment. Settings left out keep the defaults below.
+	*/
+	struct BenchScene {
+		std::string mName{ "default" };
+		std::string mSource{}; // file the scene was loaded from, empty for generated ones
+		uint32_t mWidth{ 1280 };
+		uint32_t mHeight{ 720 };
+		uint32_t mHelmetCount{ 1 };
+		float mHelmetSpacing{ 2.5f };
+		bool mInstancing{ true };
+		float mTimestep{ 1.0f / 60.0f };
+		uint32_t mWarmupFrames{ 60 };
+		uint32_t mMeasuredFrames{ 600 };
+		CameraPath::Ptr mCameraPath{ nullptr };
+
+		static BenchScene load(const std::string& path);
+
+		// Stress scene: helmetCount helmets on a grid, orbited from far enough to see all of them
+		static BenchScene createGrid(uint32_t helmetCount);
+	};
+}
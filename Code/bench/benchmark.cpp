@@ -0,0 +1,216 @@
+#include "benchmark.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace FF {
+
+	static uint64_t getPeakProcessMemory() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.PeakWorkingSetSize;
+		}
+		return 0;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) {
+			return 0;
+		}
+#ifdef __APPLE__
+		return static_cast<uint64_t>(usage.ru_maxrss); // bytes
+#else
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#endif
+	}
+
+	static const char* getDeviceTypeName(VkPhysicalDeviceType type) {
+		switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+		default: return "other";
+		}
+	}
+
+	static std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+		}
+		return escaped;
+	}
+
+	Benchmark::Percentiles Benchmark::computePercentiles(std::vector<double> samples) {
+		Percentiles percentiles{};
+		if (samples.empty()) {
+			return percentiles;
+		}
+		std::sort(samples.begin(), samples.end());
+		// Nearest rank: the smallest sample with at least p of the samples at or below it
+		auto rank = [&samples](double p) {
+			const size_t index = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+			return samples[std::min(std::max(index, static_cast<size_t>(1)), samples.size()) - 1];
+		};
+		percentiles.mSampleCount = static_cast<uint32_t>(samples.size());
+		for (double sample : samples) {
+			percentiles.mMean += sample;
+		}
+		percentiles.mMean /= static_cast<double>(samples.size());
+		percentiles.mMin = samples.front();
+		percentiles.mP50 = rank(0.50);
+		percentiles.mP95 = rank(0.95);
+		percentiles.mP99 = rank(0.99);
+		percentiles.mMax = samples.back();
+		return percentiles;
+	}
+
+	Benchmark::Result Benchmark::run(const BenchScene& scene, const std::string& imagePath) {
+		using Clock = std::chrono::steady_clock;
+		Result result{};
+		result.mScene = scene;
+
+		auto application = std::make_shared<Application>();
+		application->setResolution(scene.mWidth, scene.mHeight);
+		application->setHelmetGrid(scene.mHelmetCount, scene.mHelmetSpacing);
+		application->setInstancing(scene.mInstancing);
+		application->setCameraPath(scene.mCameraPath);
+		// Exactly the measured frames stay in the gpu history
+		application->setProfiling(false, true, scene.mMeasuredFrames);
+
+		const auto startupBegin = Clock::now();
+		application->initHeadless();
+		result.mStartupMs = std::chrono::duration<double, std::milli>(Clock::now() - startupBegin).count();
+		result.mStartupPhases = application->getStartupPhases();
+
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(application->getDevice()->getPhysicalDevice(), &properties);
+		result.mDeviceName = properties.deviceName;
+		result.mDeviceType = getDeviceTypeName(properties.deviceType);
+		result.mApiVersion = properties.apiVersion;
+		result.mDriverVersion = properties.driverVersion;
+
+		for (uint32_t frame = 0; frame < scene.mWarmupFrames; frame++) {
+			application->renderHeadlessFrame(scene.mTimestep);
+		}
+
+		std::vector<double> cpuFrameTimes{};
+		cpuFrameTimes.reserve(scene.mMeasuredFrames);
+		const auto measureBegin = Clock::now();
+		auto frameBegin = measureBegin;
+		for (uint32_t frame = 0; frame < scene.mMeasuredFrames; frame++) {
+			application->renderHeadlessFrame(scene.mTimestep);
+			const auto frameEnd = Clock::now();
+			cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameBegin).count());
+			frameBegin = frameEnd;
+		}
+
+		// Waits for the last frames before the gpu times and the memory are read
+		const std::vector<double> gpuFrameTimes = application->getGPUFrameTimes();
+		result.mMeasuredSeconds = std::chrono::duration<double>(Clock::now() - measureBegin).count();
+		result.mCPUFrameMs = computePercentiles(cpuFrameTimes);
+		result.mGPUFrameMs = computePercentiles(gpuFrameTimes);
+		result.mDrawCalls = application->getDrawCallCount();
+		result.mDeviceMemory = application->getDevice()->getDeviceLocalMemoryUsage();
+		result.mMemoryBudgetSupported = application->getDevice()->isMemoryBudgetSupported();
+		result.mPeakProcessMemory = getPeakProcessMemory();
+
+		application->finishHeadless(imagePath);
+		return result;
+	}
+
+	void Benchmark::print(const Result& result) {
+		auto printPercentiles = [](const char* name, const Percentiles& percentiles) {
+			if (percentiles.mSampleCount == 0) {
+				std::cout << name << ": not measured" << std::endl;
+				return;
+			}
+			std::cout << name << ": mean " << percentiles.mMean << " ms, p50 " << percentiles.mP50 << " ms, p95 " << percentiles.mP95
+				<< " ms, p99 " << percentiles.mP99 << " ms, max " << percentiles.mMax << " ms (" << percentiles.mSampleCount << " frames)" << std::endl;
+		};
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Bench " << result.mScene.mName << " on " << result.mDeviceName << " (" << result.mDeviceType << ")" << std::endl;
+		std::cout << "Startup: " << result.mStartupMs << " ms";
+		for (const auto& phase : result.mStartupPhases) {
+			std::cout << ", " << phase.mName << " " << phase.mMilliseconds << " ms";
+		}
+		std::cout << std::endl;
+		printPercentiles("CPU frame", result.mCPUFrameMs);
+		printPercentiles("GPU frame", result.mGPUFrameMs);
+		std::cout << "Draw calls per frame: " << result.mDrawCalls << std::endl;
+		std::cout << "Device local memory: " << result.mDeviceMemory.mUsage / (1024 * 1024) << " MB used of " << result.mDeviceMemory.mBudget / (1024 * 1024)
+			<< " MB" << (result.mMemoryBudgetSupported ? "" : " (no VK_EXT_memory_budget, usage unknown)") << std::endl;
+		std::cout << "Peak process memory: " << result.mPeakProcessMemory / (1024 * 1024) << " MB" << std::endl;
+		std::cout << std::defaultfloat;
+	}
+
+	bool Benchmark::writeJSON(const std::string& path, const Result& result) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write bench results " << path << std::endl;
+			return false;
+		}
+
+		auto writePercentiles = [&file](const Percentiles& percentiles) {
+			if (percentiles.mSampleCount == 0) {
+				file << "null";
+				return;
+			}
+			file << "{\"samples\":" << percentiles.mSampleCount << ",\"mean\":" << percentiles.mMean << ",\"min\":" << percentiles.mMin
+				<< ",\"p50\":" << percentiles.mP50 << ",\"p95\":" << percentiles.mP95 << ",\"p99\":" << percentiles.mP99
+				<< ",\"max\":" << percentiles.mMax << "}";
+		};
+
+		const BenchScene& scene = result.mScene;
+		file << std::fixed << std::setprecision(4);
+		file << "{\n";
+		file << "  \"version\": 1,\n";
+		file << "  \"scene\": {\"name\":\"" << escapeJson(scene.mName) << "\",\"source\":\"" << escapeJson(scene.mSource)
+			<< "\",\"width\":" << scene.mWidth << ",\"height\":" << scene.mHeight << ",\"helmets\":" << scene.mHelmetCount << ",\"instancing\":" << (scene.mInstancing ? "true" : "false")
+			<< ",\"timestep\":" << scene.mTimestep << ",\"warmupFrames\":" << scene.mWarmupFrames << ",\"measuredFrames\":" << scene.mMeasuredFrames << "},\n";
+		file << "  \"device\": {\"name\":\"" << escapeJson(result.mDeviceName) << "\",\"type\":\"" << result.mDeviceType
+			<< "\",\"apiVersion\":\"" << VK_API_VERSION_MAJOR(result.mApiVersion) << "." << VK_API_VERSION_MINOR(result.mApiVersion) << "." << VK_API_VERSION_PATCH(result.mApiVersion)
+			<< "\",\"driverVersion\":" << result.mDriverVersion << "},\n";
+
+		file << "  \"startupMs\": {\"total\":" << result.mStartupMs;
+		for (const auto& phase : result.mStartupPhases) {
+			file << ",\"" << escapeJson(phase.mName) << "\":" << phase.mMilliseconds;
+		}
+		file << "},\n";
+		file << "  \"measuredSeconds\": " << result.mMeasuredSeconds << ",\n";
+		file << "  \"cpuFrameMs\": ";
+		writePercentiles(result.mCPUFrameMs);
+		file << ",\n  \"gpuFrameMs\": ";
+		writePercentiles(result.mGPUFrameMs);
+		file << ",\n";
+		file << "  \"drawCalls\": " << result.mDrawCalls << ",\n";
+		file << "  \"memory\": {\"deviceLocalUsageBytes\":";
+		if (result.mMemoryBudgetSupported) {
+			file << result.mDeviceMemory.mUsage;
+		}
+		else {
+			file << "null";
+		}
+		file << ",\"deviceLocalBudgetBytes\":" << result.mDeviceMemory.mBudget << ",\"peakProcessBytes\":" << result.mPeakProcessMemory << "}\n";
+		file << "}\n";
+		std::cout << "Bench results written to " << path << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "../application.h"
+#include "benchScene.h"
+
+namespace FF {
+	/*
+	* Renders a BenchScene headless at a fixed timestep: warmup frames, then a measured window.
+	* The cpu frame time is the wall time of a frame, fence wait included, so it is bound by whichever of the cpu and the gpu is slower.
+	* The gpu frame time comes from the "Frame" timestamp zone around the frame graph.
+	*/
+	class Benchmark {
+	public:
+		struct Percentiles {
+			uint32_t mSampleCount{ 0 };
+			double mMean{ 0.0 };
+			double mMin{ 0.0 };
+			double mP50{ 0.0 };
+			double mP95{ 0.0 };
+			double mP99{ 0.0 };
+			double mMax{ 0.0 };
+		};
+
+		struct Result {
+			BenchScene mScene{};
+			std::string mDeviceName;
+			std::string mDeviceType;
+			uint32_t mApiVersion{ 0 };
+			uint32_t mDriverVersion{ 0 };
+
+			std::vector<Application::StartupPhase> mStartupPhases{};
+			double mStartupMs{ 0.0 }; // initHeadless as a whole, scene nodes included
+			double mMeasuredSeconds{ 0.0 };
+
+			Percentiles mCPUFrameMs{};
+			Percentiles mGPUFrameMs{}; // no samples without timestamp support
+			uint32_t mDrawCalls{ 0 };
+
+			Wrapper::Device::MemoryUsage mDeviceMemory{};
+			bool mMemoryBudgetSupported{ false };
+			uint64_t mPeakProcessMemory{ 0 }; // bytes, 0 where it is not known
+		};
+
+		static Percentiles computePercentiles(std::vector<double> samples);
+
+		/// @brief Run the scene and release the application.
+		/// @param imagePath written from the last frame like runHeadless does, empty writes nothing.
+		static Result run(const BenchScene& scene, const std::string& imagePath = "");
+
+		static void print(const Result& result);
+		static bool writeJSON(const std::string& path, const Result& result);
+	};
+}
@@ -0,0 +1,108 @@
+#include "bindlessTextureTable.h"
+
+namespace FF {
+	BindlessTextureTable::BindlessTextureTable(const Wrapper::Device::Ptr& device, uint32_t frameCount, uint32_t maxTextures, uint32_t maxMaterials)
+		: mDevice(device), mMaxTextures(maxTextures), mMaxMaterials(maxMaterials), mFrameCount(frameCount) {
+		if (!mDevice->isDescriptorIndexingSupported()) {
+			throw std::runtime_error("Error: bindless texture table requires descriptor indexing support!");
+		}
+
+		// 1. Material parameter buffers, one per frame, sized for the maximum number of materials
+		for (uint32_t i = 0; i < mFrameCount; i++) {
+			mMaterialBuffers.push_back(Wrapper::Buffer::createStorageBuffer(mDevice, sizeof(MaterialParameters) * mMaxMaterials, nullptr));
+		}
+		mPendingMaterials.resize(mFrameCount);
+
+		auto materialParam = Wrapper::UniformParameter::create();
+		materialParam->mBinding = 0;
+		materialParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materialParam->mCount = 1;
+		materialParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		materialParam->mSize = sizeof(MaterialParameters) * mMaxMaterials;
+		materialParam->mBuffers = mMaterialBuffers;
+		mUniformParameters.push_back(materialParam);
+
+		// 2. Texture array, starts empty and is filled slot by slot
+		auto textureParam = Wrapper::UniformParameter::create();
+		textureParam->mBinding = 1;
+		textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		textureParam->mCount = mMaxTextures;
+		textureParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		textureParam->mBindingFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+			VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+		textureParam->mTextures.resize(mFrameCount);
+		mUniformParameters.push_back(textureParam);
+
+		// 3. One set per frame in flight, the textures are the same in all of them
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build(mUniformParameters);
+
+		mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		mDescriptorPool->build(mUniformParameters, mFrameCount);
+
+		mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, mUniformParameters, mDescriptorLayout, mDescriptorPool, mFrameCount);
+	}
+
+	BindlessTextureTable::~BindlessTextureTable() {
+		mDescriptorSet.reset();
+		mDescriptorPool.reset();
+		mDescriptorLayout.reset();
+		mTextures.clear();
+	}
+
+	uint32_t BindlessTextureTable::addTexture(const Texture::Ptr& texture) {
+		if (mTextures.size() >= mMaxTextures) {
+			throw std::runtime_error("Error: bindless texture table is full!");
+		}
+		uint32_t slot = static_cast<uint32_t>(mTextures.size());
+		mTextures.push_back(texture);
+		for (auto& frameTextures : mUniformParameters[1]->mTextures) {
+			frameTextures.push_back(texture);
+		}
+
+		// Update-after-bind: safe even if the set is already bound in a recorded command buffer
+		for (uint32_t i = 0; i < mFrameCount; i++) {
+			mDescriptorSet->updateImage(i, mUniformParameters[1]->mBinding, slot, texture->getImageInfo());
+		}
+		return slot;
+	}
+
+	uint32_t BindlessTextureTable::addImage(const Wrapper::Image::Ptr& image, const Wrapper::Sampler::Ptr& sampler) {
+		return addTexture(Texture::createFromImage(mDevice, image, sampler));
+	}
+
+	uint32_t BindlessTextureTable::addMaterial(const MaterialParameters& params) {
+		if (mMaterials.size() >= mMaxMaterials) {
+			throw std::runtime_error("Error: bindless material buffer is full!");
+		}
+		uint32_t materialIndex = static_cast<uint32_t>(mMaterials.size());
+		mMaterials.push_back(params);
+		// Only the new element: the ones before it may be read by pending frames
+		for (const auto& materialBuffer : mMaterialBuffers) {
+			materialBuffer->updateBufferByMap(&params, sizeof(MaterialParameters), sizeof(MaterialParameters) * materialIndex);
+		}
+		return materialIndex;
+	}
+
+	void BindlessTextureTable::updateMaterial(uint32_t materialIndex, const MaterialParameters& params) {
+		if (materialIndex >= mMaterials.size()) {
+			throw std::runtime_error("Error: invalid bindless material index!");
+		}
+		mMaterials[materialIndex] = params;
+		for (auto& pendingMaterials : mPendingMaterials) {
+			if (std::find(pendingMaterials.begin(), pendingMaterials.end(), materialIndex) == pendingMaterials.end()) {
+				pendingMaterials.push_back(materialIndex);
+			}
+		}
+	}
+
+	void BindlessTextureTable::update(uint32_t frame) {
+		for (uint32_t materialIndex : mPendingMaterials[frame]) {
+			mMaterialBuffers[frame]->updateBufferByMap(&mMaterials[materialIndex], sizeof(MaterialParameters), sizeof(MaterialParameters) * materialIndex);
+		}
+		mPendingMaterials[frame].clear();
+	}
+}
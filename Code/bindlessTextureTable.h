@@ -0,0 +1,72 @@
+#pragma once
+#include "base.h"
+#include "texture/texture.h"
+#include "vulkanWrapper/buffer.h"
+#include "vulkanWrapper/sampler.h"
+#include "vulkanWrapper/descriptorSetLayout.h"
+#include "vulkanWrapper/descriptorPool.h"
+#include "vulkanWrapper/descriptorSet.h"
+#include "vulkanWrapper/device.h"
+
+namespace FF {
+
+	// One entry per material in the material parameter buffer, -1 means "map not present"
+	// Must match MaterialParameters in shaders/pbr1.frag with BINDLESS_MATERIALS (std430)
+	struct MaterialParameters {
+		glm::ivec4 mMapIndices0{ -1 }; // albedo, normal, emissive, ao
+		glm::ivec4 mMapIndices1{ -1 }; // metallic, roughness, metalRoughness, unused
+	};
+
+	/*
+	* Global bindless texture table (descriptor indexing)
+	* binding 0: storage buffer with MaterialParameters[], indexed by the material index pushed per draw
+	* binding 1: partially bound, update-after-bind sampler2D array, indexed by MaterialParameters
+	* 
+	* All materials share this single layout, so adding a material never creates a new pipeline layout.
+	* Every frame in flight has its own set and material buffer: updateMaterial only reaches a frame at its update,
+	* so the buffers of pending frames are never written.
+	*/
+	class BindlessTextureTable {
+	public:
+		using Ptr = std::shared_ptr<BindlessTextureTable>;
+		static Ptr create(const Wrapper::Device::Ptr& device, uint32_t frameCount, uint32_t maxTextures = 1024, uint32_t maxMaterials = 256) {
+			return std::make_shared<BindlessTextureTable>(device, frameCount, maxTextures, maxMaterials);
+		}
+
+		BindlessTextureTable(const Wrapper::Device::Ptr& device, uint32_t frameCount, uint32_t maxTextures, uint32_t maxMaterials);
+		~BindlessTextureTable();
+
+		// Returns the slot of the texture in the sampler array
+		uint32_t addTexture(const Texture::Ptr& texture);
+		uint32_t addImage(const Wrapper::Image::Ptr& image, const Wrapper::Sampler::Ptr& sampler);
+
+		// Returns the material index to push with the draw, written to every frame at once (no pending frame reads a new index)
+		uint32_t addMaterial(const MaterialParameters& params);
+		// Reaches each frame at its next update
+		void updateMaterial(uint32_t materialIndex, const MaterialParameters& params);
+
+		// Writes the materials changed since the last update of the frame, none of its draws may be pending
+		void update(uint32_t frame);
+
+		[[nodiscard]] auto getDescriptorLayout() const { return mDescriptorLayout; }
+		[[nodiscard]] auto getDescriptorSet(uint32_t frame) const { return mDescriptorSet->getDescriptorSet(frame); }
+		[[nodiscard]] auto getTextureCount() const { return static_cast<uint32_t>(mTextures.size()); }
+		[[nodiscard]] auto getMaterialCount() const { return static_cast<uint32_t>(mMaterials.size()); }
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		uint32_t mMaxTextures{ 0 };
+		uint32_t mMaxMaterials{ 0 };
+		uint32_t mFrameCount{ 0 };
+
+		std::vector<Texture::Ptr> mTextures{}; // keep textures alive as long as they are referenced by the table
+		std::vector<MaterialParameters> mMaterials{};
+		std::vector<Wrapper::Buffer::Ptr> mMaterialBuffers{}; // per frame in flight
+		std::vector<std::vector<uint32_t>> mPendingMaterials{}; // per frame, materials changed since its last update
+
+		std::vector<Wrapper::UniformParameter::Ptr> mUniformParameters{};
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+		Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+	};
+}
@@ -0,0 +1,61 @@
+#include "cameraPath.h"
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+namespace FF {
+
+	void CameraPath::addKey(const Key& key) {
+		auto position = std::upper_bound(mKeys.begin(), mKeys.end(), key.mTime,
+			[](float time, const Key& other) { return time < other.mTime; });
+		mKeys.insert(position, key);
+	}
+
+	CameraPath::Ptr CameraPath::createOrbit(const glm::vec3& target, float radius, float height, float duration, uint32_t keyCount) {
+		auto path = create();
+		keyCount = std::max(keyCount, 3u);
+		// The last key closes the loop on the first one
+		for (uint32_t i = 0; i <= keyCount; i++) {
+			const float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(keyCount);
+			Key key{};
+			key.mTime = duration * static_cast<float>(i) / static_cast<float>(keyCount);
+			key.mPosition = target + glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+			key.mTarget = target;
+			path->addKey(key);
+		}
+		return path;
+	}
+
+	static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+		const float t2 = t * t;
+		const float t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	}
+
+	void CameraPath::sample(float time, glm::vec3& position, glm::vec3& target) const {
+		if (mKeys.empty()) {
+			return;
+		}
+		const float duration = getDuration();
+		if (mKeys.size() == 1 || duration <= 0.0f) {
+			position = mKeys.front().mPosition;
+			target = mKeys.front().mTarget;
+			return;
+		}
+
+		time = std::fmod(std::max(time, 0.0f), duration);
+		size_t segment = 0;
+		while (segment + 2 < mKeys.size() && mKeys[segment + 1].mTime <= time) {
+			segment++;
+		}
+		const Key& from = mKeys[segment];
+		const Key& to = mKeys[segment + 1];
+		const float length = to.mTime - from.mTime;
+		const float t = length > 0.0f ? glm::clamp((time - from.mTime) / length, 0.0f, 1.0f) : 0.0f;
+
+		// The end keys repeat as their own neighbours
+		const Key& before = mKeys[segment > 0 ? segment - 1 : 0];
+		const Key& after = mKeys[std::min(segment + 2, mKeys.size() - 1)];
+		position = catmullRom(before.mPosition, from.mPosition, to.mPosition, after.mPosition, t);
+		target = catmullRom(before.mTarget, from.mTarget, to.mTarget, after.mTarget, t);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "base.h"
+
+namespace FF {
+	/*
+	* Scripted camera: eye and target keyframes on a timeline, played back from a time the caller advances.
+	* Positions are interpolated with Catmull-Rom splines through the keyframes, so the path passes every key with a
+	* continuous velocity. Past the last key the path loops back to the first one.
+	*/
+	class CameraPath {
+	public:
+		using Ptr = std::shared_ptr<CameraPath>;
+
+		struct Key {
+			float mTime{ 0.0f }; // seconds from the start of the path
+			glm::vec3 mPosition{ 0.0f, 0.0f, 5.0f };
+			glm::vec3 mTarget{ 0.0f };
+		};
+
+		static Ptr create() { return std::make_shared<CameraPath>(); }
+
+		CameraPath() = default;
+		~CameraPath() = default;
+
+		// Keys are kept sorted by time
+		void addKey(const Key& key);
+
+		// An orbit around target in the xz plane, keyCount keys over duration seconds
+		static Ptr createOrbit(const glm::vec3& target, float radius, float height, float duration, uint32_t keyCount = 8);
+
+		void sample(float time, glm::vec3& position, glm::vec3& target) const;
+
+		[[nodiscard]] bool isEmpty() const { return mKeys.empty(); }
+		[[nodiscard]] float getDuration() const { return mKeys.empty() ? 0.0f : mKeys.back().mTime; }
+		[[nodiscard]] const std::vector<Key>& getKeys() const { return mKeys; }
+
+	private:
+		std::vector<Key> mKeys{};
+	};
+}
@@ -0,0 +1,102 @@
+#include "framePacer.h"
+#include <thread>
+
+namespace FF {
+
+	FramePacer::FramePacer(const Wrapper::Device::Ptr& device, const Settings& settings)
+		: mDevice(device), mSettings(settings) {
+		mPresentWait = mDevice->isPresentWaitSupported();
+		mNextFrameStart = Clock::now();
+		mLastReport = mNextFrameStart;
+	}
+
+	FramePacer::~FramePacer() {
+		mPendingPresents.clear();
+		mDevice = nullptr;
+	}
+
+	void FramePacer::waitForNextFrame(VkSwapchainKHR swapChain) {
+		limitFrameRate();
+
+		if (!mPresentWait) {
+			return;
+		}
+		// Presents already on screen complete without blocking, the oldest ones block while too many are queued
+		while (!mPendingPresents.empty()) {
+			const bool mustWait = mSettings.mMaxQueuedPresents > 0 && mPendingPresents.size() >= mSettings.mMaxQueuedPresents;
+			// A bounded wait, a minimized window may never show the image
+			const uint64_t timeout = mustWait ? 100000000ull : 0ull;
+			const VkResult result = mDevice->waitForPresent(swapChain, mPendingPresents.front().mPresentId, timeout);
+			if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+				addLatencySample(mPendingPresents.front().mInputSample, Clock::now());
+				mPendingPresents.pop_front();
+			}
+			else if (result == VK_TIMEOUT && !mustWait) {
+				break;
+			}
+			else {
+				// Timed out while pacing, or the swap chain is out of date: that present is not waited on again
+				mPendingPresents.pop_front();
+			}
+		}
+	}
+
+	void FramePacer::limitFrameRate() {
+		if (mSettings.mFrameRateLimit <= 0.0f) {
+			return;
+		}
+		const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / mSettings.mFrameRateLimit));
+		// sleep_for overshoots by up to a scheduler tick, the last millisecond is spent yielding
+		const auto spinMargin = std::chrono::milliseconds(1);
+		Clock::time_point now = Clock::now();
+		if (mNextFrameStart - now > spinMargin) {
+			std::this_thread::sleep_for(mNextFrameStart - now - spinMargin);
+		}
+		while ((now = Clock::now()) < mNextFrameStart) {
+			std::this_thread::yield();
+		}
+		// A frame slower than the period moves the schedule instead of bursting to catch up
+		mNextFrameStart = std::max(mNextFrameStart + period, now);
+	}
+
+	void FramePacer::markInputSample() {
+		mInputSample = Clock::now();
+	}
+
+	uint64_t FramePacer::beginPresent() {
+		return mPresentWait ? mNextPresentId++ : 0;
+	}
+
+	void FramePacer::endPresent(uint64_t presentId) {
+		if (presentId == 0) {
+			addLatencySample(mInputSample, Clock::now());
+			return;
+		}
+		mPendingPresents.push_back({ presentId, mInputSample });
+		if (mPendingPresents.size() > MaxTrackedPresents) {
+			mPendingPresents.pop_front();
+		}
+	}
+
+	void FramePacer::resetSwapChain() {
+		mPendingPresents.clear();
+	}
+
+	void FramePacer::addLatencySample(Clock::time_point inputSample, Clock::time_point presented) {
+		mLatencySumMs += std::chrono::duration<double, std::milli>(presented - inputSample).count();
+		mLatencyCount++;
+
+		const Clock::time_point now = Clock::now();
+		if (std::chrono::duration<double>(now - mLastReport).count() < mSettings.mReportInterval) {
+			return;
+		}
+		mAverageLatencyMs = mLatencySumMs / mLatencyCount;
+		if (mSettings.mReportLatency) {
+			std::cout << "Input to present latency: " << mAverageLatencyMs << " ms over " << mLatencyCount << " frames"
+				<< (mPresentWait ? " (on screen)" : " (until vkQueuePresentKHR)") << std::endl;
+		}
+		mLatencySumMs = 0.0;
+		mLatencyCount = 0;
+		mLastReport = now;
+	}
+}
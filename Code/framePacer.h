@@ -0,0 +1,79 @@
+#pragma once
+#include "base.h"
+#include "vulkanWrapper/device.h"
+#include <chrono>
+#include <deque>
+
+namespace FF {
+	/*
+	* Frame pacing on the cpu side of the present: an optional frame rate limiter, and with VK_KHR_present_wait a cap on the
+	* presents still queued when a frame starts, so the input of that frame is sampled as close to its display as possible.
+	* Also measures input sample to present latency: until the image is on screen with present wait,
+	* until vkQueuePresentKHR returned otherwise (a lower bound, the queue and the display are not seen).
+	* Per frame order: waitForNextFrame, poll the input, markInputSample, record and submit, beginPresent, present, endPresent.
+	*/
+	class FramePacer {
+	public:
+		using Ptr = std::shared_ptr<FramePacer>;
+		using Clock = std::chrono::steady_clock;
+
+		struct Settings {
+			float mFrameRateLimit{ 0.0f }; // frames per second, 0 disables the limiter
+			uint32_t mMaxQueuedPresents{ 0 }; // presents allowed to be pending at the start of a frame, 0 disables the pacing (needs present wait)
+			bool mReportLatency{ false }; // print the average latency every mReportInterval seconds
+			double mReportInterval{ 1.0 };
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const Settings& settings = {}) {
+			return std::make_shared<FramePacer>(device, settings);
+		}
+
+		FramePacer(const Wrapper::Device::Ptr& device, const Settings& settings);
+		~FramePacer();
+
+		// Sleeps for the limiter, then waits until at most mMaxQueuedPresents presents of swapChain are pending
+		void waitForNextFrame(VkSwapchainKHR swapChain);
+
+		// The input the frame is built from has just been polled
+		void markInputSample();
+
+		/// @return the id to chain in VkPresentIdKHR, 0 (no id) without present wait.
+		uint64_t beginPresent();
+		// After vkQueuePresentKHR of the id returned by beginPresent
+		void endPresent(uint64_t presentId);
+
+		// The swap chain was recreated, the presents pending on the old one are not waited on any more
+		void resetSwapChain();
+
+		[[nodiscard]] bool isPresentWaitEnabled() const { return mPresentWait; }
+		// Average over the last report interval, 0 before the first one
+		[[nodiscard]] double getAverageLatencyMs() const { return mAverageLatencyMs; }
+
+	private:
+		struct PendingPresent {
+			uint64_t mPresentId{ 0 };
+			Clock::time_point mInputSample{};
+		};
+
+		// Presents that never complete (hidden window) are forgotten past this many
+		static constexpr size_t MaxTrackedPresents = 16;
+
+		void limitFrameRate();
+		void addLatencySample(Clock::time_point inputSample, Clock::time_point presented);
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Settings mSettings{};
+		bool mPresentWait{ false };
+
+		Clock::time_point mNextFrameStart{};
+		Clock::time_point mInputSample{};
+		uint64_t mNextPresentId{ 1 }; // ids only have to increase on a swap chain, one counter serves all of them
+		std::deque<PendingPresent> mPendingPresents{};
+
+		double mLatencySumMs{ 0.0 };
+		uint32_t mLatencyCount{ 0 };
+		double mAverageLatencyMs{ 0.0 };
+		Clock::time_point mLastReport{};
+	};
+}
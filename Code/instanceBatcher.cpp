@@ -0,0 +1,87 @@
+#include "instanceBatcher.h"
+
+namespace FF {
+
+	InstanceBatcher::InstanceBatcher(const Wrapper::Device::Ptr& device, uint32_t frameCount) {
+		mDevice = device;
+		mFrameCount = frameCount;
+	}
+
+	InstanceBatcher::~InstanceBatcher() {
+		mGroups.clear();
+		mInstanceBuffers.clear();
+	}
+
+	void InstanceBatcher::build(const std::vector<SceneNode::Ptr>& nodes) {
+		mGroups.clear();
+		mInstanceBuffers.clear();
+		for (const auto& node : nodes) {
+			auto group = std::find_if(mGroups.begin(), mGroups.end(), [&node](const Group& candidate) {
+				return candidate.mModels == node->mModels && candidate.mMaterial == node->mMaterial;
+			});
+			if (group == mGroups.end()) {
+				mGroups.push_back({ node->mModels, node->mMaterial, {}, 0 });
+				group = mGroups.end() - 1;
+			}
+			group->mNodes.push_back(node);
+		}
+
+		uint32_t instanceCount = 0;
+		for (auto& group : mGroups) {
+			group.mFirstInstance = instanceCount;
+			instanceCount += static_cast<uint32_t>(group.mNodes.size());
+		}
+		if (instanceCount == 0) {
+			return;
+		}
+		for (uint32_t i = 0; i < mFrameCount; i++) {
+			mInstanceBuffers.push_back(Wrapper::Buffer::create(mDevice, sizeof(glm::mat4) * instanceCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+		}
+	}
+
+	void InstanceBatcher::update(uint32_t frame) {
+		if (mInstanceBuffers.empty()) {
+			return;
+		}
+		std::vector<glm::mat4> transforms{};
+		for (const auto& group : mGroups) {
+			for (const auto& node : group.mNodes) {
+				transforms.push_back(node->mModelMatrix);
+			}
+		}
+		mInstanceBuffers[frame]->updateBufferByMap(transforms.data(), sizeof(glm::mat4) * transforms.size());
+	}
+
+	void InstanceBatcher::draw(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t groupIndex, uint32_t frame) const {
+		const Group& group = mGroups[groupIndex];
+		commandBuffer->bindVertexBuffer({ mInstanceBuffers[frame]->getBuffer() }, InstanceBinding);
+		for (const auto& model : group.mModels) {
+			if (model) {
+				model->draw(commandBuffer, static_cast<uint32_t>(group.mNodes.size()), group.mFirstInstance);
+			}
+		}
+	}
+
+	std::vector<VkVertexInputBindingDescription> InstanceBatcher::getInstanceBindingDescriptions() {
+		std::vector<VkVertexInputBindingDescription> bindingDes{};
+		bindingDes.resize(1);
+		bindingDes[0].binding = InstanceBinding;
+		bindingDes[0].stride = sizeof(glm::mat4);
+		bindingDes[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return bindingDes;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> InstanceBatcher::getInstanceAttributeDescriptions() {
+		// A mat4 takes four locations, one column each
+		std::vector<VkVertexInputAttributeDescription> attributeDes{};
+		attributeDes.resize(4);
+		for (uint32_t i = 0; i < 4; i++) {
+			attributeDes[i].binding = InstanceBinding;
+			attributeDes[i].location = InstanceLocation + i;
+			attributeDes[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDes[i].offset = sizeof(glm::vec4) * i;
+		}
+		return attributeDes;
+	}
+}
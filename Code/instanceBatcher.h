@@ -0,0 +1,59 @@
+#pragma once
+#include "base.h"
+#include "SceneNode.h"
+#include "vulkanWrapper/device.h"
+#include "vulkanWrapper/buffer.h"
+#include "vulkanWrapper/commandBuffer.h"
+
+namespace FF {
+	/*
+	* Hardware instancing of scene nodes that share their models and material.
+	* build groups the nodes, every group is drawn with one instanced draw per submesh; the model matrix of each node
+	* goes to a per instance vertex binding, one host visible buffer per frame in flight packing the groups one after another.
+	* A group draws from its mFirstInstance, so gl_InstanceIndex is the index of the node in that packed order.
+	* The first node of a group provides the descriptor sets and the object uniform of the whole group.
+	*/
+	class InstanceBatcher {
+	public:
+		using Ptr = std::shared_ptr<InstanceBatcher>;
+
+		// Vertex binding of the instance transforms, binding 0 is the model vertex data
+		static constexpr uint32_t InstanceBinding = 1;
+		// Locations of the four columns of the instance transform, after every attribute of the model vertex layouts
+		static constexpr uint32_t InstanceLocation = 8;
+
+		struct Group {
+			std::vector<Model::Ptr> mModels{};
+			Material::Ptr mMaterial{ nullptr };
+			std::vector<SceneNode::Ptr> mNodes{};
+			uint32_t mFirstInstance{ 0 }; // first node of the group in the instance buffers
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, uint32_t frameCount) {
+			return std::make_shared<InstanceBatcher>(device, frameCount);
+		}
+
+		InstanceBatcher(const Wrapper::Device::Ptr& device, uint32_t frameCount);
+		~InstanceBatcher();
+
+		// Groups the nodes by models and material, in the order their first node appears
+		void build(const std::vector<SceneNode::Ptr>& nodes);
+
+		// Writes the model matrices of every node into the buffers of the frame, none of its draws may be pending
+		void update(uint32_t frame);
+
+		// Binds the instance buffer of the frame and draws every submesh of the group once for all its nodes
+		void draw(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t groupIndex, uint32_t frame) const;
+
+		[[nodiscard]] const std::vector<Group>& getGroups() const { return mGroups; }
+
+		static std::vector<VkVertexInputBindingDescription> getInstanceBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> getInstanceAttributeDescriptions();
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		uint32_t mFrameCount{ 0 };
+		std::vector<Group> mGroups{};
+		std::vector<Wrapper::Buffer::Ptr> mInstanceBuffers{}; // per frame in flight
+	};
+}
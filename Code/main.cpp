@@ -1,10 +1,21 @@
 #include <iostream>
 #include "application.h"
-int main(){
+int main(int argc, char** argv){
 	std::shared_ptr<FF::Application> app = std::make_shared<FF::Application>();
 
     try {
-		app->run();
+		// --bake-ibl fills the IBL cache on the CPU and exits, for machines without a GPU
+		if (argc > 1 && std::string(argv[1]) == "--bake-ibl") {
+			app->bakeIBLOffline();
+		}
+		// --headless [frames] [output.png|output.exr] renders without a window, e.g. on lavapipe
+		else if (argc > 1 && std::string(argv[1]) == "--headless") {
+			const uint32_t frameCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 100;
+			app->runHeadless(frameCount, argc > 3 ? argv[3] : "");
+		}
+		else {
+			app->run();
+		}
     }
     catch (const std::exception& e) {
         std::cout << e.what() << std::endl;
@@ -1,4 +1,5 @@
 #include "model.h"
+#include "vulkanWrapper/cpuProfiler.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -6,6 +7,7 @@
 namespace FF {
 
 	void Model::loadModel(const std::string& path, const Wrapper::Device::Ptr& device) {
+		FF_CPU_ZONE("Model::loadModel");
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -74,6 +76,7 @@ namespace FF {
 	}
 
 	void Model::loadBattleFireModel(const std::string& path, const Wrapper::Device::Ptr& device) {
+		FF_CPU_ZONE("Model::loadBattleFireModel");
 		std::ifstream file(path, std::ios::binary);
 		if (!file.is_open()) throw std::runtime_error("Failed to open file: " + path);
 
@@ -351,18 +354,18 @@ namespace FF {
 	
 	}
 
-	void Model::draw(const Wrapper::CommandBuffer::Ptr& cmdBuf) {
+	void Model::draw(const Wrapper::CommandBuffer::Ptr& cmdBuf, uint32_t instanceCount, uint32_t firstInstance) {
 		cmdBuf->bindVertexBuffer(getVertexDataBuffer());
 		if (!mSubMeshes.empty()) {
 			// If there are submeshes, draw each submesh
 			for (const auto& subMesh : mSubMeshes) {
 				cmdBuf->bindIndexBuffer(subMesh.second->mSubMeshIndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-				cmdBuf->drawIndexed(subMesh.second->mIndexCount, 1, 0, 0, 0);
+				cmdBuf->drawIndexed(subMesh.second->mIndexCount, instanceCount, 0, 0, firstInstance);
 			}
 		}
 		else {
 			cmdBuf->bindIndexBuffer(getIndexBuffer()->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-			cmdBuf->drawIndexed(getIndexCount(), 1, 0, 0, 0);
+			cmdBuf->drawIndexed(getIndexCount(), instanceCount, 0, 0, firstInstance);
 		}
 	}
 
@@ -100,7 +100,11 @@ namespace FF {
 
 			mAngle += 0.01f;
 		}
-		void draw(const Wrapper::CommandBuffer::Ptr& cmdBuf);
+		// instanceCount > 1 expects the instance data bound by the caller, see InstanceBatcher.
+		// firstInstance offsets gl_InstanceIndex and the instance rate attributes
+		void draw(const Wrapper::CommandBuffer::Ptr& cmdBuf, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		// Draw calls recorded by draw, one per submesh
+		[[nodiscard]] uint32_t getDrawCount() const { return mSubMeshes.empty() ? 1u : static_cast<uint32_t>(mSubMeshes.size()); }
 
 	public:
 		std::vector<VkVertexInputBindingDescription> bindingDes{};
@@ -0,0 +1,192 @@
+#include "cubeMapCaptureTarget.h"
+
+namespace FF {
+    CubeMapCaptureTarget::CubeMapCaptureTarget(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& cubeMap, const CubeMapCaptureMatrices& matrices, bool withDepth)
+        : mDevice(device), mCubeMap(cubeMap) {
+        if (!mCubeMap->isCubeMap() || (mCubeMap->getUsage() & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) == 0) {
+            throw std::runtime_error("Error: cubemap capture target needs a cubemap image with color attachment usage!");
+        }
+        mWidth = mCubeMap->getWidth();
+        mHeight = mCubeMap->getHeight();
+        mMipLevels = mCubeMap->getMipLevels();
+
+        if (withDepth) {
+            mDepthImage = Wrapper::Image::create(
+                mDevice, mWidth, mHeight,
+                Wrapper::Image::findDepthFormat(mDevice),
+                VK_IMAGE_TYPE_2D,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_IMAGE_ASPECT_DEPTH_BIT);
+        }
+
+        createRenderPass();
+        createFaceFramebuffers();
+        createMatricesDescriptor(matrices);
+    }
+
+    CubeMapCaptureTarget::~CubeMapCaptureTarget() {
+        for (auto& framebuffer : mFaceFramebuffers) {
+            vkDestroyFramebuffer(mDevice->getDevice(), framebuffer, nullptr);
+        }
+        for (auto& view : mFaceViews) {
+            vkDestroyImageView(mDevice->getDevice(), view, nullptr);
+        }
+        mDescriptorSet.reset();
+        mDescriptorPool.reset();
+        mDescriptorLayout.reset();
+        mRenderPass.reset();
+        mDepthImage.reset();
+    }
+
+    void CubeMapCaptureTarget::createRenderPass() {
+        mRenderPass = Wrapper::RenderPass::create(mDevice);
+
+        // 0: the cubemap face itself, single sampled, no depth unless asked for: the capture mesh is a box around the camera
+        // The whole image is moved to COLOR_ATTACHMENT_OPTIMAL before the bake and to SHADER_READ_ONLY_OPTIMAL after it
+        VkAttachmentDescription faceAttachment{};
+        faceAttachment.format = mCubeMap->getFormat();
+        faceAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        faceAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        faceAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        faceAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        faceAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        faceAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        faceAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        mRenderPass->addAttachment(faceAttachment);
+
+        VkAttachmentReference faceAttachmentRef{};
+        faceAttachmentRef.attachment = 0;
+        faceAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        Wrapper::SubPass subpass{};
+        subpass.addColorAttachmentReference(faceAttachmentRef);
+
+        // 1: depth, cleared for every face and never stored
+        if (mDepthImage != nullptr) {
+            VkAttachmentDescription depthAttachment{};
+            depthAttachment.format = mDepthImage->getFormat();
+            depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            mRenderPass->addAttachment(depthAttachment);
+
+            VkAttachmentReference depthAttachmentRef{};
+            depthAttachmentRef.attachment = 1;
+            depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            subpass.setDepthStencilAttachmentReference(depthAttachmentRef);
+        }
+        mRenderPass->addSubpass(subpass);
+
+        // The depth attachment is reused by the next face: its clear waits for the previous face's depth tests
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = mDepthImage != nullptr ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (mDepthImage != nullptr ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+        mRenderPass->addDependency(dependency);
+        mRenderPass->buildRenderPass();
+    }
+
+    void CubeMapCaptureTarget::createFaceFramebuffers() {
+        mFaceViews.resize(mMipLevels * 6);
+        mFaceFramebuffers.resize(mMipLevels * 6);
+
+        for (uint32_t mipLevel = 0; mipLevel < mMipLevels; mipLevel++) {
+            for (uint32_t face = 0; face < 6; face++) {
+                const uint32_t index = mipLevel * 6 + face;
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = mCubeMap->getImage();
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = mCubeMap->getFormat();
+                viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+                viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+                viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+                viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+                viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                viewInfo.subresourceRange.baseMipLevel = mipLevel;
+                viewInfo.subresourceRange.levelCount = 1;
+                viewInfo.subresourceRange.baseArrayLayer = face;
+                viewInfo.subresourceRange.layerCount = 1;
+                if (vkCreateImageView(mDevice->getDevice(), &viewInfo, nullptr, &mFaceViews[index]) != VK_SUCCESS) {
+                    throw std::runtime_error("Error: failed to create cubemap face image view!");
+                }
+
+                std::vector<VkImageView> attachments = { mFaceViews[index] };
+                if (mDepthImage != nullptr) {
+                    attachments.push_back(mDepthImage->getImageView());
+                }
+
+                VkFramebufferCreateInfo framebufferInfo{};
+                framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebufferInfo.renderPass = mRenderPass->getRenderPass();
+                framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+                framebufferInfo.pAttachments = attachments.data();
+                framebufferInfo.width = getMipWidth(mipLevel);
+                framebufferInfo.height = getMipHeight(mipLevel);
+                framebufferInfo.layers = 1;
+                if (vkCreateFramebuffer(mDevice->getDevice(), &framebufferInfo, nullptr, &mFaceFramebuffers[index]) != VK_SUCCESS) {
+                    throw std::runtime_error("Error: failed to create cubemap face framebuffer!");
+                }
+            }
+        }
+    }
+
+    void CubeMapCaptureTarget::createMatricesDescriptor(const CubeMapCaptureMatrices& matrices) {
+        auto matricesParam = Wrapper::UniformParameter::create();
+        matricesParam->mBinding = 0;
+        matricesParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        matricesParam->mCount = 1;
+        matricesParam->mStageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        matricesParam->mSize = sizeof(CubeMapCaptureMatrices);
+        matricesParam->mBuffers.push_back(Wrapper::Buffer::createUniformBuffer(mDevice, matricesParam->mSize, (void*)&matrices));
+        mUniformParameters.push_back(matricesParam);
+
+        mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+        mDescriptorLayout->build(mUniformParameters);
+
+        mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+        mDescriptorPool->build(mUniformParameters, 1);
+
+        mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, mUniformParameters, mDescriptorLayout, mDescriptorPool, 1);
+    }
+
+    VkPushConstantRange CubeMapCaptureTarget::getFacePushConstantRange() const {
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        range.offset = FaceIndexPushConstantOffset;
+        range.size = sizeof(uint32_t);
+        return range;
+    }
+
+    void CubeMapCaptureTarget::beginFace(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t face, uint32_t mipLevel) {
+        VkClearValue clearValues[2]{};
+        clearValues[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+        clearValues[1].depthStencil = { 1.0f, 0 };
+
+        VkRenderPassBeginInfo renderPassBeginInfo{};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.renderPass = mRenderPass->getRenderPass();
+        renderPassBeginInfo.framebuffer = mFaceFramebuffers[mipLevel * 6 + face];
+        renderPassBeginInfo.renderArea.offset = { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = { getMipWidth(mipLevel), getMipHeight(mipLevel) };
+        renderPassBeginInfo.clearValueCount = mDepthImage != nullptr ? 2 : 1;
+        renderPassBeginInfo.pClearValues = clearValues;
+
+        commandBuffer->beginRenderPass(renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    void CubeMapCaptureTarget::pushFaceIndex(const Wrapper::CommandBuffer::Ptr& commandBuffer, VkPipelineLayout layout, uint32_t face) {
+        commandBuffer->pushConstants(layout, VK_SHADER_STAGE_VERTEX_BIT, FaceIndexPushConstantOffset, sizeof(uint32_t), &face);
+    }
+}
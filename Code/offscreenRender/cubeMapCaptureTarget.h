@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/renderPass.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+
+namespace FF {
+    // Matrices of the six capture cameras, one uniform buffer shared by every face and mip
+    struct CubeMapCaptureMatrices {
+        glm::mat4 mProjectionMatrix{ 1.0f };
+        glm::mat4 mViewMatrices[6]{};
+    };
+
+    /*
+    * Render target that draws straight into the faces and mips of a cubemap image.
+    * Every face/mip gets its own 2D image view and framebuffer, so a whole bake is recorded into one command buffer
+    * without an intermediate render target or copy.
+    * The capture vertex shader reads the matrices from set 2 and the face index from a vertex push constant.
+    * withDepth adds a depth attachment, shared by every face and cleared per face, for captures of scene geometry (local probes).
+    */
+    class CubeMapCaptureTarget {
+    public:
+        using Ptr = std::shared_ptr<CubeMapCaptureTarget>;
+        static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& cubeMap, const CubeMapCaptureMatrices& matrices, bool withDepth = false) {
+            return std::make_shared<CubeMapCaptureTarget>(device, cubeMap, matrices, withDepth);
+        }
+
+        // Placed after the 192 byte block reserved by PushConstantManager, so fragment constants can coexist
+        static constexpr uint32_t FaceIndexPushConstantOffset = 192;
+        static constexpr uint32_t DescriptorSetIndex = 2;
+
+        CubeMapCaptureTarget(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& cubeMap, const CubeMapCaptureMatrices& matrices, bool withDepth = false);
+        ~CubeMapCaptureTarget();
+
+        // Begin the render pass on one face of one mip level
+        void beginFace(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t face, uint32_t mipLevel);
+        void pushFaceIndex(const Wrapper::CommandBuffer::Ptr& commandBuffer, VkPipelineLayout layout, uint32_t face);
+
+        [[nodiscard]] Wrapper::RenderPass::Ptr getRenderPass() const { return mRenderPass; }
+        [[nodiscard]] VkDescriptorSetLayout getDescriptorLayout() const { return mDescriptorLayout->getLayout(); }
+        [[nodiscard]] VkDescriptorSet getDescriptorSet() const { return mDescriptorSet->getDescriptorSet(0); }
+        [[nodiscard]] VkPushConstantRange getFacePushConstantRange() const;
+        [[nodiscard]] uint32_t getMipLevels() const { return mMipLevels; }
+        [[nodiscard]] bool hasDepth() const { return mDepthImage != nullptr; }
+        [[nodiscard]] uint32_t getMipWidth(uint32_t mipLevel) const { return std::max(1u, mWidth >> mipLevel); }
+        [[nodiscard]] uint32_t getMipHeight(uint32_t mipLevel) const { return std::max(1u, mHeight >> mipLevel); }
+
+    private:
+        void createRenderPass();
+        void createFaceFramebuffers();
+        void createMatricesDescriptor(const CubeMapCaptureMatrices& matrices);
+
+    private:
+        Wrapper::Device::Ptr mDevice{ nullptr };
+        Wrapper::Image::Ptr mCubeMap{ nullptr };
+        uint32_t mWidth{ 0 };
+        uint32_t mHeight{ 0 };
+        uint32_t mMipLevels{ 1 };
+        // Mip 0 sized, smaller mips render into its corner
+        Wrapper::Image::Ptr mDepthImage{ nullptr };
+
+        Wrapper::RenderPass::Ptr mRenderPass{ nullptr };
+        // Indexed by mipLevel * 6 + face
+        std::vector<VkImageView> mFaceViews{};
+        std::vector<VkFramebuffer> mFaceFramebuffers{};
+
+        std::vector<Wrapper::UniformParameter::Ptr> mUniformParameters{};
+        Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+        Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+        Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+    };
+}
@@ -21,7 +21,8 @@ namespace FF {
         VkSampleCountFlagBits sampleCount,
         VkFrontFace inFrontFace,
         bool needFlipVewport,
-        bool enableDynamicViewPort)
+        bool enableDynamicViewPort,
+        bool enableDepthWrite)
     {
         mWidth = width;
         mHeight = height;
@@ -70,18 +71,8 @@ namespace FF {
         mPipeline->mViewportState.scissorCount = static_cast<uint32_t>(mPipeline->mScissors.size());
         mPipeline->mViewportState.pScissors = mPipeline->mScissors.data();
 
-        // 4. dynamic state 
-        
-        mPipeline->mDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		if (enableDynamicViewPort) {
-			mPipeline->mDynamicState.dynamicStateCount = 2; // Viewport and Scissor
-			mPipeline->dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			mPipeline->mDynamicState.pDynamicStates = mPipeline->dynamicStates.data();
-		}
-		else {
-			mPipeline->mDynamicState.dynamicStateCount = 0;
-			mPipeline->mDynamicState.pDynamicStates = nullptr;
-		}
+        // 4. dynamic state, viewport and scissor are then set at record time
+        mPipeline->setDynamicViewport(enableDynamicViewPort);
 
         // 5. vertex input
         mPipeline->mVertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -114,7 +105,7 @@ namespace FF {
 
         mPipeline->mDepthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         mPipeline->mDepthStencilState.depthTestEnable = VK_TRUE;
-        mPipeline->mDepthStencilState.depthWriteEnable = VK_FALSE;
+        mPipeline->mDepthStencilState.depthWriteEnable = enableDepthWrite ? VK_TRUE : VK_FALSE;
         mPipeline->mDepthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
         mPipeline->mDepthStencilState.depthBoundsTestEnable = VK_FALSE;
         mPipeline->mDepthStencilState.stencilTestEnable = VK_FALSE;
@@ -219,18 +210,8 @@ namespace FF {
         mPipeline->mViewportState.scissorCount = static_cast<uint32_t>(mPipeline->mScissors.size());
         mPipeline->mViewportState.pScissors = mPipeline->mScissors.data();
 
-        // 4. dynamic state 
-
-        mPipeline->mDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        if (enableDynamicViewPort) {
-            mPipeline->mDynamicState.dynamicStateCount = 2; // Viewport and Scissor
-            mPipeline->dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-            mPipeline->mDynamicState.pDynamicStates = mPipeline->dynamicStates.data();
-        }
-        else {
-            mPipeline->mDynamicState.dynamicStateCount = 0;
-            mPipeline->mDynamicState.pDynamicStates = nullptr;
-        }
+        // 4. dynamic state, viewport and scissor are then set at record time
+        mPipeline->setDynamicViewport(enableDynamicViewPort);
 
         // 5. vertex input
         // Full screen triangle, no need for vertex buffer
@@ -28,7 +28,8 @@ namespace FF {
             VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT,
 			VkFrontFace inFrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
 			bool needFlipVewport = true,
-			bool enableDynamicViewPort = false
+			bool enableDynamicViewPort = true,
+			bool enableDepthWrite = false
         );
 
         void buildScreenQuadPipeline(const Wrapper::RenderPass::Ptr& renderPass,
@@ -39,7 +40,7 @@ namespace FF {
             VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT,
             VkFrontFace inFrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
             bool needFlipVewport = true,
-            bool enableDynamicViewPort = false);
+            bool enableDynamicViewPort = true);
 
         Wrapper::Pipeline::Ptr getPipeline() const { return mPipeline; }
 
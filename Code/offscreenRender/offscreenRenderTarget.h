@@ -60,7 +60,7 @@ namespace FF {
         Wrapper::Device::Ptr mDevice;
         Wrapper::CommandPool::Ptr mCommandPool;
         uint32_t mWidth, mHeight;
-		uint32_t mImageCount; // Number of images in the offscreen render target,by default the same as the swap chain image count
+		uint32_t mImageCount; // Number of images in the offscreen render target, one per frame in flight
         int mColorBufferCount;
         VkFormat mColorFormat, mDepthFormat;
 
@@ -0,0 +1,65 @@
+#include "parallelCommandRecorder.h"
+
+namespace FF {
+
+	ParallelCommandRecorder::ParallelCommandRecorder(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount, uint32_t minItemsPerBuffer)
+		: mDevice(device), mThreadPool(threadPool), mMinItemsPerBuffer(std::max(1u, minItemsPerBuffer)) {
+		mFrameSlots.resize(frameCount);
+		for (auto& slots : mFrameSlots) {
+			slots.resize(getMaxBufferCount());
+			for (auto& slot : slots) {
+				slot.mCommandPool = Wrapper::CommandPool::create(mDevice, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			}
+		}
+	}
+
+	ParallelCommandRecorder::~ParallelCommandRecorder() {
+		// Buffers go back to their pools before the pools are destroyed
+		for (auto& slots : mFrameSlots) {
+			for (auto& slot : slots) {
+				slot.mCommandBuffers.clear();
+				slot.mCommandPool = nullptr;
+			}
+		}
+		mFrameSlots.clear();
+	}
+
+	void ParallelCommandRecorder::beginFrame(uint32_t frame) {
+		for (auto& slot : mFrameSlots[frame]) {
+			if (slot.mUsedCount > 0) {
+				slot.mCommandPool->reset();
+				slot.mUsedCount = 0;
+			}
+		}
+	}
+
+	std::vector<VkCommandBuffer> ParallelCommandRecorder::record(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritance, uint32_t itemCount, const RecordTask& task) {
+		if (itemCount == 0) {
+			return {};
+		}
+
+		std::vector<RangeSlot>& slots = mFrameSlots[frame];
+		const uint32_t rangeCount = std::min(static_cast<uint32_t>(slots.size()), (itemCount + mMinItemsPerBuffer - 1) / mMinItemsPerBuffer);
+		const uint32_t rangeSize = (itemCount + rangeCount - 1) / rangeCount;
+
+		// Several passes of a frame may record through the same slots, each range takes the next unused buffer of its slot
+		std::vector<VkCommandBuffer> recorded((itemCount + rangeSize - 1) / rangeSize, VK_NULL_HANDLE);
+
+		mThreadPool->parallelFor(itemCount, [&](uint32_t begin, uint32_t end) {
+			const uint32_t range = begin / rangeSize;
+			RangeSlot& slot = slots[range];
+			if (slot.mUsedCount == slot.mCommandBuffers.size()) {
+				slot.mCommandBuffers.push_back(Wrapper::CommandBuffer::create(mDevice, slot.mCommandPool, true));
+			}
+			const Wrapper::CommandBuffer::Ptr& commandBuffer = slot.mCommandBuffers[slot.mUsedCount++];
+
+			commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, inheritance);
+			task(commandBuffer, begin, end);
+			commandBuffer->endCommandBuffer();
+
+			recorded[range] = commandBuffer->getCommandBuffer();
+		}, rangeSize);
+
+		return recorded;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "base.h"
+#include "threadPool.h"
+#include "vulkanWrapper/device.h"
+#include "vulkanWrapper/commandPool.h"
+#include "vulkanWrapper/commandBuffer.h"
+
+namespace FF {
+	/*
+	* Records the draws of one subpass in parallel: [0, itemCount) is split in at most one contiguous range per thread,
+	* each range goes to a secondary command buffer that continues the render pass of the primary.
+	* Command pools are externally synchronized, so every range slot owns a transient pool per frame in flight;
+	* a range is recorded by a single thread and the pools of a frame are reset together once its fence signaled.
+	*/
+	class ParallelCommandRecorder {
+	public:
+		using Ptr = std::shared_ptr<ParallelCommandRecorder>;
+		// Records items [begin, end). Nothing is inherited but the render pass: bind the pipeline, sets and dynamic state first
+		using RecordTask = std::function<void(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t begin, uint32_t end)>;
+
+		/// @param minItemsPerBuffer below this many items per range fewer secondaries are recorded, small passes stay on the calling thread.
+		static Ptr create(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount, uint32_t minItemsPerBuffer = 64) {
+			return std::make_shared<ParallelCommandRecorder>(device, threadPool, frameCount, minItemsPerBuffer);
+		}
+
+		ParallelCommandRecorder(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount, uint32_t minItemsPerBuffer);
+		~ParallelCommandRecorder();
+
+		// Reset every pool of the frame, none of its secondaries may be pending
+		void beginFrame(uint32_t frame);
+
+		/// @brief Record the items into secondaries continuing inheritance.renderPass / subpass / framebuffer, blocks until all are done.
+		/// @return the secondaries in item order for CommandBuffer::executeCommands, valid until the next beginFrame of the frame.
+		std::vector<VkCommandBuffer> record(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritance, uint32_t itemCount, const RecordTask& task);
+
+		[[nodiscard]] uint32_t getMaxBufferCount() const { return mThreadPool->getThreadCount(); }
+
+	private:
+		// Secondaries are kept across frames and handed out again after the pool reset
+		struct RangeSlot {
+			Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+			std::vector<Wrapper::CommandBuffer::Ptr> mCommandBuffers{};
+			uint32_t mUsedCount{ 0 };
+		};
+
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		ThreadPool::Ptr mThreadPool{ nullptr };
+		uint32_t mMinItemsPerBuffer{ 64 };
+		// [frame][range]
+		std::vector<std::vector<RangeSlot>> mFrameSlots{};
+	};
+}
@@ -0,0 +1,549 @@
+#include "renderGraph.h"
+
+namespace FF {
+
+	namespace {
+		constexpr VkAccessFlags WriteAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		bool isDepthFormat(VkFormat format) {
+			return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+				format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+		}
+
+		bool hasStencil(VkFormat format) {
+			return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+		}
+	}
+
+	RenderGraph::RenderGraph(const Wrapper::Device::Ptr& device) : mDevice(device) {
+	}
+
+	RenderGraph::~RenderGraph() {
+		for (auto& pass : mPasses) {
+			if (pass.mFramebuffer != VK_NULL_HANDLE) {
+				vkDestroyFramebuffer(mDevice->getDevice(), pass.mFramebuffer, nullptr);
+			}
+			for (auto& [views, framebuffer] : pass.mImportedFramebuffers) {
+				vkDestroyFramebuffer(mDevice->getDevice(), framebuffer, nullptr);
+			}
+			pass.mRenderPass.reset();
+		}
+		// The images go before the memory they are bound to
+		for (auto& resource : mResources) {
+			resource.mImage.reset();
+		}
+		for (auto& block : mMemoryBlocks) {
+			if (block.mMemory != VK_NULL_HANDLE) {
+				vkFreeMemory(mDevice->getDevice(), block.mMemory, nullptr);
+			}
+		}
+		mPasses.clear();
+		mResources.clear();
+		mMemoryBlocks.clear();
+		mDevice.reset();
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const ImageDesc& desc) {
+		if (mCompiled) {
+			throw std::runtime_error("Error: render graph is already compiled!");
+		}
+		Resource resource{};
+		resource.mName = name;
+		resource.mDesc = desc;
+		mResources.push_back(resource);
+		return static_cast<ResourceHandle>(mResources.size() - 1);
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const ImageDesc& desc, VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags initialStage) {
+		const ResourceHandle handle = createImage(name, desc);
+		Resource& resource = mResources[handle];
+		resource.mImported = true;
+		resource.mInitialLayout = initialLayout;
+		resource.mFinalLayout = finalLayout;
+		resource.mInitialStage = initialStage;
+		return handle;
+	}
+
+	RenderGraph::PassHandle RenderGraph::addRasterPass(const RasterPass& pass) {
+		if (mCompiled) {
+			throw std::runtime_error("Error: render graph is already compiled!");
+		}
+		if (pass.mColorAttachments.empty()) {
+			throw std::runtime_error("Error: render graph pass " + pass.mName + " has no color attachment!");
+		}
+		Pass graphPass{};
+		graphPass.mDesc = pass;
+		mPasses.push_back(graphPass);
+		return static_cast<PassHandle>(mPasses.size() - 1);
+	}
+
+	void RenderGraph::setImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView) {
+		if (!mResources[resource].mImported) {
+			throw std::runtime_error("Error: render graph image " + mResources[resource].mName + " is not imported!");
+		}
+		mResources[resource].mVkImage = image;
+		mResources[resource].mImageView = imageView;
+	}
+
+	void RenderGraph::compile() {
+		if (mCompiled) {
+			throw std::runtime_error("Error: render graph is already compiled!");
+		}
+		cullPasses();
+		collectAccesses();
+		allocateTransientImages();
+		createRenderPasses();
+		createFramebuffers();
+		buildBarriers();
+		mCompiled = true;
+
+		std::cout << "Render graph: " << mPasses.size() - mCulledPassCount << " passes, " << mCulledPassCount << " culled, transient memory "
+			<< mTransientMemorySize / (1024.0 * 1024.0) << " MB (" << mUnaliasedMemorySize / (1024.0 * 1024.0) << " MB without aliasing)" << std::endl;
+	}
+
+	void RenderGraph::cullPasses() {
+		// Walking backwards from the outputs: a pass is kept if something kept later, or an imported image, needs what it writes
+		std::vector<bool> needed(mResources.size(), false);
+		for (size_t i = 0; i < mResources.size(); i++) {
+			needed[i] = mResources[i].mImported;
+		}
+
+		mCulledPassCount = 0;
+		for (size_t i = mPasses.size(); i-- > 0;) {
+			Pass& pass = mPasses[i];
+			const RasterPass& desc = pass.mDesc;
+			bool live = false;
+			for (const auto& attachment : desc.mColorAttachments) {
+				live = live || needed[attachment.mResource];
+			}
+			if (desc.mResolveAttachment != InvalidResource) {
+				live = live || needed[desc.mResolveAttachment];
+			}
+			if (desc.mDepthAttachment.mResource != InvalidResource) {
+				live = live || needed[desc.mDepthAttachment.mResource];
+			}
+
+			pass.mCulled = !live;
+			if (!live) {
+				mCulledPassCount++;
+				continue;
+			}
+			for (ResourceHandle sampled : desc.mSampledImages) {
+				needed[sampled] = true;
+			}
+			for (const auto& attachment : desc.mColorAttachments) {
+				if (attachment.mLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+					needed[attachment.mResource] = true;
+				}
+			}
+			if (desc.mDepthAttachment.mResource != InvalidResource && desc.mDepthAttachment.mLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+				needed[desc.mDepthAttachment.mResource] = true;
+			}
+		}
+	}
+
+	void RenderGraph::collectAccesses() {
+		for (int32_t i = 0; i < static_cast<int32_t>(mPasses.size()); i++) {
+			Pass& pass = mPasses[i];
+			if (pass.mCulled) {
+				continue;
+			}
+			const RasterPass& desc = pass.mDesc;
+
+			auto addAccess = [&](ResourceHandle handle, VkImageLayout layout, VkPipelineStageFlags stage, VkAccessFlags access, bool discard, bool attachment, VkImageUsageFlags usage) {
+				if (handle >= mResources.size()) {
+					throw std::runtime_error("Error: render graph pass " + desc.mName + " uses an unknown image!");
+				}
+				for (const auto& other : pass.mAccesses) {
+					if (other.mResource == handle) {
+						throw std::runtime_error("Error: render graph pass " + desc.mName + " uses " + mResources[handle].mName + " twice!");
+					}
+				}
+				Resource& resource = mResources[handle];
+				resource.mUsage |= usage;
+				if (resource.mFirstPass < 0) {
+					resource.mFirstPass = i;
+				}
+				resource.mLastPass = i;
+				pass.mAccesses.push_back({ handle, layout, stage, access, discard, attachment });
+			};
+
+			for (ResourceHandle sampled : desc.mSampledImages) {
+				addAccess(sampled, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					VK_ACCESS_SHADER_READ_BIT, false, false, VK_IMAGE_USAGE_SAMPLED_BIT);
+			}
+			for (const auto& attachment : desc.mColorAttachments) {
+				const bool load = attachment.mLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+				addAccess(attachment.mResource, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0), !load, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+			}
+			if (desc.mResolveAttachment != InvalidResource) {
+				addAccess(desc.mResolveAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+			}
+			if (desc.mDepthAttachment.mResource != InvalidResource) {
+				const bool load = desc.mDepthAttachment.mLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+				addAccess(desc.mDepthAttachment.mResource, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, !load, true,
+					VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+			}
+		}
+
+		for (auto& resource : mResources) {
+			const VkFormat format = resource.mDesc.mFormat;
+			resource.mUsage |= resource.mDesc.mExtraUsage;
+			// A sampled view of a depth image only sees the depth aspect
+			resource.mAspect = !isDepthFormat(format) ? VK_IMAGE_ASPECT_COLOR_BIT
+				: (VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil(format) && !(resource.mUsage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0));
+			// Written and consumed inside one pass, tile based gpus may keep it in tile memory
+			if (!resource.mImported && resource.mFirstPass >= 0 && resource.mFirstPass == resource.mLastPass
+				&& !(resource.mUsage & VK_IMAGE_USAGE_SAMPLED_BIT) && resource.mDesc.mExtraUsage == 0) {
+				resource.mUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+		}
+	}
+
+	void RenderGraph::allocateTransientImages() {
+		std::vector<ResourceHandle> transients{};
+		std::vector<VkMemoryRequirements> requirements(mResources.size());
+		mUnaliasedMemorySize = 0;
+		for (ResourceHandle handle = 0; handle < mResources.size(); handle++) {
+			Resource& resource = mResources[handle];
+			if (resource.mImported || resource.mFirstPass < 0) {
+				continue;
+			}
+			resource.mImage = Wrapper::Image::create(mDevice,
+				resource.mDesc.mWidth, resource.mDesc.mHeight,
+				resource.mDesc.mFormat,
+				VK_IMAGE_TYPE_2D,
+				VK_IMAGE_TILING_OPTIMAL,
+				resource.mUsage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				resource.mDesc.mSamples,
+				resource.mAspect,
+				false, 1, 0, 1,
+				false);
+			requirements[handle] = resource.mImage->getMemoryRequirements();
+			mUnaliasedMemorySize += requirements[handle].size;
+			transients.push_back(handle);
+		}
+
+		// Largest first, each image goes into the first block whose images are all out of use during its passes
+		std::sort(transients.begin(), transients.end(), [&](ResourceHandle a, ResourceHandle b) {
+			return requirements[a].size > requirements[b].size;
+		});
+		for (ResourceHandle handle : transients) {
+			Resource& resource = mResources[handle];
+			uint32_t blockIndex = static_cast<uint32_t>(mMemoryBlocks.size());
+			for (uint32_t b = 0; b < mMemoryBlocks.size(); b++) {
+				const MemoryBlock& block = mMemoryBlocks[b];
+				if ((block.mMemoryTypeBits & requirements[handle].memoryTypeBits) == 0) {
+					continue;
+				}
+				// Images read back after the frame are never aliased
+				bool overlaps = resource.mDesc.mExtraUsage != 0;
+				for (ResourceHandle other : block.mResources) {
+					const Resource& otherResource = mResources[other];
+					overlaps = overlaps || otherResource.mDesc.mExtraUsage != 0
+						|| (resource.mFirstPass <= otherResource.mLastPass && otherResource.mFirstPass <= resource.mLastPass);
+				}
+				if (!overlaps) {
+					blockIndex = b;
+					break;
+				}
+			}
+			if (blockIndex == mMemoryBlocks.size()) {
+				mMemoryBlocks.push_back({});
+			}
+			// Every image sits at offset 0 of its block, which satisfies any alignment
+			MemoryBlock& block = mMemoryBlocks[blockIndex];
+			block.mSize = std::max(block.mSize, requirements[handle].size);
+			block.mMemoryTypeBits &= requirements[handle].memoryTypeBits;
+			block.mResources.push_back(handle);
+			resource.mMemoryBlock = blockIndex;
+		}
+
+		mTransientMemorySize = 0;
+		for (auto& block : mMemoryBlocks) {
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = block.mSize;
+			allocInfo.memoryTypeIndex = findMemoryType(block.mMemoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			if (vkAllocateMemory(mDevice->getDevice(), &allocInfo, nullptr, &block.mMemory) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to allocate render graph memory!");
+			}
+			mTransientMemorySize += block.mSize;
+
+			for (ResourceHandle handle : block.mResources) {
+				Resource& resource = mResources[handle];
+				resource.mImage->bindMemory(block.mMemory, 0);
+				resource.mVkImage = resource.mImage->getImage();
+				resource.mImageView = resource.mImage->getImageView();
+			}
+		}
+	}
+
+	void RenderGraph::createRenderPasses() {
+		for (int32_t i = 0; i < static_cast<int32_t>(mPasses.size()); i++) {
+			Pass& pass = mPasses[i];
+			if (pass.mCulled) {
+				continue;
+			}
+			const RasterPass& desc = pass.mDesc;
+			pass.mRenderPass = Wrapper::RenderPass::create(mDevice);
+
+			// The layouts are set by the barriers before the pass, the render pass itself only transitions an imported
+			// image after its last use, into the layout it has to be left in
+			auto addAttachment = [&](ResourceHandle handle, VkAttachmentLoadOp loadOp, VkImageLayout layout, VkClearValue clearValue) {
+				const Resource& resource = mResources[handle];
+				if (pass.mAttachments.empty()) {
+					pass.mExtent = { resource.mDesc.mWidth, resource.mDesc.mHeight };
+				}
+				else if (pass.mExtent.width != resource.mDesc.mWidth || pass.mExtent.height != resource.mDesc.mHeight) {
+					throw std::runtime_error("Error: render graph pass " + desc.mName + " has attachments of different sizes!");
+				}
+
+				VkAttachmentDescription attachment{};
+				attachment.format = resource.mDesc.mFormat;
+				attachment.samples = resource.mDesc.mSamples;
+				attachment.loadOp = loadOp;
+				// Nobody reads what is left after the last pass of a transient image
+				attachment.storeOp = (resource.mImported || resource.mLastPass > i) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.initialLayout = layout;
+				attachment.finalLayout = (resource.mImported && resource.mLastPass == i) ? resource.mFinalLayout : layout;
+				pass.mRenderPass->addAttachment(attachment);
+
+				pass.mAttachments.push_back(handle);
+				pass.mClearValues.push_back(clearValue);
+				return static_cast<uint32_t>(pass.mAttachments.size() - 1);
+			};
+
+			Wrapper::SubPass subpass{};
+			for (const auto& attachment : desc.mColorAttachments) {
+				const uint32_t index = addAttachment(attachment.mResource, attachment.mLoadOp, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, attachment.mClearValue);
+				subpass.addColorAttachmentReference({ index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			}
+			if (desc.mResolveAttachment != InvalidResource) {
+				const uint32_t index = addAttachment(desc.mResolveAttachment, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, {});
+				subpass.setResolveAttachmentReference({ index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			}
+			if (desc.mDepthAttachment.mResource != InvalidResource) {
+				const uint32_t index = addAttachment(desc.mDepthAttachment.mResource, desc.mDepthAttachment.mLoadOp,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, desc.mDepthAttachment.mClearValue);
+				subpass.setDepthStencilAttachmentReference({ index, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL });
+			}
+			pass.mRenderPass->addSubpass(subpass);
+			pass.mRenderPass->buildRenderPass();
+		}
+	}
+
+	void RenderGraph::createFramebuffers() {
+		for (auto& pass : mPasses) {
+			if (pass.mCulled) {
+				continue;
+			}
+			bool imported = false;
+			std::vector<VkImageView> views{};
+			for (ResourceHandle handle : pass.mAttachments) {
+				imported = imported || mResources[handle].mImported;
+				views.push_back(mResources[handle].mImageView);
+			}
+			// With an imported attachment the framebuffer depends on the image of the frame, see getFramebuffer
+			if (!imported) {
+				pass.mFramebuffer = createFramebuffer(pass, views);
+			}
+		}
+	}
+
+	VkFramebuffer RenderGraph::getFramebuffer(Pass& pass) {
+		if (pass.mFramebuffer != VK_NULL_HANDLE) {
+			return pass.mFramebuffer;
+		}
+		std::vector<VkImageView> views{};
+		for (ResourceHandle handle : pass.mAttachments) {
+			if (mResources[handle].mImageView == VK_NULL_HANDLE) {
+				throw std::runtime_error("Error: render graph image " + mResources[handle].mName + " was not set!");
+			}
+			views.push_back(mResources[handle].mImageView);
+		}
+		auto it = pass.mImportedFramebuffers.find(views);
+		if (it == pass.mImportedFramebuffers.end()) {
+			it = pass.mImportedFramebuffers.emplace(views, createFramebuffer(pass, views)).first;
+		}
+		return it->second;
+	}
+
+	VkFramebuffer RenderGraph::createFramebuffer(const Pass& pass, const std::vector<VkImageView>& views) const {
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = pass.mRenderPass->getRenderPass();
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = pass.mExtent.width;
+		framebufferInfo.height = pass.mExtent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer{ VK_NULL_HANDLE };
+		if (vkCreateFramebuffer(mDevice->getDevice(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to create render graph framebuffer!");
+		}
+		return framebuffer;
+	}
+
+	void RenderGraph::buildBarriers() {
+		struct State {
+			VkImageLayout mLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkPipelineStageFlags mStage{ 0 };
+			VkAccessFlags mAccess{ 0 };
+		};
+
+		// Last access of every image in a frame
+		std::vector<State> lastAccess(mResources.size());
+		for (const auto& pass : mPasses) {
+			for (const auto& access : pass.mAccesses) {
+				lastAccess[access.mResource] = { access.mLayout, access.mStage, access.mAccess };
+			}
+		}
+
+		// A transient image starts its frame after the last use of every image sharing its memory: the ones before it in
+		// this frame, and all of them in the previous frame
+		std::vector<State> states(mResources.size());
+		for (ResourceHandle handle = 0; handle < mResources.size(); handle++) {
+			const Resource& resource = mResources[handle];
+			if (resource.mImported) {
+				states[handle] = { resource.mInitialLayout, resource.mInitialStage, 0 };
+				continue;
+			}
+			if (resource.mFirstPass < 0) {
+				continue;
+			}
+			State& state = states[handle];
+			for (ResourceHandle other : mMemoryBlocks[resource.mMemoryBlock].mResources) {
+				state.mStage |= lastAccess[other].mStage;
+				state.mAccess |= lastAccess[other].mAccess & WriteAccessMask;
+			}
+		}
+
+		auto addBarrier = [&](BarrierBatch& batch, ResourceHandle handle, const State& from, VkImageLayout oldLayout, const State& to) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = to.mLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			// Only writes have to be made available, a write after a read only needs the execution dependency
+			barrier.srcAccessMask = from.mAccess & WriteAccessMask;
+			barrier.dstAccessMask = to.mAccess;
+			barrier.subresourceRange.aspectMask = mResources[handle].mAspect;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+			batch.mBarriers.push_back({ handle, barrier });
+			batch.mSrcStages |= from.mStage != 0 ? from.mStage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			batch.mDstStages |= to.mStage;
+		};
+
+		for (int32_t i = 0; i < static_cast<int32_t>(mPasses.size()); i++) {
+			Pass& pass = mPasses[i];
+			for (const auto& access : pass.mAccesses) {
+				const Resource& resource = mResources[access.mResource];
+				State& state = states[access.mResource];
+				if (!resource.mImported && resource.mFirstPass == i && !access.mDiscard) {
+					throw std::runtime_error("Error: render graph image " + resource.mName + " is read before any pass writes it!");
+				}
+
+				const State next{ access.mLayout, access.mStage, access.mAccess };
+				const bool hazard = state.mLayout != next.mLayout || (state.mAccess & WriteAccessMask) || (next.mAccess & WriteAccessMask);
+				if (hazard) {
+					addBarrier(pass.mBarriers, access.mResource, state, access.mDiscard ? VK_IMAGE_LAYOUT_UNDEFINED : state.mLayout, next);
+				}
+				state = next;
+				if (resource.mImported && resource.mLastPass == i && access.mAttachment) {
+					// The render pass ends it in its final layout
+					state.mLayout = resource.mFinalLayout;
+				}
+			}
+		}
+
+		for (ResourceHandle handle = 0; handle < mResources.size(); handle++) {
+			const Resource& resource = mResources[handle];
+			if (resource.mImported && resource.mFirstPass >= 0 && states[handle].mLayout != resource.mFinalLayout) {
+				addBarrier(mFinalBarriers, handle, states[handle], states[handle].mLayout,
+					{ resource.mFinalLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 });
+			}
+		}
+	}
+
+	void RenderGraph::execute(const Wrapper::CommandBuffer::Ptr& commandBuffer) {
+		if (!mCompiled) {
+			throw std::runtime_error("Error: render graph is not compiled!");
+		}
+
+		auto emitBarriers = [&](const BarrierBatch& batch) {
+			if (batch.mBarriers.empty()) {
+				return;
+			}
+			std::vector<VkImageMemoryBarrier> barriers{};
+			barriers.reserve(batch.mBarriers.size());
+			for (const auto& imageBarrier : batch.mBarriers) {
+				const Resource& resource = mResources[imageBarrier.mResource];
+				if (resource.mVkImage == VK_NULL_HANDLE) {
+					throw std::runtime_error("Error: render graph image " + resource.mName + " was not set!");
+				}
+				barriers.push_back(imageBarrier.mBarrier);
+				barriers.back().image = resource.mVkImage;
+			}
+			commandBuffer->transferImageLayouts(barriers, batch.mSrcStages, batch.mDstStages);
+		};
+
+		for (auto& pass : mPasses) {
+			if (pass.mCulled) {
+				continue;
+			}
+			emitBarriers(pass.mBarriers);
+
+			// Pipeline statistics of a pass continued by secondaries would need inherited queries, those only get timestamps
+			Wrapper::GPUZone zone(mProfiler, commandBuffer, pass.mDesc.mName, pass.mDesc.mContents == VK_SUBPASS_CONTENTS_INLINE);
+
+			VkRenderPassBeginInfo renderPassBeginInfo{};
+			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassBeginInfo.renderPass = pass.mRenderPass->getRenderPass();
+			renderPassBeginInfo.framebuffer = getFramebuffer(pass);
+			renderPassBeginInfo.renderArea.offset = { 0, 0 };
+			renderPassBeginInfo.renderArea.extent = pass.mExtent;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.mClearValues.size());
+			renderPassBeginInfo.pClearValues = pass.mClearValues.data();
+			commandBuffer->beginRenderPass(renderPassBeginInfo, pass.mDesc.mContents);
+
+			PassContext context{};
+			context.mCommandBuffer = commandBuffer;
+			context.mInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			context.mInheritance.renderPass = renderPassBeginInfo.renderPass;
+			context.mInheritance.subpass = 0;
+			context.mInheritance.framebuffer = renderPassBeginInfo.framebuffer;
+			context.mExtent = pass.mExtent;
+			if (pass.mDesc.mExecute) {
+				pass.mDesc.mExecute(context);
+			}
+
+			commandBuffer->endRenderPass();
+		}
+		emitBarriers(mFinalBarriers);
+	}
+
+	uint32_t RenderGraph::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(mDevice->getPhysicalDevice(), &memProperties);
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+		throw std::runtime_error("Error: failed to find suitable memory type!");
+	}
+}
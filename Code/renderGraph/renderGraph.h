@@ -0,0 +1,193 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/renderPass.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/gpuProfiler.h"
+#include <map>
+#include <functional>
+
+namespace FF {
+	/*
+	* Frame graph of raster passes. Passes declare the images they write as attachments and the images they sample,
+	* compile() then derives everything that used to be written by hand for each pass:
+	* - passes none of whose writes reach an imported image (the outputs) are culled, with the images only they used
+	* - one render pass and framebuffer per pass, store ops are DONT_CARE for contents nobody reads afterwards
+	* - layout transitions and hazards as one batched vkCmdPipelineBarrier before each pass, reads after reads need none
+	* - transient images are created without memory, images whose pass ranges do not overlap share one allocation
+	* Transient images live as long as the graph and are shared by the frames in flight: the first barrier of a frame
+	* waits on the last use of the previous frame, so consecutive frames do not overlap on them. Their contents do not
+	* survive from one frame to the next, the first pass using one in a frame has to write it without loading it.
+	* The graph is static, build it again when the extent or the passes change.
+	*/
+	class RenderGraph {
+	public:
+		using Ptr = std::shared_ptr<RenderGraph>;
+		using ResourceHandle = uint32_t;
+		using PassHandle = uint32_t;
+		static constexpr ResourceHandle InvalidResource = ~0u;
+
+		struct ImageDesc {
+			uint32_t mWidth{ 0 };
+			uint32_t mHeight{ 0 };
+			VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+			VkSampleCountFlagBits mSamples{ VK_SAMPLE_COUNT_1_BIT };
+			// On top of the usage the passes imply, TRANSFER_SRC to read a graph image back after the frame.
+			// Such an image gets memory of its own, its contents stay until the next frame writes it
+			VkImageUsageFlags mExtraUsage{ 0 };
+		};
+
+		struct Attachment {
+			ResourceHandle mResource{ InvalidResource };
+			VkAttachmentLoadOp mLoadOp{ VK_ATTACHMENT_LOAD_OP_CLEAR }; // LOAD reads what the previous writer left
+			VkClearValue mClearValue{};
+		};
+
+		// What the execute callback of a pass records against, the render pass is already begun
+		struct PassContext {
+			Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+			VkCommandBufferInheritanceInfo mInheritance{}; // for secondaries continuing the pass
+			VkExtent2D mExtent{};
+		};
+		using ExecuteCallback = std::function<void(const PassContext& context)>;
+
+		struct RasterPass {
+			std::string mName;
+			std::vector<Attachment> mColorAttachments{};
+			ResourceHandle mResolveAttachment{ InvalidResource }; // single sampled target of the first color attachment
+			Attachment mDepthAttachment{};
+			std::vector<ResourceHandle> mSampledImages{}; // read by the fragment shaders
+			VkSubpassContents mContents{ VK_SUBPASS_CONTENTS_INLINE };
+			ExecuteCallback mExecute{};
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device) {
+			return std::make_shared<RenderGraph>(device);
+		}
+
+		RenderGraph(const Wrapper::Device::Ptr& device);
+		~RenderGraph();
+
+		// Image owned by the graph, only valid during the frame between its first and last pass
+		ResourceHandle createImage(const std::string& name, const ImageDesc& desc);
+
+		/// @brief Image owned outside the graph (swap chain image), its VkImage is set every frame with setImportedImage.
+		/// @param initialLayout layout at the start of the frame, UNDEFINED discards the contents.
+		/// @param finalLayout layout the graph leaves it in.
+		/// @param initialStage stage the first access waits on, the wait stage of the acquire semaphore for a swap chain image.
+		ResourceHandle importImage(const std::string& name, const ImageDesc& desc, VkImageLayout initialLayout, VkImageLayout finalLayout,
+			VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+		// Passes run in the order they are added
+		PassHandle addRasterPass(const RasterPass& pass);
+
+		// Cull, create the render passes, framebuffers and transient images, and precompute the barriers
+		void compile();
+
+		void setImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView);
+
+		// Every pass executed is measured as a zone named after it, barriers excluded. nullptr stops measuring
+		void setProfiler(const Wrapper::GPUProfiler::Ptr& profiler) { mProfiler = profiler; }
+
+		// Record every pass that was not culled, between beginCommandBuffer and endCommandBuffer of a primary
+		void execute(const Wrapper::CommandBuffer::Ptr& commandBuffer);
+
+		// nullptr for a culled pass. Pipelines built against it stay compatible with the render pass of a rebuilt graph
+		// as long as the formats and sample counts of the pass do not change
+		[[nodiscard]] Wrapper::RenderPass::Ptr getRenderPass(PassHandle pass) const { return mPasses[pass].mRenderPass; }
+		// nullptr for an imported or culled image
+		[[nodiscard]] Wrapper::Image::Ptr getImage(ResourceHandle resource) const { return mResources[resource].mImage; }
+		[[nodiscard]] bool isCulled(PassHandle pass) const { return mPasses[pass].mCulled; }
+
+		[[nodiscard]] uint32_t getCulledPassCount() const { return mCulledPassCount; }
+		// Memory of the transient images as allocated, and as it would be with one allocation per image
+		[[nodiscard]] VkDeviceSize getTransientMemorySize() const { return mTransientMemorySize; }
+		[[nodiscard]] VkDeviceSize getUnaliasedMemorySize() const { return mUnaliasedMemorySize; }
+
+	private:
+		struct Resource {
+			std::string mName;
+			ImageDesc mDesc{};
+			bool mImported{ false };
+			VkImageLayout mInitialLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkImageLayout mFinalLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkPipelineStageFlags mInitialStage{ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
+
+			Wrapper::Image::Ptr mImage{ nullptr };
+			VkImage mVkImage{ VK_NULL_HANDLE };
+			VkImageView mImageView{ VK_NULL_HANDLE };
+			VkImageUsageFlags mUsage{ 0 };
+			VkImageAspectFlags mAspect{ 0 };
+
+			// Range of passes using it, culled passes excluded, -1 if none
+			int32_t mFirstPass{ -1 };
+			int32_t mLastPass{ -1 };
+			uint32_t mMemoryBlock{ ~0u };
+		};
+
+		struct ImageAccess {
+			ResourceHandle mResource{ InvalidResource };
+			VkImageLayout mLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkPipelineStageFlags mStage{ 0 };
+			VkAccessFlags mAccess{ 0 };
+			bool mDiscard{ false }; // the previous contents are not read, the transition may start from UNDEFINED
+			bool mAttachment{ false };
+		};
+
+		struct ImageBarrier {
+			ResourceHandle mResource{ InvalidResource };
+			VkImageMemoryBarrier mBarrier{}; // image filled in at execute for imported images
+		};
+
+		struct BarrierBatch {
+			std::vector<ImageBarrier> mBarriers{};
+			VkPipelineStageFlags mSrcStages{ 0 };
+			VkPipelineStageFlags mDstStages{ 0 };
+		};
+
+		struct Pass {
+			RasterPass mDesc{};
+			bool mCulled{ false };
+			std::vector<ImageAccess> mAccesses{};
+			BarrierBatch mBarriers{};
+
+			Wrapper::RenderPass::Ptr mRenderPass{ nullptr };
+			std::vector<ResourceHandle> mAttachments{}; // framebuffer order
+			std::vector<VkClearValue> mClearValues{};
+			VkExtent2D mExtent{};
+			VkFramebuffer mFramebuffer{ VK_NULL_HANDLE }; // only transient attachments
+			std::map<std::vector<VkImageView>, VkFramebuffer> mImportedFramebuffers{}; // keyed by the attachment views
+		};
+
+		struct MemoryBlock {
+			VkDeviceMemory mMemory{ VK_NULL_HANDLE };
+			VkDeviceSize mSize{ 0 };
+			uint32_t mMemoryTypeBits{ ~0u };
+			std::vector<ResourceHandle> mResources{};
+		};
+
+		void cullPasses();
+		void collectAccesses();
+		void createRenderPasses();
+		void allocateTransientImages();
+		void createFramebuffers();
+		void buildBarriers();
+		VkFramebuffer getFramebuffer(Pass& pass);
+		VkFramebuffer createFramebuffer(const Pass& pass, const std::vector<VkImageView>& views) const;
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		std::vector<Resource> mResources{};
+		std::vector<Pass> mPasses{};
+		std::vector<MemoryBlock> mMemoryBlocks{};
+		BarrierBatch mFinalBarriers{}; // imported images whose last use left them outside their final layout
+		Wrapper::GPUProfiler::Ptr mProfiler{ nullptr };
+		bool mCompiled{ false };
+
+		uint32_t mCulledPassCount{ 0 };
+		VkDeviceSize mTransientMemorySize{ 0 };
+		VkDeviceSize mUnaliasedMemorySize{ 0 };
+	};
+}
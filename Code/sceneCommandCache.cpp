@@ -0,0 +1,83 @@
+#include "sceneCommandCache.h"
+
+namespace FF {
+
+	SceneCommandCache::SceneCommandCache(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount)
+		: mDevice(device), mThreadPool(threadPool) {
+		mFrames.resize(frameCount);
+		for (auto& frame : mFrames) {
+			// Cached buffers are reset one by one when they are recorded again, never the pool as a whole
+			frame.mCommandPools.resize(mThreadPool->getThreadCount());
+			for (auto& commandPool : frame.mCommandPools) {
+				commandPool = Wrapper::CommandPool::create(mDevice, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			}
+		}
+	}
+
+	SceneCommandCache::~SceneCommandCache() {
+		// Buffers go back to their pools before the pools are destroyed
+		for (auto& frame : mFrames) {
+			frame.mItems.clear();
+			frame.mCommandPools.clear();
+		}
+		mFrames.clear();
+	}
+
+	void SceneCommandCache::invalidate() {
+		for (auto& frame : mFrames) {
+			for (auto& item : frame.mItems) {
+				item.mValid = false;
+			}
+		}
+	}
+
+	std::vector<VkCommandBuffer> SceneCommandCache::update(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritance, const std::vector<uint64_t>& revisions, const RecordTask& task) {
+		FrameCache& cache = mFrames[frame];
+		if (cache.mRenderPass != inheritance.renderPass || cache.mFramebuffer != inheritance.framebuffer) {
+			for (auto& item : cache.mItems) {
+				item.mValid = false;
+			}
+			cache.mRenderPass = inheritance.renderPass;
+			cache.mFramebuffer = inheritance.framebuffer;
+		}
+		// Items past the end are dropped with their buffers, new ones start stale
+		cache.mItems.resize(revisions.size());
+
+		const uint32_t poolCount = static_cast<uint32_t>(cache.mCommandPools.size());
+		std::vector<std::vector<uint32_t>> staleItems(poolCount);
+		mLastRecordedCount = 0;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(revisions.size()); i++) {
+			const CachedCommands& item = cache.mItems[i];
+			if (!item.mValid || item.mRevision != revisions[i]) {
+				staleItems[i % poolCount].push_back(i);
+				mLastRecordedCount++;
+			}
+		}
+
+		if (mLastRecordedCount > 0) {
+			// One task per pool: a pool and the buffers allocated from it are only touched by the thread running its task
+			mThreadPool->parallelFor(poolCount, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t pool = begin; pool < end; pool++) {
+					for (uint32_t index : staleItems[pool]) {
+						CachedCommands& item = cache.mItems[index];
+						if (item.mCommandBuffer == nullptr) {
+							item.mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, cache.mCommandPools[pool], true);
+						}
+						// Beginning resets the previous recording, the pool was created with RESET_COMMAND_BUFFER
+						item.mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, inheritance);
+						task(item.mCommandBuffer, index);
+						item.mCommandBuffer->endCommandBuffer();
+						item.mRevision = revisions[index];
+						item.mValid = true;
+					}
+				}
+			}, 1);
+		}
+
+		std::vector<VkCommandBuffer> commandBuffers(cache.mItems.size());
+		for (size_t i = 0; i < cache.mItems.size(); i++) {
+			commandBuffers[i] = cache.mItems[i].mCommandBuffer->getCommandBuffer();
+		}
+		return commandBuffers;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "base.h"
+#include "threadPool.h"
+#include "vulkanWrapper/device.h"
+#include "vulkanWrapper/commandPool.h"
+#include "vulkanWrapper/commandBuffer.h"
+
+namespace FF {
+	/*
+	* One secondary command buffer per draw item and frame in flight, kept across frames.
+	* An item is recorded again only when its revision differs from the one it was recorded at, or when the render pass
+	* or framebuffer it continues changed; per frame data has to reach it through the buffers its sets already point to.
+	* Item i lives in pool i % poolCount of its frame, so stale items of different pools are recorded on different threads.
+	*/
+	class SceneCommandCache {
+	public:
+		using Ptr = std::shared_ptr<SceneCommandCache>;
+		// Records one item. Nothing is inherited but the render pass: bind the pipeline, sets and dynamic state first
+		using RecordTask = std::function<void(const Wrapper::CommandBuffer::Ptr& commandBuffer, uint32_t item)>;
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount) {
+			return std::make_shared<SceneCommandCache>(device, threadPool, frameCount);
+		}
+
+		SceneCommandCache(const Wrapper::Device::Ptr& device, const ThreadPool::Ptr& threadPool, uint32_t frameCount);
+		~SceneCommandCache();
+
+		/// @brief Record the stale items of the frame, none of its secondaries may be pending.
+		/// @param revisions one per item, the item count is revisions.size().
+		/// @return every secondary of the frame in item order for CommandBuffer::executeCommands.
+		std::vector<VkCommandBuffer> update(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritance, const std::vector<uint64_t>& revisions, const RecordTask& task);
+
+		// Every item of every frame is recorded again at its next update
+		void invalidate();
+
+		// Items recorded by the last update, the rest was reused as is
+		[[nodiscard]] uint32_t getLastRecordedCount() const { return mLastRecordedCount; }
+
+	private:
+		struct CachedCommands {
+			Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+			uint64_t mRevision{ 0 };
+			bool mValid{ false };
+		};
+
+		struct FrameCache {
+			std::vector<Wrapper::CommandPool::Ptr> mCommandPools{};
+			std::vector<CachedCommands> mItems{};
+			VkRenderPass mRenderPass{ VK_NULL_HANDLE };
+			VkFramebuffer mFramebuffer{ VK_NULL_HANDLE };
+		};
+
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		ThreadPool::Ptr mThreadPool{ nullptr };
+		std::vector<FrameCache> mFrames{};
+		uint32_t mLastRecordedCount{ 0 };
+	};
+}
@@ -46,28 +46,47 @@ vec3 ImportanceSampleGGX(vec2 inXi,vec3 inN,float inRoughness){
     return normalize(HFinal);
 }
 
-void main() {
-	vec3 texcoord = normalize(V_Texcoord);
+// Filtered importance sampling: each GGX sample reads the source mip whose texel solid angle matches the solid angle of the sample
+// (pdf = D * NdotH / (4 * VdotH) = D / 4 with V = N). Roughness 0 is a single fetch at the mip matching the target resolution.
+vec3 PrefilterEnvironment(vec3 inN, float inRoughness, uint inSampleCount, bool inFiltered, float inTargetSize){
+    float sourceSize = float(textureSize(hdrSampler, 0).x);
+    float maxLod = float(textureQueryLevels(hdrSampler) - 1);
+    if (inFiltered && inRoughness <= 0.0) {
+        return textureLod(hdrSampler, inN, clamp(log2(sourceSize / inTargetSize), 0.0, maxLod)).rgb;
+    }
+
+    float a2 = pow(inRoughness, 4);
+    float texelSolidAngle = 4.0 * PI / (6.0 * sourceSize * sourceSize);
+    vec3 V = inN;
     vec3 prefilteredColor = vec3(0.0);
-    vec3 N = texcoord; // Normal vector, equal to the texture coordinate passed by the vertex shader
-    vec3 V = N; // L
-    float roughness = Constants.offsets[0].z; // Roughness value, can be replaced with a varying input
     float weight = 0.0;
-    const uint sampleCount = 1024; // Number of samples to take
-
-    for (uint i = 0; i < sampleCount; ++i) {
-        vec2 xi = HammersleyPoint(i, sampleCount); // Generate Hammersley point
-        vec3 H = ImportanceSampleGGX(xi, N, roughness); // Sample the GGX distribution
-        vec3 L = normalize(2.0 * dot(N, H) * H - V); // Calculate light direction
-
-        
-        float NdotL = max(dot(N, L), 0.0); // Calculate dot product for visibility
-        if(NdotL > 0.0){
-            vec3 hdriColor = texture(hdrSampler, L).rgb; // Sample the HDR texture
-            prefilteredColor += hdriColor * NdotL; // Accumulate color weighted by visibility
-            weight += NdotL; // Accumulate weight
+    for (uint i = 0u; i < inSampleCount; ++i) {
+        vec2 xi = HammersleyPoint(i, inSampleCount);
+        vec3 H = ImportanceSampleGGX(xi, inN, inRoughness);
+        vec3 L = normalize(2.0 * dot(inN, H) * H - V);
+        float NdotL = max(dot(inN, L), 0.0);
+        if (NdotL > 0.0) {
+            float lod = 0.0;
+            if (inFiltered) {
+                float NdotH = max(dot(inN, H), 0.0);
+                float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+                float pdf = a2 / (PI * d * d) * 0.25;
+                float sampleSolidAngle = 1.0 / (float(inSampleCount) * pdf + 1e-4);
+                lod = clamp(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0, maxLod);
+            }
+            prefilteredColor += textureLod(hdrSampler, L, lod).rgb * NdotL;
+            weight += NdotL;
         }
     }
-    prefilteredColor /= weight; // Average the accumulated color
+    return prefilteredColor / max(weight, 1e-4);
+}
+
+void main() {
+    vec3 N = normalize(V_Texcoord); // Normal vector, equal to the texture coordinate passed by the vertex shader
+    // offsets[0]: sample count, filtered importance sampling, face size of this mip, roughness of this mip
+    uint sampleCount = uint(Constants.offsets[0].x);
+    bool filtered = Constants.offsets[0].y > 0.5;
+    float roughness = Constants.offsets[0].w;
+    vec3 prefilteredColor = PrefilterEnvironment(N, roughness, sampleCount, filtered, Constants.offsets[0].z);
 	FragColor = vec4(prefilteredColor, 1.0); // Output color with alpha set to 1.0
-}
\ No newline at end of file
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+
+layout(location=0)in vec3 position;
+layout(location=1)in vec3 texcoord;
+layout(location=2)in vec3 normal;
+
+
+// All six capture cameras in one buffer, the face being rendered is selected by push constant
+layout(set = 2,binding = 0) uniform CaptureMatrices {
+    mat4 projection;
+    mat4 views[6];
+}captureUBO;
+
+layout(push_constant) uniform CaptureFace {
+    layout(offset = 192) uint faceIndex;
+}face;
+
+layout(location=0)out vec3 V_Texcoord;
+
+void main(){
+    V_Texcoord = position.xyz;
+    gl_Position = captureUBO.projection * captureUBO.views[face.faceIndex] * vec4(position.xyz, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 450
+
+#extension GL_KHR_vulkan_glsl : enable
+
+layout(set = 0, binding = 4) uniform samplerCube hdrSampler;
+
+layout(push_constant) uniform ProbeCapture {
+    mat4 model;
+    vec4 probePosition; // w: 1 for scene meshes, 0 for the environment
+    vec4 albedo;
+}probe;
+
+layout(location = 0) in vec3 V_Direction;
+layout(location = 1) in vec3 V_NormalWS;
+layout(location = 0) out vec4 FragColor;
+
+void main() {
+	if (probe.probePosition.w > 0.5) {
+		// Flat albedo lit by the blurriest mip of the environment, a cheap stand-in for its irradiance
+		vec3 N = normalize(V_NormalWS);
+		float lod = float(textureQueryLevels(hdrSampler) - 1);
+		FragColor = vec4(probe.albedo.rgb * textureLod(hdrSampler, N, lod).rgb, 1.0);
+	}
+	else {
+		FragColor = vec4(texture(hdrSampler, normalize(V_Direction)).rgb, 1.0);
+	}
+}
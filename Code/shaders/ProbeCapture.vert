@@ -0,0 +1,41 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+
+layout(location=0)in vec3 position;
+layout(location=2)in vec3 normal;
+
+
+// Same cameras as CubeMapCapture.vert, centered on the origin
+layout(set = 2,binding = 0) uniform CaptureMatrices {
+    mat4 projection;
+    mat4 views[6];
+}captureUBO;
+
+// Shared with ProbeCapture.frag, the face index stays where CubeMapCaptureTarget pushes it
+layout(push_constant) uniform ProbeCapture {
+    mat4 model;
+    vec4 probePosition; // w: 1 for scene meshes, 0 for the environment
+    vec4 albedo;
+    layout(offset = 192) uint faceIndex;
+}probe;
+
+layout(location=0)out vec3 V_Direction;
+layout(location=1)out vec3 V_NormalWS;
+
+void main(){
+    mat4 viewProjection = captureUBO.projection * captureUBO.views[probe.faceIndex];
+    if(probe.probePosition.w > 0.5){
+        // Scene mesh, seen from the probe (uniform scale assumed for the normal)
+        vec3 positionWS = (probe.model * vec4(position, 1.0)).xyz;
+        V_Direction = positionWS - probe.probePosition.xyz;
+        V_NormalWS = mat3(probe.model) * normal;
+        gl_Position = viewProjection * vec4(V_Direction, 1.0);
+    }
+    else{
+        // Environment at infinity: pushed to the far plane, behind every mesh
+        V_Direction = position;
+        V_NormalWS = vec3(0.0);
+        gl_Position = (viewProjection * vec4(position, 1.0)).xyww;
+    }
+}
@@ -13,13 +13,38 @@ C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V HDRI2Cubemap.frag -o HDRI2Cub
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V SkyBox.vert -o SkyBoxVert.spv
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V SkyBox.frag -o SkyBoxFrag.spv
 
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V CubeMapCapture.vert -o CubeMapCaptureVert.spv
+
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V ProbeCapture.vert -o ProbeCaptureVert.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V ProbeCapture.frag -o ProbeCaptureFrag.spv
+
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V CaptureDiffuseIrradiance.frag -o CaptureDiffuseIrradianceFrag.spv
 
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V CaptureSpecularPrefilter.frag -o CaptureSpecularPrefilterFrag.spv
 
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V generateBRDF.frag -o generateBRDFFrag.spv
 
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V EquirectToCube.comp -o EquirectToCubeComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V DiffuseIrradiance.comp -o DiffuseIrradianceComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V SpecularPrefilter.comp -o SpecularPrefilterComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V BRDFLUT.comp -o BRDFLUTComp.spv
+
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DTRANSMITTANCE_LUT SkyAtmosphere.comp -o SkyTransmittanceComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DMULTI_SCATTERING_LUT SkyAtmosphere.comp -o SkyMultiScatteringComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DSKY_VIEW_LUT SkyAtmosphere.comp -o SkyViewComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DSKY_CUBEMAP SkyAtmosphere.comp -o SkyCubeMapComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DBC6H HDRCompress.comp -o HDRCompressBC6HComp.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V HDRCompress.comp -o HDRCompressB10G11R11Comp.spv
+
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V pbr1.vert -o pbr1Vert.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DINSTANCED pbr1.vert -o pbr1InstancedVert.spv
 C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V pbr1.frag -o pbr1Frag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DBINDLESS_MATERIALS pbr1.frag -o pbr1BindlessFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DIRRADIANCE_SH pbr1.frag -o pbr1SHFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DBINDLESS_MATERIALS -DIRRADIANCE_SH pbr1.frag -o pbr1BindlessSHFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DREFLECTION_PROBES pbr1.frag -o pbr1ProbesFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DBINDLESS_MATERIALS -DREFLECTION_PROBES pbr1.frag -o pbr1BindlessProbesFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DIRRADIANCE_SH -DREFLECTION_PROBES pbr1.frag -o pbr1SHProbesFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslangValidator.exe -V -DBINDLESS_MATERIALS -DIRRADIANCE_SH -DREFLECTION_PROBES pbr1.frag -o pbr1BindlessSHProbesFrag.spv
 
 pause
\ No newline at end of file
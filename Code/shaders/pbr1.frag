@@ -1,10 +1,14 @@
-#version 420
+#version 450
 #extension GL_KHR_vulkan_glsl : enable
+#ifdef BINDLESS_MATERIALS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location=0)in vec4 V_Texcoord;
 layout(location=1)in vec4 V_NormalWS;
 layout(location=2)in vec4 V_PositionWS;
 layout(location=3)in mat3 V_TBN;
+layout(location=6)flat in int V_ObjectIndex;
 
 layout(location=0)out vec4 FragColor;
 
@@ -14,9 +18,76 @@ layout(set = 0, binding = 3) uniform cameraParameters{
 };
 
 layout(set =0, binding = 4) uniform samplerCube U_prefilteredColor;
+#ifdef IRRADIANCE_SH
+// 9 SH coefficients of the diffuse irradiance (rgb), already convolved with the cosine lobe and divided by PI
+layout(set = 0, binding = 5) uniform DiffuseIrradianceSH{
+    vec4 SHCoefficients[9];
+};
+#else
 layout(set = 0, binding = 5) uniform samplerCube U_DiffuseIrradiance;
-layout(set = 0, binding = 6) uniform sampler2D U_BRDFLUT;
+#endif
+layout(set = 0, binding = 6) uniform sampler2D U_BRDFLUT; // partially bound and never read with ANALYTIC_ENV_BRDF
+
+#ifdef REFLECTION_PROBES
+// Local reflection probes, see ReflectionProbeSet. The probes blended for each object are selected on the cpu
+#define MAX_REFLECTION_PROBES 8
+layout(set = 2, binding = 0) uniform samplerCubeArray U_ReflectionProbes;
+layout(set = 2, binding = 1) uniform ReflectionProbes{
+    vec4 ProbePositions[MAX_REFLECTION_PROBES]; // w: proxy shape, 0 box, 1 sphere
+    vec4 ProxyCenters[MAX_REFLECTION_PROBES];   // w: sphere radius
+    vec4 ProxyExtents[MAX_REFLECTION_PROBES];   // xyz: box half extent, w: blend distance
+};
+struct ProbeSelectionData {
+    ivec4 selection; // x, y: probe indices, -1 when unused
+    vec4 weights;    // x, y: their weights, the global environment gets the rest
+};
+layout(std430, set = 2, binding = 2) readonly buffer ProbeSelections {
+    ProbeSelectionData probeSelections[]; // indexed by the object index
+};
+#endif
+
+// Irradiance volume, see IrradianceVolume. SH9 probes on a grid, coefficient texel k of every probe in z slab k
+#define VOLUME_TEXELS_PER_PROBE 7
+layout(set = 3, binding = 0) uniform sampler3D U_IrradianceVolume;
+layout(set = 3, binding = 1) uniform IrradianceVolume{
+    vec4 VolumeBoundsMin; // w: 1 once baked
+    vec4 VolumeBoundsMax;
+    ivec4 VolumeResolution; // probes per axis
+};
+
+// Analytic environment BRDF instead of the LUT fetch, set by the application (Application::useAnalyticEnvBRDF)
+layout(constant_id = 0) const bool ANALYTIC_ENV_BRDF = false;
 
+#ifdef BINDLESS_MATERIALS
+// Bindless material table (set 1), see BindlessTextureTable
+struct MaterialParameters {
+    ivec4 mapIndices0; // albedo, normal, emissive, ao
+    ivec4 mapIndices1; // metallic, roughness, metalRoughness, unused
+};
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+    MaterialParameters materials[];
+};
+layout(set = 1, binding = 1) uniform sampler2D bindlessTextures[];
+
+// Vertex stage owns bytes [0, 192), the material index follows it
+layout(push_constant) uniform MaterialConstants {
+    layout(offset = 192) uint materialIndex;
+}Material;
+
+// The index comes from a push constant and the material buffer: it is dynamically uniform, no nonuniformEXT needed
+vec4 SampleMap(int inIndex, vec2 inUV, vec4 inDefault){
+    if(inIndex < 0){
+        return inDefault;
+    }
+    return texture(bindlessTextures[inIndex], inUV);
+}
+
+vec4 SampleAlbedo(vec2 inUV){ return SampleMap(materials[Material.materialIndex].mapIndices0.x, inUV, vec4(1.0)); }
+vec4 SampleNormalMap(vec2 inUV){ return SampleMap(materials[Material.materialIndex].mapIndices0.y, inUV, vec4(0.5, 0.5, 1.0, 1.0)); }
+vec4 SampleEmissive(vec2 inUV){ return SampleMap(materials[Material.materialIndex].mapIndices0.z, inUV, vec4(0.0)); }
+vec4 SampleAO(vec2 inUV){ return SampleMap(materials[Material.materialIndex].mapIndices0.w, inUV, vec4(1.0)); }
+vec4 SampleMetalRoughness(vec2 inUV){ return SampleMap(materials[Material.materialIndex].mapIndices1.z, inUV, vec4(1.0)); }
+#else
 layout(binding=7)uniform sampler2D U_Albedo;//base/diffuse
 layout(binding=8)uniform sampler2D U_Normal;
 layout(binding=9)uniform sampler2D U_Emissive;
@@ -28,7 +99,117 @@ layout(binding=13)uniform sampler2D U_DefaultMetalRoughness;
 
 layout(set = 1, binding = 0) uniform sampler2D texSampler[3];
 
+vec4 SampleAlbedo(vec2 inUV){ return texture(U_Albedo, inUV); }
+vec4 SampleNormalMap(vec2 inUV){ return texture(U_Normal, inUV); }
+vec4 SampleEmissive(vec2 inUV){ return texture(U_Emissive, inUV); }
+vec4 SampleAO(vec2 inUV){ return texture(U_AO, inUV); }
+vec4 SampleMetalRoughness(vec2 inUV){ return texture(U_DefaultMetalRoughness, inUV); }
+#endif
+
 const float PI = 3.14159265359;
+
+// Polynomial fit of the split sum BRDF (Karis, mobile env BRDF), returns the same (scale, bias) to F0 as the LUT
+vec2 EnvBRDFApprox(float inNdotV, float inRoughness){
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = inRoughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * inNdotV)) * r.x + r.y;
+    return vec2(-1.04, 1.04) * a004 + r.zw;
+}
+
+#ifdef IRRADIANCE_SH
+vec3 EvaluateIrradianceSH(vec3 inN){
+    vec3 irradiance = SHCoefficients[0].rgb * 0.282095;
+    irradiance += SHCoefficients[1].rgb * 0.488603 * inN.y;
+    irradiance += SHCoefficients[2].rgb * 0.488603 * inN.z;
+    irradiance += SHCoefficients[3].rgb * 0.488603 * inN.x;
+    irradiance += SHCoefficients[4].rgb * 1.092548 * inN.x * inN.y;
+    irradiance += SHCoefficients[5].rgb * 1.092548 * inN.y * inN.z;
+    irradiance += SHCoefficients[6].rgb * 0.315392 * (3.0 * inN.z * inN.z - 1.0);
+    irradiance += SHCoefficients[7].rgb * 1.092548 * inN.x * inN.z;
+    irradiance += SHCoefficients[8].rgb * 0.546274 * (inN.x * inN.x - inN.y * inN.y);
+    return max(irradiance, vec3(0.0));
+}
+#endif
+#ifdef REFLECTION_PROBES
+// Parallax correction: the direction from the capture point to where the reflected ray leaves the probe's proxy
+vec3 ProbeLookupDirection(int inProbe, vec3 inPositionWS, vec3 inR){
+    vec3 center = ProxyCenters[inProbe].xyz;
+    float hitDistance;
+    if(ProbePositions[inProbe].w < 0.5){
+        // Box: nearest exit among the three slabs
+        vec3 extent = ProxyExtents[inProbe].xyz;
+        vec3 toMax = (center + extent - inPositionWS) / inR;
+        vec3 toMin = (center - extent - inPositionWS) / inR;
+        vec3 exits = max(toMax, toMin);
+        hitDistance = min(min(exits.x, exits.y), exits.z);
+    }
+    else{
+        // Sphere: far root of |p + t * R - c| = radius
+        vec3 offset = inPositionWS - center;
+        float radius = ProxyCenters[inProbe].w;
+        float b = dot(offset, inR);
+        float c = dot(offset, offset) - radius * radius;
+        hitDistance = -b + sqrt(max(b * b - c, 0.0));
+    }
+    vec3 hitPosition = inPositionWS + inR * max(hitDistance, 0.0);
+    return normalize(hitPosition - ProbePositions[inProbe].xyz);
+}
+
+// Prefiltered specular from the selected local probes, blended with the global environment
+vec3 SamplePrefilteredColor(vec3 inPositionWS, vec3 inR, float inLod){
+    ProbeSelectionData probeSelection = probeSelections[V_ObjectIndex];
+    float globalWeight = max(1.0 - probeSelection.weights.x - probeSelection.weights.y, 0.0);
+    vec3 color = textureLod(U_prefilteredColor, inR, inLod).rgb * globalWeight;
+    for(int i = 0; i < 2; i++){
+        int probe = probeSelection.selection[i];
+        if(probe >= 0){
+            vec3 direction = ProbeLookupDirection(probe, inPositionWS, inR);
+            color += textureLod(U_ReflectionProbes, vec4(direction, float(probe)), inLod).rgb * probeSelection.weights[i];
+        }
+    }
+    return color;
+}
+#else
+// No set 2 without probes, the global environment only
+vec3 SamplePrefilteredColor(vec3 inPositionWS, vec3 inR, float inLod){
+    return textureLod(U_prefilteredColor, inR, inLod).rgb;
+}
+#endif
+
+// Trilinear SH9 between the 8 probes around inPositionWS, clamped to the volume
+vec3 SampleIrradianceVolume(vec3 inPositionWS, vec3 inN){
+    vec3 resolution = vec3(VolumeResolution.xyz);
+    vec3 uvw = clamp((inPositionWS - VolumeBoundsMin.xyz) / max(VolumeBoundsMax.xyz - VolumeBoundsMin.xyz, vec3(1e-4)), 0.0, 1.0);
+    // Texel centers of the first and last probe, so the filter never reaches the neighbouring slab
+    vec3 texel = uvw * (resolution - 1.0) + 0.5;
+    float depth = resolution.z * float(VOLUME_TEXELS_PER_PROBE);
+    vec4 packed[VOLUME_TEXELS_PER_PROBE];
+    for(int i = 0; i < VOLUME_TEXELS_PER_PROBE; i++){
+        packed[i] = texture(U_IrradianceVolume, vec3(texel.xy / resolution.xy, (texel.z + float(i) * resolution.z) / depth));
+    }
+    float coefficients[28] = float[28](
+        packed[0].x, packed[0].y, packed[0].z, packed[0].w, packed[1].x, packed[1].y, packed[1].z, packed[1].w,
+        packed[2].x, packed[2].y, packed[2].z, packed[2].w, packed[3].x, packed[3].y, packed[3].z, packed[3].w,
+        packed[4].x, packed[4].y, packed[4].z, packed[4].w, packed[5].x, packed[5].y, packed[5].z, packed[5].w,
+        packed[6].x, packed[6].y, packed[6].z, packed[6].w);
+    float basis[9] = float[9](
+        0.282095,
+        0.488603 * inN.y,
+        0.488603 * inN.z,
+        0.488603 * inN.x,
+        1.092548 * inN.x * inN.y,
+        1.092548 * inN.y * inN.z,
+        0.315392 * (3.0 * inN.z * inN.z - 1.0),
+        1.092548 * inN.x * inN.z,
+        0.546274 * (inN.x * inN.x - inN.y * inN.y));
+    vec3 irradiance = vec3(0.0);
+    for(int k = 0; k < 9; k++){
+        irradiance += vec3(coefficients[k * 3], coefficients[k * 3 + 1], coefficients[k * 3 + 2]) * basis[k];
+    }
+    return max(irradiance, vec3(0.0));
+}
+
 vec3 F(vec3 inF0, vec3 inH, vec3 inV){// Schlick Fresnel equation
     // inF0: Fresnel reflectance at normal incidence
     float HDotV = max(dot(inH, inV), 0.0);
@@ -44,7 +225,7 @@ vec3 GammaDecode(vec3 inSRGB){
 }
 
 vec3 GetNormal(vec2 inUV){
-    vec3 normalTS=texture(U_Normal,inUV).xyz;//0.0~1.0
+    vec3 normalTS=SampleNormalMap(inUV).xyz;//0.0~1.0
     normalTS=normalize(normalTS*2.0-vec3(1.0));//-1.0~1.0
     vec3 normalWS=normalize(V_TBN*normalTS);
     return normalWS;
@@ -86,14 +267,14 @@ void main(){
     float NdotL = max(dot(N, L), 0.0);
     float NdotV = max(dot(N, V), 0.0);
     float NdotH = max(dot(N, H), 0.0);
-    float roughness=texture(U_DefaultMetalRoughness,V_Texcoord.xy).g;//rgba,rgb,alpha
+    float roughness=SampleMetalRoughness(V_Texcoord.xy).g;//rgba,rgb,alpha
 
     vec3 F0 = vec3(0.04); // Fresnel reflectance at normal incidence for dielectrics
-    vec3 albedo = GammaDecode(texture(U_Albedo,V_Texcoord.xy).rgb);//texture -> albedo.jpg baseColor.jpg
+    vec3 albedo = GammaDecode(SampleAlbedo(V_Texcoord.xy).rgb);//texture -> albedo.jpg baseColor.jpg
     vec3 FinalColor = vec3(0.0);
     float eps = 0.01;
 
-    float metallic = texture(U_DefaultMetalRoughness,V_Texcoord.xy).b;
+    float metallic = SampleMetalRoughness(V_Texcoord.xy).b;
     F0 = mix(F0, albedo, metallic); // Adjust F0 based on metallic property, linear interpolation between F0 and albedo
 
 
@@ -121,17 +302,29 @@ void main(){
         vec3 ks = FRoughness(F0, NdotV, roughness); // Fresnel term for roughness
         vec3 kd = vec3(1.0) - ks; // Diffuse reflectance
         kd *= 1.0 - metallic; // Adjust diffuse color based on metallic property
+#ifdef IRRADIANCE_SH
+        vec3 diffuseLight = EvaluateIrradianceSH(N); // Diffuse irradiance from SH coefficients
+#else
         vec3 diffuseLight = texture(U_DiffuseIrradiance, N).rgb; // Diffuse irradiance from environment map
+#endif
+        if (VolumeBoundsMin.w > 0.5) {
+            diffuseLight = SampleIrradianceVolume(V_PositionWS.xyz, N); // Local irradiance, replaces the global one inside the scene
+        }
         vec3 ambientDiffuse = kd * diffuseLight * albedo; // Ambient diffuse contribution
 
-        vec2 brdf = texture(U_BRDFLUT, vec2(NdotV, roughness)).rg; // BRDF LUT lookup
-        vec3 prefilteredColor = textureLod(U_prefilteredColor, R, roughness * 4.0).rgb; // Prefiltered specular color from environment map
+        vec2 brdf;
+        if (ANALYTIC_ENV_BRDF) {
+            brdf = EnvBRDFApprox(NdotV, roughness);
+        } else {
+            brdf = texture(U_BRDFLUT, vec2(NdotV, roughness)).rg; // BRDF LUT lookup
+        }
+        vec3 prefilteredColor = SamplePrefilteredColor(V_PositionWS.xyz, R, roughness * 4.0); // Prefiltered specular color from the probes and environment map
         vec3 ambientSpecular = prefilteredColor * (F0 * brdf.x + brdf.y);
 
-        ambientColor = (ambientDiffuse+ambientSpecular)*texture(U_AO,V_Texcoord.xy).r; // Combine ambient contributions
+        ambientColor = (ambientDiffuse+ambientSpecular)*SampleAO(V_Texcoord.xy).r; // Combine ambient contributions
         FinalColor += ambientColor; // Add ambient color to final color
     }
 
-    FragColor = vec4(FinalColor + texture(U_Emissive,V_Texcoord.xy).rgb, 1.0);
+    FragColor = vec4(FinalColor + SampleEmissive(V_Texcoord.xy).rgb, 1.0);
     //FragColor = vec4(vec3(NdotL), 1.0);
 }
\ No newline at end of file
@@ -4,6 +4,10 @@ layout(location=0)in vec4 position;
 layout(location=1)in vec4 texcoord;
 layout(location=2)in vec4 normal;
 layout(location=3)in vec4 tangent;
+#ifdef INSTANCED
+// Per instance transform of the scene node, see InstanceBatcher
+layout(location=8)in mat4 instanceModel;
+#endif
 
 layout(push_constant)uniform PushConstants {
     vec4 offsets[3];
@@ -22,16 +26,26 @@ layout(location=0)out vec4 V_Texcoord;
 layout(location=1)out vec4 V_NormalWS;
 layout(location=2)out vec4 V_PositionWS;
 layout(location=3)out mat3 V_TBN;
+// Object index for the per object data of the fragment stage: firstInstance of the draw plus the instance
+layout(location=6)flat out int V_ObjectIndex;
 
 void main(){
+#ifdef INSTANCED
+    // Node transforms are rigid with uniform scale: their rotation carries the normals
+    mat4 model = instanceModel * objectUBO.model;
+    vec3 n = normalize(mat3(instanceModel) * (vpUBO.normalMatrix * vec4(normal.xyz, 0.0)).xyz);
+#else
+    mat4 model = objectUBO.model;
     vec3 n = normalize((vpUBO.normalMatrix * vec4(normal.xyz, 0.0)).xyz);
+#endif
     V_NormalWS = vec4(n, 0.0);
     V_Texcoord=texcoord;
-    vec3 t=normalize(vec3(objectUBO.model*vec4(tangent.xyz,0.0)));
+    V_ObjectIndex=gl_InstanceIndex;
+    vec3 t=normalize(vec3(model*vec4(tangent.xyz,0.0)));
     vec3 b=normalize(cross(V_NormalWS.xyz,t));
     V_TBN=mat3(t,b,V_NormalWS.xyz);
 
     vec4 positionMS = vec4(position.xyz,1.0);
-    V_PositionWS=objectUBO.model*positionMS;//world space
+    V_PositionWS=model*positionMS;//world space
     gl_Position=vpUBO.projection * vpUBO.view * V_PositionWS;//ndc
 }
\ No newline at end of file
@@ -39,131 +39,180 @@ namespace FF {
 		gCaptureCameras[4].setPerpective(90.0f, 1.0f, 0.1f, 100.0f);
 		gCaptureCameras[5].setPerpective(90.0f, 1.0f, 0.1f, 100.0f);
 	}
-	void HDRI::HDRI2CubeMap(
-		const std::string& filePath,
+	CubeMapCaptureMatrices HDRI::buildCaptureMatrices(bool flipViewport) {
+		CubeMapCaptureMatrices matrices{};
+		matrices.mProjectionMatrix = gCaptureCameras[0].getProjectMatrix();
+		for (int i = 0; i < 6; i++) {
+			matrices.mViewMatrices[i] = gCaptureCameras[i].getViewMatrix();
+		}
+		// Without the flipped viewport the +Y and -Y cameras trade places
+		if (!flipViewport) {
+			std::swap(matrices.mViewMatrices[2], matrices.mViewMatrices[3]);
+		}
+		return matrices;
+	}
+
+	void HDRI::captureCubeMap(
 		Wrapper::Image::Ptr& cubMapImage,
-		uint32_t texWidth, uint32_t texHeight,
-		std::string inVertShaderPath, std::string inFragShaderPath) {
+		const OffscreenSceneNode::Ptr& captureNode,
+		const std::string& inVertShaderPath, const std::string& inFragShaderPath,
+		VkFrontFace frontFace,
+		bool flipViewport,
+		bool pushMipRoughness,
+		uint32_t prefilterSampleCount,
+		bool filteredSampling) {
+
+		CubeMapCaptureTarget::Ptr captureTarget = CubeMapCaptureTarget::create(mDevice, cubMapImage, buildCaptureMatrices(flipViewport));
+		// Without a per mip roughness only mip 0 is rendered, the rest of the chain is downsampled from it
+		const uint32_t mipLevels = pushMipRoughness ? captureTarget->getMipLevels() : 1;
+
+		std::vector<VkDescriptorSetLayout> layouts = {
+			captureNode->mUniformManager->getDescriptorLayout()->getLayout(),
+			captureNode->mMaterial->getDescriptorLayout()->getLayout(),
+			captureTarget->getDescriptorLayout()
+		};
+		std::vector<VkDescriptorSet> descriptorSets = {
+			captureNode->mUniformManager->getDescriptorSet(0),
+			captureNode->mMaterial->getDescriptorSet(0),
+			captureTarget->getDescriptorSet()
+		};
+
+		PushConstantManager::Ptr mPushConstantManager = PushConstantManager::create();
+		mPushConstantManager->init();
+		mPushConstantManager->setConstantStageFlags(VK_SHADER_STAGE_FRAGMENT_BIT);
+		std::vector<VkPushConstantRange> pushConstantRanges = { captureTarget->getFacePushConstantRange() };
+		if (pushMipRoughness) {
+			pushConstantRanges.push_back(mPushConstantManager->getPushConstantRanges()->getPushConstantRange());
+		}
 
+		// One pipeline for every mip, the viewport is dynamic and set per mip while recording
+		OffscreenPipeline::Ptr capturePipeline = OffscreenPipeline::create(mDevice);
+		capturePipeline->build(
+			captureTarget->getRenderPass(),
+			captureTarget->getMipWidth(0), captureTarget->getMipHeight(0),
+			inVertShaderPath, inFragShaderPath,
+			layouts,
+			captureNode->mModels[0]->getVertexInputBindingDescriptions(),
+			captureNode->mModels[0]->getAttributeDescriptions(),
+			&pushConstantRanges,
+			VK_SAMPLE_COUNT_1_BIT,
+			frontFace,
+			flipViewport);
+		auto pipeline = capturePipeline->getPipeline();
 
-		OffscreenRenderTarget::Ptr mOffscreenRenderTarget{ nullptr };
-		OffscreenPipeline::Ptr mOffscreenPipeline{ nullptr };
-		OffscreenSceneNode::Ptr mOffscreenSphereNode{ nullptr };
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = 6; // Cubemap has 6 faces
 
-		//InitMatrices();
-		Texture::Ptr hdriTexture = Texture::createHDRITexture(mDevice, mCommandPool, filePath);
+		// Every face of every mip is recorded into this one command buffer, and waited on once
+		Wrapper::CommandBuffer::Ptr mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
+		cubMapImage->setImageLayout(
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			subresourceRange,
+			mCommandPool,
+			mCommandBuffer);
 
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			// Roughness ranges from 0 to 1 across the mip chain
+			float roughness = mipLevels > 1 ? static_cast<float>(mipLevel) / static_cast<float>(mipLevels - 1) : 0.0f;
+			mPushConstantManager->updateConstantData(
+				glm::vec4(static_cast<float>(prefilterSampleCount), filteredSampling ? 1.0f : 0.0f,
+					static_cast<float>(captureTarget->getMipWidth(mipLevel)), roughness), // Sample count, filtered sampling, face size, roughness
+				glm::vec4(0.0f, 0.0f, 0.0f, 0.0f), // Unused offsets
+				glm::vec4(0.0f, 0.0f, 0.0f, 0.0f) // Unused offsets
+			);
 
-		mOffscreenRenderTarget = OffscreenRenderTarget::create(
-			mDevice, mCommandPool,
-			texWidth, texHeight,
-			1,
-			VK_FORMAT_R32G32B32A32_SFLOAT, // Color format
-			VK_FORMAT_D24_UNORM_S8_UINT, // Depth format
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL // Final layout for the offscreen render target, copy from render target to cubemap image, need to be VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-		);
+			for (uint32_t face = 0; face < 6; face++) {
+				captureTarget->beginFace(mCommandBuffer, face, mipLevel);
+				mCommandBuffer->bindGraphicPipeline(pipeline);
+				mCommandBuffer->setViewportAndScissor(captureTarget->getMipWidth(mipLevel), captureTarget->getMipHeight(mipLevel), flipViewport);
+				mCommandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data());
+				captureTarget->pushFaceIndex(mCommandBuffer, pipeline->getPipelineLayout(), face);
+				if (pushMipRoughness) {
+					mCommandBuffer->pushConstants(pipeline->getPipelineLayout(), VK_SHADER_STAGE_FRAGMENT_BIT,
+						0, sizeof(constantData), &mPushConstantManager->getConstantData());
+				}
+
+				captureNode->draw(mCommandBuffer);
+				mCommandBuffer->endRenderPass();
+			}
+		}
 
+		if (mipLevels < cubMapImage->getMipLevels()) {
+			cubMapImage->generateMipmaps(mCommandPool, mCommandBuffer);
+		}
+		else {
+			cubMapImage->setImageLayout(
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				subresourceRange,
+				mCommandPool,
+				mCommandBuffer);
+		}
+
+		mCommandBuffer->endCommandBuffer();
+		mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		mCommandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+	}
+
+	OffscreenSceneNode::Ptr HDRI::createCaptureNode(Wrapper::Image::Ptr hdriCubMapImage, Wrapper::Image::Ptr hdriImage) {
 		Model::Ptr skyboxModel = Model::create(mDevice);
 		skyboxModel->loadBattleFireComponent("assets/skybox.staticmesh", mDevice);
-		mOffscreenSphereNode = OffscreenSceneNode::create();
+
+		OffscreenSceneNode::Ptr mOffscreenSphereNode = OffscreenSceneNode::create();
 		mOffscreenSphereNode->mUniformManager = UniformManager::create();
 		mOffscreenSphereNode->mUniformManager->init(mDevice, mCommandPool, 1);
+		if (hdriCubMapImage != nullptr) {
+			mOffscreenSphereNode->mUniformManager->attachCubeMap(hdriCubMapImage);
+		}
 		mOffscreenSphereNode->mUniformManager->build();
 		mOffscreenSphereNode->mModels.push_back(skyboxModel);
 		mOffscreenSphereNode->mModels[0]->setModelMatrix(glm::mat4(1.0f));
 
-
 		std::vector<std::string> textureFiles;
 		textureFiles.push_back("assets/book.jpg");
 		textureFiles.push_back("assets/diffuse.jpg");
 		textureFiles.push_back("assets/metal.jpg");
-
 		mOffscreenSphereNode->mMaterial = Material::create();
 		mOffscreenSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mOffscreenSphereNode->mMaterial->attachImages({ hdriTexture ->getImage()});
+		if (hdriImage != nullptr) {
+			mOffscreenSphereNode->mMaterial->attachImages({ hdriImage });
+		}
 		mOffscreenSphereNode->mMaterial->init(mDevice, mCommandPool, 1);
+		return mOffscreenSphereNode;
+	}
 
-		auto layout0 = mOffscreenSphereNode->mUniformManager->getDescriptorLayout()->getLayout();
-		auto layout1 = mOffscreenSphereNode->mMaterial->getDescriptorLayout()->getLayout();
-
-		mOffscreenPipeline = OffscreenPipeline::create(mDevice);
-		mOffscreenPipeline->build(
-			mOffscreenRenderTarget->getRenderPass(),
-			texWidth, texHeight,
-			inVertShaderPath, inFragShaderPath,
-			{ layout0,layout1 },
-			mOffscreenSphereNode->mModels[0]->getVertexInputBindingDescriptions(),
-			mOffscreenSphereNode->mModels[0]->getAttributeDescriptions(),
-			nullptr, // No push constants
-			mDevice->getMaxUsableSampleCount(),
-			VK_FRONT_FACE_CLOCKWISE);
-
-
-		VkRenderPassBeginInfo offScreenRenderPassBeginInfo{};
-		offScreenRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		offScreenRenderPassBeginInfo.renderPass = mOffscreenRenderTarget->getRenderPass()->getRenderPass();
-		offScreenRenderPassBeginInfo.framebuffer = mOffscreenRenderTarget->getOffScreenFramebuffers()[0];
-		offScreenRenderPassBeginInfo.renderArea.offset = { 0, 0 };
-		offScreenRenderPassBeginInfo.renderArea.extent = { static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight) };
-		std::vector<VkClearValue> cvs;
-		//0: final output color attachment 1:multisample image 2: depth attachment
-		VkClearValue offScreenClearFinalColor{};
-		offScreenClearFinalColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-		cvs.push_back(offScreenClearFinalColor);
-
-		//1: Multisample image
-		VkClearValue offScreenClearMultiSample{};
-		offScreenClearMultiSample.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-		cvs.push_back(offScreenClearMultiSample);
-
-		//2: Depth attachment
-		VkClearValue offScreenClearDepth{};
-		offScreenClearDepth.depthStencil = { 1.0f, 0 };
-		cvs.push_back(offScreenClearDepth);
-
-		offScreenRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(cvs.size());
-		offScreenRenderPassBeginInfo.pClearValues = cvs.data();
-
-		for (int i = 0; i < 6; i++) {
-
-			Wrapper::CommandBuffer::Ptr mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
-
-
-			mNVPMatrices.mViewMatrix = gCaptureCameras[i].getViewMatrix();
-			mNVPMatrices.mProjectionMatrix = gCaptureCameras[i].getProjectMatrix();
-			mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mNVPMatrices.mViewMatrix));
-			mCameraParameters.CameraWorldPosition = gCaptureCameras[i].getCamPosition();
-
-			mOffscreenSphereNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mOffscreenSphereNode->mModels[0]->getUniform(), mCameraParameters, 0);
-
-
-			mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-			// Begin offscreen render pass
-			mCommandBuffer->beginRenderPass(offScreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			mCommandBuffer->bindGraphicPipeline(mOffscreenPipeline->getPipeline());
-			std::vector<VkDescriptorSet> offscreenDescriptorSets = { mOffscreenSphereNode->mUniformManager->getDescriptorSet(0) , mOffscreenSphereNode->mMaterial->getDescriptorSet(0) };
-			mCommandBuffer->bindDescriptorSets(mOffscreenPipeline->getPipeline()->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
-
-			mOffscreenSphereNode->draw(mCommandBuffer);
-			mCommandBuffer->endRenderPass();
-
-			// Copy the rendered image to the cubemap image
-			mCommandBuffer->CopyRTImageToCubeMap(
-				mOffscreenRenderTarget->getRenderTargetImages()[0]->getImage(),
-				cubMapImage->getImage(),
-				texWidth, texHeight, i, 0);
-
+	Wrapper::Image::Ptr HDRI::createCaptureCubeMap(uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels) {
+		// Rendered into directly through per face views, then sampled (and read back by the IBL cache), blitted for mipmaps
+		return Wrapper::Image::create(
+			mDevice, texWidth, texHeight,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, true, mipLevels);
+	}
 
-			mCommandBuffer->endCommandBuffer();
-			// Submit the command buffer
-			mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
-			// Wait for the command buffer to finish
-			mCommandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+	void HDRI::HDRI2CubeMap(
+		const std::string& filePath,
+		Wrapper::Image::Ptr& cubMapImage,
+		uint32_t texWidth, uint32_t texHeight,
+		std::string inVertShaderPath, std::string inFragShaderPath) {
 
-		}
+		Texture::Ptr hdriTexture = Texture::createHDRITexture(mDevice, mCommandPool, filePath);
+		OffscreenSceneNode::Ptr mOffscreenSphereNode = createCaptureNode(nullptr, hdriTexture->getImage());
 
+		captureCubeMap(cubMapImage, mOffscreenSphereNode, inVertShaderPath, inFragShaderPath, VK_FRONT_FACE_CLOCKWISE, true, false);
 	}
 
 	Wrapper::Image::Ptr HDRI::LoadHDRICubeMapFromFile(
@@ -172,43 +221,13 @@ namespace FF {
 		const std::string& filePath,
 		uint32_t texWidth, uint32_t texHeight,
 		std::string inVertShaderPath, std::string inFragShaderPath) {
-        // Create the cubemap image
-        Wrapper::Image::Ptr mImage = Wrapper::Image::create(
-            mDevice, texWidth, texHeight,
-            VK_FORMAT_R32G32B32A32_SFLOAT,
-            VK_IMAGE_TYPE_2D,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            VK_SAMPLE_COUNT_1_BIT,
-            VK_IMAGE_ASPECT_COLOR_BIT, true);
-
-		// Set the image layout for transfer
-		VkImageSubresourceRange subresourceRange{};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = 1;
-		subresourceRange.baseArrayLayer = 0;
-		subresourceRange.layerCount = 6; // Cubemap has 6 faces
-
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			subresourceRange,
-			mCommandPool);
+		// Create the cubemap image, with a full mip chain for filtered importance sampling
+		Wrapper::Image::Ptr mImage = createCaptureCubeMap(texWidth, texHeight, Wrapper::Image::getMaxMipLevels(texWidth, texHeight));
 
 		InitMatrices();
 		// Load the HDR image data
 		HDRI2CubeMap(filePath, mImage, texWidth, texHeight, inVertShaderPath, inFragShaderPath);
 
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			subresourceRange,
-			mCommandPool);
-
 		return mImage;
 	}
 
@@ -218,122 +237,9 @@ namespace FF {
 		std::string inVertShaderPath,
 		std::string inFragShaderPath) {
 
-		OffscreenRenderTarget::Ptr mOffscreenRenderTarget{ nullptr };
-		OffscreenPipeline::Ptr mOffscreenPipeline{ nullptr };
-		OffscreenSceneNode::Ptr mOffscreenSphereNode{ nullptr };
-
-
-		mOffscreenRenderTarget = OffscreenRenderTarget::create(
-			mDevice, mCommandPool,
-			texWidth, texHeight,
-			1,
-			VK_FORMAT_R32G32B32A32_SFLOAT, // Color format
-			VK_FORMAT_D24_UNORM_S8_UINT, // Depth format
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL // Final layout for the offscreen render target, copy from render target to cubemap image, need to be VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-		);
-
-		Model::Ptr skyboxModel = Model::create(mDevice);
-		skyboxModel->loadBattleFireComponent("assets/skybox.staticmesh", mDevice);
-
-		mOffscreenSphereNode = OffscreenSceneNode::create();
-		mOffscreenSphereNode->mUniformManager = UniformManager::create();
-		mOffscreenSphereNode->mUniformManager->init(mDevice, mCommandPool, 1);
-		mOffscreenSphereNode->mUniformManager->attachCubeMap(hdriCubMapImage);
-		mOffscreenSphereNode->mUniformManager->build();
-		mOffscreenSphereNode->mModels.push_back(skyboxModel);
-		mOffscreenSphereNode->mModels[0]->setModelMatrix(glm::mat4(1.0f));
-
-		std::vector<std::string> textureFiles;
-		textureFiles.push_back("assets/book.jpg");
-		textureFiles.push_back("assets/diffuse.jpg");
-		textureFiles.push_back("assets/metal.jpg");
-		mOffscreenSphereNode->mMaterial = Material::create();
-		mOffscreenSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mOffscreenSphereNode->mMaterial->init(mDevice, mCommandPool, 1);
-		//mOffscreenSphereNode->mMaterial->attachImages({ inCubMapImage });
-
-		mOffscreenPipeline = OffscreenPipeline::create(mDevice);
-		mOffscreenPipeline->build(
-			mOffscreenRenderTarget->getRenderPass(),
-			texWidth, texHeight,
-			inVertShaderPath, inFragShaderPath,
-			{ mOffscreenSphereNode->mUniformManager->getDescriptorLayout()->getLayout(), mOffscreenSphereNode->mMaterial->getDescriptorLayout()->getLayout() },
-			mOffscreenSphereNode->mModels[0]->getVertexInputBindingDescriptions(),
-			mOffscreenSphereNode->mModels[0]->getAttributeDescriptions(),
-			nullptr, // No push constants
-			mDevice->getMaxUsableSampleCount(),
-			VK_FRONT_FACE_COUNTER_CLOCKWISE,
-			false);
-
-
-		gCaptureCameras[3].lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
-		gCaptureCameras[2].lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-		VkRenderPassBeginInfo offScreenRenderPassBeginInfo{};
-		offScreenRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		offScreenRenderPassBeginInfo.renderPass = mOffscreenRenderTarget->getRenderPass()->getRenderPass();
-		offScreenRenderPassBeginInfo.framebuffer = mOffscreenRenderTarget->getOffScreenFramebuffers()[0];
-		offScreenRenderPassBeginInfo.renderArea.offset = { 0, 0 };
-		offScreenRenderPassBeginInfo.renderArea.extent = { static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight) };
-		std::vector<VkClearValue> cvs;
-		//0: final output color attachment 1:multisample image 2: depth attachment
-		VkClearValue offScreenClearFinalColor{};
-		offScreenClearFinalColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-		cvs.push_back(offScreenClearFinalColor);
-
-		//1: Multisample image
-		VkClearValue offScreenClearMultiSample{};
-		offScreenClearMultiSample.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-		cvs.push_back(offScreenClearMultiSample);
-
-		//2: Depth attachment
-		VkClearValue offScreenClearDepth{};
-		offScreenClearDepth.depthStencil = { 1.0f, 0 };
-		cvs.push_back(offScreenClearDepth);
-
-		offScreenRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(cvs.size());
-		offScreenRenderPassBeginInfo.pClearValues = cvs.data();
-
-		for (int i = 0; i < 6; i++) {
-
-			Wrapper::CommandBuffer::Ptr mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
-
-
-			mNVPMatrices.mViewMatrix = gCaptureCameras[i].getViewMatrix();
-			mNVPMatrices.mProjectionMatrix = gCaptureCameras[i].getProjectMatrix();
-			mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mNVPMatrices.mViewMatrix));
-			mCameraParameters.CameraWorldPosition = gCaptureCameras[i].getCamPosition();
-
-			mOffscreenSphereNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mOffscreenSphereNode->mModels[0]->getUniform(), mCameraParameters, 0);
-
-
-			mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-			// Begin offscreen render pass
-			mCommandBuffer->beginRenderPass(offScreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			mCommandBuffer->bindGraphicPipeline(mOffscreenPipeline->getPipeline());
-			std::vector<VkDescriptorSet> offscreenDescriptorSets = { mOffscreenSphereNode->mUniformManager->getDescriptorSet(0) , mOffscreenSphereNode->mMaterial->getDescriptorSet(0) };
-			mCommandBuffer->bindDescriptorSets(mOffscreenPipeline->getPipeline()->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
-
-			mOffscreenSphereNode->draw(mCommandBuffer);
-			mCommandBuffer->endRenderPass();
-
-			// Copy the rendered image to the cubemap image
-			mCommandBuffer->CopyRTImageToCubeMap(
-				mOffscreenRenderTarget->getRenderTargetImages()[0]->getImage(),
-				diffuseIrradianceCubMapImage->getImage(),
-				texWidth, texHeight, i, 0);
-
-
-			mCommandBuffer->endCommandBuffer();
-			// Submit the command buffer
-			mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
-			// Wait for the command buffer to finish
-			mCommandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
-
-		}
-
+		OffscreenSceneNode::Ptr mOffscreenSphereNode = createCaptureNode(hdriCubMapImage, nullptr);
 
+		captureCubeMap(diffuseIrradianceCubMapImage, mOffscreenSphereNode, inVertShaderPath, inFragShaderPath, VK_FRONT_FACE_COUNTER_CLOCKWISE, false, false);
 	}
 
 	Wrapper::Image::Ptr HDRI::generateDiffuseIrradianceMap(
@@ -342,48 +248,15 @@ namespace FF {
 		const Wrapper::CommandPool::Ptr& commandPool,
 		uint32_t texWidth, uint32_t texHeight,
 		std::string inVertShaderPath, std::string inFragShaderPath) {
-
 		// Create the diffuse irradiance map image
-		Wrapper::Image::Ptr mImage = Wrapper::Image::create(
-			mDevice, texWidth, texHeight,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_TYPE_2D,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			VK_SAMPLE_COUNT_1_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, true);
-
-		// Set the image layout for transfer
-		VkImageSubresourceRange subresourceRange{};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = 1;
-		subresourceRange.baseArrayLayer = 0;
-		subresourceRange.layerCount = 6; // Cubemap has 6 faces
+		Wrapper::Image::Ptr mImage = createCaptureCubeMap(texWidth, texHeight, 1);
 
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			subresourceRange,
-			mCommandPool);
-
-
-		// Load the HDR image data
 		captureDiffuseIrradianceMap(
 			hdriCubMapImage,
 			mImage,
 			texWidth, texHeight,
 			inVertShaderPath, inFragShaderPath);
 
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			subresourceRange,
-			mCommandPool);
-
 		return mImage;
 	}
 
@@ -393,184 +266,174 @@ namespace FF {
 		Wrapper::Image::Ptr& specularPrefilterCubMapImage,
 		uint32_t texWidth, uint32_t texHeight,
 		std::string inVertShaderPath,
-		std::string inFragShaderPath) {
+		std::string inFragShaderPath,
+		bool filteredSampling) {
 
-		OffscreenSceneNode::Ptr mOffscreenSphereNode{ nullptr };
+		OffscreenSceneNode::Ptr mOffscreenSphereNode = createCaptureNode(hdriCubMapImage, nullptr);
 
+		captureCubeMap(specularPrefilterCubMapImage, mOffscreenSphereNode, inVertShaderPath, inFragShaderPath, VK_FRONT_FACE_COUNTER_CLOCKWISE, false, true,
+			filteredSampling ? FilteredPrefilterSampleCount : SpecularPrefilterSampleCount, filteredSampling);
+	}
 
-		Model::Ptr skyboxModel = Model::create(mDevice);
-		skyboxModel->loadBattleFireComponent("assets/skybox.staticmesh", mDevice);
-		mOffscreenSphereNode = OffscreenSceneNode::create();
-		mOffscreenSphereNode->mUniformManager = UniformManager::create();
-		mOffscreenSphereNode->mUniformManager->init(mDevice, mCommandPool, 1);
-		mOffscreenSphereNode->mUniformManager->attachCubeMap(hdriCubMapImage);
-		mOffscreenSphereNode->mUniformManager->build();
-		mOffscreenSphereNode->mModels.push_back(skyboxModel);
-		mOffscreenSphereNode->mModels[0]->setModelMatrix(glm::mat4(1.0f));
-		std::vector<std::string> textureFiles;
-		textureFiles.push_back("assets/book.jpg");
-		textureFiles.push_back("assets/diffuse.jpg");
-		textureFiles.push_back("assets/metal.jpg");
-		mOffscreenSphereNode->mMaterial = Material::create();
-		mOffscreenSphereNode->mMaterial->attachTexturePaths(textureFiles);
-		mOffscreenSphereNode->mMaterial->init(mDevice, mCommandPool, 1);
+	Wrapper::Image::Ptr HDRI::generateSpecularPrefilterMap(
+		Wrapper::Image::Ptr hdriCubMapImage,
+		const Wrapper::Device::Ptr& device,
+		const Wrapper::CommandPool::Ptr& commandPool,
+		uint32_t texWidth, uint32_t texHeight,
+		std::string inVertShaderPath, std::string inFragShaderPath,
+		bool filteredSampling) {
+		// Create the specular prefilter map image
+		Wrapper::Image::Ptr mImage = createCaptureCubeMap(texWidth, texHeight, SpecularPrefilterMipLevels);
 
-		gCaptureCameras[3].lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
-		gCaptureCameras[2].lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		captureSpecularPrefilterMap(hdriCubMapImage, mImage, texWidth, texHeight, inVertShaderPath, inFragShaderPath, filteredSampling);
 
-		auto layout0 = mOffscreenSphereNode->mUniformManager->getDescriptorLayout()->getLayout();
-		auto layout1 = mOffscreenSphereNode->mMaterial->getDescriptorLayout()->getLayout();
+		return mImage;
+	}
 
-		for (int mipmapLevel = 0; mipmapLevel < 5; mipmapLevel++) {
+	Wrapper::Image::Ptr HDRI::captureLocalProbe(
+		const Wrapper::Image::Ptr& environmentCubeMap,
+		const glm::vec3& probePosition,
+		const std::vector<ProbeCaptureMesh>& meshes,
+		uint32_t faceSize,
+		const std::string& inVertShaderPath, const std::string& inFragShaderPath) {
+		const LocalProbeCaptureState state = createLocalProbeCaptureState(environmentCubeMap, meshes, faceSize, inVertShaderPath, inFragShaderPath);
 
-			uint32_t mipWidth = static_cast<float>(texWidth * std::pow(0.5f, mipmapLevel));
-			uint32_t mipHeight = static_cast<float>(texHeight * std::pow(0.5f, mipmapLevel));
-			float roughness = static_cast<float>(mipmapLevel) / 4.0f; // Roughness ranges from 0 to 1
+		Wrapper::CommandBuffer::Ptr mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		const LocalProbeCapture capture = recordLocalProbeCapture(state, mCommandBuffer, probePosition, meshes);
+		mCommandBuffer->endCommandBuffer();
+		mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		mCommandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
 
-			// create offscreen render target for each mipmap level
-			OffscreenRenderTarget::Ptr mOffscreenRenderTarget = OffscreenRenderTarget::create(
-				mDevice, mCommandPool,
-				mipWidth, mipHeight,
-				1,
-				VK_FORMAT_R32G32B32A32_SFLOAT,// Color format
-				VK_FORMAT_D24_UNORM_S8_UINT,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-			);
+		return capture.mCubeMap;
+	}
 
-			PushConstantManager::Ptr mPushConstantManager = PushConstantManager::create();
-			mPushConstantManager->init();
-			mPushConstantManager->updateConstantData(
-				glm::vec4(0.0f, 0.0f, 0.0f, roughness), // Roughness offset
-				glm::vec4(0.0f, 0.0f, 0.0f, 0.0f), // Unused offsets
-				glm::vec4(0.0f, 0.0f, 0.0f, 0.0f) // Unused offsets
-			);
-			mPushConstantManager->setConstantStageFlags(VK_SHADER_STAGE_FRAGMENT_BIT);
-			std::vector<VkPushConstantRange> pushConstantRange = { mPushConstantManager->getPushConstantRanges()->getPushConstantRange() };
-			// create offscreen pipeline for each mipmap level
-			OffscreenPipeline::Ptr mOffscreenPipeline = OffscreenPipeline::create(mDevice);
-			mOffscreenPipeline->build(
-				mOffscreenRenderTarget->getRenderPass(),
-				mipWidth, mipHeight,
+	HDRI::LocalProbeCaptureState HDRI::createLocalProbeCaptureState(
+		const Wrapper::Image::Ptr& environmentCubeMap,
+		const std::vector<ProbeCaptureMesh>& meshes,
+		uint32_t faceSize,
+		const std::string& inVertShaderPath, const std::string& inFragShaderPath) {
+		LocalProbeCaptureState state{};
+		state.mFaceSize = faceSize;
+		state.mLayoutTarget = CubeMapCaptureTarget::create(mDevice, createCaptureCubeMap(1, 1, 1), buildCaptureMatrices(true), true);
+		state.mEnvironmentNode = createCaptureNode(environmentCubeMap, nullptr);
+
+		std::vector<VkDescriptorSetLayout> layouts = {
+			state.mEnvironmentNode->mUniformManager->getDescriptorLayout()->getLayout(),
+			state.mEnvironmentNode->mMaterial->getDescriptorLayout()->getLayout(),
+			state.mLayoutTarget->getDescriptorLayout()
+		};
+
+		VkPushConstantRange probeRange{};
+		probeRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		probeRange.offset = 0;
+		probeRange.size = sizeof(ProbeCaptureConstants);
+		std::vector<VkPushConstantRange> pushConstantRanges = { state.mLayoutTarget->getFacePushConstantRange(), probeRange };
+
+		// Meshes write depth, the environment is drawn last at the far plane and only fills what they left uncovered
+		// One pipeline per mesh since vertex layouts may differ
+		for (const auto& mesh : meshes) {
+			OffscreenPipeline::Ptr meshPipeline = OffscreenPipeline::create(mDevice);
+			meshPipeline->build(
+				state.mLayoutTarget->getRenderPass(),
+				faceSize, faceSize,
 				inVertShaderPath, inFragShaderPath,
-				{ layout0, layout1 },
-				mOffscreenSphereNode->mModels[0]->getVertexInputBindingDescriptions(),
-				mOffscreenSphereNode->mModels[0]->getAttributeDescriptions(),
-				&pushConstantRange,
-				mDevice->getMaxUsableSampleCount(),
+				layouts,
+				mesh.mModel->getVertexInputBindingDescriptions(),
+				mesh.mModel->getAttributeDescriptions(),
+				&pushConstantRanges,
+				VK_SAMPLE_COUNT_1_BIT,
 				VK_FRONT_FACE_COUNTER_CLOCKWISE,
-				false,
-				false
-			);
-
-			VkRenderPassBeginInfo offScreenRenderPassBeginInfo{};
-			offScreenRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			offScreenRenderPassBeginInfo.renderPass = mOffscreenRenderTarget->getRenderPass()->getRenderPass();
-			offScreenRenderPassBeginInfo.framebuffer = mOffscreenRenderTarget->getOffScreenFramebuffers()[0];
-			offScreenRenderPassBeginInfo.renderArea.offset = { 0, 0 };
-			offScreenRenderPassBeginInfo.renderArea.extent = { static_cast<uint32_t>(mipWidth), static_cast<uint32_t>(mipHeight) };
-			std::vector<VkClearValue> cvs;
-			//0: final output color attachment 1:multisample image 2: depth attachment
-			VkClearValue offScreenClearFinalColor{};
-			offScreenClearFinalColor.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			cvs.push_back(offScreenClearFinalColor);
-
-			//1: Multisample image
-			VkClearValue offScreenClearMultiSample{};
-			offScreenClearMultiSample.color = { 0.0f, 0.0f, 0.0f, 0.0f };
-			cvs.push_back(offScreenClearMultiSample);
-
-			//2: Depth attachment
-			VkClearValue offScreenClearDepth{};
-			offScreenClearDepth.depthStencil = { 1.0f, 0 };
-			cvs.push_back(offScreenClearDepth);
-
-			offScreenRenderPassBeginInfo.clearValueCount = static_cast<uint32_t>(cvs.size());
-			offScreenRenderPassBeginInfo.pClearValues = cvs.data();
-
-			for (int i = 0; i < 6; i++) {
-
-
-
-				Wrapper::CommandBuffer::Ptr mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
-
-				mNVPMatrices.mViewMatrix = gCaptureCameras[i].getViewMatrix();
-				mNVPMatrices.mProjectionMatrix = gCaptureCameras[i].getProjectMatrix();
-				mNVPMatrices.mNormalMatrix = glm::transpose(glm::inverse(mNVPMatrices.mViewMatrix));
-				mCameraParameters.CameraWorldPosition = gCaptureCameras[i].getCamPosition();
-
-				mOffscreenSphereNode->mUniformManager->updateUniformBuffer(mNVPMatrices, mOffscreenSphereNode->mModels[0]->getUniform(), mCameraParameters, 0);
-
-
-				mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-				// Begin offscreen render pass
-				mCommandBuffer->beginRenderPass(offScreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				mCommandBuffer->bindGraphicPipeline(mOffscreenPipeline->getPipeline());
-				std::vector<VkDescriptorSet> offscreenDescriptorSets = { mOffscreenSphereNode->mUniformManager->getDescriptorSet(0) , mOffscreenSphereNode->mMaterial->getDescriptorSet(0) };
-				mCommandBuffer->bindDescriptorSets(mOffscreenPipeline->getPipeline()->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
-				mCommandBuffer->pushConstants(mOffscreenPipeline->getPipeline()->getPipelineLayout(), mPushConstantManager->getConstantParam().stageFlags,
-					mPushConstantManager->getConstantParam().offset, mPushConstantManager->getConstantParam().size, &mPushConstantManager->getConstantData());
-
-				mOffscreenSphereNode->draw(mCommandBuffer);
-				mCommandBuffer->endRenderPass();
-
-				// Copy the rendered image to the cubemap image
-				mCommandBuffer->CopyRTImageToCubeMap(
-					mOffscreenRenderTarget->getRenderTargetImages()[0]->getImage(),
-					specularPrefilterCubMapImage->getImage(),
-					mipWidth, mipHeight, i, mipmapLevel);
-
-
-				mCommandBuffer->endCommandBuffer();
-				// Submit the command buffer
-				mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
-				// Wait for the command buffer to finish
-				mCommandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
-
-			}
+				true, true, true);
+			state.mMeshPipelines.push_back(meshPipeline);
 		}
+		state.mEnvironmentPipeline = OffscreenPipeline::create(mDevice);
+		state.mEnvironmentPipeline->build(
+			state.mLayoutTarget->getRenderPass(),
+			faceSize, faceSize,
+			inVertShaderPath, inFragShaderPath,
+			layouts,
+			state.mEnvironmentNode->mModels[0]->getVertexInputBindingDescriptions(),
+			state.mEnvironmentNode->mModels[0]->getAttributeDescriptions(),
+			&pushConstantRanges,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_FRONT_FACE_CLOCKWISE,
+			true);
+		return state;
+	}
 
+	void HDRI::setLocalProbeEnvironment(const LocalProbeCaptureState& state, const Wrapper::Image::Ptr& environmentCubeMap) {
+		// Binding 4 is the cubemap attached by createCaptureNode
+		state.mEnvironmentNode->mUniformManager->replaceImage(4, environmentCubeMap);
 	}
 
-	Wrapper::Image::Ptr HDRI::generateSpecularPrefilterMap(
-		Wrapper::Image::Ptr hdriCubMapImage,
-		const Wrapper::Device::Ptr& device,
-		const Wrapper::CommandPool::Ptr& commandPool,
-		uint32_t texWidth, uint32_t texHeight,
-		std::string inVertShaderPath, std::string inFragShaderPath) {
-		// Create the specular prefilter map image
-		Wrapper::Image::Ptr mImage = Wrapper::Image::create(
-			mDevice, texWidth, texHeight,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_TYPE_2D,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			VK_SAMPLE_COUNT_1_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, true, 5);// 5 mip levels for prefiltering
-		// Set the image layout for transfer
+	HDRI::LocalProbeCapture HDRI::recordLocalProbeCapture(
+		const LocalProbeCaptureState& state,
+		const Wrapper::CommandBuffer::Ptr& commandBuffer,
+		const glm::vec3& probePosition,
+		const std::vector<ProbeCaptureMesh>& meshes) {
+		const uint32_t faceSize = state.mFaceSize;
+
+		LocalProbeCapture capture{};
+		// Full mip chain: the prefilter reads it with filtered importance sampling
+		capture.mCubeMap = createCaptureCubeMap(faceSize, faceSize, Wrapper::Image::getMaxMipLevels(faceSize, faceSize));
+		// The views stay centered on the origin, ProbeCapture.vert moves the meshes by -probePosition
+		capture.mTarget = CubeMapCaptureTarget::create(mDevice, capture.mCubeMap, buildCaptureMatrices(true), true);
+		const CubeMapCaptureTarget::Ptr& captureTarget = capture.mTarget;
+		const OffscreenSceneNode::Ptr& environmentNode = state.mEnvironmentNode;
+
+		std::vector<VkDescriptorSet> descriptorSets = {
+			environmentNode->mUniformManager->getDescriptorSet(0),
+			environmentNode->mMaterial->getDescriptorSet(0),
+			captureTarget->getDescriptorSet()
+		};
+
 		VkImageSubresourceRange subresourceRange{};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = 5;
+		subresourceRange.levelCount = 1;
 		subresourceRange.baseArrayLayer = 0;
-		subresourceRange.layerCount = 6; // Cubemap has 6 faces
+		subresourceRange.layerCount = 6;
 
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		capture.mCubeMap->setImageLayout(
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
 			subresourceRange,
-			mCommandPool);
-		captureSpecularPrefilterMap(hdriCubMapImage, mImage, texWidth, texHeight, inVertShaderPath, inFragShaderPath);
+			mCommandPool,
+			commandBuffer);
+
+		const VkShaderStageFlagBits probeStages = static_cast<VkShaderStageFlagBits>(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+		auto drawWith = [&](const Wrapper::Pipeline::Ptr& pipeline, uint32_t face, ProbeCaptureConstants constants) {
+			commandBuffer->bindGraphicPipeline(pipeline);
+			commandBuffer->setViewportAndScissor(faceSize, faceSize, true);
+			commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data());
+			captureTarget->pushFaceIndex(commandBuffer, pipeline->getPipelineLayout(), face);
+			commandBuffer->pushConstants(pipeline->getPipelineLayout(), probeStages, 0, sizeof(ProbeCaptureConstants), &constants);
+		};
+
+		for (uint32_t face = 0; face < 6; face++) {
+			captureTarget->beginFace(commandBuffer, face, 0);
+
+			for (size_t i = 0; i < meshes.size(); i++) {
+				ProbeCaptureConstants constants{};
+				constants.mModelMatrix = meshes[i].mModelMatrix;
+				constants.mProbePosition = glm::vec4(probePosition, 1.0f);
+				constants.mAlbedo = meshes[i].mAlbedo;
+				drawWith(state.mMeshPipelines[i]->getPipeline(), face, constants);
+				meshes[i].mModel->draw(commandBuffer);
+			}
 
-		mImage->setImageLayout(
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			subresourceRange,
-			mCommandPool);
-		return mImage;
+			ProbeCaptureConstants environmentConstants{};
+			environmentConstants.mProbePosition = glm::vec4(probePosition, 0.0f);
+			drawWith(state.mEnvironmentPipeline->getPipeline(), face, environmentConstants);
+			environmentNode->draw(commandBuffer);
+
+			commandBuffer->endRenderPass();
+		}
+
+		capture.mCubeMap->generateMipmaps(mCommandPool, commandBuffer);
+		return capture;
 	}
 
 	Wrapper::Image::Ptr HDRI::generateBRDFLUT(
@@ -584,7 +447,7 @@ namespace FF {
 			VK_FORMAT_R32G32B32A32_SFLOAT,
 			VK_IMAGE_TYPE_2D,
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			VK_SAMPLE_COUNT_1_BIT,
 			VK_IMAGE_ASPECT_COLOR_BIT);
@@ -689,6 +552,7 @@ namespace FF {
 		// Begin offscreen render pass
 		mCommandBuffer->beginRenderPass(offScreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		mCommandBuffer->bindGraphicPipeline(mOffscreenPipeline->getPipeline());
+		mCommandBuffer->setViewportAndScissor(texWidth, texHeight);
 		std::vector<VkDescriptorSet> offscreenDescriptorSets = { mOffscreenSphereNode->mUniformManager->getDescriptorSet(0) , mOffscreenSphereNode->mMaterial->getDescriptorSet(0) };
 		mCommandBuffer->bindDescriptorSets(mOffscreenPipeline->getPipeline()->getPipelineLayout(), 0, offscreenDescriptorSets.size(), offscreenDescriptorSets.data());
 
@@ -6,12 +6,21 @@
 #include "../offscreenRender/offscreenRenderTarget.h"
 #include "../offscreenRender/offscreenPipeline.h"
 #include "../offscreenRender/OffscreenSceneNode.h"
+#include "../offscreenRender/cubeMapCaptureTarget.h"
 #include "../model.h"
 #include "../Camera.h"
 #include "../pushConstantManager.h"
 #include "texture.h"
 
 namespace FF {
+	// Scene mesh drawn into a local probe capture, flat shaded with its albedo
+	struct ProbeCaptureMesh {
+		Model::Ptr mModel{ nullptr };
+		std::string mSourcePath; // part of the probe cache key
+		glm::mat4 mModelMatrix{ 1.0f };
+		glm::vec4 mAlbedo{ 0.5f, 0.5f, 0.5f, 1.0f };
+	};
+
 	class HDRI {
 	public:
 		using Ptr = std::shared_ptr<HDRI>;
@@ -33,7 +42,7 @@ namespace FF {
 			const std::string& filePath,
 			Wrapper::Image::Ptr& cubMapImage,
 			uint32_t texWidth = 1024, uint32_t texHeight = 1024,
-			std::string inVertShaderPath = "shaders/SkyboxVert.spv",
+			std::string inVertShaderPath = "shaders/CubeMapCaptureVert.spv",
 			std::string inFragShaderPath = "shaders/SkyBoxFrag.spv");
 
 
@@ -48,7 +57,7 @@ namespace FF {
 			Wrapper::Image::Ptr& hdriCubMapImage,
 			Wrapper::Image::Ptr& diffuseIrradianceCubMapImage,
 			uint32_t texWidth = 32, uint32_t texHeight =32,
-			std::string inVertShaderPath = "shaders/SkyboxVert.spv",
+			std::string inVertShaderPath = "shaders/CubeMapCaptureVert.spv",
 			std::string inFragShaderPath = "shaders/CaptureDiffuseIrradianceFrag.spv");
 
 		Wrapper::Image::Ptr generateSpecularPrefilterMap(
@@ -56,14 +65,16 @@ namespace FF {
 			const Wrapper::Device::Ptr& device,
 			const Wrapper::CommandPool::Ptr& commandPool,
 			uint32_t texWidth, uint32_t texHeight,
-			std::string inVertShaderPath, std::string inFragShaderPath);
+			std::string inVertShaderPath, std::string inFragShaderPath,
+			bool filteredSampling = true);
 
 		void captureSpecularPrefilterMap(
 			Wrapper::Image::Ptr& hdriCubMapImage,
 			Wrapper::Image::Ptr& specularPrefilterCubMapImage,
 			uint32_t texWidth = 128, uint32_t texHeight = 128,
-			std::string inVertShaderPath = "shaders/SkyboxVert.spv",
-			std::string inFragShaderPath = "shaders/CaptureSpecularPrefilterFrag.spv");
+			std::string inVertShaderPath = "shaders/CubeMapCaptureVert.spv",
+			std::string inFragShaderPath = "shaders/CaptureSpecularPrefilterFrag.spv",
+			bool filteredSampling = true);
 
 		Wrapper::Image::Ptr generateBRDFLUT(
 			const Wrapper::Device::Ptr& device,
@@ -73,8 +84,84 @@ namespace FF {
 
 
 
+		/// @brief Capture the scene around a point: the meshes lit by the blurriest mip of the environment, the environment behind them.
+		/// Meshes need the BattleFire vertex layout (position at location 0, normal at location 2).
+		/// @return RGBA32F cubemap with a full mip chain, ready for the specular prefilter.
+		Wrapper::Image::Ptr captureLocalProbe(
+			const Wrapper::Image::Ptr& environmentCubeMap,
+			const glm::vec3& probePosition,
+			const std::vector<ProbeCaptureMesh>& meshes,
+			uint32_t faceSize,
+			const std::string& inVertShaderPath = "shaders/ProbeCaptureVert.spv",
+			const std::string& inFragShaderPath = "shaders/ProbeCaptureFrag.spv");
+
+		// Environment node and pipelines of the local probe captures, built once and shared by every capture of a bake
+		struct LocalProbeCaptureState {
+			uint32_t mFaceSize{ 0 };
+			OffscreenSceneNode::Ptr mEnvironmentNode{ nullptr };
+			// 1x1 target the pipelines were built against, its render pass and set layout match every capture target
+			CubeMapCaptureTarget::Ptr mLayoutTarget{ nullptr };
+			std::vector<OffscreenPipeline::Ptr> mMeshPipelines{};
+			OffscreenPipeline::Ptr mEnvironmentPipeline{ nullptr };
+		};
+
+		// One recorded capture, the target has to live until the commands ran
+		struct LocalProbeCapture {
+			Wrapper::Image::Ptr mCubeMap{ nullptr };
+			CubeMapCaptureTarget::Ptr mTarget{ nullptr };
+		};
+
+		LocalProbeCaptureState createLocalProbeCaptureState(
+			const Wrapper::Image::Ptr& environmentCubeMap,
+			const std::vector<ProbeCaptureMesh>& meshes,
+			uint32_t faceSize,
+			const std::string& inVertShaderPath = "shaders/ProbeCaptureVert.spv",
+			const std::string& inFragShaderPath = "shaders/ProbeCaptureFrag.spv");
+
+		// Point the captures of state at another environment, no capture recorded with it may be pending
+		void setLocalProbeEnvironment(const LocalProbeCaptureState& state, const Wrapper::Image::Ptr& environmentCubeMap);
+
+		/// @brief captureLocalProbe recorded into commandBuffer instead of submitted, for captures spread over frames.
+		/// The cubemap is in SHADER_READ_ONLY layout once the commands ran.
+		LocalProbeCapture recordLocalProbeCapture(
+			const LocalProbeCaptureState& state,
+			const Wrapper::CommandBuffer::Ptr& commandBuffer,
+			const glm::vec3& probePosition,
+			const std::vector<ProbeCaptureMesh>& meshes);
+
 		void InitMatrices();
 
+		// Sample counts baked into the capture shaders, part of the IBL cache key
+		static constexpr uint32_t DiffuseIrradianceSampleCount = 1000 * 250;
+		static constexpr uint32_t SpecularPrefilterSampleCount = 1024;
+		// Filtered importance sampling reads a mip of the source chosen from the sample PDF, so far fewer samples converge
+		static constexpr uint32_t FilteredPrefilterSampleCount = 64;
+		static constexpr uint32_t SpecularPrefilterMipLevels = 5;
+		static constexpr uint32_t BRDFLUTSampleCount = 1000;
+
+	private:
+		// Push constants of ProbeCapture.vert/.frag, the face index follows at CubeMapCaptureTarget::FaceIndexPushConstantOffset
+		struct ProbeCaptureConstants {
+			glm::mat4 mModelMatrix{ 1.0f };
+			glm::vec4 mProbePosition{ 0.0f }; // w: 1 for scene meshes, 0 for the environment
+			glm::vec4 mAlbedo{ 0.0f };
+		};
+
+		CubeMapCaptureMatrices buildCaptureMatrices(bool flipViewport);
+		OffscreenSceneNode::Ptr createCaptureNode(Wrapper::Image::Ptr hdriCubMapImage, Wrapper::Image::Ptr hdriImage);
+		Wrapper::Image::Ptr createCaptureCubeMap(uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels);
+
+		// Render every face and mip of a cubemap in a single submission
+		void captureCubeMap(
+			Wrapper::Image::Ptr& cubMapImage,
+			const OffscreenSceneNode::Ptr& captureNode,
+			const std::string& inVertShaderPath, const std::string& inFragShaderPath,
+			VkFrontFace frontFace,
+			bool flipViewport,
+			bool pushMipRoughness,
+			uint32_t prefilterSampleCount = 0,
+			bool filteredSampling = false);
+
 	private:
 		Wrapper::Device::Ptr mDevice{ nullptr };
 		Wrapper::Image::Ptr mImage{ nullptr };
@@ -0,0 +1,526 @@
+#include "cpuIBLBaker.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+#include "HDRI.h"
+#include "../stb_image.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FF_CPU_IBL_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace FF {
+
+	namespace {
+		const float PI = 3.14159265359f;
+
+		// CubeFaceDirection of the bake kernels, Vulkan cube face selection table
+		glm::vec3 cubeFaceDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t faceSize) {
+			const float s = (x + 0.5f) / faceSize * 2.0f - 1.0f;
+			const float t = (y + 0.5f) / faceSize * 2.0f - 1.0f;
+			glm::vec3 direction;
+			switch (face) {
+			case 0: direction = glm::vec3(1.0f, -t, -s); break; // +X
+			case 1: direction = glm::vec3(-1.0f, -t, s); break; // -X
+			case 2: direction = glm::vec3(s, 1.0f, t); break; // +Y
+			case 3: direction = glm::vec3(s, -1.0f, -t); break; // -Y
+			case 4: direction = glm::vec3(s, -t, 1.0f); break; // +Z
+			default: direction = glm::vec3(-s, -t, -1.0f); break; // -Z
+			}
+			return glm::normalize(direction);
+		}
+
+		// Solid angle of the face region [0,0]-[x,y] in [-1,1] face coordinates
+		float cubeAreaElement(float x, float y) {
+			return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+		}
+
+		float cubeTexelSolidAngle(uint32_t x, uint32_t y, uint32_t faceSize) {
+			const float invSize = 1.0f / faceSize;
+			const float x0 = x * 2.0f * invSize - 1.0f;
+			const float y0 = y * 2.0f * invSize - 1.0f;
+			const float x1 = x0 + 2.0f * invSize;
+			const float y1 = y0 + 2.0f * invSize;
+			return cubeAreaElement(x0, y0) - cubeAreaElement(x0, y1) - cubeAreaElement(x1, y0) + cubeAreaElement(x1, y1);
+		}
+
+		float radicalInverseVDC(uint32_t index) {
+			index = (index << 16u) | (index >> 16u);
+			index = ((index & 0x55555555u) << 1u) | ((index & 0xAAAAAAAAu) >> 1u);
+			index = ((index & 0x33333333u) << 2u) | ((index & 0xCCCCCCCCu) >> 2u);
+			index = ((index & 0x0F0F0F0Fu) << 4u) | ((index & 0xF0F0F0F0u) >> 4u);
+			index = ((index & 0x00FF00FFu) << 8u) | ((index & 0xFF00FF00u) >> 8u);
+			return static_cast<float>(index) * 2.3283064365386963e-10f;
+		}
+
+		glm::vec3 importanceSampleGGX(float xi0, float xi1, const glm::vec3& N, float roughness) {
+			const float r4 = std::pow(roughness, 4.0f);
+			const float phi = 2.0f * PI * xi0;
+			const float cosTheta = std::sqrt((1.0f - xi1) / (1.0f + (r4 - 1.0f) * xi1));
+			const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+			const glm::vec3 H(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+			const glm::vec3 temp = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			const glm::vec3 X = glm::normalize(glm::cross(temp, N));
+			const glm::vec3 Y = glm::normalize(glm::cross(N, X));
+			return glm::normalize(X * H.x + Y * H.y + N * H.z);
+		}
+
+		float geometrySchlick(float NdotX, float roughness) {
+			const float k = roughness * roughness / 2.0f;
+			return NdotX / (NdotX * (1.0f - k) + k);
+		}
+
+		// Bilinear fetch with clamp to edge inside one face (or a 2D image)
+		glm::vec3 sampleFaceBilinear(const IBLImageData& image, uint32_t level, uint32_t face, float s, float t) {
+			const int width = static_cast<int>(image.getLevelWidth(level));
+			const int height = static_cast<int>(image.getLevelHeight(level));
+			const float u = s * width - 0.5f;
+			const float v = t * height - 0.5f;
+			const float u0 = std::floor(u);
+			const float v0 = std::floor(v);
+			const float fu = u - u0;
+			const float fv = v - v0;
+			const int x0 = std::clamp(static_cast<int>(u0), 0, width - 1);
+			const int x1 = std::clamp(static_cast<int>(u0) + 1, 0, width - 1);
+			const int y0 = std::clamp(static_cast<int>(v0), 0, height - 1);
+			const int y1 = std::clamp(static_cast<int>(v0) + 1, 0, height - 1);
+
+			const float* t00 = image.getTexel(level, face, x0, y0);
+			const float* t10 = image.getTexel(level, face, x1, y0);
+			const float* t01 = image.getTexel(level, face, x0, y1);
+			const float* t11 = image.getTexel(level, face, x1, y1);
+			glm::vec3 result;
+			for (int c = 0; c < 3; c++) {
+				const float top = t00[c] + (t10[c] - t00[c]) * fu;
+				const float bottom = t01[c] + (t11[c] - t01[c]) * fu;
+				result[c] = top + (bottom - top) * fv;
+			}
+			return result;
+		}
+
+		// Bilinear fetch with repeat addressing, the sampler IBLComputeBaker uses for the equirect source
+		glm::vec3 sampleEquirect(const float* pixelsRGBA, uint32_t width, uint32_t height, float s, float t) {
+			const float u = s * width - 0.5f;
+			const float v = t * height - 0.5f;
+			const float u0 = std::floor(u);
+			const float v0 = std::floor(v);
+			const float fu = u - u0;
+			const float fv = v - v0;
+			auto wrap = [](int value, int size) { return ((value % size) + size) % size; };
+			const int w = static_cast<int>(width);
+			const int h = static_cast<int>(height);
+			const int x0 = wrap(static_cast<int>(u0), w);
+			const int x1 = wrap(static_cast<int>(u0) + 1, w);
+			const int y0 = wrap(static_cast<int>(v0), h);
+			const int y1 = wrap(static_cast<int>(v0) + 1, h);
+
+			auto texel = [&](int x, int y) { return pixelsRGBA + (static_cast<size_t>(y) * width + x) * 4; };
+			const float* t00 = texel(x0, y0);
+			const float* t10 = texel(x1, y0);
+			const float* t01 = texel(x0, y1);
+			const float* t11 = texel(x1, y1);
+			glm::vec3 result;
+			for (int c = 0; c < 3; c++) {
+				const float top = t00[c] + (t10[c] - t00[c]) * fu;
+				const float bottom = t01[c] + (t11[c] - t01[c]) * fu;
+				result[c] = top + (bottom - top) * fv;
+			}
+			return result;
+		}
+	}
+
+	CPUIBLBaker::CPUIBLBaker(uint32_t threadCount) {
+		mThreadPool = ThreadPool::create(threadCount);
+	}
+
+	CPUIBLBaker::~CPUIBLBaker() {
+		mThreadPool.reset();
+	}
+
+	glm::vec3 CPUIBLBaker::sampleCube(const IBLImageData& cubeMap, const glm::vec3& direction, float lod) {
+		// Major axis selection, sc/tc per the Vulkan spec cube map face table
+		const glm::vec3 a = glm::abs(direction);
+		uint32_t face;
+		float sc, tc, ma;
+		if (a.x >= a.y && a.x >= a.z) {
+			face = direction.x >= 0.0f ? 0 : 1;
+			sc = direction.x >= 0.0f ? -direction.z : direction.z;
+			tc = -direction.y;
+			ma = a.x;
+		}
+		else if (a.y >= a.z) {
+			face = direction.y >= 0.0f ? 2 : 3;
+			sc = direction.x;
+			tc = direction.y >= 0.0f ? direction.z : -direction.z;
+			ma = a.y;
+		}
+		else {
+			face = direction.z >= 0.0f ? 4 : 5;
+			sc = direction.z >= 0.0f ? direction.x : -direction.x;
+			tc = -direction.y;
+			ma = a.z;
+		}
+		const float s = 0.5f * (sc / ma + 1.0f);
+		const float t = 0.5f * (tc / ma + 1.0f);
+
+		lod = std::clamp(lod, 0.0f, static_cast<float>(cubeMap.mMipLevels - 1));
+		const uint32_t level0 = static_cast<uint32_t>(lod);
+		const float blend = lod - static_cast<float>(level0);
+		const glm::vec3 color0 = sampleFaceBilinear(cubeMap, level0, face, s, t);
+		if (blend <= 0.0f || level0 + 1 >= cubeMap.mMipLevels) {
+			return color0;
+		}
+		return glm::mix(color0, sampleFaceBilinear(cubeMap, level0 + 1, face, s, t), blend);
+	}
+
+	void CPUIBLBaker::generateMipmaps(IBLImageData& image) {
+		for (uint32_t level = 1; level < image.mMipLevels; level++) {
+			const uint32_t width = image.getLevelWidth(level);
+			const uint32_t height = image.getLevelHeight(level);
+			const uint32_t sourceWidth = image.getLevelWidth(level - 1);
+			const uint32_t sourceHeight = image.getLevelHeight(level - 1);
+			mThreadPool->parallelFor(image.mFaceCount * height, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t row = begin; row < end; row++) {
+					const uint32_t face = row / height;
+					const uint32_t y = row % height;
+					const uint32_t sy0 = std::min(y * 2, sourceHeight - 1);
+					const uint32_t sy1 = std::min(y * 2 + 1, sourceHeight - 1);
+					for (uint32_t x = 0; x < width; x++) {
+						const uint32_t sx0 = std::min(x * 2, sourceWidth - 1);
+						const uint32_t sx1 = std::min(x * 2 + 1, sourceWidth - 1);
+						const float* t00 = image.getTexel(level - 1, face, sx0, sy0);
+						const float* t10 = image.getTexel(level - 1, face, sx1, sy0);
+						const float* t01 = image.getTexel(level - 1, face, sx0, sy1);
+						const float* t11 = image.getTexel(level - 1, face, sx1, sy1);
+						float* target = image.getTexel(level, face, x, y);
+						for (uint32_t c = 0; c < IBLImageData::ChannelCount; c++) {
+							target[c] = 0.25f * (t00[c] + t10[c] + t01[c] + t11[c]);
+						}
+					}
+				}
+			});
+		}
+	}
+
+	IBLImageData CPUIBLBaker::equirectToCubeMap(const float* pixelsRGBA, uint32_t width, uint32_t height, uint32_t faceSize) {
+		FF_CPU_ZONE("CPUIBLBaker::equirectToCubeMap");
+		if (pixelsRGBA == nullptr || width == 0 || height == 0 || faceSize == 0) {
+			throw std::runtime_error("Error: invalid image for cpu cubemap conversion!");
+		}
+
+		uint32_t mipLevels = 1;
+		while ((faceSize >> mipLevels) > 0) {
+			mipLevels++;
+		}
+		IBLImageData cubeMap = IBLImageData::create(faceSize, faceSize, 6, mipLevels);
+		mThreadPool->parallelFor(6 * faceSize, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t row = begin; row < end; row++) {
+				const uint32_t face = row / faceSize;
+				const uint32_t y = row % faceSize;
+				for (uint32_t x = 0; x < faceSize; x++) {
+					// Vec3Texcoord2UV of EquirectToCube.comp
+					const glm::vec3 direction = cubeFaceDirection(face, x, y, faceSize);
+					const float u = std::atan2(direction.z, direction.x) / PI * 0.5f + 0.5f;
+					const float v = std::asin(std::clamp(direction.y, -1.0f, 1.0f)) / PI + 0.5f;
+					const glm::vec3 color = sampleEquirect(pixelsRGBA, width, height, u, v);
+					float* target = cubeMap.getTexel(0, face, x, y);
+					target[0] = color.r;
+					target[1] = color.g;
+					target[2] = color.b;
+					target[3] = 1.0f;
+				}
+			}
+		});
+		generateMipmaps(cubeMap);
+		return cubeMap;
+	}
+
+	IBLImageData CPUIBLBaker::equirectToCubeMapFromFile(const std::string& filePath, uint32_t faceSize) {
+		int texWidth = 0, texHeight = 0, texChannels = 0;
+		stbi_set_flip_vertically_on_load(0);
+		float* pixels = stbi_loadf(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels || texWidth <= 0 || texHeight <= 0) {
+			throw std::runtime_error("Error: failed to load image for cpu IBL bake! Path: " + filePath);
+		}
+
+		IBLImageData cubeMap = equirectToCubeMap(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), faceSize);
+		stbi_image_free(pixels);
+		return cubeMap;
+	}
+
+	IBLImageData CPUIBLBaker::generateDiffuseIrradianceMap(const IBLImageData& environmentCubeMap, uint32_t faceSize) {
+		FF_CPU_ZONE("CPUIBLBaker::generateDiffuseIrradianceMap");
+		if (!environmentCubeMap.isCubeMap()) {
+			throw std::runtime_error("Error: diffuse irradiance needs a cubemap!");
+		}
+
+		// The integral is smooth, a small source mip gives the same result as the 250k samples of the gpu kernel
+		uint32_t sourceLevel = 0;
+		while (sourceLevel + 1 < environmentCubeMap.mMipLevels && environmentCubeMap.getLevelWidth(sourceLevel) > IrradianceSourceSize) {
+			sourceLevel++;
+		}
+		const uint32_t sourceSize = environmentCubeMap.getLevelWidth(sourceLevel);
+
+		// Source texels as structure of arrays, radiance premultiplied by solid angle / PI, padded to a multiple of 4 with zero weight
+		const uint32_t texelCount = 6 * sourceSize * sourceSize;
+		const uint32_t paddedCount = (texelCount + 3) & ~3u;
+		std::vector<float> dirX(paddedCount, 0.0f), dirY(paddedCount, 0.0f), dirZ(paddedCount, 0.0f);
+		std::vector<float> weightR(paddedCount, 0.0f), weightG(paddedCount, 0.0f), weightB(paddedCount, 0.0f);
+		for (uint32_t face = 0; face < 6; face++) {
+			for (uint32_t y = 0; y < sourceSize; y++) {
+				for (uint32_t x = 0; x < sourceSize; x++) {
+					const uint32_t index = (face * sourceSize + y) * sourceSize + x;
+					const glm::vec3 direction = cubeFaceDirection(face, x, y, sourceSize);
+					const float weight = cubeTexelSolidAngle(x, y, sourceSize) / PI;
+					const float* texel = environmentCubeMap.getTexel(sourceLevel, face, x, y);
+					dirX[index] = direction.x;
+					dirY[index] = direction.y;
+					dirZ[index] = direction.z;
+					weightR[index] = texel[0] * weight;
+					weightG[index] = texel[1] * weight;
+					weightB[index] = texel[2] * weight;
+				}
+			}
+		}
+
+		IBLImageData irradianceMap = IBLImageData::create(faceSize, faceSize, 6, 1);
+		mThreadPool->parallelFor(6 * faceSize, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t row = begin; row < end; row++) {
+				const uint32_t face = row / faceSize;
+				const uint32_t y = row % faceSize;
+				for (uint32_t x = 0; x < faceSize; x++) {
+					const glm::vec3 N = cubeFaceDirection(face, x, y, faceSize);
+					float irradiance[3]{};
+					uint32_t index = 0;
+
+#ifdef FF_CPU_IBL_USE_SSE
+					const __m128 nx = _mm_set1_ps(N.x);
+					const __m128 ny = _mm_set1_ps(N.y);
+					const __m128 nz = _mm_set1_ps(N.z);
+					const __m128 zero = _mm_setzero_ps();
+					__m128 accR = zero, accG = zero, accB = zero;
+					for (; index < paddedCount; index += 4) {
+						__m128 cosine = _mm_mul_ps(nx, _mm_loadu_ps(&dirX[index]));
+						cosine = _mm_add_ps(cosine, _mm_mul_ps(ny, _mm_loadu_ps(&dirY[index])));
+						cosine = _mm_add_ps(cosine, _mm_mul_ps(nz, _mm_loadu_ps(&dirZ[index])));
+						cosine = _mm_max_ps(cosine, zero);
+						accR = _mm_add_ps(accR, _mm_mul_ps(cosine, _mm_loadu_ps(&weightR[index])));
+						accG = _mm_add_ps(accG, _mm_mul_ps(cosine, _mm_loadu_ps(&weightG[index])));
+						accB = _mm_add_ps(accB, _mm_mul_ps(cosine, _mm_loadu_ps(&weightB[index])));
+					}
+					float lanes[4];
+					_mm_storeu_ps(lanes, accR);
+					irradiance[0] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+					_mm_storeu_ps(lanes, accG);
+					irradiance[1] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+					_mm_storeu_ps(lanes, accB);
+					irradiance[2] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+					// Remaining texels (or all of them without SSE)
+					for (; index < paddedCount; index++) {
+						const float cosine = std::max(0.0f, N.x * dirX[index] + N.y * dirY[index] + N.z * dirZ[index]);
+						irradiance[0] += cosine * weightR[index];
+						irradiance[1] += cosine * weightG[index];
+						irradiance[2] += cosine * weightB[index];
+					}
+
+					float* target = irradianceMap.getTexel(0, face, x, y);
+					target[0] = irradiance[0];
+					target[1] = irradiance[1];
+					target[2] = irradiance[2];
+					target[3] = 1.0f;
+				}
+			}
+		});
+		return irradianceMap;
+	}
+
+	IBLImageData CPUIBLBaker::generateSpecularPrefilterMap(const IBLImageData& environmentCubeMap, uint32_t faceSize, uint32_t mipLevels, bool filteredSampling) {
+		FF_CPU_ZONE("CPUIBLBaker::generateSpecularPrefilterMap");
+		if (!environmentCubeMap.isCubeMap()) {
+			throw std::runtime_error("Error: specular prefilter needs a cubemap!");
+		}
+
+		const uint32_t sampleCount = filteredSampling ? HDRI::FilteredPrefilterSampleCount : HDRI::SpecularPrefilterSampleCount;
+		const float sourceSize = static_cast<float>(environmentCubeMap.mWidth);
+		const float maxLod = static_cast<float>(environmentCubeMap.mMipLevels - 1);
+		const float texelSolidAngle = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+
+		// The Hammersley points are the same for every texel
+		std::vector<glm::vec2> sequence(sampleCount);
+		for (uint32_t i = 0; i < sampleCount; i++) {
+			sequence[i] = glm::vec2(static_cast<float>(i) / static_cast<float>(sampleCount), radicalInverseVDC(i));
+		}
+
+		IBLImageData prefilterMap = IBLImageData::create(faceSize, faceSize, 6, mipLevels);
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t levelSize = prefilterMap.getLevelWidth(level);
+			const float roughness = mipLevels > 1 ? static_cast<float>(level) / static_cast<float>(mipLevels - 1) : 0.0f;
+			const float a2 = std::pow(roughness, 4.0f);
+
+			mThreadPool->parallelFor(6 * levelSize, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t row = begin; row < end; row++) {
+					const uint32_t face = row / levelSize;
+					const uint32_t y = row % levelSize;
+					for (uint32_t x = 0; x < levelSize; x++) {
+						const glm::vec3 N = cubeFaceDirection(face, x, y, levelSize);
+						glm::vec3 color(0.0f);
+						if (filteredSampling && roughness <= 0.0f) {
+							color = sampleCube(environmentCubeMap, N, std::clamp(std::log2(sourceSize / levelSize), 0.0f, maxLod));
+						}
+						else {
+							float weight = 0.0f;
+							for (uint32_t i = 0; i < sampleCount; i++) {
+								const glm::vec3 H = importanceSampleGGX(sequence[i].x, sequence[i].y, N, roughness);
+								const glm::vec3 L = glm::normalize(2.0f * glm::dot(N, H) * H - N);
+								const float NdotL = std::max(glm::dot(N, L), 0.0f);
+								if (NdotL > 0.0f) {
+									float lod = 0.0f;
+									if (filteredSampling) {
+										const float NdotH = std::max(glm::dot(N, H), 0.0f);
+										const float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+										const float pdf = a2 / (PI * d * d) * 0.25f;
+										const float sampleSolidAngle = 1.0f / (static_cast<float>(sampleCount) * pdf + 1e-4f);
+										lod = std::clamp(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f, maxLod);
+									}
+									color += sampleCube(environmentCubeMap, L, lod) * NdotL;
+									weight += NdotL;
+								}
+							}
+							color /= std::max(weight, 1e-4f);
+						}
+
+						float* target = prefilterMap.getTexel(level, face, x, y);
+						target[0] = color.r;
+						target[1] = color.g;
+						target[2] = color.b;
+						target[3] = 1.0f;
+					}
+				}
+			});
+		}
+		return prefilterMap;
+	}
+
+	IBLImageData CPUIBLBaker::generateBRDFLUT(uint32_t size) {
+		FF_CPU_ZONE("CPUIBLBaker::generateBRDFLUT");
+		const uint32_t sampleCount = HDRI::BRDFLUTSampleCount;
+		IBLImageData lut = IBLImageData::create(size, size, 1, 1);
+		mThreadPool->parallelFor(size, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t y = begin; y < end; y++) {
+				// GenerateBRDF of BRDFLUT.comp at texel centers: x = NdotV, y = roughness
+				const float roughness = (y + 0.5f) / size;
+				for (uint32_t x = 0; x < size; x++) {
+					const float NdotV = (x + 0.5f) / size;
+					const glm::vec3 N(0.0f, 0.0f, 1.0f);
+					const glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+					float A = 0.0f;
+					float B = 0.0f;
+					for (uint32_t i = 0; i < sampleCount; i++) {
+						const float xi0 = static_cast<float>(i) / static_cast<float>(sampleCount);
+						const glm::vec3 H = importanceSampleGGX(xi0, radicalInverseVDC(i), N, roughness);
+						const glm::vec3 L = glm::normalize(2.0f * glm::dot(V, H) * H - V);
+						const float NdotL = std::max(L.z, 0.0f);
+						const float NdotH = std::max(H.z, 0.0f);
+						const float HdotV = std::max(glm::dot(H, V), 0.0f);
+						if (NdotL > 0.0f) {
+							const float G = geometrySchlick(NdotV, roughness) * geometrySchlick(NdotL, roughness);
+							const float visibility = (G * NdotL) / (NdotH * NdotV);
+							const float fresnel = std::pow(1.0f - HdotV, 5.0f);
+							A += (1.0f - fresnel) * visibility;
+							B += fresnel * visibility;
+						}
+					}
+					float* target = lut.getTexel(0, 0, x, y);
+					target[0] = A / sampleCount;
+					target[1] = B / sampleCount;
+					target[2] = 0.0f;
+					target[3] = 0.0f;
+				}
+			}
+		});
+		return lut;
+	}
+
+	std::vector<CPUIBLBaker::LevelError> CPUIBLBaker::compare(const IBLImageData& reference, const IBLImageData& test) {
+		if (reference.mWidth != test.mWidth || reference.mHeight != test.mHeight ||
+			reference.mFaceCount != test.mFaceCount || reference.mMipLevels != test.mMipLevels) {
+			return {};
+		}
+
+		std::vector<LevelError> errors(reference.mMipLevels);
+		for (uint32_t level = 0; level < reference.mMipLevels; level++) {
+			const auto& referenceLevel = reference.mLevels[level];
+			const auto& testLevel = test.mLevels[level];
+			double squaredSum = 0.0;
+			size_t sampleCount = 0;
+			LevelError& error = errors[level];
+			for (size_t i = 0; i < referenceLevel.size(); i += IBLImageData::ChannelCount) {
+				for (size_t c = 0; c < 3; c++) {
+					const float absError = std::abs(referenceLevel[i + c] - testLevel[i + c]);
+					error.mMaxAbsError = std::max(error.mMaxAbsError, absError);
+					error.mMaxRelativeError = std::max(error.mMaxRelativeError, absError / std::max(std::abs(referenceLevel[i + c]), 1e-3f));
+					squaredSum += static_cast<double>(absError) * absError;
+					sampleCount++;
+				}
+			}
+			error.mRMSE = sampleCount > 0 ? static_cast<float>(std::sqrt(squaredSum / sampleCount)) : 0.0f;
+		}
+		return errors;
+	}
+
+	glm::vec2 CPUIBLBaker::evaluateAnalyticEnvBRDF(float NdotV, float roughness) {
+		const glm::vec4 c0(-1.0f, -0.0275f, -0.572f, 0.022f);
+		const glm::vec4 c1(1.0f, 0.0425f, 1.04f, -0.04f);
+		const glm::vec4 r = roughness * c0 + c1;
+		const float a004 = std::min(r.x * r.x, std::exp2(-9.28f * NdotV)) * r.x + r.y;
+		return glm::vec2(-1.04f, 1.04f) * a004 + glm::vec2(r.z, r.w);
+	}
+
+	CPUIBLBaker::EnvBRDFError CPUIBLBaker::compareAnalyticEnvBRDF(const IBLImageData& brdfLUT) {
+		EnvBRDFError result{};
+		if (brdfLUT.empty()) {
+			return result;
+		}
+		const float dielectricF0 = 0.04f;
+		LevelError& error = result.mScaleBias;
+		double squaredSum = 0.0;
+		double dielectricSquaredSum = 0.0;
+		for (uint32_t y = 0; y < brdfLUT.mHeight; y++) {
+			const float roughness = (y + 0.5f) / brdfLUT.mHeight;
+			for (uint32_t x = 0; x < brdfLUT.mWidth; x++) {
+				const glm::vec2 analytic = evaluateAnalyticEnvBRDF((x + 0.5f) / brdfLUT.mWidth, roughness);
+				const float* baked = brdfLUT.getTexel(0, 0, x, y);
+				for (int c = 0; c < 2; c++) {
+					const float absError = std::abs(baked[c] - analytic[c]);
+					error.mMaxAbsError = std::max(error.mMaxAbsError, absError);
+					error.mMaxRelativeError = std::max(error.mMaxRelativeError, absError / std::max(std::abs(baked[c]), 1e-3f));
+					squaredSum += static_cast<double>(absError) * absError;
+				}
+				// What the shading sees: the specular reflectance of a dielectric
+				const float dielectricError = std::abs((dielectricF0 * baked[0] + baked[1]) - (dielectricF0 * analytic.x + analytic.y));
+				result.mMaxDielectricError = std::max(result.mMaxDielectricError, dielectricError);
+				dielectricSquaredSum += static_cast<double>(dielectricError) * dielectricError;
+			}
+		}
+		const double texelCount = static_cast<double>(brdfLUT.mWidth) * brdfLUT.mHeight;
+		error.mRMSE = static_cast<float>(std::sqrt(squaredSum / (2.0 * texelCount)));
+		result.mDielectricRMSE = static_cast<float>(std::sqrt(dielectricSquaredSum / texelCount));
+		result.mPassed = error.mRMSE <= AnalyticEnvBRDFMaxRMSE && result.mDielectricRMSE <= AnalyticEnvBRDFMaxDielectricRMSE;
+		return result;
+	}
+
+	void CPUIBLBaker::printComparison(const std::string& name, const std::vector<LevelError>& errors) {
+		if (errors.empty()) {
+			std::cout << "IBL validation: " << name << " shapes differ, nothing compared" << std::endl;
+			return;
+		}
+		for (size_t level = 0; level < errors.size(); level++) {
+			std::cout << "IBL validation: " << name << " mip " << level
+				<< " max abs " << errors[level].mMaxAbsError
+				<< " rmse " << errors[level].mRMSE
+				<< " max rel " << errors[level].mMaxRelativeError << std::endl;
+		}
+	}
+}
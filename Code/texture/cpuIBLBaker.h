@@ -0,0 +1,87 @@
+#pragma once
+#include "../base.h"
+#include "../threadPool.h"
+#include "iblImageData.h"
+
+namespace FF {
+	/*
+	* Bakes the IBL resources on the CPU, without a device, into the same RGBA32F layouts the gpu bakers produce:
+	* environment cubemap with a full mip chain, irradiance cubemap, GGX prefiltered cubemap and the split sum BRDF LUT.
+	* Kernels follow the compute shaders (same face table, equirect mapping, Hammersley sequence and sample counts),
+	* work is split across a thread pool and the irradiance convolution runs 4 source texels at a time with SSE.
+	* Results go through IBLCache::store / upload, so a build machine can precompute the cache and the runtime only loads it.
+	*/
+	class CPUIBLBaker {
+	public:
+		using Ptr = std::shared_ptr<CPUIBLBaker>;
+		/// @param threadCount 0 uses every hardware thread.
+		static Ptr create(uint32_t threadCount = 0) {
+			return std::make_shared<CPUIBLBaker>(threadCount);
+		}
+
+		// Bumped whenever a kernel changes, part of the cache keys of cpu baked entries
+		static constexpr uint32_t Version = 1;
+
+		// Irradiance is integrated exactly over a source mip no larger than this
+		static constexpr uint32_t IrradianceSourceSize = 64;
+
+		// Error of one mip level, over every face and the rgb channels
+		struct LevelError {
+			float mMaxAbsError{ 0.0f };
+			float mRMSE{ 0.0f };
+			float mMaxRelativeError{ 0.0f };
+		};
+
+		CPUIBLBaker(uint32_t threadCount);
+		~CPUIBLBaker();
+
+		IBLImageData equirectToCubeMap(const float* pixelsRGBA, uint32_t width, uint32_t height, uint32_t faceSize);
+
+		// stbi_loadf without flip, like Texture::createHDRITexture
+		IBLImageData equirectToCubeMapFromFile(const std::string& filePath, uint32_t faceSize);
+
+		IBLImageData generateDiffuseIrradianceMap(const IBLImageData& environmentCubeMap, uint32_t faceSize);
+
+		// Roughness goes from 0 at mip 0 to 1 at the last mip, PrefilterEnvironment of SpecularPrefilter.comp per texel
+		IBLImageData generateSpecularPrefilterMap(const IBLImageData& environmentCubeMap, uint32_t faceSize, uint32_t mipLevels, bool filteredSampling = true);
+
+		IBLImageData generateBRDFLUT(uint32_t size);
+
+		// Trilinear cubemap fetch with the Vulkan face selection and clamp to edge inside each face (non seamless sampler)
+		static glm::vec3 sampleCube(const IBLImageData& cubeMap, const glm::vec3& direction, float lod);
+
+		/// @brief Compare two images of the same shape level by level, reference is usually the gpu bake read back with IBLCache::download.
+		/// @return empty when the shapes differ.
+		static std::vector<LevelError> compare(const IBLImageData& reference, const IBLImageData& test);
+
+		// EnvBRDFApprox of pbr1.frag, (scale, bias) applied to F0
+		static glm::vec2 evaluateAnalyticEnvBRDF(float NdotV, float roughness);
+
+		// Tolerances of the analytic env BRDF against the LUT, as RMSE over the texel centers. EnvBRDFApprox is a fit:
+		// measured against generateBRDFLUT it is at about 0.076 (rg) and 0.029 (dielectric), a wrong coefficient goes past both.
+		// The max errors are not checked, they come from the grazing NdotV column where the LUT integrand grows with 1 / NdotV
+		static constexpr float AnalyticEnvBRDFMaxRMSE = 0.09f; // scale and bias
+		static constexpr float AnalyticEnvBRDFMaxDielectricRMSE = 0.035f; // F0 * scale + bias with F0 = 0.04
+
+		struct EnvBRDFError {
+			LevelError mScaleBias{}; // rg channels
+			float mDielectricRMSE{ 0.0f };
+			float mMaxDielectricError{ 0.0f };
+			bool mPassed{ false }; // both RMSE within their tolerance, false for an empty LUT
+		};
+
+		// Error of the analytic env BRDF against a baked LUT (texel centers)
+		static EnvBRDFError compareAnalyticEnvBRDF(const IBLImageData& brdfLUT);
+
+		static void printComparison(const std::string& name, const std::vector<LevelError>& errors);
+
+		[[nodiscard]] uint32_t getThreadCount() const { return mThreadPool->getThreadCount(); }
+
+	private:
+		// 2x2 box filter of every level from the previous one
+		void generateMipmaps(IBLImageData& image);
+
+	private:
+		ThreadPool::Ptr mThreadPool{ nullptr };
+	};
+}
@@ -0,0 +1,438 @@
+#include "hdrCompressor.h"
+#include <glm/gtc/packing.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace FF {
+
+	namespace {
+		// Largest finite half float, the UFLOAT formats store nothing below 0
+		constexpr float MaxHalf = 65504.0f;
+
+		constexpr uint32_t BC6HWeights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Mode 11: 5 mode bits 00011, two 10 bit rgb endpoints, 63 index bits
+		constexpr uint32_t BC6HMode11 = 0x03;
+
+		glm::vec3 clampHDR(const glm::vec3& color) {
+			glm::vec3 result{};
+			for (int channel = 0; channel < 3; channel++) {
+				const float value = color[channel];
+				result[channel] = std::isnan(value) ? 0.0f : std::clamp(value, 0.0f, MaxHalf);
+			}
+			return result;
+		}
+
+		// Half float bit patterns, BC6H interpolates these rather than the values
+		glm::vec3 toHalfBits(const glm::vec3& color) {
+			return glm::vec3(
+				static_cast<float>(glm::packHalf1x16(color.r)),
+				static_cast<float>(glm::packHalf1x16(color.g)),
+				static_cast<float>(glm::packHalf1x16(color.b)));
+		}
+
+		// Decoding maps q to (q << 6) + 32 then multiplies by 31/64, so the nearest q of a half pattern h is (h - 15.5) / 31
+		uint32_t quantizeEndpoint(float halfBits) {
+			return static_cast<uint32_t>(std::clamp(std::round((halfBits - 15.5f) / 31.0f), 0.0f, 1023.0f));
+		}
+
+		uint32_t unquantizeEndpoint(uint32_t value) {
+			if (value == 0) {
+				return 0;
+			}
+			if (value == 1023) {
+				return 0xFFFF;
+			}
+			return (value << 6) + 32;
+		}
+
+		// Palette entry as a half pattern, exactly what the sampler decodes
+		uint32_t interpolateEndpoints(uint32_t a, uint32_t b, uint32_t weight) {
+			return (((a * (64 - weight) + b * weight + 32) >> 6) * 31) >> 6;
+		}
+
+		// Blocks are little endian bit streams starting at bit 0 of byte 0
+		struct BitWriter {
+			uint8_t* mBytes{ nullptr };
+			uint32_t mOffset{ 0 };
+
+			void write(uint32_t value, uint32_t bitCount) {
+				for (uint32_t bit = 0; bit < bitCount; bit++, mOffset++) {
+					if ((value >> bit) & 1u) {
+						mBytes[mOffset >> 3] |= static_cast<uint8_t>(1u << (mOffset & 7));
+					}
+				}
+			}
+		};
+	}
+
+	HDRCompressor::HDRCompressor(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount)
+		: mDevice(device), mCommandPool(commandPool) {
+		mFormat = selectFormat(mDevice);
+		mThreadPool = ThreadPool::create(threadCount);
+		// Built once, every job shares them
+		if (mFormat != VK_FORMAT_UNDEFINED) {
+			buildPipeline();
+		}
+	}
+
+	HDRCompressor::~HDRCompressor() {
+		mPipeline.reset();
+		mDescriptorLayout.reset();
+		mThreadPool.reset();
+		mCommandPool.reset();
+		mDevice.reset();
+	}
+
+	VkFormat HDRCompressor::selectFormat(const Wrapper::Device::Ptr& device) {
+		if (device == nullptr) {
+			return VK_FORMAT_UNDEFINED;
+		}
+		const VkFormatFeatureFlags requiredFeatures =
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		auto isUsable = [&](VkFormat format) {
+			VkFormatProperties properties{};
+			vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &properties);
+			return (properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+		};
+
+		if (device->isTextureCompressionBCSupported() && isUsable(VK_FORMAT_BC6H_UFLOAT_BLOCK)) {
+			return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		}
+		if (isUsable(VK_FORMAT_B10G11R11_UFLOAT_PACK32)) {
+			return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	void HDRCompressor::encodeBC6HBlock(const glm::vec3 texels[16], uint8_t block[16]) {
+		glm::vec3 bits[16];
+		glm::vec3 mean(0.0f);
+		glm::vec3 minBits(MaxHalf);
+		glm::vec3 maxBits(0.0f);
+		for (uint32_t i = 0; i < 16; i++) {
+			bits[i] = toHalfBits(clampHDR(texels[i]));
+			mean += bits[i] / 16.0f;
+			minBits = glm::min(minBits, bits[i]);
+			maxBits = glm::max(maxBits, bits[i]);
+		}
+
+		// Principal axis by power iteration on the covariance, starting from the bounding box diagonal
+		glm::mat3 covariance(0.0f);
+		for (uint32_t i = 0; i < 16; i++) {
+			const glm::vec3 offset = bits[i] - mean;
+			covariance += glm::outerProduct(offset, offset);
+		}
+		glm::vec3 axis = maxBits - minBits;
+		for (uint32_t iteration = 0; iteration < 8; iteration++) {
+			const glm::vec3 next = covariance * axis;
+			const float length = glm::length(next);
+			if (length < 1e-6f) {
+				break;
+			}
+			axis = next / length;
+		}
+		const float axisLength = glm::length(axis);
+		axis = axisLength > 1e-6f ? axis / axisLength : glm::vec3(0.0f);
+
+		float tMin = 0.0f;
+		float tMax = 0.0f;
+		for (uint32_t i = 0; i < 16; i++) {
+			const float t = glm::dot(bits[i] - mean, axis);
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		uint32_t endpoints[2][3];
+		for (int channel = 0; channel < 3; channel++) {
+			endpoints[0][channel] = quantizeEndpoint(mean[channel] + axis[channel] * tMin);
+			endpoints[1][channel] = quantizeEndpoint(mean[channel] + axis[channel] * tMax);
+		}
+
+		float palette[16][3];
+		for (uint32_t entry = 0; entry < 16; entry++) {
+			for (int channel = 0; channel < 3; channel++) {
+				palette[entry][channel] = static_cast<float>(interpolateEndpoints(
+					unquantizeEndpoint(endpoints[0][channel]), unquantizeEndpoint(endpoints[1][channel]), BC6HWeights[entry]));
+			}
+		}
+
+		uint32_t indices[16];
+		for (uint32_t i = 0; i < 16; i++) {
+			float bestError = std::numeric_limits<float>::max();
+			for (uint32_t entry = 0; entry < 16; entry++) {
+				const glm::vec3 difference = bits[i] - glm::vec3(palette[entry][0], palette[entry][1], palette[entry][2]);
+				const float error = glm::dot(difference, difference);
+				if (error < bestError) {
+					bestError = error;
+					indices[i] = entry;
+				}
+			}
+		}
+
+		// The anchor index only has 3 bits: mirror the block when its top bit is set, the weights are symmetric
+		if (indices[0] >= 8) {
+			std::swap(endpoints[0], endpoints[1]);
+			for (auto& index : indices) {
+				index = 15 - index;
+			}
+		}
+
+		std::memset(block, 0, 16);
+		BitWriter writer{ block };
+		writer.write(BC6HMode11, 5);
+		for (int endpoint = 0; endpoint < 2; endpoint++) {
+			for (int channel = 0; channel < 3; channel++) {
+				writer.write(endpoints[endpoint][channel], 10);
+			}
+		}
+		writer.write(indices[0], 3);
+		for (uint32_t i = 1; i < 16; i++) {
+			writer.write(indices[i], 4);
+		}
+	}
+
+	uint32_t HDRCompressor::packB10G11R11(const glm::vec3& color) {
+		return glm::packF2x11_1x10(clampHDR(color));
+	}
+
+	IBLCompressedImageData HDRCompressor::encode(const IBLImageData& data, VkFormat format) {
+		if (IBLCompressedImageData::getBlockSize(format) == 0) {
+			throw std::runtime_error("Error: HDR compression only encodes BC6H and B10G11R11!");
+		}
+
+		IBLCompressedImageData result = IBLCompressedImageData::create(format, data.mWidth, data.mHeight, data.mFaceCount, data.mMipLevels);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			const uint32_t width = data.getLevelWidth(level);
+			const uint32_t height = data.getLevelHeight(level);
+			const uint32_t blocksX = result.getLevelBlocksX(level);
+			const uint32_t blocksPerFace = blocksX * result.getLevelBlocksY(level);
+
+			mThreadPool->parallelFor(blocksPerFace * data.mFaceCount, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t blockIndex = begin; blockIndex < end; blockIndex++) {
+					const uint32_t face = blockIndex / blocksPerFace;
+					const uint32_t blockX = (blockIndex % blocksPerFace) % blocksX;
+					const uint32_t blockY = (blockIndex % blocksPerFace) / blocksX;
+					uint8_t* output = result.getBlock(level, face, blockX, blockY);
+
+					if (format == VK_FORMAT_B10G11R11_UFLOAT_PACK32) {
+						const float* texel = data.getTexel(level, face, blockX, blockY);
+						const uint32_t packed = packB10G11R11(glm::vec3(texel[0], texel[1], texel[2]));
+						std::memcpy(output, &packed, sizeof(packed));
+						continue;
+					}
+
+					// Levels smaller than a block repeat their edge texels
+					glm::vec3 texels[16];
+					for (uint32_t y = 0; y < 4; y++) {
+						for (uint32_t x = 0; x < 4; x++) {
+							const float* texel = data.getTexel(level, face,
+								std::min(blockX * 4 + x, width - 1),
+								std::min(blockY * 4 + y, height - 1));
+							texels[y * 4 + x] = glm::vec3(texel[0], texel[1], texel[2]);
+						}
+					}
+					encodeBC6HBlock(texels, output);
+				}
+			});
+		}
+		return result;
+	}
+
+	void HDRCompressor::buildPipeline() {
+		std::vector<Wrapper::UniformParameter::Ptr> params{};
+		for (uint32_t binding = 0; binding < 2; binding++) {
+			auto bufferParam = Wrapper::UniformParameter::create();
+			bufferParam->mBinding = binding;
+			bufferParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bufferParam->mCount = 1;
+			bufferParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			params.push_back(bufferParam);
+		}
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build(params);
+
+		VkDescriptorSetLayout setLayout = mDescriptorLayout->getLayout();
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(LevelConstants);
+
+		const bool isBC6H = mFormat == VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		mPipeline = Wrapper::ComputePipeline::create(mDevice);
+		mPipeline->setShader(Wrapper::Shader::create(mDevice, ShaderPaths[isBC6H ? 0 : 1], VK_SHADER_STAGE_COMPUTE_BIT, "main"));
+		mPipeline->mPipelineLayoutInfo.setLayoutCount = 1;
+		mPipeline->mPipelineLayoutInfo.pSetLayouts = &setLayout;
+		mPipeline->mPipelineLayoutInfo.pushConstantRangeCount = 1;
+		mPipeline->mPipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		mPipeline->build();
+	}
+
+	HDRCompressor::Job HDRCompressor::createJob(const Wrapper::Image::Ptr& source) const {
+		if (mFormat == VK_FORMAT_UNDEFINED) {
+			throw std::runtime_error("Error: HDR compression has no format on this device!");
+		}
+		if (source->getFormat() != VK_FORMAT_R32G32B32A32_SFLOAT || (source->getUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+			throw std::runtime_error("Error: HDR compression needs an RGBA32F image with transfer src usage!");
+		}
+
+		Job job{};
+		job.mSource = source;
+
+		// Shape only, the levels stay empty
+		IBLCompressedImageData& layout = job.mLayout;
+		layout.mFormat = mFormat;
+		layout.mWidth = source->getWidth();
+		layout.mHeight = source->getHeight();
+		layout.mFaceCount = source->getLayerCount();
+		layout.mMipLevels = source->getMipLevels();
+
+		// Source texels are copied to a buffer level after level, faces back to back like IBLCache::download,
+		// and the kernel writes the blocks of each level with the same layout, ready for one copy to the compressed image
+		job.mLevelConstants.resize(layout.mMipLevels);
+		VkDeviceSize sourceSize = 0;
+		VkDeviceSize outputSize = 0;
+		for (uint32_t level = 0; level < layout.mMipLevels; level++) {
+			const uint32_t width = layout.getLevelWidth(level);
+			const uint32_t height = layout.getLevelHeight(level);
+			const VkDeviceSize sourceFaceSize = static_cast<VkDeviceSize>(width) * height * IBLImageData::ChannelCount * sizeof(float);
+			const VkDeviceSize outputFaceSize = layout.getFaceByteCount(level);
+
+			job.mLevelConstants[level].mWidth = width;
+			job.mLevelConstants[level].mHeight = height;
+			job.mLevelConstants[level].mSourceOffset = static_cast<uint32_t>(sourceSize / (IBLImageData::ChannelCount * sizeof(float)));
+			job.mLevelConstants[level].mOutputOffset = static_cast<uint32_t>(outputSize / sizeof(uint32_t));
+
+			for (uint32_t face = 0; face < layout.mFaceCount; face++) {
+				VkBufferImageCopy region{};
+				region.bufferRowLength = 0;
+				region.bufferImageHeight = 0;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = face;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { width, height, 1 };
+
+				region.bufferOffset = sourceSize + face * sourceFaceSize;
+				job.mSourceRegions.push_back(region);
+				region.bufferOffset = outputSize + face * outputFaceSize;
+				job.mOutputRegions.push_back(region);
+			}
+			sourceSize += sourceFaceSize * layout.mFaceCount;
+			outputSize += outputFaceSize * layout.mFaceCount;
+		}
+
+		job.mSourceBuffer = Wrapper::Buffer::create(mDevice, sourceSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		job.mOutputBuffer = Wrapper::Buffer::create(mDevice, outputSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		std::vector<Wrapper::UniformParameter::Ptr> params{};
+		auto sourceParam = Wrapper::UniformParameter::create();
+		sourceParam->mBinding = 0;
+		sourceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		sourceParam->mCount = 1;
+		sourceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		sourceParam->mSize = static_cast<size_t>(sourceSize);
+		sourceParam->mBuffers.push_back(job.mSourceBuffer);
+		params.push_back(sourceParam);
+
+		auto outputParam = Wrapper::UniformParameter::create();
+		outputParam->mBinding = 1;
+		outputParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		outputParam->mCount = 1;
+		outputParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		outputParam->mSize = static_cast<size_t>(outputSize);
+		outputParam->mBuffers.push_back(job.mOutputBuffer);
+		params.push_back(outputParam);
+
+		job.mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		job.mDescriptorPool->build(params, 1);
+		job.mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, params, mDescriptorLayout, job.mDescriptorPool, 1);
+
+		job.mTarget = Wrapper::Image::create(
+			mDevice, layout.mWidth, layout.mHeight,
+			mFormat,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, layout.isCubeMap(), layout.mMipLevels);
+		return job;
+	}
+
+	void HDRCompressor::recordJob(const Job& job, const Wrapper::CommandBuffer::Ptr& commandBuffer) const {
+		const IBLCompressedImageData& layout = job.mLayout;
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = layout.mMipLevels;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = layout.mFaceCount;
+
+		job.mSource->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->copyImageToBuffer(job.mSource->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, job.mSourceBuffer->getBuffer(), job.mSourceRegions);
+		job.mSource->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->memoryBarrier(
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		commandBuffer->bindComputePipeline(mPipeline);
+		VkDescriptorSet set = job.mDescriptorSet->getDescriptorSet(0);
+		commandBuffer->bindDescriptorSets(mPipeline->getPipelineLayout(), 0, 1, &set, VK_PIPELINE_BIND_POINT_COMPUTE);
+		for (uint32_t level = 0; level < layout.mMipLevels; level++) {
+			// Levels write disjoint ranges of the output, no barrier between dispatches
+			LevelConstants pushValue = job.mLevelConstants[level];
+			commandBuffer->pushConstants(mPipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LevelConstants), &pushValue);
+			commandBuffer->dispatch(
+				(layout.getLevelBlocksX(level) + WorkGroupSize - 1) / WorkGroupSize,
+				(layout.getLevelBlocksY(level) + WorkGroupSize - 1) / WorkGroupSize,
+				layout.mFaceCount);
+		}
+
+		commandBuffer->memoryBarrier(
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		job.mTarget->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->copyBufferToImage(job.mOutputBuffer->getBuffer(), job.mTarget->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, job.mOutputRegions);
+		job.mTarget->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+	}
+
+	Wrapper::Image::Ptr HDRCompressor::compress(const Wrapper::Image::Ptr& source) {
+		if (mFormat == VK_FORMAT_UNDEFINED) {
+			return source;
+		}
+		const Job job = createJob(source);
+
+		Wrapper::CommandBuffer::Ptr commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		recordJob(job, commandBuffer);
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		return job.mTarget;
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "../base.h"
+#include "../threadPool.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/computePipeline.h"
+#include "../vulkanWrapper/shader.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "iblImageData.h"
+
+namespace FF {
+	/*
+	* Compresses the baked HDR cubemaps for sampling, every face and mip kept: BC6H_UFLOAT (1 byte per texel) when the device
+	* samples it, B10G11R11_UFLOAT (4 bytes) otherwise, against 16 bytes for the RGBA32F bakes.
+	* BC6H blocks are mode 11: one region, 10 bit endpoints fitted along the principal axis of the block in half float bit space
+	* (the space the format interpolates in), 16 weights. The cpu encoder feeds the cache and the offline cook,
+	* HDRCompress.comp runs the same encoder on the gpu for the runtime bakes, one thread per block or texel.
+	*/
+	class HDRCompressor {
+	public:
+		using Ptr = std::shared_ptr<HDRCompressor>;
+		/// @param device nullptr for the cpu encoder only (offline cook), compress then returns its input.
+		/// @param threadCount 0 uses every hardware thread.
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount = 0) {
+			return std::make_shared<HDRCompressor>(device, commandPool, threadCount);
+		}
+
+		// Bumped whenever an encoder changes, part of the cache keys of compressed entries
+		static constexpr uint32_t Version = 1;
+
+		// Matches local_size_x/y of HDRCompress.comp
+		static constexpr uint32_t WorkGroupSize = 8;
+
+		// Push constants of one level dispatch, layout of PushConstants in HDRCompress.comp
+		struct LevelConstants {
+			uint32_t mWidth{ 0 };
+			uint32_t mHeight{ 0 };
+			uint32_t mSourceOffset{ 0 }; // first texel of the level in the source buffer
+			uint32_t mOutputOffset{ 0 }; // first uint of the level in the output buffer
+		};
+
+		static constexpr const char* ShaderPaths[2] = {
+			"shaders/HDRCompressBC6HComp.spv",
+			"shaders/HDRCompressB10G11R11Comp.spv"
+		};
+
+		// Resources of one gpu encode, alive until the submission that recorded it has completed
+		struct Job {
+			Wrapper::Image::Ptr mSource{ nullptr };
+			Wrapper::Image::Ptr mTarget{ nullptr }; // SHADER_READ_ONLY once the recorded commands ran
+			IBLCompressedImageData mLayout{}; // shape only, the levels stay empty
+			std::vector<LevelConstants> mLevelConstants{};
+			std::vector<VkBufferImageCopy> mSourceRegions{};
+			std::vector<VkBufferImageCopy> mOutputRegions{};
+			Wrapper::Buffer::Ptr mSourceBuffer{ nullptr };
+			Wrapper::Buffer::Ptr mOutputBuffer{ nullptr };
+			Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+			Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+		};
+
+		HDRCompressor(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount);
+		~HDRCompressor();
+
+		/// @brief Best format the device can sample with linear filtering and copy to: BC6H, then B10G11R11.
+		/// @return VK_FORMAT_UNDEFINED when neither is usable, the maps then stay RGBA32F.
+		static VkFormat selectFormat(const Wrapper::Device::Ptr& device);
+
+		/// @brief Gpu encode of an RGBA32F 2D or cube image in SHADER_READ_ONLY layout, created with TRANSFER_SRC usage.
+		/// @return a new sampled image in SHADER_READ_ONLY layout, or the source itself when there is no compressed format.
+		/// Submits and waits, createJob and recordJob put the same work into a command buffer of the caller.
+		Wrapper::Image::Ptr compress(const Wrapper::Image::Ptr& source);
+
+		// Buffers, descriptor set and target of the encode of source, throws when there is no compressed format
+		[[nodiscard]] Job createJob(const Wrapper::Image::Ptr& source) const;
+		// Source copy, one dispatch per level and the copy to the target, source is left in SHADER_READ_ONLY layout
+		void recordJob(const Job& job, const Wrapper::CommandBuffer::Ptr& commandBuffer) const;
+
+		// Cpu encode of every face and mip, the blocks of a level are split across the thread pool
+		IBLCompressedImageData encode(const IBLImageData& data, VkFormat format);
+
+		// One 4x4 block of rgb texels, row major, to 16 bytes. Negative and non finite inputs are clamped to the format range
+		static void encodeBC6HBlock(const glm::vec3 texels[16], uint8_t block[16]);
+
+		static uint32_t packB10G11R11(const glm::vec3& color);
+
+		// Cache key inputs of a compressed entry, its parent is the key of the RGBA32F bake
+		static std::vector<uint32_t> getKeyParameters(VkFormat format) {
+			return { static_cast<uint32_t>(format), Version };
+		}
+
+		[[nodiscard]] VkFormat getFormat() const { return mFormat; }
+
+	private:
+		void buildPipeline();
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+		ThreadPool::Ptr mThreadPool{ nullptr };
+		// HDRCompress.comp of mFormat: source buffer at binding 0, output buffer at binding 1
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::ComputePipeline::Ptr mPipeline{ nullptr };
+	};
+}
@@ -0,0 +1,585 @@
+#include "iblCache.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+
+namespace FF {
+
+	namespace {
+		// Bump when the bake output changes in a way the key can not see
+		constexpr uint32_t IBLCacheVersion = 1;
+
+		const uint8_t KTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct KTX2Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(KTX2Header) == 80, "KTX2 header must be 80 bytes");
+
+		struct KTX2LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		// Basic data format descriptor of the cached formats, linear BT709:
+		// 4 channel 32 bit float texels, packed B10G11R11 unsigned float texels, or BC6H unsigned float 4x4 blocks
+		std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format) {
+			struct Sample {
+				uint32_t mChannel;
+				uint32_t mBitOffset;
+				uint32_t mBitLength;
+			};
+			uint32_t colorModel = 1;			// RGBSDA
+			uint32_t texelBlockDimension = 0;	// 1x1x1x1
+			uint32_t bytesPlane0 = 0;
+			uint32_t qualifiers = 0x80;			// FLOAT
+			uint32_t sampleLower = 0;			// 0.0f
+			std::vector<Sample> samples;
+			switch (format) {
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				bytesPlane0 = 16;
+				qualifiers |= 0x40;				// SIGNED
+				sampleLower = 0xBF800000;		// -1.0f
+				samples = { { 0, 0, 32 }, { 1, 32, 32 }, { 2, 64, 32 }, { 15, 96, 32 } };// R G B A
+				break;
+			case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+				bytesPlane0 = 4;
+				samples = { { 0, 0, 11 }, { 1, 11, 11 }, { 2, 22, 10 } };
+				break;
+			case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+				colorModel = 131;				// BC6H
+				texelBlockDimension = 3 | (3 << 8);// 4x4x1x1
+				bytesPlane0 = 16;
+				samples = { { 0, 0, 128 } };
+				break;
+			default:
+				throw std::runtime_error("Error: no KTX2 data format descriptor for this IBL cache format!");
+			}
+
+			const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+			std::vector<uint32_t> dfd;
+			dfd.push_back(4 + blockSize);				// dfdTotalSize
+			dfd.push_back(0);							// vendorId = KHRONOS, descriptorType = BASICFORMAT
+			dfd.push_back(2 | (blockSize << 16));		// versionNumber = 2, descriptorBlockSize
+			dfd.push_back(colorModel | (1 << 8) | (1 << 16));	// colorModel, colorPrimaries = BT709, transferFunction = LINEAR, flags = 0
+			dfd.push_back(texelBlockDimension);
+			dfd.push_back(bytesPlane0);
+			dfd.push_back(0);
+
+			for (const auto& sample : samples) {
+				// bitOffset | bitLength - 1 | channelType with the FLOAT (and SIGNED) qualifiers
+				dfd.push_back(sample.mBitOffset | ((sample.mBitLength - 1) << 16) | ((sample.mChannel | qualifiers) << 24));
+				dfd.push_back(0);			// samplePosition
+				dfd.push_back(sampleLower);	// sampleLower
+				dfd.push_back(0x3F800000);	// sampleUpper 1.0f
+			}
+			return dfd;
+		}
+
+		// Whole file with its header and level index, each loader checks the format and the level sizes it expects
+		struct KTX2File {
+			KTX2Header mHeader{};
+			std::vector<KTX2LevelIndex> mLevels{};
+			std::vector<char> mData{};
+		};
+
+		bool readKTX2File(const std::string& path, KTX2File& result) {
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file) {
+				return false;
+			}
+
+			const size_t fileSize = static_cast<size_t>(file.tellg());
+			if (fileSize < sizeof(KTX2Header)) {
+				return false;
+			}
+			result.mData.resize(fileSize);
+			file.seekg(0);
+			file.read(result.mData.data(), fileSize);
+			if (!file) {
+				return false;
+			}
+
+			KTX2Header& header = result.mHeader;
+			std::memcpy(&header, result.mData.data(), sizeof(header));
+			if (std::memcmp(header.identifier, KTX2Identifier, sizeof(KTX2Identifier)) != 0 ||
+				header.supercompressionScheme != 0 ||
+				header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+				header.layerCount != 0 ||
+				(header.faceCount != 1 && header.faceCount != 6) ||
+				header.levelCount == 0 ||
+				sizeof(KTX2Header) + header.levelCount * sizeof(KTX2LevelIndex) > fileSize) {
+				return false;
+			}
+
+			result.mLevels.resize(header.levelCount);
+			std::memcpy(result.mLevels.data(), result.mData.data() + sizeof(KTX2Header), result.mLevels.size() * sizeof(KTX2LevelIndex));
+			return true;
+		}
+
+		bool isLevelValid(const KTX2File& file, uint32_t level, uint64_t expectedSize, uint32_t texelSize) {
+			const KTX2LevelIndex& index = file.mLevels[level];
+			return index.byteLength == expectedSize &&
+				index.byteOffset % texelSize == 0 &&
+				index.byteOffset + index.byteLength <= file.mData.size();
+		}
+
+		uint64_t alignUp(uint64_t value, uint64_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	IBLCache::IBLCache(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& cacheDirectory, uint64_t maxCacheBytes)
+		: mDevice(device), mCommandPool(commandPool), mCacheDirectory(cacheDirectory), mMaxCacheBytes(maxCacheBytes) {
+	}
+
+	IBLCache::~IBLCache() {}
+
+	uint64_t IBLCache::hashBytes(const void* pData, size_t size, uint64_t seed) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(pData);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	uint64_t IBLCache::hashFile(const std::string& filePath, uint64_t seed) {
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Error: failed to open file for hashing: " + filePath);
+		}
+
+		uint64_t hash = seed;
+		std::vector<char> chunk(64 * 1024);
+		while (file) {
+			file.read(chunk.data(), chunk.size());
+			hash = hashBytes(chunk.data(), static_cast<size_t>(file.gcount()), hash);
+		}
+		return hash;
+	}
+
+	uint64_t IBLCache::makeKey(const std::vector<std::string>& inputFiles, const std::vector<uint32_t>& parameters, uint64_t parentKey) const {
+		uint64_t key = hashBytes(&IBLCacheVersion, sizeof(IBLCacheVersion));
+		key = hashBytes(&parentKey, sizeof(parentKey), key);
+		for (const auto& file : inputFiles) {
+			key = hashFile(file, key);
+		}
+		if (!parameters.empty()) {
+			key = hashBytes(parameters.data(), parameters.size() * sizeof(uint32_t), key);
+		}
+		return key;
+	}
+
+	std::string IBLCache::getEntryPath(const std::string& name, uint64_t key) const {
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+		return mCacheDirectory + "/" + name + "_" + hex + ".ktx2";
+	}
+
+	uint32_t IBLCache::getTexelSize(VkFormat format) {
+		// Bytes per texel block: one texel for the uncompressed formats, 4x4 texels for BC6H
+		switch (format) {
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+			return IBLCompressedImageData::getBlockSize(format);
+		default:
+			return 0;
+		}
+	}
+
+	bool IBLCache::loadData(const std::string& name, uint64_t key, IBLImageData& data) const {
+		const std::string path = getEntryPath(name, key);
+		KTX2File file{};
+		if (!readKTX2File(path, file)) {
+			if (!file.mData.empty()) {
+				std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+			}
+			return false;
+		}
+		const KTX2Header& header = file.mHeader;
+		if (header.vkFormat != VK_FORMAT_R32G32B32A32_SFLOAT) {
+			std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+			return false;
+		}
+
+		// Validate every level before using it, a truncated file is a cache miss
+		const uint32_t texelSize = getTexelSize(VK_FORMAT_R32G32B32A32_SFLOAT);
+		IBLImageData result = IBLImageData::create(header.pixelWidth, header.pixelHeight, header.faceCount, header.levelCount);
+		for (uint32_t level = 0; level < header.levelCount; level++) {
+			const uint64_t levelSize = result.mLevels[level].size() * sizeof(float);
+			if (!isLevelValid(file, level, levelSize, texelSize)) {
+				std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+				return false;
+			}
+			std::memcpy(result.mLevels[level].data(), file.mData.data() + file.mLevels[level].byteOffset, levelSize);
+		}
+
+		data = std::move(result);
+		touchEntry(path);
+		std::cout << "IBL cache: loaded " << path << std::endl;
+		return true;
+	}
+
+	bool IBLCache::loadData(const std::string& name, uint64_t key, IBLCompressedImageData& data) const {
+		const std::string path = getEntryPath(name, key);
+		KTX2File file{};
+		if (!readKTX2File(path, file)) {
+			if (!file.mData.empty()) {
+				std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+			}
+			return false;
+		}
+		const KTX2Header& header = file.mHeader;
+		const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+		if (IBLCompressedImageData::getBlockSize(format) == 0) {
+			std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+			return false;
+		}
+
+		IBLCompressedImageData result = IBLCompressedImageData::create(format, header.pixelWidth, header.pixelHeight, header.faceCount, header.levelCount);
+		for (uint32_t level = 0; level < header.levelCount; level++) {
+			const uint64_t levelSize = result.mLevels[level].size();
+			if (!isLevelValid(file, level, levelSize, getTexelSize(format))) {
+				std::cout << "IBL cache: ignoring invalid entry " << path << std::endl;
+				return false;
+			}
+			std::memcpy(result.mLevels[level].data(), file.mData.data() + file.mLevels[level].byteOffset, levelSize);
+		}
+
+		data = std::move(result);
+		touchEntry(path);
+		std::cout << "IBL cache: loaded " << path << std::endl;
+		return true;
+	}
+
+	Wrapper::Image::Ptr IBLCache::load(const std::string& name, uint64_t key) {
+		FF_CPU_ZONE("IBLCache::load");
+		IBLImageData data{};
+		if (!loadData(name, key, data)) {
+			return nullptr;
+		}
+		return upload(data);
+	}
+
+	Wrapper::Image::Ptr IBLCache::upload(const IBLImageData& data) {
+		std::vector<const void*> levelData(data.mMipLevels);
+		std::vector<size_t> levelSizes(data.mMipLevels);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			levelData[level] = data.mLevels[level].data();
+			levelSizes[level] = data.mLevels[level].size() * sizeof(float);
+		}
+		return uploadLevels(VK_FORMAT_R32G32B32A32_SFLOAT, data.mWidth, data.mHeight, data.mFaceCount, levelData, levelSizes);
+	}
+
+	Wrapper::Image::Ptr IBLCache::upload(const IBLCompressedImageData& data) {
+		std::vector<const void*> levelData(data.mMipLevels);
+		std::vector<size_t> levelSizes(data.mMipLevels);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			levelData[level] = data.mLevels[level].data();
+			levelSizes[level] = data.mLevels[level].size();
+		}
+		return uploadLevels(data.mFormat, data.mWidth, data.mHeight, data.mFaceCount, levelData, levelSizes);
+	}
+
+	Wrapper::Image::Ptr IBLCache::uploadLevels(VkFormat format, uint32_t width, uint32_t height, uint32_t faceCount, const std::vector<const void*>& levelData, const std::vector<size_t>& levelSizes) {
+		const uint32_t mipLevels = static_cast<uint32_t>(levelData.size());
+
+		// Levels are packed back to back in the staging buffer, one region per face and level.
+		// Block compressed levels smaller than a block copy the whole mip extent, which the copy rules allow at the image edge.
+		std::vector<VkBufferImageCopy> regions;
+		std::vector<uint8_t> stagingData;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const size_t levelOffset = static_cast<size_t>(alignUp(stagingData.size(), 16));
+			const size_t faceSize = levelSizes[level] / faceCount;
+			for (uint32_t face = 0; face < faceCount; face++) {
+				VkBufferImageCopy region{};
+				region.bufferOffset = levelOffset + face * faceSize;
+				region.bufferRowLength = 0;
+				region.bufferImageHeight = 0;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = face;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+				regions.push_back(region);
+			}
+			stagingData.resize(levelOffset + levelSizes[level]);
+			std::memcpy(stagingData.data() + levelOffset, levelData[level], levelSizes[level]);
+		}
+
+		auto image = Wrapper::Image::create(
+			mDevice, width, height,
+			format,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, faceCount == 6, mipLevels);
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = faceCount;
+
+		auto stageBuffer = Wrapper::Buffer::createStageBuffer(mDevice, stagingData.size(), stagingData.data());
+
+		auto commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->copyBufferToImage(stageBuffer->getBuffer(), image->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions);
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		return image;
+	}
+
+	IBLImageData IBLCache::download(const Wrapper::Image::Ptr& image) {
+		FF_CPU_ZONE("IBLCache::download");
+		if (image->getFormat() != VK_FORMAT_R32G32B32A32_SFLOAT || (image->getUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+			throw std::runtime_error("Error: IBL readback needs an RGBA32F image with transfer src usage!");
+		}
+
+		IBLImageData data = IBLImageData::create(image->getWidth(), image->getHeight(), image->getLayerCount(), image->getMipLevels());
+
+		std::vector<VkBufferImageCopy> regions;
+		std::vector<VkDeviceSize> levelOffsets(data.mMipLevels);
+		VkDeviceSize bufferSize = 0;
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			levelOffsets[level] = bufferSize;
+			const VkDeviceSize faceSize = data.getFaceFloatCount(level) * sizeof(float);
+			for (uint32_t face = 0; face < data.mFaceCount; face++) {
+				VkBufferImageCopy region{};
+				region.bufferOffset = bufferSize + face * faceSize;
+				region.bufferRowLength = 0;
+				region.bufferImageHeight = 0;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = face;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { data.getLevelWidth(level), data.getLevelHeight(level), 1 };
+				regions.push_back(region);
+			}
+			bufferSize += faceSize * data.mFaceCount;
+		}
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = data.mMipLevels;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = data.mFaceCount;
+
+		auto readbackBuffer = Wrapper::Buffer::createReadbackBuffer(mDevice, bufferSize);
+
+		auto commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->copyImageToBuffer(image->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer->getBuffer(), regions);
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+
+		std::vector<float> bufferData(static_cast<size_t>(bufferSize / sizeof(float)));
+		readbackBuffer->readBufferByMap(bufferData.data(), bufferSize);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			const auto first = bufferData.begin() + static_cast<std::ptrdiff_t>(levelOffsets[level] / sizeof(float));
+			std::copy(first, first + static_cast<std::ptrdiff_t>(data.mLevels[level].size()), data.mLevels[level].begin());
+		}
+		return data;
+	}
+
+	bool IBLCache::store(const std::string& name, uint64_t key, const Wrapper::Image::Ptr& image) {
+		if (image->getFormat() != VK_FORMAT_R32G32B32A32_SFLOAT || (image->getUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+			std::cout << "IBL cache: can not store " << name << ", unsupported format or usage" << std::endl;
+			return false;
+		}
+		return store(name, key, download(image));
+	}
+
+	bool IBLCache::store(const std::string& name, uint64_t key, const IBLImageData& data) {
+		std::vector<const void*> levelData(data.mMipLevels);
+		std::vector<size_t> levelSizes(data.mMipLevels);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			levelData[level] = data.mLevels[level].data();
+			levelSizes[level] = data.mLevels[level].size() * sizeof(float);
+		}
+		return writeEntry(name, key, VK_FORMAT_R32G32B32A32_SFLOAT, data.mWidth, data.mHeight, data.mFaceCount, levelData, levelSizes);
+	}
+
+	bool IBLCache::store(const std::string& name, uint64_t key, const IBLCompressedImageData& data) {
+		if (IBLCompressedImageData::getBlockSize(data.mFormat) == 0) {
+			std::cout << "IBL cache: can not store " << name << ", unsupported format" << std::endl;
+			return false;
+		}
+		std::vector<const void*> levelData(data.mMipLevels);
+		std::vector<size_t> levelSizes(data.mMipLevels);
+		for (uint32_t level = 0; level < data.mMipLevels; level++) {
+			levelData[level] = data.mLevels[level].data();
+			levelSizes[level] = data.mLevels[level].size();
+		}
+		return writeEntry(name, key, data.mFormat, data.mWidth, data.mHeight, data.mFaceCount, levelData, levelSizes);
+	}
+
+	bool IBLCache::writeEntry(const std::string& name, uint64_t key, VkFormat format, uint32_t width, uint32_t height, uint32_t faceCount, const std::vector<const void*>& levelData, const std::vector<size_t>& levelSizes) {
+		FF_CPU_ZONE("IBLCache::writeEntry");
+		const uint32_t texelSize = getTexelSize(format);
+		const uint32_t levelCount = static_cast<uint32_t>(levelData.size());
+		const std::vector<uint32_t> dfd = buildDataFormatDescriptor(format);
+
+		KTX2Header header{};
+		std::memcpy(header.identifier, KTX2Identifier, sizeof(KTX2Identifier));
+		header.vkFormat = static_cast<uint32_t>(format);
+		header.typeSize = format == VK_FORMAT_BC6H_UFLOAT_BLOCK ? 1 : 4; // block compressed formats use 1
+		header.pixelWidth = width;
+		header.pixelHeight = height;
+		header.pixelDepth = 0;
+		header.layerCount = 0;
+		header.faceCount = faceCount;
+		header.levelCount = levelCount;
+		header.supercompressionScheme = 0;
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(KTX2Header) + levelCount * sizeof(KTX2LevelIndex));
+		header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+		// KTX2 stores the smallest mip first, each level aligned to lcm(texel block size, 4), every cached format is a multiple of 4
+		std::vector<KTX2LevelIndex> levels(levelCount);
+		uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+		for (int level = static_cast<int>(levelCount) - 1; level >= 0; level--) {
+			offset = alignUp(offset, texelSize);
+			levels[level].byteOffset = offset;
+			levels[level].byteLength = levelSizes[level];
+			levels[level].uncompressedByteLength = levels[level].byteLength;
+			offset += levels[level].byteLength;
+		}
+		const uint64_t fileSize = offset;
+
+		std::vector<char> fileData(static_cast<size_t>(fileSize), 0);
+		std::memcpy(fileData.data(), &header, sizeof(header));
+		std::memcpy(fileData.data() + sizeof(header), levels.data(), levels.size() * sizeof(KTX2LevelIndex));
+		std::memcpy(fileData.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+		for (uint32_t level = 0; level < levelCount; level++) {
+			std::memcpy(fileData.data() + levels[level].byteOffset, levelData[level], levels[level].byteLength);
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(mCacheDirectory, ec);
+
+		// Write through a temporary file so a crash never leaves a torn entry
+		const std::string path = getEntryPath(name, key);
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				std::cout << "IBL cache: failed to write " << tempPath << std::endl;
+				return false;
+			}
+			file.write(fileData.data(), fileData.size());
+			if (!file) {
+				std::cout << "IBL cache: failed to write " << tempPath << std::endl;
+				return false;
+			}
+		}
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			std::cout << "IBL cache: failed to write " << path << std::endl;
+			return false;
+		}
+
+		std::cout << "IBL cache: stored " << path << std::endl;
+		evictEntries(path);
+		return true;
+	}
+
+	void IBLCache::touchEntry(const std::string& path) const {
+		std::error_code ec;
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+	}
+
+	void IBLCache::evictEntries(const std::string& keepPath) {
+		struct Entry {
+			std::filesystem::path mPath;
+			uint64_t mSize{ 0 };
+			std::filesystem::file_time_type mLastUse{};
+		};
+
+		std::error_code ec;
+		std::vector<Entry> entries;
+		uint64_t totalSize = 0;
+		for (const auto& entry : std::filesystem::directory_iterator(mCacheDirectory, ec)) {
+			if (!entry.is_regular_file(ec) || entry.path().extension() != ".ktx2") {
+				continue;
+			}
+			Entry cached{};
+			cached.mPath = entry.path();
+			cached.mSize = entry.file_size(ec);
+			cached.mLastUse = entry.last_write_time(ec);
+			totalSize += cached.mSize;
+			entries.push_back(cached);
+		}
+		if (totalSize <= mMaxCacheBytes) {
+			return;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.mLastUse < b.mLastUse; });
+		const std::filesystem::path kept(keepPath);
+		for (const auto& entry : entries) {
+			if (totalSize <= mMaxCacheBytes) {
+				break;
+			}
+			if (std::filesystem::equivalent(entry.mPath, kept, ec)) {
+				continue;
+			}
+			if (std::filesystem::remove(entry.mPath, ec)) {
+				totalSize -= entry.mSize;
+				std::cout << "IBL cache: evicted " << entry.mPath.string() << std::endl;
+			}
+		}
+	}
+}
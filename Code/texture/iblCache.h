@@ -0,0 +1,86 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/buffer.h"
+#include "iblImageData.h"
+
+namespace FF {
+	/*
+	* On-disk cache for baked IBL resources (environment cubemap, irradiance, prefiltered specular, BRDF LUT).
+	* Each entry is a KTX2 file holding every face and mip level, named <name>_<key>.ktx2, where the key hashes
+	* the bake inputs: source file content, resolutions, sample counts and the SPIR-V of the capture shaders.
+	* Entries are RGBA32F, or BC6H / B10G11R11 for the compressed copies written by HDRCompressor.
+	* The directory is bounded by size: loads refresh the write time of an entry, stores evict the least recently used ones.
+	*/
+	class IBLCache {
+	public:
+		using Ptr = std::shared_ptr<IBLCache>;
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& cacheDirectory = "cache/ibl", uint64_t maxCacheBytes = DefaultMaxCacheBytes) {
+			return std::make_shared<IBLCache>(device, commandPool, cacheDirectory, maxCacheBytes);
+		}
+
+		// Room for every variant of a few environments (HDRs, filtered / brute force prefilter, SH / map irradiance...)
+		static constexpr uint64_t DefaultMaxCacheBytes = 1024ull * 1024ull * 1024ull;
+
+		IBLCache(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& cacheDirectory, uint64_t maxCacheBytes);
+		~IBLCache();
+
+		// 64 bit FNV-1a
+		static uint64_t hashBytes(const void* pData, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+		static uint64_t hashFile(const std::string& filePath, uint64_t seed = 0xcbf29ce484222325ull);
+
+		/// @brief Build a cache key from the content of the input files and the bake parameters.
+		/// @param inputFiles source image and shader binaries, hashed by content so renaming a file keeps the entry valid.
+		/// @param parameters resolutions, mip counts, sample counts...
+		/// @param parentKey key of the resource this one is baked from, 0 if it has none.
+		[[nodiscard]] uint64_t makeKey(const std::vector<std::string>& inputFiles, const std::vector<uint32_t>& parameters, uint64_t parentKey = 0) const;
+
+		/// @brief Load a cached image, all faces and mips are uploaded and the image is left in SHADER_READ_ONLY layout.
+		/// @return nullptr when there is no valid entry for this key.
+		Wrapper::Image::Ptr load(const std::string& name, uint64_t key);
+
+		/// @brief Read a cached entry without touching the gpu, works with a null device.
+		bool loadData(const std::string& name, uint64_t key, IBLImageData& data) const;
+		// Same for BC6H / B10G11R11 entries, fails on RGBA32F ones
+		bool loadData(const std::string& name, uint64_t key, IBLCompressedImageData& data) const;
+
+		/// @brief Read a baked image back from the gpu and write it to the cache, evicting the least recently used entries past the size budget.
+		/// The image must be in SHADER_READ_ONLY layout and have been created with TRANSFER_SRC usage.
+		bool store(const std::string& name, uint64_t key, const Wrapper::Image::Ptr& image);
+
+		/// @brief Write cpu baked data to the cache, works with a null device (offline bakes on machines without a gpu).
+		bool store(const std::string& name, uint64_t key, const IBLImageData& data);
+		bool store(const std::string& name, uint64_t key, const IBLCompressedImageData& data);
+
+		// Upload to a sampled RGBA32F image left in SHADER_READ_ONLY layout
+		Wrapper::Image::Ptr upload(const IBLImageData& data);
+		// Same with the format of the compressed data, the device must support sampling it
+		Wrapper::Image::Ptr upload(const IBLCompressedImageData& data);
+
+		// Read every face and mip of an RGBA32F image back from the gpu
+		IBLImageData download(const Wrapper::Image::Ptr& image);
+
+		[[nodiscard]] std::string getEntryPath(const std::string& name, uint64_t key) const;
+
+	private:
+		static uint32_t getTexelSize(VkFormat format);
+
+		// Levels hold their faces back to back, the same layout for every format
+		Wrapper::Image::Ptr uploadLevels(VkFormat format, uint32_t width, uint32_t height, uint32_t faceCount, const std::vector<const void*>& levelData, const std::vector<size_t>& levelSizes);
+		bool writeEntry(const std::string& name, uint64_t key, VkFormat format, uint32_t width, uint32_t height, uint32_t faceCount, const std::vector<const void*>& levelData, const std::vector<size_t>& levelSizes);
+
+		// Mark an entry as used now, the write time is the LRU stamp
+		void touchEntry(const std::string& path) const;
+		// Remove the oldest entries until the directory fits in mMaxCacheBytes, never the one just written
+		void evictEntries(const std::string& keepPath);
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		std::string mCacheDirectory;
+		uint64_t mMaxCacheBytes{ DefaultMaxCacheBytes };
+	};
+}
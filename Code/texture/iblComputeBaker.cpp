@@ -0,0 +1,283 @@
+#include "iblComputeBaker.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+#include "HDRI.h"
+
+namespace FF {
+	IBLComputeBaker::IBLComputeBaker(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool)
+		: mDevice(device), mCommandPool(commandPool) {
+		mCubeSampler = Wrapper::Sampler::create(mDevice, true);
+	}
+
+	IBLComputeBaker::~IBLComputeBaker() {
+		mKernels.clear();
+		mCubeSampler.reset();
+		mCommandPool.reset();
+		mDevice.reset();
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::equirectToCubeMap(const std::string& filePath, uint32_t faceSize, const std::string& shaderPath) {
+		// Longitude wraps around, so the equirect is sampled with repeat addressing
+		Texture::Ptr hdriTexture = Texture::createHDRITexture(mDevice, mCommandPool, filePath);
+		Texture::Ptr source = Texture::createFromImage(mDevice, hdriTexture->getImage(), Wrapper::Sampler::create(mDevice, false, true));
+
+		Wrapper::Image::Ptr cubeMap = createStorageImage(faceSize, faceSize, Wrapper::Image::getMaxMipLevels(faceSize, faceSize), true);
+		dispatchPerMip(cubeMap, source, shaderPath, {});
+		return cubeMap;
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::generateDiffuseIrradianceMap(const Wrapper::Image::Ptr& environmentCubeMap, uint32_t faceSize, const std::string& shaderPath) {
+		Texture::Ptr source = Texture::createFromImage(mDevice, environmentCubeMap, mCubeSampler);
+
+		Wrapper::Image::Ptr irradianceMap = createStorageImage(faceSize, faceSize, 1, true);
+		dispatchPerMip(irradianceMap, source, shaderPath, {});
+		return irradianceMap;
+	}
+
+	std::vector<IBLComputeBaker::MipConstants> IBLComputeBaker::buildPrefilterConstants(uint32_t mipLevels, bool filteredSampling) const {
+		std::vector<MipConstants> mipConstants(mipLevels);
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			mipConstants[mipLevel].mRoughness = mipLevels > 1 ? static_cast<float>(mipLevel) / static_cast<float>(mipLevels - 1) : 0.0f;
+			mipConstants[mipLevel].mSampleCount = filteredSampling ? HDRI::FilteredPrefilterSampleCount : HDRI::SpecularPrefilterSampleCount;
+			mipConstants[mipLevel].mFilteredSampling = filteredSampling ? 1 : 0;
+		}
+		return mipConstants;
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::generateSpecularPrefilterMap(const Wrapper::Image::Ptr& environmentCubeMap, uint32_t faceSize, uint32_t mipLevels, bool filteredSampling, const std::string& shaderPath) {
+		Texture::Ptr source = Texture::createFromImage(mDevice, environmentCubeMap, mCubeSampler);
+
+		Wrapper::Image::Ptr prefilterMap = createStorageImage(faceSize, faceSize, mipLevels, true);
+		dispatchPerMip(prefilterMap, source, shaderPath, buildPrefilterConstants(mipLevels, filteredSampling));
+		return prefilterMap;
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::recordSpecularPrefilterMap(
+		const Wrapper::CommandBuffer::Ptr& commandBuffer,
+		Dispatch& dispatch,
+		const Wrapper::Image::Ptr& environmentCubeMap,
+		uint32_t faceSize,
+		uint32_t mipLevels,
+		bool filteredSampling,
+		const std::string& shaderPath) {
+		Texture::Ptr source = Texture::createFromImage(mDevice, environmentCubeMap, mCubeSampler);
+
+		Wrapper::Image::Ptr prefilterMap = createStorageImage(faceSize, faceSize, mipLevels, true);
+		dispatch = recordPerMip(commandBuffer, prefilterMap, source, shaderPath, buildPrefilterConstants(mipLevels, filteredSampling), false);
+		return prefilterMap;
+	}
+
+	void IBLComputeBaker::releaseDispatch(Dispatch& dispatch) {
+		dispatch.mDescriptorSet.reset();
+		dispatch.mDescriptorPool.reset();
+		for (auto& view : dispatch.mMipViews) {
+			vkDestroyImageView(mDevice->getDevice(), view, nullptr);
+		}
+		dispatch.mMipViews.clear();
+		dispatch.mSource.reset();
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::generateBRDFLUT(uint32_t size, const std::string& shaderPath) {
+		Wrapper::Image::Ptr brdfLUT = createStorageImage(size, size, 1, false);
+		dispatchPerMip(brdfLUT, nullptr, shaderPath, {});
+		return brdfLUT;
+	}
+
+	Wrapper::Image::Ptr IBLComputeBaker::createStorageImage(uint32_t width, uint32_t height, uint32_t mipLevels, bool isCubeMap) {
+		// Written as a storage image, then sampled (and read back by the IBL cache), blitted for mipmaps
+		return Wrapper::Image::create(
+			mDevice, width, height,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, isCubeMap, mipLevels);
+	}
+
+	const IBLComputeBaker::Kernel& IBLComputeBaker::getKernel(const std::string& shaderPath, bool hasSource, bool hasConstants) {
+		auto found = mKernels.find(shaderPath);
+		if (found != mKernels.end()) {
+			return found->second;
+		}
+
+		std::vector<Wrapper::UniformParameter::Ptr> params{};
+		if (hasSource) {
+			auto sourceParam = Wrapper::UniformParameter::create();
+			sourceParam->mBinding = 0;
+			sourceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			sourceParam->mCount = 1;
+			sourceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			params.push_back(sourceParam);
+		}
+		auto targetParam = Wrapper::UniformParameter::create();
+		targetParam->mBinding = 1;
+		targetParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		targetParam->mCount = 1;
+		targetParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		params.push_back(targetParam);
+
+		Kernel kernel{};
+		kernel.mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		kernel.mDescriptorLayout->build(params);
+
+		VkDescriptorSetLayout setLayout = kernel.mDescriptorLayout->getLayout();
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(MipConstants);
+
+		kernel.mPipeline = Wrapper::ComputePipeline::create(mDevice);
+		kernel.mPipeline->setShader(Wrapper::Shader::create(mDevice, shaderPath, VK_SHADER_STAGE_COMPUTE_BIT, "main"));
+		kernel.mPipeline->mPipelineLayoutInfo.setLayoutCount = 1;
+		kernel.mPipeline->mPipelineLayoutInfo.pSetLayouts = &setLayout;
+		kernel.mPipeline->mPipelineLayoutInfo.pushConstantRangeCount = hasConstants ? 1 : 0;
+		kernel.mPipeline->mPipelineLayoutInfo.pPushConstantRanges = hasConstants ? &pushConstantRange : nullptr;
+		kernel.mPipeline->build();
+		return mKernels.emplace(shaderPath, kernel).first->second;
+	}
+
+	void IBLComputeBaker::dispatchPerMip(
+		const Wrapper::Image::Ptr& target,
+		const Texture::Ptr& source,
+		const std::string& shaderPath,
+		const std::vector<MipConstants>& mipConstants) {
+		FF_CPU_ZONE("IBLComputeBaker::dispatchPerMip");
+
+		Wrapper::CommandBuffer::Ptr commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		if (mProfiler != nullptr) {
+			mProfiler->beginFrame(commandBuffer, mProfilerSlot);
+		}
+		Dispatch dispatch = recordPerMip(commandBuffer, target, source, shaderPath, mipConstants, true);
+
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		if (mProfiler != nullptr) {
+			mProfiler->collect(mProfilerSlot);
+		}
+		releaseDispatch(dispatch);
+	}
+
+	IBLComputeBaker::Dispatch IBLComputeBaker::recordPerMip(
+		const Wrapper::CommandBuffer::Ptr& commandBuffer,
+		const Wrapper::Image::Ptr& target,
+		const Texture::Ptr& source,
+		const std::string& shaderPath,
+		const std::vector<MipConstants>& mipConstants,
+		bool profile) {
+		const uint32_t mipLevels = mipConstants.empty() ? 1 : target->getMipLevels();
+		const uint32_t layerCount = target->getLayerCount();
+		const Kernel& kernel = getKernel(shaderPath, source != nullptr, !mipConstants.empty());
+
+		Dispatch dispatch{};
+		dispatch.mSource = source;
+
+		// One storage view per mip, a 2D array over the faces for cubemaps
+		dispatch.mMipViews.assign(mipLevels, VK_NULL_HANDLE);
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = target->getImage();
+			viewInfo.viewType = target->isCubeMap() ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = target->getFormat();
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = mipLevel;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = layerCount;
+			if (vkCreateImageView(mDevice->getDevice(), &viewInfo, nullptr, &dispatch.mMipViews[mipLevel]) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to create IBL bake storage image view!");
+			}
+		}
+
+		// One descriptor set per mip: same source, different storage view
+		std::vector<Wrapper::UniformParameter::Ptr> params{};
+		if (source != nullptr) {
+			auto sourceParam = Wrapper::UniformParameter::create();
+			sourceParam->mBinding = 0;
+			sourceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			sourceParam->mCount = 1;
+			sourceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			sourceParam->mTextures.resize(mipLevels);
+			for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+				sourceParam->mTextures[mipLevel].push_back(source);
+			}
+			params.push_back(sourceParam);
+		}
+		auto targetParam = Wrapper::UniformParameter::create();
+		targetParam->mBinding = 1;
+		targetParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		targetParam->mCount = 1;
+		targetParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			VkDescriptorImageInfo storageInfo{};
+			storageInfo.imageView = dispatch.mMipViews[mipLevel];
+			storageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			targetParam->mStorageImageInfos.push_back(storageInfo);
+		}
+		params.push_back(targetParam);
+
+		dispatch.mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		dispatch.mDescriptorPool->build(params, static_cast<int>(mipLevels));
+		dispatch.mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, params, kernel.mDescriptorLayout, dispatch.mDescriptorPool, static_cast<int>(mipLevels));
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = layerCount;
+
+		target->setImageLayout(
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			subresourceRange,
+			mCommandPool,
+			commandBuffer);
+
+		// Zones are named after the kernel, "shaders/SpecularPrefilterComp.spv" is measured as SpecularPrefilterComp
+		const Wrapper::GPUProfiler::Ptr profiler = profile ? mProfiler : nullptr;
+		std::string kernelName = shaderPath.substr(shaderPath.find_last_of("/\\") + 1);
+		kernelName = kernelName.substr(0, kernelName.find_last_of('.'));
+		const uint32_t kernelZone = profiler != nullptr ? profiler->beginZone(commandBuffer, kernelName, true) : Wrapper::GPUProfiler::InvalidZone;
+
+		const Wrapper::ComputePipeline::Ptr& pipeline = kernel.mPipeline;
+		commandBuffer->bindComputePipeline(pipeline);
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			Wrapper::GPUZone mipZone(profiler, commandBuffer, kernelName + " mip " + std::to_string(mipLevel));
+			// Mips are disjoint subresources and nothing reads the target here, so no barrier between dispatches
+			VkDescriptorSet mipSet = dispatch.mDescriptorSet->getDescriptorSet(static_cast<int>(mipLevel));
+			commandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, 1, &mipSet, VK_PIPELINE_BIND_POINT_COMPUTE);
+			if (!mipConstants.empty()) {
+				MipConstants pushValue = mipConstants[mipLevel];
+				commandBuffer->pushConstants(pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MipConstants), &pushValue);
+			}
+			const uint32_t mipWidth = std::max(1u, target->getWidth() >> mipLevel);
+			const uint32_t mipHeight = std::max(1u, target->getHeight() >> mipLevel);
+			commandBuffer->dispatch(
+				(mipWidth + WorkGroupSize - 1) / WorkGroupSize,
+				(mipHeight + WorkGroupSize - 1) / WorkGroupSize,
+				layerCount);
+		}
+		if (profiler != nullptr) {
+			profiler->endZone(commandBuffer, kernelZone);
+		}
+
+		if (mipLevels < target->getMipLevels()) {
+			target->generateMipmaps(mCommandPool, commandBuffer);
+		}
+		else {
+			target->setImageLayout(
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				subresourceRange,
+				mCommandPool,
+				commandBuffer);
+		}
+		return dispatch;
+	}
+}
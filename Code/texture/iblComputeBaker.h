@@ -0,0 +1,132 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/computePipeline.h"
+#include "../vulkanWrapper/shader.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/sampler.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "../vulkanWrapper/gpuProfiler.h"
+#include "texture.h"
+
+namespace FF {
+	/*
+	* Bakes the IBL resources with compute shaders that write storage images directly.
+	* No render pass, depth, MSAA resolve, capture mesh or copy: every bake is one submission with one dispatch per mip,
+	* covering all six faces through gl_GlobalInvocationID.z.
+	* Kernels bind the source at set 0 binding 0 (combined image sampler) and the target mip at binding 1 (storage image).
+	*/
+	class IBLComputeBaker {
+	public:
+		using Ptr = std::shared_ptr<IBLComputeBaker>;
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool) {
+			return std::make_shared<IBLComputeBaker>(device, commandPool);
+		}
+
+		// Matches local_size_x/y of the bake kernels
+		static constexpr uint32_t WorkGroupSize = 8;
+
+		// Push constants of one mip dispatch, layout of PushConstants in SpecularPrefilter.comp
+		struct MipConstants {
+			float mRoughness{ 0.0f };
+			uint32_t mSampleCount{ 0 };
+			uint32_t mFilteredSampling{ 0 };
+		};
+
+		IBLComputeBaker(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool);
+		~IBLComputeBaker();
+
+		// The cubemap gets a full mip chain, downsampled from mip 0, for filtered importance sampling
+		Wrapper::Image::Ptr equirectToCubeMap(
+			const std::string& filePath,
+			uint32_t faceSize,
+			const std::string& shaderPath = "shaders/EquirectToCubeComp.spv");
+
+		Wrapper::Image::Ptr generateDiffuseIrradianceMap(
+			const Wrapper::Image::Ptr& environmentCubeMap,
+			uint32_t faceSize,
+			const std::string& shaderPath = "shaders/DiffuseIrradianceComp.spv");
+
+		// Roughness goes from 0 at mip 0 to 1 at the last mip, like the raster prefilter
+		// filteredSampling reads the environment mip chain with HDRI::FilteredPrefilterSampleCount samples instead of 1024 base level fetches
+		Wrapper::Image::Ptr generateSpecularPrefilterMap(
+			const Wrapper::Image::Ptr& environmentCubeMap,
+			uint32_t faceSize,
+			uint32_t mipLevels,
+			bool filteredSampling = true,
+			const std::string& shaderPath = "shaders/SpecularPrefilterComp.spv");
+
+		Wrapper::Image::Ptr generateBRDFLUT(
+			uint32_t size,
+			const std::string& shaderPath = "shaders/BRDFLUTComp.spv");
+
+		// Views and descriptors of a recorded bake, alive until the submission that recorded it has completed
+		struct Dispatch {
+			Texture::Ptr mSource{ nullptr };
+			std::vector<VkImageView> mMipViews{};
+			Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+			Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+		};
+
+		/// @brief generateSpecularPrefilterMap recorded into commandBuffer instead of submitted, for bakes spread over frames.
+		/// The returned map is in SHADER_READ_ONLY layout once the commands ran, then releaseDispatch frees dispatch.
+		Wrapper::Image::Ptr recordSpecularPrefilterMap(
+			const Wrapper::CommandBuffer::Ptr& commandBuffer,
+			Dispatch& dispatch,
+			const Wrapper::Image::Ptr& environmentCubeMap,
+			uint32_t faceSize,
+			uint32_t mipLevels,
+			bool filteredSampling = true,
+			const std::string& shaderPath = "shaders/SpecularPrefilterComp.spv");
+
+		void releaseDispatch(Dispatch& dispatch);
+
+		// Every bake is measured in slot of profiler, one zone per kernel with a zone per mip inside. The slot must not be used by a frame in flight
+		void setProfiler(const Wrapper::GPUProfiler::Ptr& profiler, uint32_t slot) {
+			mProfiler = profiler;
+			mProfilerSlot = slot;
+		}
+
+	private:
+		// Pipeline of one kernel, built the first time it runs
+		struct Kernel {
+			Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+			Wrapper::ComputePipeline::Ptr mPipeline{ nullptr };
+		};
+
+		Wrapper::Image::Ptr createStorageImage(uint32_t width, uint32_t height, uint32_t mipLevels, bool isCubeMap);
+		std::vector<MipConstants> buildPrefilterConstants(uint32_t mipLevels, bool filteredSampling) const;
+		const Kernel& getKernel(const std::string& shaderPath, bool hasSource, bool hasConstants);
+
+		/// @brief Record one dispatch per mip of target into a single command buffer, submit and wait.
+		/// @param source sampled at binding 0, nullptr for kernels without input.
+		/// @param mipConstants pushed at offset 0 for each mip. When empty only mip 0 is dispatched and the rest of the chain is blitted down from it.
+		void dispatchPerMip(
+			const Wrapper::Image::Ptr& target,
+			const Texture::Ptr& source,
+			const std::string& shaderPath,
+			const std::vector<MipConstants>& mipConstants);
+
+		// The commands of dispatchPerMip, with the profiler zones when profile is set
+		Dispatch recordPerMip(
+			const Wrapper::CommandBuffer::Ptr& commandBuffer,
+			const Wrapper::Image::Ptr& target,
+			const Texture::Ptr& source,
+			const std::string& shaderPath,
+			const std::vector<MipConstants>& mipConstants,
+			bool profile);
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		Wrapper::Sampler::Ptr mCubeSampler{ nullptr };
+		Wrapper::GPUProfiler::Ptr mProfiler{ nullptr };
+		uint32_t mProfilerSlot{ 0 };
+		std::map<std::string, Kernel> mKernels{};
+	};
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include "../base.h"
+
+namespace FF {
+	/*
+	* CPU side copy of a baked IBL image: RGBA32F, 1 face (2D) or 6 faces (cubemap), full or partial mip chain.
+	* Each level holds its faces back to back, the same layout as a KTX2 level and as the gpu readback in IBLCache.
+	*/
+	struct IBLImageData {
+		uint32_t mWidth{ 0 };
+		uint32_t mHeight{ 0 };
+		uint32_t mFaceCount{ 1 };
+		uint32_t mMipLevels{ 1 };
+		std::vector<std::vector<float>> mLevels{};
+
+		static constexpr uint32_t ChannelCount = 4;
+
+		static IBLImageData create(uint32_t width, uint32_t height, uint32_t faceCount, uint32_t mipLevels) {
+			IBLImageData data{};
+			data.mWidth = width;
+			data.mHeight = height;
+			data.mFaceCount = faceCount;
+			data.mMipLevels = mipLevels;
+			data.mLevels.resize(mipLevels);
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				data.mLevels[level].assign(static_cast<size_t>(data.getLevelWidth(level)) * data.getLevelHeight(level) * faceCount * ChannelCount, 0.0f);
+			}
+			return data;
+		}
+
+		[[nodiscard]] uint32_t getLevelWidth(uint32_t level) const { return std::max(1u, mWidth >> level); }
+		[[nodiscard]] uint32_t getLevelHeight(uint32_t level) const { return std::max(1u, mHeight >> level); }
+		[[nodiscard]] size_t getFaceFloatCount(uint32_t level) const { return static_cast<size_t>(getLevelWidth(level)) * getLevelHeight(level) * ChannelCount; }
+		[[nodiscard]] bool isCubeMap() const { return mFaceCount == 6; }
+		[[nodiscard]] bool empty() const { return mLevels.empty(); }
+
+		float* getTexel(uint32_t level, uint32_t face, uint32_t x, uint32_t y) {
+			return mLevels[level].data() + face * getFaceFloatCount(level) + (static_cast<size_t>(y) * getLevelWidth(level) + x) * ChannelCount;
+		}
+		[[nodiscard]] const float* getTexel(uint32_t level, uint32_t face, uint32_t x, uint32_t y) const {
+			return mLevels[level].data() + face * getFaceFloatCount(level) + (static_cast<size_t>(y) * getLevelWidth(level) + x) * ChannelCount;
+		}
+	};
+
+	/*
+	* Block compressed copy of an IBL image, same face and level layout as IBLImageData but raw bytes:
+	* BC6H_UFLOAT (16 byte 4x4 blocks) or B10G11R11_UFLOAT (4 byte texels). Levels smaller than a block still take one block.
+	*/
+	struct IBLCompressedImageData {
+		VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+		uint32_t mWidth{ 0 };
+		uint32_t mHeight{ 0 };
+		uint32_t mFaceCount{ 1 };
+		uint32_t mMipLevels{ 1 };
+		std::vector<std::vector<uint8_t>> mLevels{};
+
+		// 0 for the formats the IBL code does not compress to
+		static uint32_t getBlockSize(VkFormat format) {
+			switch (format) {
+			case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+				return 16;
+			case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+		static uint32_t getBlockExtent(VkFormat format) { return format == VK_FORMAT_BC6H_UFLOAT_BLOCK ? 4 : 1; }
+
+		static IBLCompressedImageData create(VkFormat format, uint32_t width, uint32_t height, uint32_t faceCount, uint32_t mipLevels) {
+			IBLCompressedImageData data{};
+			data.mFormat = format;
+			data.mWidth = width;
+			data.mHeight = height;
+			data.mFaceCount = faceCount;
+			data.mMipLevels = mipLevels;
+			data.mLevels.resize(mipLevels);
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				data.mLevels[level].assign(data.getFaceByteCount(level) * faceCount, 0);
+			}
+			return data;
+		}
+
+		[[nodiscard]] uint32_t getLevelWidth(uint32_t level) const { return std::max(1u, mWidth >> level); }
+		[[nodiscard]] uint32_t getLevelHeight(uint32_t level) const { return std::max(1u, mHeight >> level); }
+		[[nodiscard]] uint32_t getLevelBlocksX(uint32_t level) const { return (getLevelWidth(level) + getBlockExtent(mFormat) - 1) / getBlockExtent(mFormat); }
+		[[nodiscard]] uint32_t getLevelBlocksY(uint32_t level) const { return (getLevelHeight(level) + getBlockExtent(mFormat) - 1) / getBlockExtent(mFormat); }
+		[[nodiscard]] size_t getFaceByteCount(uint32_t level) const { return static_cast<size_t>(getLevelBlocksX(level)) * getLevelBlocksY(level) * getBlockSize(mFormat); }
+		[[nodiscard]] bool isCubeMap() const { return mFaceCount == 6; }
+		[[nodiscard]] bool empty() const { return mLevels.empty(); }
+
+		uint8_t* getBlock(uint32_t level, uint32_t face, uint32_t blockX, uint32_t blockY) {
+			return mLevels[level].data() + face * getFaceByteCount(level) + (static_cast<size_t>(blockY) * getLevelBlocksX(level) + blockX) * getBlockSize(mFormat);
+		}
+	};
+}
@@ -0,0 +1,564 @@
+#include "iblRebaker.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+#include "../stb_image.h"
+
+namespace FF {
+	IBLRebaker::IBLRebaker(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings)
+		: mDevice(device), mCommandPool(commandPool), mSettings(settings) {
+		mEquirectSampler = Wrapper::Sampler::create(mDevice, false, true);
+		mCubeSampler = Wrapper::Sampler::create(mDevice, true);
+
+		// Same bindings as the IBLComputeBaker kernels: source sampler at 0, target storage image at 1
+		auto sourceParam = Wrapper::UniformParameter::create();
+		sourceParam->mBinding = 0;
+		sourceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sourceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		auto targetParam = Wrapper::UniformParameter::create();
+		targetParam->mBinding = 1;
+		targetParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		targetParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build({ sourceParam, targetParam });
+
+		VkDescriptorSetLayout setLayout = mDescriptorLayout->getLayout();
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(IBLComputeBaker::MipConstants);
+
+		auto createPipeline = [&](const std::string& shaderPath, bool hasConstants) {
+			auto pipeline = Wrapper::ComputePipeline::create(mDevice);
+			pipeline->setShader(Wrapper::Shader::create(mDevice, shaderPath, VK_SHADER_STAGE_COMPUTE_BIT, "main"));
+			// Slices offset the workgroup ids to their face and rows
+			pipeline->setCreateFlags(VK_PIPELINE_CREATE_DISPATCH_BASE_BIT);
+			pipeline->mPipelineLayoutInfo.setLayoutCount = 1;
+			pipeline->mPipelineLayoutInfo.pSetLayouts = &setLayout;
+			pipeline->mPipelineLayoutInfo.pushConstantRangeCount = hasConstants ? 1 : 0;
+			pipeline->mPipelineLayoutInfo.pPushConstantRanges = hasConstants ? &pushConstantRange : nullptr;
+			pipeline->build();
+			return pipeline;
+		};
+		mEquirectPipeline = createPipeline("shaders/EquirectToCubeComp.spv", false);
+		if (!mSettings.mSHIrradiance) {
+			mIrradiancePipeline = createPipeline("shaders/DiffuseIrradianceComp.spv", false);
+		}
+		mPrefilterPipeline = createPipeline("shaders/SpecularPrefilterComp.spv", true);
+
+		mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		mFence = Wrapper::Fence::create(mDevice, true);
+
+		mUseTimestamps = mDevice->isTimestampSupported();
+		if (mUseTimestamps) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			if (vkCreateQueryPool(mDevice->getDevice(), &queryPoolInfo, nullptr, &mQueryPool) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to create IBL rebake query pool!");
+			}
+		}
+		mGroupCostMs.assign((static_cast<uint32_t>(SliceType::Compress) + 1) * MaxCostMipLevels, -1.0f);
+	}
+
+	IBLRebaker::~IBLRebaker() {
+		if (mInFlight) {
+			mFence->waitForFence();
+		}
+		if (mLoading.valid()) {
+			mLoading.wait();
+		}
+		dropBake();
+		if (mQueryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(mDevice->getDevice(), mQueryPool, nullptr);
+			mQueryPool = VK_NULL_HANDLE;
+		}
+		mResult.reset();
+		mPendingCubeMap.reset();
+		mCompressor.reset();
+		mCommandBuffer.reset();
+		mFence.reset();
+		mEquirectPipeline.reset();
+		mIrradiancePipeline.reset();
+		mPrefilterPipeline.reset();
+		mDescriptorLayout.reset();
+		mCommandPool.reset();
+		mDevice.reset();
+	}
+
+	void IBLRebaker::requestEnvironment(const std::string& hdrPath) {
+		// Picked up by update once nothing of the previous request is running
+		mPendingPath = hdrPath;
+		mPendingCubeMap.reset();
+	}
+
+	void IBLRebaker::requestCubeMap(const Wrapper::Image::Ptr& environmentCubeMap) {
+		mPendingCubeMap = environmentCubeMap;
+		mPendingPath.clear();
+	}
+
+	float IBLRebaker::getProgress() const {
+		if (mBake == nullptr || mBake->mSlices.empty()) {
+			return mResult != nullptr ? 1.0f : 0.0f;
+		}
+		return static_cast<float>(mBake->mNextSlice) / static_cast<float>(mBake->mSlices.size());
+	}
+
+	IBLRebaker::SourceData IBLRebaker::loadSource(const std::string& hdrPath, bool projectSH) {
+		FF_CPU_ZONE("IBLRebaker::loadSource");
+		// Loader thread: stbi_set_flip_vertically_on_load is global state, the default (no flip) is what every HDR path uses
+		int texWidth = 0, texHeight = 0, texChannels = 0;
+		float* pixels = stbi_loadf(hdrPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels || texWidth <= 0 || texHeight <= 0) {
+			throw std::runtime_error("Error: failed to load image for IBL rebake! Path: " + hdrPath);
+		}
+
+		SourceData source{};
+		source.mPath = hdrPath;
+		source.mWidth = static_cast<uint32_t>(texWidth);
+		source.mHeight = static_cast<uint32_t>(texHeight);
+		source.mPixels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+		stbi_image_free(pixels);
+
+		if (projectSH) {
+			// One thread, the other cores belong to the frame
+			source.mIrradianceSH = SphericalHarmonics::projectEquirectIrradiance(source.mPixels.data(), source.mWidth, source.mHeight, 1);
+		}
+		return source;
+	}
+
+	void IBLRebaker::update() {
+		FF_CPU_ZONE("IBLRebaker::update");
+		if (mInFlight) {
+			if (vkGetFenceStatus(mDevice->getDevice(), mFence->getFence()) != VK_SUCCESS) {
+				return;
+			}
+			mInFlight = false;
+			readTimestamps();
+			if (mBake != nullptr && mBake->mNextSlice == mBake->mSlices.size()) {
+				finishBake();
+			}
+		}
+
+		if (mLoading.valid() && mLoading.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			try {
+				SourceData source = mLoading.get();
+				// A newer request supersedes this one
+				if (mPendingPath.empty() && mPendingCubeMap == nullptr) {
+					startBake(std::move(source));
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << std::endl;
+			}
+		}
+
+		if (!mPendingPath.empty() && !mLoading.valid()) {
+			dropBake();
+			mLoading = std::async(std::launch::async, &IBLRebaker::loadSource, mPendingPath, mSettings.mSHIrradiance);
+			mPendingPath.clear();
+		}
+		// Nothing to decode, the bake starts right away
+		if (mPendingCubeMap != nullptr && !mLoading.valid()) {
+			dropBake();
+			startCubeMapBake(mPendingCubeMap);
+			mPendingCubeMap.reset();
+		}
+
+		if (mBake == nullptr || mBake->mNextSlice == mBake->mSlices.size()) {
+			return;
+		}
+
+		mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		if (mUseTimestamps) {
+			mCommandBuffer->resetQueryPool(mQueryPool, 0, 2);
+			mCommandBuffer->writeTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, 0);
+		}
+
+		// Slices of one kernel and mip per submission, so the measured time belongs to a single cost entry.
+		// Until that entry has been measured a single slice goes out.
+		const Slice& firstSlice = mBake->mSlices[mBake->mNextSlice];
+		const float groupCost = getGroupCost(firstSlice);
+		mSubmittedCostIndex = static_cast<int>(&getGroupCost(firstSlice) - mGroupCostMs.data());
+		mSubmittedGroups = 0;
+		float estimatedMs = 0.0f;
+		uint32_t sliceCount = 0;
+		while (mBake->mNextSlice < mBake->mSlices.size() && sliceCount < mMaxSlicesPerFrame) {
+			const Slice& slice = mBake->mSlices[mBake->mNextSlice];
+			const uint32_t sliceGroups = slice.mGroupCountX * slice.mGroupCountY;
+			if (sliceCount > 0) {
+				if (&getGroupCost(slice) != &mGroupCostMs[mSubmittedCostIndex]) {
+					break;
+				}
+				if (mUseTimestamps && (groupCost < 0.0f || estimatedMs + groupCost * sliceGroups > mFrameBudgetMs)) {
+					break;
+				}
+			}
+			recordSlice(slice);
+			estimatedMs += std::max(groupCost, 0.0f) * sliceGroups;
+			mSubmittedGroups += sliceGroups;
+			sliceCount++;
+			mBake->mNextSlice++;
+		}
+
+		if (mUseTimestamps) {
+			mCommandBuffer->writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, 1);
+		}
+		mCommandBuffer->endCommandBuffer();
+
+		mFence->resetFence();
+		mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue(), mFence->getFence());
+		mInFlight = true;
+	}
+
+	void IBLRebaker::startBake(SourceData&& source) {
+		mBake = std::make_unique<Bake>();
+		mBake->mPath = source.mPath;
+		mBake->mIrradianceSH = source.mIrradianceSH;
+
+		const VkDeviceSize equirectSize = static_cast<VkDeviceSize>(source.mPixels.size()) * sizeof(float);
+		mBake->mStagingBuffer = Wrapper::Buffer::createStageBuffer(mDevice, equirectSize, source.mPixels.data());
+		mBake->mEquirect = Wrapper::Image::create(
+			mDevice, source.mWidth, source.mHeight,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT);
+		mBake->mEquirectTexture = Texture::createFromImage(mDevice, mBake->mEquirect, mEquirectSampler);
+
+		const uint32_t environmentMips = Wrapper::Image::getMaxMipLevels(mSettings.mEnvironmentSize, mSettings.mEnvironmentSize);
+		createKernelTarget(mBake->mEnvironment, createCubeMap(mSettings.mEnvironmentSize, environmentMips), 1, mBake->mEquirectTexture);
+		mBake->mEnvironmentTexture = Texture::createFromImage(mDevice, mBake->mEnvironment.mImage, mCubeSampler);
+
+		auto& slices = mBake->mSlices;
+		slices.push_back({ SliceType::Upload });
+		appendDispatchSlices(slices, SliceType::Environment, mSettings.mEnvironmentSize, 1);
+		slices.push_back({ SliceType::EnvironmentMips });
+		appendFilterSlices();
+	}
+
+	void IBLRebaker::startCubeMapBake(const Wrapper::Image::Ptr& sourceCubeMap) {
+		mBake = std::make_unique<Bake>();
+		mBake->mSourceCubeMap = sourceCubeMap;
+
+		// Copied as it is, no kernel writes the environment
+		mBake->mEnvironment.mImage = createCubeMap(sourceCubeMap->getWidth(), sourceCubeMap->getMipLevels());
+		mBake->mEnvironmentTexture = Texture::createFromImage(mDevice, mBake->mEnvironment.mImage, mCubeSampler);
+
+		if (mSettings.mSHIrradiance) {
+			// A 32x32 mip carries more than the three SH bands need
+			mBake->mReadbackLevel = std::min(2u, sourceCubeMap->getMipLevels() - 1);
+			const VkDeviceSize levelSize = std::max(1u, sourceCubeMap->getWidth() >> mBake->mReadbackLevel);
+			mBake->mReadbackBuffer = Wrapper::Buffer::createReadbackBuffer(mDevice, levelSize * levelSize * 6 * IBLImageData::ChannelCount * sizeof(float));
+		}
+
+		Slice copySlice{};
+		copySlice.mType = SliceType::CubeMapCopy;
+		copySlice.mGroupCountX = 1;
+		copySlice.mGroupCountY = 1;
+		mBake->mSlices.push_back(copySlice);
+		appendFilterSlices();
+	}
+
+	void IBLRebaker::appendFilterSlices() {
+		if (!mSettings.mSHIrradiance) {
+			createKernelTarget(mBake->mIrradiance, createCubeMap(mSettings.mIrradianceSize, 1), 1, mBake->mEnvironmentTexture);
+		}
+		createKernelTarget(mBake->mPrefilter, createCubeMap(mSettings.mPrefilterSize, mSettings.mPrefilterMipLevels), mSettings.mPrefilterMipLevels, mBake->mEnvironmentTexture);
+
+		const uint32_t prefilterMips = mSettings.mPrefilterMipLevels;
+		mBake->mPrefilter.mMipConstants.resize(prefilterMips);
+		for (uint32_t mipLevel = 0; mipLevel < prefilterMips; mipLevel++) {
+			auto& constants = mBake->mPrefilter.mMipConstants[mipLevel];
+			constants.mRoughness = prefilterMips > 1 ? static_cast<float>(mipLevel) / static_cast<float>(prefilterMips - 1) : 0.0f;
+			constants.mSampleCount = mSettings.mFilteredSampling ? HDRI::FilteredPrefilterSampleCount : HDRI::SpecularPrefilterSampleCount;
+			constants.mFilteredSampling = mSettings.mFilteredSampling ? 1 : 0;
+		}
+
+		auto& slices = mBake->mSlices;
+		if (!mSettings.mSHIrradiance) {
+			appendDispatchSlices(slices, SliceType::Irradiance, mSettings.mIrradianceSize, 1);
+		}
+		appendDispatchSlices(slices, SliceType::Prefilter, mSettings.mPrefilterSize, prefilterMips);
+		slices.push_back({ SliceType::Finish });
+
+		// The encodes read whole maps, each one goes out as a single slice after the maps are finished
+		if (mCompressor != nullptr && mCompressor->getFormat() != VK_FORMAT_UNDEFINED) {
+			mBake->mCompressJobs.resize(3);
+			for (uint32_t mapIndex = 0; mapIndex < 3; mapIndex++) {
+				if (mapIndex == 1 && mSettings.mSHIrradiance) {
+					continue;
+				}
+				Slice slice{};
+				slice.mType = SliceType::Compress;
+				slice.mMipLevel = mapIndex;
+				slice.mGroupCountX = 1;
+				slice.mGroupCountY = 1;
+				slices.push_back(slice);
+			}
+		}
+	}
+
+	Wrapper::Image::Ptr IBLRebaker::createCubeMap(uint32_t faceSize, uint32_t mipLevels) const {
+		// Same usage as IBLComputeBaker targets: storage writes, mip blits, sampling and cache readback
+		return Wrapper::Image::create(
+			mDevice, faceSize, faceSize,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, true, mipLevels);
+	}
+
+	void IBLRebaker::dropBake() {
+		if (mBake == nullptr) {
+			return;
+		}
+		destroyKernelTarget(mBake->mEnvironment);
+		destroyKernelTarget(mBake->mIrradiance);
+		destroyKernelTarget(mBake->mPrefilter);
+		mBake.reset();
+	}
+
+	void IBLRebaker::appendDispatchSlices(std::vector<Slice>& slices, SliceType type, uint32_t faceSize, uint32_t mipLevels) const {
+		// One row of workgroups per slice, the smallest unit the budget can stop at
+		const uint32_t groupSize = IBLComputeBaker::WorkGroupSize;
+		for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+			const uint32_t mipSize = std::max(1u, faceSize >> mipLevel);
+			const uint32_t groupCount = (mipSize + groupSize - 1) / groupSize;
+			for (uint32_t face = 0; face < 6; face++) {
+				for (uint32_t groupY = 0; groupY < groupCount; groupY++) {
+					Slice slice{};
+					slice.mType = type;
+					slice.mMipLevel = mipLevel;
+					slice.mFace = face;
+					slice.mGroupY = groupY;
+					slice.mGroupCountY = 1;
+					slice.mGroupCountX = groupCount;
+					slices.push_back(slice);
+				}
+			}
+		}
+	}
+
+	void IBLRebaker::createKernelTarget(KernelTarget& target, const Wrapper::Image::Ptr& image, uint32_t dispatchedMips, const Texture::Ptr& source) {
+		target.mImage = image;
+		target.mMipViews.assign(dispatchedMips, VK_NULL_HANDLE);
+		for (uint32_t mipLevel = 0; mipLevel < dispatchedMips; mipLevel++) {
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image->getImage();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			viewInfo.format = image->getFormat();
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = mipLevel;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = image->getLayerCount();
+			if (vkCreateImageView(mDevice->getDevice(), &viewInfo, nullptr, &target.mMipViews[mipLevel]) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to create IBL rebake storage image view!");
+			}
+		}
+
+		auto sourceParam = Wrapper::UniformParameter::create();
+		sourceParam->mBinding = 0;
+		sourceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sourceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		sourceParam->mTextures.assign(dispatchedMips, { source });
+		auto targetParam = Wrapper::UniformParameter::create();
+		targetParam->mBinding = 1;
+		targetParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		targetParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		for (uint32_t mipLevel = 0; mipLevel < dispatchedMips; mipLevel++) {
+			VkDescriptorImageInfo storageInfo{};
+			storageInfo.imageView = target.mMipViews[mipLevel];
+			storageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			targetParam->mStorageImageInfos.push_back(storageInfo);
+		}
+		const std::vector<Wrapper::UniformParameter::Ptr> params = { sourceParam, targetParam };
+
+		target.mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		target.mDescriptorPool->build(params, static_cast<int>(dispatchedMips));
+		target.mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, params, mDescriptorLayout, target.mDescriptorPool, static_cast<int>(dispatchedMips));
+	}
+
+	void IBLRebaker::destroyKernelTarget(KernelTarget& target) {
+		target.mDescriptorSet.reset();
+		target.mDescriptorPool.reset();
+		for (auto& view : target.mMipViews) {
+			vkDestroyImageView(mDevice->getDevice(), view, nullptr);
+		}
+		target.mMipViews.clear();
+	}
+
+	float& IBLRebaker::getGroupCost(const Slice& slice) {
+		return mGroupCostMs[static_cast<uint32_t>(slice.mType) * MaxCostMipLevels + std::min(slice.mMipLevel, MaxCostMipLevels - 1)];
+	}
+
+	void IBLRebaker::recordSlice(const Slice& slice) {
+		auto fullRange = [](const Wrapper::Image::Ptr& image) {
+			VkImageSubresourceRange subresourceRange{};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = image->getMipLevels();
+			subresourceRange.baseArrayLayer = 0;
+			subresourceRange.layerCount = image->getLayerCount();
+			return subresourceRange;
+		};
+
+		// The images only live in this bake, so every transition starts from the layout tracked by Image
+		switch (slice.mType) {
+		case SliceType::Upload: {
+			auto& equirect = mBake->mEquirect;
+			equirect->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, fullRange(equirect), mCommandPool, mCommandBuffer);
+			mCommandBuffer->copyBufferToImage(mBake->mStagingBuffer->getBuffer(), equirect->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, equirect->getWidth(), equirect->getHeight());
+			equirect->setImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fullRange(equirect), mCommandPool, mCommandBuffer);
+
+			auto& environment = mBake->mEnvironment.mImage;
+			environment->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fullRange(environment), mCommandPool, mCommandBuffer);
+			break;
+		}
+		case SliceType::CubeMapCopy: {
+			auto& source = mBake->mSourceCubeMap;
+			auto& environment = mBake->mEnvironment.mImage;
+			source->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, fullRange(source), mCommandPool, mCommandBuffer);
+			environment->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, fullRange(environment), mCommandPool, mCommandBuffer);
+			std::vector<VkImageCopy> copyRegions;
+			for (uint32_t mipLevel = 0; mipLevel < environment->getMipLevels(); mipLevel++) {
+				const uint32_t mipSize = std::max(1u, environment->getWidth() >> mipLevel);
+				VkImageCopy region{};
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, environment->getLayerCount() };
+				region.dstSubresource = region.srcSubresource;
+				region.extent = { mipSize, mipSize, 1 };
+				copyRegions.push_back(region);
+			}
+			mCommandBuffer->copyImage(source->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, environment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyRegions);
+
+			if (mBake->mReadbackBuffer != nullptr) {
+				const uint32_t levelSize = std::max(1u, source->getWidth() >> mBake->mReadbackLevel);
+				const VkDeviceSize faceSize = static_cast<VkDeviceSize>(levelSize) * levelSize * IBLImageData::ChannelCount * sizeof(float);
+				std::vector<VkBufferImageCopy> readbackRegions;
+				for (uint32_t face = 0; face < 6; face++) {
+					VkBufferImageCopy region{};
+					region.bufferOffset = face * faceSize;
+					region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mBake->mReadbackLevel, face, 1 };
+					region.imageExtent = { levelSize, levelSize, 1 };
+					readbackRegions.push_back(region);
+				}
+				mCommandBuffer->copyImageToBuffer(source->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mBake->mReadbackBuffer->getBuffer(), readbackRegions);
+				mCommandBuffer->memoryBarrier(
+					VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+			}
+
+			// The source goes back to its owner, the copy to the irradiance and prefilter kernels
+			source->setImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, fullRange(source), mCommandPool, mCommandBuffer);
+			environment->setImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fullRange(environment), mCommandPool, mCommandBuffer);
+			for (auto* target : { &mBake->mIrradiance, &mBake->mPrefilter }) {
+				if (target->mImage != nullptr) {
+					target->mImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fullRange(target->mImage), mCommandPool, mCommandBuffer);
+				}
+			}
+			break;
+		}
+		case SliceType::EnvironmentMips: {
+			// Leaves the whole chain in SHADER_READ_ONLY for the irradiance and prefilter kernels
+			mBake->mEnvironment.mImage->generateMipmaps(mCommandPool, mCommandBuffer);
+			for (auto* target : { &mBake->mIrradiance, &mBake->mPrefilter }) {
+				if (target->mImage != nullptr) {
+					target->mImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fullRange(target->mImage), mCommandPool, mCommandBuffer);
+				}
+			}
+			break;
+		}
+		case SliceType::Finish: {
+			for (auto* target : { &mBake->mIrradiance, &mBake->mPrefilter }) {
+				if (target->mImage != nullptr) {
+					target->mImage->setImageLayout(
+						VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						fullRange(target->mImage), mCommandPool, mCommandBuffer);
+				}
+			}
+			break;
+		}
+		case SliceType::Compress: {
+			const Wrapper::Image::Ptr maps[3] = { mBake->mEnvironment.mImage, mBake->mIrradiance.mImage, mBake->mPrefilter.mImage };
+			HDRCompressor::Job& job = mBake->mCompressJobs[slice.mMipLevel];
+			job = mCompressor->createJob(maps[slice.mMipLevel]);
+			mCompressor->recordJob(job, mCommandBuffer);
+			break;
+		}
+		default: {
+			// Rows of one face of one mip; slices write disjoint texels so they need no barrier between them
+			KernelTarget* target = &mBake->mEnvironment;
+			Wrapper::ComputePipeline::Ptr pipeline = mEquirectPipeline;
+			if (slice.mType == SliceType::Irradiance) {
+				target = &mBake->mIrradiance;
+				pipeline = mIrradiancePipeline;
+			}
+			else if (slice.mType == SliceType::Prefilter) {
+				target = &mBake->mPrefilter;
+				pipeline = mPrefilterPipeline;
+			}
+
+			mCommandBuffer->bindComputePipeline(pipeline);
+			VkDescriptorSet mipSet = target->mDescriptorSet->getDescriptorSet(static_cast<int>(slice.mMipLevel));
+			mCommandBuffer->bindDescriptorSets(pipeline->getPipelineLayout(), 0, 1, &mipSet, VK_PIPELINE_BIND_POINT_COMPUTE);
+			if (!target->mMipConstants.empty()) {
+				IBLComputeBaker::MipConstants pushValue = target->mMipConstants[slice.mMipLevel];
+				mCommandBuffer->pushConstants(pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(IBLComputeBaker::MipConstants), &pushValue);
+			}
+			// gl_GlobalInvocationID carries the base offset, so the kernels need no change: z is the face, y the texel row
+			mCommandBuffer->dispatchBase(0, slice.mGroupY, slice.mFace, slice.mGroupCountX, slice.mGroupCountY, 1);
+			break;
+		}
+		}
+	}
+
+	void IBLRebaker::readTimestamps() {
+		if (!mUseTimestamps || mSubmittedCostIndex < 0 || mSubmittedGroups == 0) {
+			return;
+		}
+		uint64_t timestamps[2]{};
+		if (vkGetQueryPoolResults(mDevice->getDevice(), mQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+		const float elapsedMs = static_cast<float>(timestamps[1] - timestamps[0]) * mDevice->getTimestampPeriod() * 1e-6f;
+		const float measuredCost = elapsedMs / static_cast<float>(mSubmittedGroups);
+
+		// Smoothed, a single slow frame should not stall the bake
+		float& groupCost = mGroupCostMs[mSubmittedCostIndex];
+		groupCost = groupCost < 0.0f ? measuredCost : groupCost * 0.75f + measuredCost * 0.25f;
+	}
+
+	void IBLRebaker::finishBake() {
+		FF_CPU_ZONE("IBLRebaker::finishBake");
+		mResult = std::make_unique<Result>();
+		mResult->mSourcePath = mBake->mPath;
+		mResult->mEnvironment = mBake->mEnvironment.mImage;
+		mResult->mDiffuseIrradiance = mBake->mIrradiance.mImage;
+		mResult->mSpecularPrefilter = mBake->mPrefilter.mImage;
+		mResult->mIrradianceSH = mBake->mIrradianceSH;
+		if (mBake->mReadbackBuffer != nullptr) {
+			// A few thousand texels, cheap enough between two frames
+			const uint32_t levelSize = std::max(1u, mBake->mSourceCubeMap->getWidth() >> mBake->mReadbackLevel);
+			IBLImageData data = IBLImageData::create(levelSize, levelSize, 6, 1);
+			mBake->mReadbackBuffer->readBufferByMap(data.mLevels[0].data(), data.mLevels[0].size() * sizeof(float));
+			mResult->mIrradianceSH = SphericalHarmonics::projectCubeMapIrradiance(data);
+		}
+		// The RGBA32F maps go with the bake once their encodes ran
+		if (!mBake->mCompressJobs.empty()) {
+			mResult->mEnvironment = mBake->mCompressJobs[0].mTarget;
+			mResult->mDiffuseIrradiance = mBake->mCompressJobs[1].mTarget;
+			mResult->mSpecularPrefilter = mBake->mCompressJobs[2].mTarget;
+		}
+
+		dropBake();
+	}
+}
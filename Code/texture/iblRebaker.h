@@ -0,0 +1,204 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/computePipeline.h"
+#include "../vulkanWrapper/shader.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/sampler.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/fence.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "iblComputeBaker.h"
+#include "hdrCompressor.h"
+#include "HDRI.h"
+#include "sphericalHarmonics.h"
+#include "texture.h"
+#include <future>
+#include <chrono>
+
+namespace FF {
+	/*
+	* Re-bakes the environment at runtime without stalling the frame: the HDR is decoded (and projected to SH) on a background
+	* thread, then the compute kernels of IBLComputeBaker run in slices of a few workgroup rows of one face and mip, submitted
+	* once per frame after the frame's own work. GPU timestamps measure each slice so the amount of work per frame follows the
+	* frame budget. The previous environment keeps rendering until takeResult hands over the finished maps in one piece.
+	* A bake can also start from a rendered cubemap (the procedural sky): its first slice copies the mip chain and reads
+	* a low mip back for the SH projection, which runs on the cpu when the bake finishes.
+	* With a compressor the finished maps are also encoded in slices, one map per submission, before they are handed over.
+	* The BRDF LUT does not depend on the environment and is not rebaked.
+	*/
+	class IBLRebaker {
+	public:
+		using Ptr = std::shared_ptr<IBLRebaker>;
+
+		struct Settings {
+			uint32_t mEnvironmentSize{ 512 };
+			uint32_t mIrradianceSize{ 32 };
+			uint32_t mPrefilterSize{ 128 };
+			uint32_t mPrefilterMipLevels{ HDRI::SpecularPrefilterMipLevels };
+			bool mFilteredSampling{ true };
+			bool mSHIrradiance{ true }; // project SH9 on the loader thread instead of baking the irradiance cubemap
+		};
+
+		// Finished environment, every image is in SHADER_READ_ONLY layout and in the compressor format when one is set
+		struct Result {
+			std::string mSourcePath;
+			Wrapper::Image::Ptr mEnvironment{ nullptr };
+			Wrapper::Image::Ptr mDiffuseIrradiance{ nullptr }; // nullptr with mSHIrradiance
+			Wrapper::Image::Ptr mSpecularPrefilter{ nullptr };
+			SH9Irradiance mIrradianceSH{};
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings = {}) {
+			return std::make_shared<IBLRebaker>(device, commandPool, settings);
+		}
+
+		IBLRebaker(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings);
+		~IBLRebaker();
+
+		/// @brief Start baking a new environment. A bake already in progress is dropped once its last slice has retired.
+		void requestEnvironment(const std::string& hdrPath);
+		/// @brief Same from an RGBA32F cubemap with its mip chain, in SHADER_READ_ONLY layout once the queue reaches the first slice.
+		/// The bake works on its own copy: environmentCubeMap may be written again once the bake is no longer busy.
+		void requestCubeMap(const Wrapper::Image::Ptr& environmentCubeMap);
+
+		/// @brief Record and submit this frame's slices on the graphics queue, call once per frame after the frame submission.
+		/// Never waits: when the previous slices are still running the frame is skipped.
+		void update();
+
+		// Compress the maps of the next bakes, nullptr (or a device without compressed format) keeps them RGBA32F
+		void setCompressor(const HDRCompressor::Ptr& compressor) { mCompressor = compressor; }
+
+		// GPU time the slices may take per frame
+		void setFrameBudget(float milliseconds) { mFrameBudgetMs = milliseconds; }
+		// Upper bound on the slices per frame, also the fixed amount when the queue has no timestamps
+		void setMaxSlicesPerFrame(uint32_t sliceCount) { mMaxSlicesPerFrame = std::max(1u, sliceCount); }
+
+		[[nodiscard]] bool isBusy() const { return mLoading.valid() || mBake != nullptr || !mPendingPath.empty() || mPendingCubeMap != nullptr; }
+		[[nodiscard]] bool hasResult() const { return mResult != nullptr; }
+		// 0 to 1 over the slices of the current bake
+		[[nodiscard]] float getProgress() const;
+
+		/// @brief Hand over the finished maps, the caller swaps them in and releases the old ones.
+		std::unique_ptr<Result> takeResult() { return std::move(mResult); }
+
+	private:
+		// Decoded on the loader thread
+		struct SourceData {
+			std::string mPath;
+			std::vector<float> mPixels; // RGBA32F
+			uint32_t mWidth{ 0 };
+			uint32_t mHeight{ 0 };
+			SH9Irradiance mIrradianceSH{};
+		};
+
+		enum class SliceType : uint32_t {
+			Upload,            // staging buffer -> equirect image
+			CubeMapCopy,       // source cubemap -> environment, every mip, and the SH mip to the readback buffer
+			Environment,       // equirect -> cubemap mip 0
+			EnvironmentMips,   // blit the environment mip chain
+			Irradiance,
+			Prefilter,
+			Finish,            // final layout transitions
+			Compress           // encode one finished map, mMipLevel is its index in Bake::mCompressJobs
+		};
+
+		// Rows [mGroupY, mGroupY + mGroupCountY) of workgroups of one face of one mip
+		struct Slice {
+			SliceType mType{ SliceType::Upload };
+			uint32_t mMipLevel{ 0 };
+			uint32_t mFace{ 0 };
+			uint32_t mGroupY{ 0 };
+			uint32_t mGroupCountY{ 0 };
+			uint32_t mGroupCountX{ 0 };
+		};
+
+		// One compute kernel writing one target, a descriptor set per mip
+		struct KernelTarget {
+			Wrapper::Image::Ptr mImage{ nullptr };
+			std::vector<VkImageView> mMipViews{};
+			Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+			Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+			std::vector<IBLComputeBaker::MipConstants> mMipConstants{};
+		};
+
+		struct Bake {
+			std::string mPath;
+			SH9Irradiance mIrradianceSH{};
+			Wrapper::Buffer::Ptr mStagingBuffer{ nullptr };
+			Wrapper::Image::Ptr mEquirect{ nullptr };
+			Wrapper::Image::Ptr mSourceCubeMap{ nullptr };
+			// Mip mReadbackLevel of the environment, projected to SH by finishBake with a cubemap source
+			Wrapper::Buffer::Ptr mReadbackBuffer{ nullptr };
+			uint32_t mReadbackLevel{ 0 };
+			Texture::Ptr mEquirectTexture{ nullptr };
+			Texture::Ptr mEnvironmentTexture{ nullptr };
+			KernelTarget mEnvironment{};
+			KernelTarget mIrradiance{};
+			KernelTarget mPrefilter{};
+			// Environment, irradiance and prefilter encodes, kept until the bake is handed over
+			std::vector<HDRCompressor::Job> mCompressJobs{};
+			std::vector<Slice> mSlices{};
+			size_t mNextSlice{ 0 };
+		};
+
+		static SourceData loadSource(const std::string& hdrPath, bool projectSH);
+
+		void startBake(SourceData&& source);
+		void startCubeMapBake(const Wrapper::Image::Ptr& sourceCubeMap);
+		// Irradiance and prefilter targets sampling the environment, their slices, Finish and the encodes
+		void appendFilterSlices();
+		Wrapper::Image::Ptr createCubeMap(uint32_t faceSize, uint32_t mipLevels) const;
+		void dropBake();
+		// Storage views and descriptor sets for the first dispatchedMips mips of image
+		void createKernelTarget(KernelTarget& target, const Wrapper::Image::Ptr& image, uint32_t dispatchedMips, const Texture::Ptr& source);
+		void destroyKernelTarget(KernelTarget& target);
+		void appendDispatchSlices(std::vector<Slice>& slices, SliceType type, uint32_t faceSize, uint32_t mipLevels) const;
+
+		// Cost of one workgroup of this kernel and mip, from the timestamps of earlier slices
+		float& getGroupCost(const Slice& slice);
+		void recordSlice(const Slice& slice);
+		void readTimestamps();
+		void finishBake();
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		Settings mSettings{};
+
+		float mFrameBudgetMs{ 1.0f };
+		uint32_t mMaxSlicesPerFrame{ 64 };
+
+		std::future<SourceData> mLoading{};
+		std::string mPendingPath{};
+		Wrapper::Image::Ptr mPendingCubeMap{ nullptr };
+		std::unique_ptr<Bake> mBake{ nullptr };
+		std::unique_ptr<Result> mResult{ nullptr };
+		HDRCompressor::Ptr mCompressor{ nullptr };
+
+		// Shared by every bake, the per bake descriptor sets use the same layout
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::ComputePipeline::Ptr mEquirectPipeline{ nullptr };
+		Wrapper::ComputePipeline::Ptr mIrradiancePipeline{ nullptr };
+		Wrapper::ComputePipeline::Ptr mPrefilterPipeline{ nullptr };
+		Wrapper::Sampler::Ptr mEquirectSampler{ nullptr };
+		Wrapper::Sampler::Ptr mCubeSampler{ nullptr };
+
+		Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+		Wrapper::Fence::Ptr mFence{ nullptr };
+		bool mInFlight{ false };
+
+		// Two timestamps around the slices of one submission
+		VkQueryPool mQueryPool{ VK_NULL_HANDLE };
+		bool mUseTimestamps{ false };
+		static constexpr uint32_t MaxCostMipLevels = 16;
+		std::vector<float> mGroupCostMs{}; // per slice type and mip, < 0 until measured
+		uint32_t mSubmittedGroups{ 0 };
+		int mSubmittedCostIndex{ -1 };
+	};
+}
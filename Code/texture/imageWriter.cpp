@@ -0,0 +1,185 @@
+#include "imageWriter.h"
+#include <cstring>
+
+namespace FF {
+
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const auto table = []() {
+			std::array<uint32_t, 256> values{};
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				values[n] = c;
+			}
+			return values;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	static void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+		std::vector<uint8_t> chunk{};
+		appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		// The crc covers the type and the data
+		appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+
+	bool ImageWriter::writePNG(const std::string& filePath, uint32_t width, uint32_t height, const uint8_t* pixelsRGBA) {
+		std::ofstream file(filePath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write " << filePath << std::endl;
+			return false;
+		}
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		std::vector<uint8_t> header{};
+		appendBigEndian(header, width);
+		appendBigEndian(header, height);
+		header.push_back(8); // bits per channel
+		header.push_back(6); // RGBA
+		header.push_back(0); // deflate
+		header.push_back(0); // adaptive filtering
+		header.push_back(0); // no interlace
+		writeChunk(file, "IHDR", header);
+
+		// Every row starts with its filter type, 0 (none)
+		const size_t rowSize = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> raw{};
+		raw.reserve((rowSize + 1) * height);
+		for (uint32_t y = 0; y < height; y++) {
+			raw.push_back(0);
+			raw.insert(raw.end(), pixelsRGBA + y * rowSize, pixelsRGBA + (y + 1) * rowSize);
+		}
+
+		// zlib stream of stored blocks of at most 65535 bytes, then the adler32 of the raw data
+		std::vector<uint8_t> compressed{ 0x78, 0x01 };
+		uint32_t adlerA = 1;
+		uint32_t adlerB = 0;
+		for (size_t offset = 0; offset < raw.size() || offset == 0; ) {
+			const uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 65535));
+			const bool last = offset + blockSize == raw.size();
+			compressed.push_back(last ? 1 : 0);
+			compressed.push_back(static_cast<uint8_t>(blockSize));
+			compressed.push_back(static_cast<uint8_t>(blockSize >> 8));
+			const uint16_t invertedSize = static_cast<uint16_t>(~blockSize);
+			compressed.push_back(static_cast<uint8_t>(invertedSize));
+			compressed.push_back(static_cast<uint8_t>(invertedSize >> 8));
+			for (size_t i = offset; i < offset + blockSize; i++) {
+				adlerA = (adlerA + raw[i]) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+			compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			offset += blockSize;
+			if (last) {
+				break;
+			}
+		}
+		appendBigEndian(compressed, (adlerB << 16) | adlerA);
+		writeChunk(file, "IDAT", compressed);
+		writeChunk(file, "IEND", {});
+		return file.good();
+	}
+
+	// EXR is little endian, like every platform this builds for
+	template<typename T>
+	static void appendValue(std::vector<uint8_t>& out, const T& value) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	static void appendAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+		out.insert(out.end(), name, name + std::strlen(name) + 1);
+		out.insert(out.end(), type, type + std::strlen(type) + 1);
+		appendValue(out, static_cast<int32_t>(value.size()));
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	bool ImageWriter::writeEXR(const std::string& filePath, uint32_t width, uint32_t height, const float* pixelsRGBA) {
+		std::ofstream file(filePath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write " << filePath << std::endl;
+			return false;
+		}
+
+		std::vector<uint8_t> header{};
+		appendValue(header, static_cast<int32_t>(20000630)); // magic
+		appendValue(header, static_cast<int32_t>(2)); // version 2, single part scanline
+
+		// Channels are stored sorted by name: A, B, G, R
+		static const char channelNames[4] = { 'A', 'B', 'G', 'R' };
+		static const uint32_t channelSources[4] = { 3, 2, 1, 0 };
+		std::vector<uint8_t> channels{};
+		for (char name : channelNames) {
+			channels.push_back(static_cast<uint8_t>(name));
+			channels.push_back(0);
+			appendValue(channels, static_cast<int32_t>(2)); // FLOAT
+			appendValue(channels, static_cast<int32_t>(0)); // pLinear and reserved
+			appendValue(channels, static_cast<int32_t>(1)); // x sampling
+			appendValue(channels, static_cast<int32_t>(1)); // y sampling
+		}
+		channels.push_back(0);
+		appendAttribute(header, "channels", "chlist", channels);
+		appendAttribute(header, "compression", "compression", { 0 });
+
+		std::vector<uint8_t> window{};
+		appendValue(window, static_cast<int32_t>(0));
+		appendValue(window, static_cast<int32_t>(0));
+		appendValue(window, static_cast<int32_t>(width) - 1);
+		appendValue(window, static_cast<int32_t>(height) - 1);
+		appendAttribute(header, "dataWindow", "box2i", window);
+		appendAttribute(header, "displayWindow", "box2i", window);
+		appendAttribute(header, "lineOrder", "lineOrder", { 0 }); // increasing y
+
+		std::vector<uint8_t> value{};
+		appendValue(value, 1.0f);
+		appendAttribute(header, "pixelAspectRatio", "float", value);
+		value.clear();
+		appendValue(value, 0.0f);
+		appendValue(value, 0.0f);
+		appendAttribute(header, "screenWindowCenter", "v2f", value);
+		value.clear();
+		appendValue(value, 1.0f);
+		appendAttribute(header, "screenWindowWidth", "float", value);
+		header.push_back(0);
+
+		// One scanline per block without compression, the offset table points at each of them
+		const uint32_t lineDataSize = width * 4 * sizeof(float);
+		const uint64_t blockSize = 2 * sizeof(int32_t) + lineDataSize;
+		const uint64_t firstBlock = header.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+		for (uint32_t y = 0; y < height; y++) {
+			appendValue(header, firstBlock + y * blockSize);
+		}
+		file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+		std::vector<uint8_t> line{};
+		line.reserve(blockSize);
+		for (uint32_t y = 0; y < height; y++) {
+			line.clear();
+			appendValue(line, static_cast<int32_t>(y));
+			appendValue(line, static_cast<int32_t>(lineDataSize));
+			for (uint32_t source : channelSources) {
+				for (uint32_t x = 0; x < width; x++) {
+					appendValue(line, pixelsRGBA[(static_cast<size_t>(y) * width + x) * 4 + source]);
+				}
+			}
+			file.write(reinterpret_cast<const char*>(line.data()), line.size());
+		}
+		return file.good();
+	}
+}
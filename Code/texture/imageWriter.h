@@ -0,0 +1,17 @@
+#pragma once
+#include "../base.h"
+
+namespace FF {
+	/*
+	* Minimal image file writers for renderer output, with no dependency beyond the standard library.
+	* PNG is written with stored (uncompressed) deflate blocks, EXR as uncompressed scanlines of 32 bit floats:
+	* both are larger than an encoder would make them, and every viewer reads them.
+	* Rows go top to bottom, pixels are RGBA.
+	*/
+	class ImageWriter {
+	public:
+		static bool writePNG(const std::string& filePath, uint32_t width, uint32_t height, const uint8_t* pixelsRGBA);
+
+		static bool writeEXR(const std::string& filePath, uint32_t width, uint32_t height, const float* pixelsRGBA);
+	};
+}
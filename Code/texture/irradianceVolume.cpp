@@ -0,0 +1,261 @@
+#include "irradianceVolume.h"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+namespace FF {
+	IrradianceVolume::IrradianceVolume(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings)
+		: mDevice(device), mCommandPool(commandPool), mFrameCount(frameCount), mSettings(settings) {
+		if (mSettings.mResolution.x == 0 || mSettings.mResolution.y == 0 || mSettings.mResolution.z == 0) {
+			throw std::runtime_error("Error: irradiance volume resolution must be at least 1 on every axis!");
+		}
+		mSampler = Wrapper::Sampler::create(mDevice);
+
+		// Black 1x1x1 placeholder until the bake, never read while mBoundsMin.w is 0
+		mVolumeImage = createVolumeImage();
+		buildDescriptor();
+	}
+
+	IrradianceVolume::~IrradianceVolume() {
+		mDescriptorSet.reset();
+		mDescriptorPool.reset();
+		mDescriptorLayout.reset();
+		mUniformParameters.clear();
+		mVolumeImage.reset();
+	}
+
+	glm::vec3 IrradianceVolume::getProbePosition(uint32_t x, uint32_t y, uint32_t z) const {
+		const glm::uvec3 resolution = mSettings.mResolution;
+		// A single probe on an axis sits in the middle of the bounds
+		const glm::vec3 t(
+			resolution.x > 1 ? static_cast<float>(x) / (resolution.x - 1) : 0.5f,
+			resolution.y > 1 ? static_cast<float>(y) / (resolution.y - 1) : 0.5f,
+			resolution.z > 1 ? static_cast<float>(z) / (resolution.z - 1) : 0.5f);
+		return glm::mix(mSettings.mBoundsMin, mSettings.mBoundsMax, t);
+	}
+
+	uint64_t IrradianceVolume::makeVolumeKey(const IBLCache::Ptr& cache, const std::vector<ProbeCaptureMesh>& meshes, uint64_t environmentKey) const {
+		std::vector<std::string> inputs = { "shaders/ProbeCaptureVert.spv", "shaders/ProbeCaptureFrag.spv" };
+		std::vector<uint32_t> parameters = {
+			mSettings.mResolution.x, mSettings.mResolution.y, mSettings.mResolution.z, mSettings.mCaptureSize
+		};
+		auto pushFloats = [&parameters](const float* pValues, size_t count) {
+			for (size_t i = 0; i < count; i++) {
+				uint32_t bits = 0;
+				std::memcpy(&bits, &pValues[i], sizeof(bits));
+				parameters.push_back(bits);
+			}
+		};
+
+		pushFloats(&mSettings.mBoundsMin.x, 3);
+		pushFloats(&mSettings.mBoundsMax.x, 3);
+		for (const auto& mesh : meshes) {
+			inputs.push_back(mesh.mSourcePath);
+			pushFloats(&mesh.mModelMatrix[0][0], 16);
+			pushFloats(&mesh.mAlbedo.x, 4);
+		}
+		return cache->makeKey(inputs, parameters, environmentKey);
+	}
+
+	IBLImageData IrradianceVolume::packProbes() const {
+		IBLImageData data = IBLImageData::create(IrradianceVolumeTexelsPerProbe, static_cast<uint32_t>(mProbes.size()), 1, 1);
+		for (size_t probe = 0; probe < mProbes.size(); probe++) {
+			float* pTexels = data.getTexel(0, 0, 0, static_cast<uint32_t>(probe));
+			for (int k = 0; k < 9; k++) {
+				pTexels[k * 3 + 0] = mProbes[probe].mCoefficients[k].r;
+				pTexels[k * 3 + 1] = mProbes[probe].mCoefficients[k].g;
+				pTexels[k * 3 + 2] = mProbes[probe].mCoefficients[k].b;
+			}
+		}
+		return data;
+	}
+
+	void IrradianceVolume::unpackProbes(const IBLImageData& data) {
+		mProbes.assign(data.mHeight, SH9Irradiance{});
+		for (uint32_t probe = 0; probe < data.mHeight; probe++) {
+			const float* pTexels = data.getTexel(0, 0, 0, probe);
+			for (int k = 0; k < 9; k++) {
+				mProbes[probe].mCoefficients[k] = glm::vec4(pTexels[k * 3 + 0], pTexels[k * 3 + 1], pTexels[k * 3 + 2], 0.0f);
+			}
+		}
+	}
+
+	void IrradianceVolume::bake(const Wrapper::Image::Ptr& environmentCubeMap, const std::vector<ProbeCaptureMesh>& meshes, const IBLCache::Ptr& cache, uint64_t environmentKey) {
+		const uint64_t key = makeVolumeKey(cache, meshes, environmentKey);
+
+		IBLImageData cachedData{};
+		if (cache->loadData("irradianceVolume", key, cachedData) &&
+			cachedData.mWidth == IrradianceVolumeTexelsPerProbe && cachedData.mHeight == getProbeCount()) {
+			unpackProbes(cachedData);
+		}
+		else {
+			HDRI::Ptr hdri = HDRI::create(mDevice, mCommandPool);
+			mProbes.clear();
+			for (uint32_t z = 0; z < mSettings.mResolution.z; z++) {
+				for (uint32_t y = 0; y < mSettings.mResolution.y; y++) {
+					for (uint32_t x = 0; x < mSettings.mResolution.x; x++) {
+						Wrapper::Image::Ptr capture = hdri->captureLocalProbe(environmentCubeMap, getProbePosition(x, y, z), meshes, mSettings.mCaptureSize);
+						mProbes.push_back(SphericalHarmonics::projectCubeMapIrradiance(cache->download(capture)));
+					}
+				}
+			}
+			cache->store("irradianceVolume", key, packProbes());
+		}
+
+		mVolumeImage = createVolumeImage();
+		mUniform.mBoundsMin = glm::vec4(mSettings.mBoundsMin, 1.0f);
+		mUniform.mBoundsMax = glm::vec4(mSettings.mBoundsMax, 0.0f);
+		mUniform.mResolution = glm::ivec4(glm::ivec3(mSettings.mResolution), 0);
+		updateBindings();
+	}
+
+	Wrapper::Image::Ptr IrradianceVolume::createVolumeImage() const {
+		Wrapper::Buffer::Ptr stageBuffer{ nullptr };
+		auto commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		auto image = recordVolumeImage(mProbes, commandBuffer, stageBuffer);
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		return image;
+	}
+
+	Wrapper::Image::Ptr IrradianceVolume::recordVolumeImage(const std::vector<SH9Irradiance>& probes, const Wrapper::CommandBuffer::Ptr& commandBuffer, Wrapper::Buffer::Ptr& stageBuffer) const {
+		const glm::uvec3 resolution = !probes.empty() ? mSettings.mResolution : glm::uvec3(1);
+		const uint32_t depth = resolution.z * IrradianceVolumeTexelsPerProbe;
+
+		// Texel (x, y, slab * resolution.z + z) holds floats [4 * slab, 4 * slab + 4) of probe (x, y, z)
+		const size_t probeCount = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+		std::vector<uint16_t> texels(probeCount * IrradianceVolumeTexelsPerProbe * 4, glm::packHalf1x16(0.0f));
+		for (size_t probe = 0; probe < probes.size(); probe++) {
+			float packed[IrradianceVolumeTexelsPerProbe * 4]{};
+			for (int k = 0; k < 9; k++) {
+				packed[k * 3 + 0] = probes[probe].mCoefficients[k].r;
+				packed[k * 3 + 1] = probes[probe].mCoefficients[k].g;
+				packed[k * 3 + 2] = probes[probe].mCoefficients[k].b;
+			}
+			const size_t x = probe % resolution.x;
+			const size_t y = (probe / resolution.x) % resolution.y;
+			const size_t z = probe / (static_cast<size_t>(resolution.x) * resolution.y);
+			for (uint32_t slab = 0; slab < IrradianceVolumeTexelsPerProbe; slab++) {
+				const size_t slice = slab * resolution.z + z;
+				const size_t texel = (slice * resolution.y + y) * resolution.x + x;
+				for (int c = 0; c < 4; c++) {
+					texels[texel * 4 + c] = glm::packHalf1x16(packed[slab * 4 + c]);
+				}
+			}
+		}
+
+		auto image = Wrapper::Image::create(
+			mDevice, resolution.x, resolution.y,
+			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_TYPE_3D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false, 1, 0, depth);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { resolution.x, resolution.y, depth };
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = 1;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = 1;
+
+		stageBuffer = Wrapper::Buffer::createStageBuffer(mDevice, texels.size() * sizeof(uint16_t), texels.data());
+
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		commandBuffer->copyBufferToImage(stageBuffer->getBuffer(), image->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, { region });
+		image->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange,
+			mCommandPool, commandBuffer);
+		return image;
+	}
+
+	void IrradianceVolume::buildDescriptor() {
+		// binding 0: sampler3D U_IrradianceVolume
+		auto volumeParam = Wrapper::UniformParameter::create();
+		volumeParam->mBinding = 0;
+		volumeParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		volumeParam->mCount = 1;
+		volumeParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		volumeParam->mTextures.resize(mFrameCount);
+		for (int i = 0; i < mFrameCount; i++) {
+			volumeParam->mTextures[i].push_back(Texture::createFromImage(mDevice, mVolumeImage, mSampler));
+		}
+		mUniformParameters.push_back(volumeParam);
+
+		// binding 1: uniform IrradianceVolume
+		auto volumeDataParam = Wrapper::UniformParameter::create();
+		volumeDataParam->mBinding = 1;
+		volumeDataParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		volumeDataParam->mCount = 1;
+		volumeDataParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		volumeDataParam->mSize = sizeof(IrradianceVolumeUniform);
+		for (int i = 0; i < mFrameCount; i++) {
+			volumeDataParam->mBuffers.push_back(Wrapper::Buffer::createUniformBuffer(mDevice, volumeDataParam->mSize, &mUniform));
+		}
+		mUniformParameters.push_back(volumeDataParam);
+
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build(mUniformParameters);
+
+		mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		mDescriptorPool->build(mUniformParameters, mFrameCount);
+
+		mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, mUniformParameters, mDescriptorLayout, mDescriptorPool, mFrameCount);
+	}
+
+	void IrradianceVolume::setRebakedProbes(std::vector<SH9Irradiance>&& probes, const Wrapper::Image::Ptr& volumeImage) {
+		// The sets of the frames in flight keep the old image alive until they are rewritten
+		mProbes = std::move(probes);
+		mVolumeImage = volumeImage;
+		mUniform.mBoundsMin = glm::vec4(mSettings.mBoundsMin, 1.0f);
+		mUniform.mBoundsMax = glm::vec4(mSettings.mBoundsMax, 0.0f);
+		mUniform.mResolution = glm::ivec4(glm::ivec3(mSettings.mResolution), 0);
+		mPendingFrames.assign(mFrameCount, true);
+	}
+
+	bool IrradianceVolume::applyPendingBindings(int frameIndex) {
+		if (mPendingFrames.empty() || !mPendingFrames[frameIndex]) {
+			return false;
+		}
+		updateBindings(frameIndex);
+		mPendingFrames[frameIndex] = false;
+		return true;
+	}
+
+	void IrradianceVolume::updateBindings() {
+		// Not update-after-bind: only call this while no frame using the set is in flight
+		for (int i = 0; i < mFrameCount; i++) {
+			updateBindings(i);
+		}
+		mPendingFrames.clear();
+	}
+
+	void IrradianceVolume::updateBindings(int frameIndex) {
+		auto texture = Texture::createFromImage(mDevice, mVolumeImage, mSampler);
+		mUniformParameters[0]->mTextures[frameIndex][0] = texture;
+		mDescriptorSet->updateImage(frameIndex, 0, 0, texture->getImageInfo());
+		mUniformParameters[1]->mBuffers[frameIndex]->updateBufferByMap(&mUniform, sizeof(IrradianceVolumeUniform));
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/sampler.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "HDRI.h"
+#include "iblCache.h"
+#include "sphericalHarmonics.h"
+#include "texture.h"
+
+namespace FF {
+	// 27 SH9 floats (rgb per coefficient) packed in 7 RGBA texels
+	static constexpr uint32_t IrradianceVolumeTexelsPerProbe = 7;
+
+	// Matches the IrradianceVolume block of pbr1.frag (set 3, binding 1)
+	struct IrradianceVolumeUniform {
+		glm::vec4 mBoundsMin{ 0.0f }; // w: 1 once baked, the global irradiance is used until then
+		glm::vec4 mBoundsMax{ 0.0f };
+		glm::ivec4 mResolution{ 1, 1, 1, 0 };
+	};
+
+	/*
+	* Grid of SH9 irradiance probes over a box of the scene, for the diffuse lighting of objects moving through it.
+	* Each probe is a local capture of the scene (HDRI::captureLocalProbe) projected to SH on the cpu.
+	* The coefficients live in one RGBA16F 3D texture: the 7 texels of a probe are 7 slabs stacked along z,
+	* so one trilinear fetch per slab interpolates every coefficient between the 8 surrounding probes.
+	*/
+	class IrradianceVolume {
+	public:
+		using Ptr = std::shared_ptr<IrradianceVolume>;
+
+		struct Settings {
+			glm::uvec3 mResolution{ 4, 2, 4 }; // probes per axis, placed on the bounds and evenly in between
+			glm::vec3 mBoundsMin{ -4.0f, -2.0f, -4.0f };
+			glm::vec3 mBoundsMax{ 4.0f, 2.0f, 4.0f };
+			uint32_t mCaptureSize{ 32 }; // only the low frequencies survive the projection
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings = {}) {
+			return std::make_shared<IrradianceVolume>(device, commandPool, frameCount, settings);
+		}
+
+		IrradianceVolume(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings);
+		~IrradianceVolume();
+
+		/// @brief Capture every probe of the grid and project it to SH, or load the whole grid from the cache.
+		/// @param environmentKey cache key of environmentCubeMap, parent of the volume key.
+		void bake(const Wrapper::Image::Ptr& environmentCubeMap, const std::vector<ProbeCaptureMesh>& meshes, const IBLCache::Ptr& cache, uint64_t environmentKey);
+
+		/// @brief Swap in probes projected elsewhere (LocalLightingRebaker) and their volume image from recordVolumeImage.
+		/// Each frame's set points at them when applyPendingBindings is called for that frame.
+		void setRebakedProbes(std::vector<SH9Irradiance>&& probes, const Wrapper::Image::Ptr& volumeImage);
+		// Rewrite this frame's set if rebaked probes are waiting for it, true when the set changed. The frame must not be in flight
+		bool applyPendingBindings(int frameIndex);
+
+		/// @brief Record the upload of probes to a new 3D texture, left in SHADER_READ_ONLY layout.
+		/// stageBuffer holds the texels and has to live until the commands ran.
+		Wrapper::Image::Ptr recordVolumeImage(const std::vector<SH9Irradiance>& probes, const Wrapper::CommandBuffer::Ptr& commandBuffer, Wrapper::Buffer::Ptr& stageBuffer) const;
+
+		[[nodiscard]] const Settings& getSettings() const { return mSettings; }
+		[[nodiscard]] glm::vec3 getProbePosition(uint32_t x, uint32_t y, uint32_t z) const;
+		[[nodiscard]] uint32_t getProbeCount() const { return mSettings.mResolution.x * mSettings.mResolution.y * mSettings.mResolution.z; }
+		[[nodiscard]] bool isBaked() const { return !mProbes.empty(); }
+		// x fastest, then y, then z
+		[[nodiscard]] const std::vector<SH9Irradiance>& getProbes() const { return mProbes; }
+		[[nodiscard]] Wrapper::Image::Ptr getVolumeImage() const { return mVolumeImage; }
+		[[nodiscard]] Wrapper::DescriptorSetLayout::Ptr getDescriptorLayout() const { return mDescriptorLayout; }
+		[[nodiscard]] VkDescriptorSet getDescriptorSet(int frameIndex) const { return mDescriptorSet->getDescriptorSet(frameIndex); }
+
+	private:
+		uint64_t makeVolumeKey(const IBLCache::Ptr& cache, const std::vector<ProbeCaptureMesh>& meshes, uint64_t environmentKey) const;
+		// Texels in the cache layout: one row of 7 texels per probe
+		IBLImageData packProbes() const;
+		void unpackProbes(const IBLImageData& data);
+		// Upload the probes to a new 3D texture left in SHADER_READ_ONLY layout
+		Wrapper::Image::Ptr createVolumeImage() const;
+		void buildDescriptor();
+		void updateBindings();
+		void updateBindings(int frameIndex);
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		int mFrameCount{ 0 };
+		Settings mSettings{};
+
+		std::vector<SH9Irradiance> mProbes{};
+		Wrapper::Image::Ptr mVolumeImage{ nullptr };
+		Wrapper::Sampler::Ptr mSampler{ nullptr };
+		IrradianceVolumeUniform mUniform{};
+		std::vector<bool> mPendingFrames{}; // frames whose set still points at the previous probes
+
+		std::vector<Wrapper::UniformParameter::Ptr> mUniformParameters{};
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+		Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+	};
+}
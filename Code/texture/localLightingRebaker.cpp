@@ -0,0 +1,251 @@
+#include "localLightingRebaker.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+
+namespace FF {
+	LocalLightingRebaker::LocalLightingRebaker(
+		const Wrapper::Device::Ptr& device,
+		const Wrapper::CommandPool::Ptr& commandPool,
+		const ReflectionProbeSet::Ptr& reflectionProbes,
+		const IrradianceVolume::Ptr& irradianceVolume,
+		const std::vector<ProbeCaptureMesh>& meshes)
+		: mDevice(device), mCommandPool(commandPool), mReflectionProbes(reflectionProbes), mIrradianceVolume(irradianceVolume), mMeshes(meshes) {
+		mHDRI = HDRI::create(mDevice, mCommandPool);
+		mComputeBaker = IBLComputeBaker::create(mDevice, mCommandPool);
+		mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		mFence = Wrapper::Fence::create(mDevice, true);
+	}
+
+	LocalLightingRebaker::~LocalLightingRebaker() {
+		if (mInFlight) {
+			mFence->waitForFence();
+		}
+		dropRebake();
+		mReflectionCaptureState = {};
+		mVolumeCaptureState = {};
+		mReadbackBuffer.reset();
+		mPendingEnvironment.reset();
+		mCommandBuffer.reset();
+		mFence.reset();
+		mComputeBaker.reset();
+		mHDRI.reset();
+		mReflectionProbes.reset();
+		mIrradianceVolume.reset();
+		mCommandPool.reset();
+		mDevice.reset();
+	}
+
+	void LocalLightingRebaker::requestEnvironment(const Wrapper::Image::Ptr& environmentCubeMap) {
+		// Picked up by update once the step in flight has retired
+		mPendingEnvironment = environmentCubeMap;
+	}
+
+	void LocalLightingRebaker::update() {
+		FF_CPU_ZONE("LocalLightingRebaker::update");
+		if (mInFlight) {
+			if (vkGetFenceStatus(mDevice->getDevice(), mFence->getFence()) != VK_SUCCESS) {
+				return;
+			}
+			mInFlight = false;
+			retireStep();
+			if (mRebake != nullptr && mRebake->mNextStep == mRebake->mSteps.size()) {
+				finishRebake();
+			}
+		}
+
+		if (mPendingEnvironment != nullptr) {
+			// A newer environment supersedes the rebake in progress
+			dropRebake();
+			startRebake(mPendingEnvironment);
+			mPendingEnvironment.reset();
+		}
+
+		if (mRebake == nullptr || mRebake->mNextStep == mRebake->mSteps.size()) {
+			return;
+		}
+
+		mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		recordStep(mRebake->mSteps[mRebake->mNextStep]);
+		mCommandBuffer->endCommandBuffer();
+		mRebake->mNextStep++;
+
+		mFence->resetFence();
+		mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue(), mFence->getFence());
+		mInFlight = true;
+	}
+
+	void LocalLightingRebaker::startRebake(const Wrapper::Image::Ptr& environmentCubeMap) {
+		FF_CPU_ZONE("LocalLightingRebaker::startRebake");
+		mRebake = std::make_unique<Rebake>();
+		mRebake->mEnvironment = environmentCubeMap;
+
+		// Nothing is in flight here, the capture nodes can be pointed at the new environment
+		if (mReflectionProbes != nullptr && !mReflectionProbes->getProbes().empty()) {
+			const ReflectionProbeSet::Settings& settings = mReflectionProbes->getSettings();
+			if (mReflectionCaptureState.mEnvironmentNode == nullptr) {
+				mReflectionCaptureState = mHDRI->createLocalProbeCaptureState(environmentCubeMap, mMeshes, settings.mCaptureSize);
+			}
+			else {
+				mHDRI->setLocalProbeEnvironment(mReflectionCaptureState, environmentCubeMap);
+			}
+			mRebake->mProbeArray = mReflectionProbes->createProbeArray(static_cast<uint32_t>(mReflectionProbes->getProbes().size()), settings.mFaceSize, settings.mMipLevels);
+			for (uint32_t i = 0; i < mReflectionProbes->getProbes().size(); i++) {
+				mRebake->mSteps.push_back({ StepType::ReflectionCapture, i });
+				mRebake->mSteps.push_back({ StepType::ReflectionPrefilter, i });
+			}
+		}
+
+		if (mIrradianceVolume != nullptr && mIrradianceVolume->isBaked()) {
+			const uint32_t captureSize = mIrradianceVolume->getSettings().mCaptureSize;
+			if (mVolumeCaptureState.mEnvironmentNode == nullptr) {
+				mVolumeCaptureState = mHDRI->createLocalProbeCaptureState(environmentCubeMap, mMeshes, captureSize);
+				mReadbackBuffer = Wrapper::Buffer::createReadbackBuffer(mDevice, static_cast<VkDeviceSize>(captureSize) * captureSize * 6 * IBLImageData::ChannelCount * sizeof(float));
+			}
+			else {
+				mHDRI->setLocalProbeEnvironment(mVolumeCaptureState, environmentCubeMap);
+			}
+			mRebake->mVolumeProbes.reserve(mIrradianceVolume->getProbeCount());
+			for (uint32_t i = 0; i < mIrradianceVolume->getProbeCount(); i++) {
+				mRebake->mSteps.push_back({ StepType::VolumeCapture, i });
+			}
+			mRebake->mSteps.push_back({ StepType::VolumeUpload });
+		}
+
+		if (mRebake->mSteps.empty()) {
+			mRebake.reset();
+		}
+	}
+
+	void LocalLightingRebaker::recordStep(const Step& step) {
+		switch (step.mType) {
+		case StepType::ReflectionCapture: {
+			mRebake->mCapture = mHDRI->recordLocalProbeCapture(mReflectionCaptureState, mCommandBuffer, mReflectionProbes->getProbes()[step.mIndex].mPosition, mMeshes);
+			break;
+		}
+		case StepType::ReflectionPrefilter: {
+			const ReflectionProbeSet::Settings& settings = mReflectionProbes->getSettings();
+			const Wrapper::Image::Ptr& probeArray = mRebake->mProbeArray;
+			VkImageSubresourceRange arrayRange{};
+			arrayRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			arrayRange.baseMipLevel = 0;
+			arrayRange.levelCount = probeArray->getMipLevels();
+			arrayRange.baseArrayLayer = 0;
+			arrayRange.layerCount = probeArray->getLayerCount();
+			if (step.mIndex == 0) {
+				probeArray->setImageLayout(
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					arrayRange,
+					mCommandPool,
+					mCommandBuffer);
+			}
+
+			mRebake->mPrefiltered = mComputeBaker->recordSpecularPrefilterMap(
+				mCommandBuffer, mRebake->mDispatch, mRebake->mCapture.mCubeMap, settings.mFaceSize, settings.mMipLevels, settings.mFilteredSampling);
+			mReflectionProbes->recordProbeCopy(mCommandBuffer, probeArray, step.mIndex, mRebake->mPrefiltered);
+
+			if (step.mIndex + 1 == mReflectionProbes->getProbes().size()) {
+				probeArray->setImageLayout(
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					arrayRange,
+					mCommandPool,
+					mCommandBuffer);
+			}
+			break;
+		}
+		case StepType::VolumeCapture: {
+			const glm::uvec3 resolution = mIrradianceVolume->getSettings().mResolution;
+			const uint32_t x = step.mIndex % resolution.x;
+			const uint32_t y = (step.mIndex / resolution.x) % resolution.y;
+			const uint32_t z = step.mIndex / (resolution.x * resolution.y);
+			mRebake->mCapture = mHDRI->recordLocalProbeCapture(mVolumeCaptureState, mCommandBuffer, mIrradianceVolume->getProbePosition(x, y, z), mMeshes);
+
+			// Mip 0 only, the faces back to back like IBLCache::download
+			const Wrapper::Image::Ptr& capture = mRebake->mCapture.mCubeMap;
+			VkImageSubresourceRange subresourceRange{};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = 1;
+			subresourceRange.baseArrayLayer = 0;
+			subresourceRange.layerCount = 6;
+			capture->setImageLayout(
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				subresourceRange,
+				mCommandPool,
+				mCommandBuffer);
+
+			const VkDeviceSize faceSize = static_cast<VkDeviceSize>(capture->getWidth()) * capture->getHeight() * IBLImageData::ChannelCount * sizeof(float);
+			std::vector<VkBufferImageCopy> regions;
+			for (uint32_t face = 0; face < 6; face++) {
+				VkBufferImageCopy region{};
+				region.bufferOffset = face * faceSize;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = 0;
+				region.imageSubresource.baseArrayLayer = face;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = { capture->getWidth(), capture->getHeight(), 1 };
+				regions.push_back(region);
+			}
+			mCommandBuffer->copyImageToBuffer(capture->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mReadbackBuffer->getBuffer(), regions);
+			mCommandBuffer->memoryBarrier(
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+			mRebake->mReadbackPending = true;
+			break;
+		}
+		case StepType::VolumeUpload: {
+			mRebake->mVolumeImage = mIrradianceVolume->recordVolumeImage(mRebake->mVolumeProbes, mCommandBuffer, mRebake->mVolumeStageBuffer);
+			break;
+		}
+		}
+	}
+
+	void LocalLightingRebaker::retireStep() {
+		if (mRebake == nullptr) {
+			return;
+		}
+		if (mRebake->mReadbackPending) {
+			FF_CPU_ZONE("LocalLightingRebaker::projectVolumeProbe");
+			const uint32_t captureSize = mRebake->mCapture.mCubeMap->getWidth();
+			IBLImageData data = IBLImageData::create(captureSize, captureSize, 6, 1);
+			mReadbackBuffer->readBufferByMap(data.mLevels[0].data(), data.mLevels[0].size() * sizeof(float));
+			mRebake->mVolumeProbes.push_back(SphericalHarmonics::projectCubeMapIrradiance(data));
+			mRebake->mReadbackPending = false;
+		}
+
+		// The capture of a probe stays until its prefilter ran
+		const bool keepCapture = mRebake->mNextStep < mRebake->mSteps.size() && mRebake->mSteps[mRebake->mNextStep].mType == StepType::ReflectionPrefilter;
+		if (!keepCapture) {
+			mRebake->mCapture = {};
+		}
+		else {
+			mRebake->mCapture.mTarget.reset();
+		}
+		mComputeBaker->releaseDispatch(mRebake->mDispatch);
+		mRebake->mPrefiltered.reset();
+		mRebake->mVolumeStageBuffer.reset();
+	}
+
+	void LocalLightingRebaker::finishRebake() {
+		FF_CPU_ZONE("LocalLightingRebaker::finishRebake");
+		if (mRebake->mProbeArray != nullptr) {
+			mReflectionProbes->setProbeArray(mRebake->mProbeArray);
+		}
+		if (mRebake->mVolumeImage != nullptr) {
+			mIrradianceVolume->setRebakedProbes(std::move(mRebake->mVolumeProbes), mRebake->mVolumeImage);
+		}
+		mRebake.reset();
+	}
+
+	void LocalLightingRebaker::dropRebake() {
+		if (mRebake == nullptr) {
+			return;
+		}
+		mComputeBaker->releaseDispatch(mRebake->mDispatch);
+		mRebake.reset();
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/fence.h"
+#include "HDRI.h"
+#include "iblComputeBaker.h"
+#include "reflectionProbes.h"
+#include "irradianceVolume.h"
+#include "sphericalHarmonics.h"
+
+namespace FF {
+	/*
+	* Re-bakes the reflection probes and the irradiance volume against a new environment without stalling the frame.
+	* One step goes out per frame after the frame's own work: a probe capture, the prefilter and copy of a probe into the new
+	* array, or a volume capture whose mip 0 is read back and projected to SH once its fence signaled.
+	* The old probes and volume keep lighting the scene until the last step retired, then they are swapped in frame by frame
+	* through applyPendingBindings of ReflectionProbeSet and IrradianceVolume.
+	* Runtime rebakes are not stored in the IBL cache, the startup bake of the next run loads or bakes its own.
+	*/
+	class LocalLightingRebaker {
+	public:
+		using Ptr = std::shared_ptr<LocalLightingRebaker>;
+		/// @param reflectionProbes nullptr, or a set without probes, skips the probe steps.
+		/// @param irradianceVolume nullptr, or a volume never baked, skips the volume steps.
+		static Ptr create(
+			const Wrapper::Device::Ptr& device,
+			const Wrapper::CommandPool::Ptr& commandPool,
+			const ReflectionProbeSet::Ptr& reflectionProbes,
+			const IrradianceVolume::Ptr& irradianceVolume,
+			const std::vector<ProbeCaptureMesh>& meshes) {
+			return std::make_shared<LocalLightingRebaker>(device, commandPool, reflectionProbes, irradianceVolume, meshes);
+		}
+
+		LocalLightingRebaker(
+			const Wrapper::Device::Ptr& device,
+			const Wrapper::CommandPool::Ptr& commandPool,
+			const ReflectionProbeSet::Ptr& reflectionProbes,
+			const IrradianceVolume::Ptr& irradianceVolume,
+			const std::vector<ProbeCaptureMesh>& meshes);
+		~LocalLightingRebaker();
+
+		/// @brief Start rebaking against environmentCubeMap. A rebake already in progress is dropped once its last step has retired.
+		void requestEnvironment(const Wrapper::Image::Ptr& environmentCubeMap);
+
+		/// @brief Record and submit this frame's step on the graphics queue, call once per frame after the frame submission.
+		/// Never waits: when the previous step is still running the frame is skipped.
+		void update();
+
+		[[nodiscard]] bool isBusy() const { return mRebake != nullptr || mPendingEnvironment != nullptr; }
+
+	private:
+		enum class StepType : uint32_t {
+			ReflectionCapture,   // capture probe mIndex
+			ReflectionPrefilter, // prefilter it and copy it into the new array
+			VolumeCapture,       // capture volume probe mIndex and read its mip 0 back
+			VolumeUpload         // the projected probes to a new volume image
+		};
+
+		struct Step {
+			StepType mType{ StepType::ReflectionCapture };
+			uint32_t mIndex{ 0 };
+		};
+
+		struct Rebake {
+			Wrapper::Image::Ptr mEnvironment{ nullptr };
+			std::vector<Step> mSteps{};
+			size_t mNextStep{ 0 };
+
+			Wrapper::Image::Ptr mProbeArray{ nullptr };
+			std::vector<SH9Irradiance> mVolumeProbes{};
+			Wrapper::Image::Ptr mVolumeImage{ nullptr };
+			Wrapper::Buffer::Ptr mVolumeStageBuffer{ nullptr };
+
+			// Resources of the step in flight
+			HDRI::LocalProbeCapture mCapture{};
+			IBLComputeBaker::Dispatch mDispatch{};
+			Wrapper::Image::Ptr mPrefiltered{ nullptr };
+			bool mReadbackPending{ false };
+		};
+
+		void startRebake(const Wrapper::Image::Ptr& environmentCubeMap);
+		void recordStep(const Step& step);
+		// Work on the cpu once the step's fence signaled: SH projection, release of the step's resources
+		void retireStep();
+		// Hand the new probes and volume to the sets
+		void finishRebake();
+		void dropRebake();
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		ReflectionProbeSet::Ptr mReflectionProbes{ nullptr };
+		IrradianceVolume::Ptr mIrradianceVolume{ nullptr };
+		std::vector<ProbeCaptureMesh> mMeshes{};
+
+		HDRI::Ptr mHDRI{ nullptr };
+		IBLComputeBaker::Ptr mComputeBaker{ nullptr };
+		// Built by the first rebake, later rebakes only point them at their environment
+		HDRI::LocalProbeCaptureState mReflectionCaptureState{};
+		HDRI::LocalProbeCaptureState mVolumeCaptureState{};
+		// Mip 0 of one volume capture
+		Wrapper::Buffer::Ptr mReadbackBuffer{ nullptr };
+
+		Wrapper::Image::Ptr mPendingEnvironment{ nullptr };
+		std::unique_ptr<Rebake> mRebake{ nullptr };
+
+		Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+		Wrapper::Fence::Ptr mFence{ nullptr };
+		bool mInFlight{ false };
+	};
+}
@@ -0,0 +1,320 @@
+#include "reflectionProbes.h"
+#include "iblComputeBaker.h"
+#include <cstring>
+
+namespace FF {
+	ReflectionProbeSet::ReflectionProbeSet(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings)
+		: mDevice(device), mCommandPool(commandPool), mFrameCount(frameCount), mSettings(settings) {
+		if (!mDevice->isImageCubeArraySupported()) {
+			throw std::runtime_error("Error: reflection probes need the imageCubeArray feature!");
+		}
+		mSampler = Wrapper::Sampler::create(mDevice, true);
+
+		// 1x1 placeholder so the set is valid before the bake, never sampled while no probe is selected
+		mProbeArray = createProbeArray(1, 1, 1);
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mProbeArray->getMipLevels();
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = mProbeArray->getLayerCount();
+		mProbeArray->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			subresourceRange,
+			mCommandPool);
+
+		buildDescriptor();
+	}
+
+	ReflectionProbeSet::~ReflectionProbeSet() {
+		mDescriptorSet.reset();
+		mDescriptorPool.reset();
+		mDescriptorLayout.reset();
+		mUniformParameters.clear();
+		mProbeArray.reset();
+	}
+
+	void ReflectionProbeSet::addProbe(const ReflectionProbe& probe) {
+		if (mProbes.size() >= MaxReflectionProbes) {
+			throw std::runtime_error("Error: too many reflection probes, MaxReflectionProbes is " + std::to_string(MaxReflectionProbes));
+		}
+
+		const uint32_t index = static_cast<uint32_t>(mProbes.size());
+		mUniform.mProbePositions[index] = glm::vec4(probe.mPosition, static_cast<float>(probe.mProxy));
+		mUniform.mProxyCenters[index] = glm::vec4(probe.mProxyCenter, probe.mRadius);
+		mUniform.mProxyExtents[index] = glm::vec4(probe.mBoxHalfExtent, probe.mBlendDistance);
+		mProbes.push_back(probe);
+	}
+
+	Wrapper::Image::Ptr ReflectionProbeSet::createProbeArray(uint32_t probeCount, uint32_t faceSize, uint32_t mipLevels) const {
+		return Wrapper::Image::create(
+			mDevice, faceSize, faceSize,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false, mipLevels, probeCount);
+	}
+
+	uint64_t ReflectionProbeSet::makeProbeKey(const IBLCache::Ptr& cache, const ReflectionProbe& probe, const std::vector<ProbeCaptureMesh>& meshes, uint64_t environmentKey) const {
+		std::vector<std::string> inputs = { "shaders/ProbeCaptureVert.spv", "shaders/ProbeCaptureFrag.spv", "shaders/SpecularPrefilterComp.spv" };
+		std::vector<uint32_t> parameters = {
+			mSettings.mCaptureSize, mSettings.mFaceSize, mSettings.mMipLevels,
+			mSettings.mFilteredSampling ? HDRI::FilteredPrefilterSampleCount : HDRI::SpecularPrefilterSampleCount, mSettings.mFilteredSampling ? 1u : 0u
+		};
+		auto pushFloats = [&parameters](const float* pValues, size_t count) {
+			for (size_t i = 0; i < count; i++) {
+				uint32_t bits = 0;
+				std::memcpy(&bits, &pValues[i], sizeof(bits));
+				parameters.push_back(bits);
+			}
+		};
+
+		// Only the capture point changes the bake, the proxy is applied at lookup time
+		pushFloats(&probe.mPosition.x, 3);
+		for (const auto& mesh : meshes) {
+			inputs.push_back(mesh.mSourcePath);
+			pushFloats(&mesh.mModelMatrix[0][0], 16);
+			pushFloats(&mesh.mAlbedo.x, 4);
+		}
+		return cache->makeKey(inputs, parameters, environmentKey);
+	}
+
+	void ReflectionProbeSet::bake(const Wrapper::Image::Ptr& environmentCubeMap, const std::vector<ProbeCaptureMesh>& meshes, const IBLCache::Ptr& cache, uint64_t environmentKey) {
+		if (mProbes.empty()) {
+			return;
+		}
+
+		HDRI::Ptr hdri = HDRI::create(mDevice, mCommandPool);
+		IBLComputeBaker::Ptr computeBaker = IBLComputeBaker::create(mDevice, mCommandPool);
+
+		std::vector<Wrapper::Image::Ptr> probeCubeMaps;
+		for (size_t i = 0; i < mProbes.size(); i++) {
+			const std::string name = "reflectionProbe" + std::to_string(i);
+			const uint64_t key = makeProbeKey(cache, mProbes[i], meshes, environmentKey);
+
+			Wrapper::Image::Ptr probeCubeMap = cache->load(name, key);
+			if (probeCubeMap == nullptr) {
+				Wrapper::Image::Ptr capture = hdri->captureLocalProbe(environmentCubeMap, mProbes[i].mPosition, meshes, mSettings.mCaptureSize);
+				probeCubeMap = computeBaker->generateSpecularPrefilterMap(capture, mSettings.mFaceSize, mSettings.mMipLevels, mSettings.mFilteredSampling);
+				cache->store(name, key, probeCubeMap);
+			}
+			probeCubeMaps.push_back(probeCubeMap);
+		}
+
+		// Every probe goes to its own six layers, all mips in one copy
+		Wrapper::Image::Ptr probeArray = createProbeArray(static_cast<uint32_t>(mProbes.size()), mSettings.mFaceSize, mSettings.mMipLevels);
+
+		Wrapper::CommandBuffer::Ptr commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+		VkImageSubresourceRange arrayRange{};
+		arrayRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		arrayRange.baseMipLevel = 0;
+		arrayRange.levelCount = probeArray->getMipLevels();
+		arrayRange.baseArrayLayer = 0;
+		arrayRange.layerCount = probeArray->getLayerCount();
+		probeArray->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			arrayRange,
+			mCommandPool,
+			commandBuffer);
+
+		for (size_t i = 0; i < probeCubeMaps.size(); i++) {
+			recordProbeCopy(commandBuffer, probeArray, static_cast<uint32_t>(i), probeCubeMaps[i]);
+		}
+
+		probeArray->setImageLayout(
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			arrayRange,
+			mCommandPool,
+			commandBuffer);
+
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+
+		mProbeArray = probeArray;
+		updateProbeArrayBinding();
+	}
+
+	void ReflectionProbeSet::recordProbeCopy(const Wrapper::CommandBuffer::Ptr& commandBuffer, const Wrapper::Image::Ptr& probeArray, uint32_t probeIndex, const Wrapper::Image::Ptr& probeCubeMap) const {
+		VkImageSubresourceRange cubeRange{};
+		cubeRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		cubeRange.baseMipLevel = 0;
+		cubeRange.levelCount = probeCubeMap->getMipLevels();
+		cubeRange.baseArrayLayer = 0;
+		cubeRange.layerCount = 6;
+		probeCubeMap->setImageLayout(
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			cubeRange,
+			mCommandPool,
+			commandBuffer);
+
+		std::vector<VkImageCopy> regions;
+		for (uint32_t mipLevel = 0; mipLevel < probeArray->getMipLevels(); mipLevel++) {
+			const uint32_t mipSize = std::max(1u, probeArray->getWidth() >> mipLevel);
+			VkImageCopy region{};
+			region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.mipLevel = mipLevel;
+			region.srcSubresource.baseArrayLayer = 0;
+			region.srcSubresource.layerCount = 6;
+			region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.dstSubresource.mipLevel = mipLevel;
+			region.dstSubresource.baseArrayLayer = probeIndex * 6;
+			region.dstSubresource.layerCount = 6;
+			region.extent = { mipSize, mipSize, 1 };
+			regions.push_back(region);
+		}
+		commandBuffer->copyImage(probeCubeMap->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, probeArray->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions);
+	}
+
+	void ReflectionProbeSet::setProbeArray(const Wrapper::Image::Ptr& probeArray) {
+		// The sets of the frames in flight keep the old array alive until they are rewritten
+		mProbeArray = probeArray;
+		mPendingFrames.assign(mFrameCount, true);
+	}
+
+	bool ReflectionProbeSet::applyPendingBindings(int frameIndex) {
+		if (mPendingFrames.empty() || !mPendingFrames[frameIndex]) {
+			return false;
+		}
+		updateProbeArrayBinding(frameIndex);
+		mPendingFrames[frameIndex] = false;
+		return true;
+	}
+
+	float ReflectionProbeSet::getInfluence(const ReflectionProbe& probe, const glm::vec3& position) {
+		// Distance from position to the proxy surface, positive inside
+		float insideDistance = 0.0f;
+		if (probe.mProxy == ReflectionProbeProxy::Box) {
+			const glm::vec3 toFaces = probe.mBoxHalfExtent - glm::abs(position - probe.mProxyCenter);
+			insideDistance = std::min(toFaces.x, std::min(toFaces.y, toFaces.z));
+		}
+		else {
+			insideDistance = probe.mRadius - glm::length(position - probe.mProxyCenter);
+		}
+		if (insideDistance <= 0.0f) {
+			return 0.0f;
+		}
+		return probe.mBlendDistance > 0.0f ? std::min(insideDistance / probe.mBlendDistance, 1.0f) : 1.0f;
+	}
+
+	void ReflectionProbeSet::updateSelection(int frameIndex, const std::vector<glm::vec3>& positions) {
+		if (positions.size() > mSettings.mObjectCount) {
+			throw std::runtime_error("Error: too many objects for the reflection probe selection, the set was created for " + std::to_string(mSettings.mObjectCount));
+		}
+		mSelections.resize(positions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+			mSelections[i] = select(positions[i]);
+		}
+		mUniformParameters[1]->mBuffers[frameIndex]->updateBufferByMap(&mUniform, sizeof(ReflectionProbeUniform));
+		if (!mSelections.empty()) {
+			mUniformParameters[2]->mBuffers[frameIndex]->updateBufferByMap(mSelections.data(), sizeof(ReflectionProbeSelection) * mSelections.size());
+		}
+	}
+
+	ReflectionProbeSelection ReflectionProbeSet::select(const glm::vec3& position) const {
+		int selection[2] = { -1, -1 };
+		float weights[2] = { 0.0f, 0.0f };
+		for (size_t i = 0; i < mProbes.size(); i++) {
+			const float influence = getInfluence(mProbes[i], position);
+			if (influence <= weights[1]) {
+				continue;
+			}
+			if (influence > weights[0]) {
+				selection[1] = selection[0];
+				weights[1] = weights[0];
+				selection[0] = static_cast<int>(i);
+				weights[0] = influence;
+			}
+			else {
+				selection[1] = static_cast<int>(i);
+				weights[1] = influence;
+			}
+		}
+		// Overlapping probes share the reflection, the global environment fills in where the influences do not reach 1
+		const float totalWeight = weights[0] + weights[1];
+		if (totalWeight > 1.0f) {
+			weights[0] /= totalWeight;
+			weights[1] /= totalWeight;
+		}
+
+		ReflectionProbeSelection result{};
+		result.mSelection = glm::ivec4(selection[0], selection[1], -1, -1);
+		result.mWeights = glm::vec4(weights[0], weights[1], 0.0f, 0.0f);
+		return result;
+	}
+
+	void ReflectionProbeSet::buildDescriptor() {
+		// binding 0: samplerCubeArray U_ReflectionProbes
+		auto probeArrayParam = Wrapper::UniformParameter::create();
+		probeArrayParam->mBinding = 0;
+		probeArrayParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		probeArrayParam->mCount = 1;
+		probeArrayParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		probeArrayParam->mTextures.resize(mFrameCount);
+		for (int i = 0; i < mFrameCount; i++) {
+			probeArrayParam->mTextures[i].push_back(Texture::createFromImage(mDevice, mProbeArray, mSampler));
+		}
+		mUniformParameters.push_back(probeArrayParam);
+
+		// binding 1: uniform ReflectionProbes, one buffer per frame for the selection
+		auto probeDataParam = Wrapper::UniformParameter::create();
+		probeDataParam->mBinding = 1;
+		probeDataParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		probeDataParam->mCount = 1;
+		probeDataParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		probeDataParam->mSize = sizeof(ReflectionProbeUniform);
+		for (int i = 0; i < mFrameCount; i++) {
+			probeDataParam->mBuffers.push_back(Wrapper::Buffer::createUniformBuffer(mDevice, probeDataParam->mSize, &mUniform));
+		}
+		mUniformParameters.push_back(probeDataParam);
+
+		// binding 2: buffer ProbeSelections, one per frame, indexed by the object index (gl_InstanceIndex)
+		auto selectionParam = Wrapper::UniformParameter::create();
+		selectionParam->mBinding = 2;
+		selectionParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		selectionParam->mCount = 1;
+		selectionParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		const uint32_t objectCount = std::max(mSettings.mObjectCount, 1u);
+		selectionParam->mSize = sizeof(ReflectionProbeSelection) * objectCount;
+		// Objects without a selection written blend nothing, until the first update
+		std::vector<ReflectionProbeSelection> noSelections(objectCount);
+		for (int i = 0; i < mFrameCount; i++) {
+			selectionParam->mBuffers.push_back(Wrapper::Buffer::createStorageBuffer(mDevice, selectionParam->mSize, noSelections.data()));
+		}
+		mUniformParameters.push_back(selectionParam);
+
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build(mUniformParameters);
+
+		mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		mDescriptorPool->build(mUniformParameters, mFrameCount);
+
+		mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, mUniformParameters, mDescriptorLayout, mDescriptorPool, mFrameCount);
+	}
+
+	void ReflectionProbeSet::updateProbeArrayBinding() {
+		for (int i = 0; i < mFrameCount; i++) {
+			updateProbeArrayBinding(i);
+		}
+		mPendingFrames.clear();
+	}
+
+	void ReflectionProbeSet::updateProbeArrayBinding(int frameIndex) {
+		auto texture = Texture::createFromImage(mDevice, mProbeArray, mSampler);
+		mUniformParameters[0]->mTextures[frameIndex][0] = texture;
+		mDescriptorSet->updateImage(frameIndex, 0, 0, texture->getImageInfo());
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/sampler.h"
+#include "../vulkanWrapper/buffer.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "HDRI.h"
+#include "iblCache.h"
+#include "texture.h"
+
+namespace FF {
+	// Shape a probe's cubemap is projected on for the parallax correction, also the volume it influences
+	enum class ReflectionProbeProxy : uint32_t {
+		Box = 0,
+		Sphere = 1
+	};
+
+	struct ReflectionProbe {
+		glm::vec3 mPosition{ 0.0f }; // capture point
+		ReflectionProbeProxy mProxy{ ReflectionProbeProxy::Box };
+		glm::vec3 mProxyCenter{ 0.0f };
+		glm::vec3 mBoxHalfExtent{ 1.0f }; // axis aligned
+		float mRadius{ 1.0f };
+		float mBlendDistance{ 0.5f }; // the influence fades in over this distance inside the proxy
+	};
+
+	static constexpr uint32_t MaxReflectionProbes = 8;
+
+	// Matches the ReflectionProbes block of pbr1.frag (set 2, binding 1)
+	struct ReflectionProbeUniform {
+		glm::vec4 mProbePositions[MaxReflectionProbes]{}; // w: proxy shape
+		glm::vec4 mProxyCenters[MaxReflectionProbes]{};   // w: sphere radius
+		glm::vec4 mProxyExtents[MaxReflectionProbes]{};   // xyz: box half extent, w: blend distance
+	};
+
+	// Matches ProbeSelectionData of pbr1.frag (set 2, binding 2, std430), one per object
+	struct ReflectionProbeSelection {
+		glm::ivec4 mSelection{ -1, -1, -1, -1 }; // x, y: the two probes blended for the object, -1 when unused
+		glm::vec4 mWeights{ 0.0f };              // x, y: their weights, the global environment gets the rest
+	};
+
+	/*
+	* Baked local reflection probes. Each probe captures the scene around its position with the cubemap capture path,
+	* is prefiltered like the global environment and lands in one cube of a cubemap array, so every probe shares a single binding.
+	* The probes blended for an object are picked on the cpu from the object position and the proxy volumes, one selection per object:
+	* pbr1 reads the one of gl_InstanceIndex, so a draw passes its object index as firstInstance (an instanced group its first one).
+	* pbr1.frag corrects the reflection vector against the proxy before the lookup.
+	*/
+	class ReflectionProbeSet {
+	public:
+		using Ptr = std::shared_ptr<ReflectionProbeSet>;
+
+		struct Settings {
+			uint32_t mCaptureSize{ 256 };
+			uint32_t mFaceSize{ 128 };
+			uint32_t mMipLevels{ HDRI::SpecularPrefilterMipLevels }; // sampled with the same roughness to lod mapping as U_prefilteredColor
+			bool mFilteredSampling{ true };
+			uint32_t mObjectCount{ 1 }; // objects with their own probe selection per frame, sizes the ProbeSelections buffers
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings = {}) {
+			return std::make_shared<ReflectionProbeSet>(device, commandPool, frameCount, settings);
+		}
+
+		ReflectionProbeSet(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount, const Settings& settings);
+		~ReflectionProbeSet();
+
+		void addProbe(const ReflectionProbe& probe);
+
+		/// @brief Capture and prefilter every probe, then gather them in the cubemap array. Each probe is looked up in the cache first.
+		/// Until then the set holds a placeholder and every object uses the global environment.
+		/// @param environmentKey cache key of environmentCubeMap, parent of the probe keys.
+		void bake(const Wrapper::Image::Ptr& environmentCubeMap, const std::vector<ProbeCaptureMesh>& meshes, const IBLCache::Ptr& cache, uint64_t environmentKey);
+
+		/// @brief Pick the two probes with the largest influence at each object position and write them to this frame's buffers.
+		/// @param positions one per object index, at most Settings::mObjectCount.
+		void updateSelection(int frameIndex, const std::vector<glm::vec3>& positions);
+
+		/// @brief Swap in a probe array baked elsewhere (LocalLightingRebaker), in SHADER_READ_ONLY layout once its commands ran.
+		/// Each frame's set points at it when applyPendingBindings is called for that frame.
+		void setProbeArray(const Wrapper::Image::Ptr& probeArray);
+		// Rewrite this frame's set if a new array is waiting for it, true when the set changed. The frame must not be in flight
+		bool applyPendingBindings(int frameIndex);
+
+		// New array of probeCount cubes, TRANSFER_DST and SAMPLED usage
+		Wrapper::Image::Ptr createProbeArray(uint32_t probeCount, uint32_t faceSize, uint32_t mipLevels) const;
+		// Copy every mip of a prefiltered probe into its six layers of probeArray, which must be in TRANSFER_DST layout
+		void recordProbeCopy(const Wrapper::CommandBuffer::Ptr& commandBuffer, const Wrapper::Image::Ptr& probeArray, uint32_t probeIndex, const Wrapper::Image::Ptr& probeCubeMap) const;
+
+		// The two probes with the largest influence at position and their weights
+		ReflectionProbeSelection select(const glm::vec3& position) const;
+
+		// 0 outside the proxy, 1 once mBlendDistance inside it
+		static float getInfluence(const ReflectionProbe& probe, const glm::vec3& position);
+
+		[[nodiscard]] const Settings& getSettings() const { return mSettings; }
+		[[nodiscard]] const std::vector<ReflectionProbe>& getProbes() const { return mProbes; }
+		[[nodiscard]] Wrapper::Image::Ptr getProbeArray() const { return mProbeArray; }
+		[[nodiscard]] Wrapper::DescriptorSetLayout::Ptr getDescriptorLayout() const { return mDescriptorLayout; }
+		[[nodiscard]] VkDescriptorSet getDescriptorSet(int frameIndex) const { return mDescriptorSet->getDescriptorSet(frameIndex); }
+
+	private:
+		uint64_t makeProbeKey(const IBLCache::Ptr& cache, const ReflectionProbe& probe, const std::vector<ProbeCaptureMesh>& meshes, uint64_t environmentKey) const;
+		void buildDescriptor();
+		// Point binding 0 of every frame's set at the current array
+		void updateProbeArrayBinding();
+		void updateProbeArrayBinding(int frameIndex);
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		int mFrameCount{ 0 };
+		Settings mSettings{};
+
+		std::vector<ReflectionProbe> mProbes{};
+		Wrapper::Image::Ptr mProbeArray{ nullptr };
+		std::vector<bool> mPendingFrames{}; // frames whose set still points at the previous array
+		Wrapper::Sampler::Ptr mSampler{ nullptr };
+		// Probe data only changes with the probes, the selections are rewritten every frame
+		ReflectionProbeUniform mUniform{};
+		std::vector<ReflectionProbeSelection> mSelections{};
+
+		std::vector<Wrapper::UniformParameter::Ptr> mUniformParameters{};
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+		Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+	};
+}
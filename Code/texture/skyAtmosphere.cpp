@@ -0,0 +1,266 @@
+#include "skyAtmosphere.h"
+#include "iblComputeBaker.h"
+#include <cstring>
+
+namespace FF {
+	static_assert(sizeof(SkyAtmosphere::Parameters) == 7 * sizeof(glm::vec4), "SkyAtmosphere::Parameters must match the push constant block of SkyAtmosphere.comp");
+
+	SkyAtmosphere::SkyAtmosphere(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings, const Parameters& parameters)
+		: mDevice(device), mCommandPool(commandPool), mSettings(settings), mParameters(parameters) {
+		mSampler = Wrapper::Sampler::create(mDevice);
+
+		mTransmittanceLUT = createLUT(mSettings.mTransmittanceWidth, mSettings.mTransmittanceHeight);
+		mMultiScatteringLUT = createLUT(mSettings.mMultiScatteringSize, mSettings.mMultiScatteringSize);
+		mSkyViewLUT = createLUT(mSettings.mSkyViewWidth, mSettings.mSkyViewHeight);
+
+		mEnvironment = createEnvironmentImage();
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = mEnvironment->getImage();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = mEnvironment->getFormat();
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = mEnvironment->getLayerCount();
+		if (vkCreateImageView(mDevice->getDevice(), &viewInfo, nullptr, &mEnvironmentStorageView) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to create sky environment storage view!");
+		}
+
+		buildKernels();
+
+		mCommandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		mFence = Wrapper::Fence::create(mDevice, true);
+	}
+
+	SkyAtmosphere::~SkyAtmosphere() {
+		mFence->waitForFence();
+		mCommandBuffer.reset();
+		mFence.reset();
+		mPipelines.clear();
+		mDescriptorSet.reset();
+		mDescriptorPool.reset();
+		mDescriptorLayout.reset();
+		mUniformParameters.clear();
+		if (mEnvironmentStorageView != VK_NULL_HANDLE) {
+			vkDestroyImageView(mDevice->getDevice(), mEnvironmentStorageView, nullptr);
+			mEnvironmentStorageView = VK_NULL_HANDLE;
+		}
+	}
+
+	void SkyAtmosphere::setParameters(const Parameters& parameters) {
+		mParameters = parameters;
+		mParameters.mSunDirection = glm::normalize(mParameters.mSunDirection);
+		mLUTsDirty = true;
+	}
+
+	void SkyAtmosphere::setSunDirection(const glm::vec3& sunDirection) {
+		mParameters.mSunDirection = glm::normalize(sunDirection);
+	}
+
+	void SkyAtmosphere::setSunAngles(float elevationDegrees, float azimuthDegrees) {
+		const float elevation = glm::radians(elevationDegrees);
+		const float azimuth = glm::radians(azimuthDegrees);
+		setSunDirection(glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth)));
+	}
+
+	std::vector<uint32_t> SkyAtmosphere::getKeyParameters() const {
+		std::vector<uint32_t> parameters = {
+			mSettings.mEnvironmentSize, mSettings.mTransmittanceWidth, mSettings.mTransmittanceHeight,
+			mSettings.mMultiScatteringSize, mSettings.mSkyViewWidth, mSettings.mSkyViewHeight
+		};
+		const size_t floatCount = sizeof(Parameters) / sizeof(float);
+		const size_t offset = parameters.size();
+		parameters.resize(offset + floatCount);
+		std::memcpy(parameters.data() + offset, &mParameters, sizeof(Parameters));
+		return parameters;
+	}
+
+	Wrapper::Image::Ptr SkyAtmosphere::createLUT(uint32_t width, uint32_t height) const {
+		return Wrapper::Image::create(
+			mDevice, width, height,
+			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	Wrapper::Image::Ptr SkyAtmosphere::createEnvironmentImage() const {
+		// Written as a storage image, then sampled (and read back by the IBL cache), blitted for mipmaps and copied
+		return Wrapper::Image::create(
+			mDevice, mSettings.mEnvironmentSize, mSettings.mEnvironmentSize,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, true, Wrapper::Image::getMaxMipLevels(mSettings.mEnvironmentSize, mSettings.mEnvironmentSize));
+	}
+
+	void SkyAtmosphere::buildKernels() {
+		// Inputs a kernel does not read are still bound to a valid texture, they are never accessed
+		auto transmittance = Texture::createFromImage(mDevice, mTransmittanceLUT, mSampler);
+		auto multiScattering = Texture::createFromImage(mDevice, mMultiScatteringLUT, mSampler);
+		auto skyView = Texture::createFromImage(mDevice, mSkyViewLUT, mSampler);
+		const Texture::Ptr secondInputs[KernelCount] = { transmittance, transmittance, multiScattering, skyView };
+		const VkImageView targets[KernelCount] = {
+			mTransmittanceLUT->getImageView(), mMultiScatteringLUT->getImageView(), mSkyViewLUT->getImageView(), mEnvironmentStorageView
+		};
+
+		auto transmittanceParam = Wrapper::UniformParameter::create();
+		transmittanceParam->mBinding = 0;
+		transmittanceParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		transmittanceParam->mCount = 1;
+		transmittanceParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		auto targetParam = Wrapper::UniformParameter::create();
+		targetParam->mBinding = 1;
+		targetParam->mDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		targetParam->mCount = 1;
+		targetParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		auto secondParam = Wrapper::UniformParameter::create();
+		secondParam->mBinding = 2;
+		secondParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		secondParam->mCount = 1;
+		secondParam->mStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		for (uint32_t kernel = 0; kernel < KernelCount; kernel++) {
+			transmittanceParam->mTextures.push_back({ transmittance });
+			secondParam->mTextures.push_back({ secondInputs[kernel] });
+			VkDescriptorImageInfo storageInfo{};
+			storageInfo.imageView = targets[kernel];
+			storageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			targetParam->mStorageImageInfos.push_back(storageInfo);
+		}
+		mUniformParameters = { transmittanceParam, targetParam, secondParam };
+
+		mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
+		mDescriptorLayout->build(mUniformParameters);
+		mDescriptorPool = Wrapper::DescriptorPool::create(mDevice);
+		mDescriptorPool->build(mUniformParameters, KernelCount);
+		mDescriptorSet = Wrapper::DescriptorSet::create(mDevice, mUniformParameters, mDescriptorLayout, mDescriptorPool, KernelCount);
+
+		VkDescriptorSetLayout setLayout = mDescriptorLayout->getLayout();
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(Parameters);
+
+		for (uint32_t kernel = 0; kernel < KernelCount; kernel++) {
+			auto pipeline = Wrapper::ComputePipeline::create(mDevice);
+			pipeline->setShader(Wrapper::Shader::create(mDevice, ShaderPaths[kernel], VK_SHADER_STAGE_COMPUTE_BIT, "main"));
+			pipeline->mPipelineLayoutInfo.setLayoutCount = 1;
+			pipeline->mPipelineLayoutInfo.pSetLayouts = &setLayout;
+			pipeline->mPipelineLayoutInfo.pushConstantRangeCount = 1;
+			pipeline->mPipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+			pipeline->build();
+			mPipelines.push_back(pipeline);
+		}
+	}
+
+	void SkyAtmosphere::transitionImage(const Wrapper::CommandBuffer::Ptr& commandBuffer, const Wrapper::Image::Ptr& image, VkImageLayout newLayout, uint32_t levelCount) const {
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = levelCount;
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = image->getLayerCount();
+		image->setImageLayout(
+			newLayout,
+			newLayout == VK_IMAGE_LAYOUT_GENERAL ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			subresourceRange,
+			mCommandPool,
+			commandBuffer);
+	}
+
+	void SkyAtmosphere::dispatchKernel(const Wrapper::CommandBuffer::Ptr& commandBuffer, Kernel kernel, const Wrapper::Image::Ptr& target) {
+		commandBuffer->bindComputePipeline(mPipelines[kernel]);
+		VkDescriptorSet kernelSet = mDescriptorSet->getDescriptorSet(static_cast<int>(kernel));
+		commandBuffer->bindDescriptorSets(mPipelines[kernel]->getPipelineLayout(), 0, 1, &kernelSet, VK_PIPELINE_BIND_POINT_COMPUTE);
+		Parameters pushValue = mParameters;
+		commandBuffer->pushConstants(mPipelines[kernel]->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Parameters), &pushValue);
+		commandBuffer->dispatch(
+			(target->getWidth() + IBLComputeBaker::WorkGroupSize - 1) / IBLComputeBaker::WorkGroupSize,
+			(target->getHeight() + IBLComputeBaker::WorkGroupSize - 1) / IBLComputeBaker::WorkGroupSize,
+			target->getLayerCount());
+	}
+
+	void SkyAtmosphere::recordEnvironment(const Wrapper::CommandBuffer::Ptr& commandBuffer) {
+		// Each LUT is written in GENERAL and moved to SHADER_READ_ONLY before the next kernel samples it
+		if (mLUTsDirty) {
+			transitionImage(commandBuffer, mTransmittanceLUT, VK_IMAGE_LAYOUT_GENERAL, 1);
+			dispatchKernel(commandBuffer, Transmittance, mTransmittanceLUT);
+			transitionImage(commandBuffer, mTransmittanceLUT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+
+			transitionImage(commandBuffer, mMultiScatteringLUT, VK_IMAGE_LAYOUT_GENERAL, 1);
+			dispatchKernel(commandBuffer, MultiScattering, mMultiScatteringLUT);
+			transitionImage(commandBuffer, mMultiScatteringLUT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+			mLUTsDirty = false;
+		}
+
+		transitionImage(commandBuffer, mSkyViewLUT, VK_IMAGE_LAYOUT_GENERAL, 1);
+		dispatchKernel(commandBuffer, SkyView, mSkyViewLUT);
+		transitionImage(commandBuffer, mSkyViewLUT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+
+		// The whole chain goes to GENERAL, generateMipmaps takes it from there to SHADER_READ_ONLY
+		transitionImage(commandBuffer, mEnvironment, VK_IMAGE_LAYOUT_GENERAL, mEnvironment->getMipLevels());
+		dispatchKernel(commandBuffer, CubeMap, mEnvironment);
+		if (mEnvironment->getMipLevels() > 1) {
+			mEnvironment->generateMipmaps(mCommandPool, commandBuffer);
+		}
+		else {
+			transitionImage(commandBuffer, mEnvironment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+		}
+	}
+
+	void SkyAtmosphere::submitEnvironment() {
+		// Long done by now: the previous environment was copied by the commands that follow it
+		mFence->waitForFence();
+		mFence->resetFence();
+		mCommandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		recordEnvironment(mCommandBuffer);
+		mCommandBuffer->endCommandBuffer();
+		mCommandBuffer->submitCommandBuffer(mDevice->getGraphicQueue(), mFence->getFence());
+	}
+
+	Wrapper::Image::Ptr SkyAtmosphere::renderEnvironment() {
+		mFence->waitForFence();
+		Wrapper::Image::Ptr environment = createEnvironmentImage();
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mEnvironment->getMipLevels();
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.layerCount = mEnvironment->getLayerCount();
+
+		Wrapper::CommandBuffer::Ptr commandBuffer = Wrapper::CommandBuffer::create(mDevice, mCommandPool);
+		commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		recordEnvironment(commandBuffer);
+		mEnvironment->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange, mCommandPool, commandBuffer);
+		environment->setImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange, mCommandPool, commandBuffer);
+		std::vector<VkImageCopy> regions;
+		for (uint32_t mipLevel = 0; mipLevel < mEnvironment->getMipLevels(); mipLevel++) {
+			const uint32_t mipSize = std::max(1u, mEnvironment->getWidth() >> mipLevel);
+			VkImageCopy region{};
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, mEnvironment->getLayerCount() };
+			region.dstSubresource = region.srcSubresource;
+			region.extent = { mipSize, mipSize, 1 };
+			regions.push_back(region);
+		}
+		commandBuffer->copyImage(mEnvironment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, environment->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions);
+		mEnvironment->setImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange, mCommandPool, commandBuffer);
+		environment->setImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange, mCommandPool, commandBuffer);
+		commandBuffer->endCommandBuffer();
+		commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+		commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		return environment;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "../base.h"
+#include "../vulkanWrapper/device.h"
+#include "../vulkanWrapper/commandPool.h"
+#include "../vulkanWrapper/commandBuffer.h"
+#include "../vulkanWrapper/fence.h"
+#include "../vulkanWrapper/computePipeline.h"
+#include "../vulkanWrapper/shader.h"
+#include "../vulkanWrapper/image.h"
+#include "../vulkanWrapper/sampler.h"
+#include "../vulkanWrapper/description.h"
+#include "../vulkanWrapper/descriptorSetLayout.h"
+#include "../vulkanWrapper/descriptorPool.h"
+#include "../vulkanWrapper/descriptorSet.h"
+#include "texture.h"
+
+namespace FF {
+	/*
+	* Procedural sky from precomputed atmospheric scattering (Hillaire, "A Scalable and Production Ready Sky and Atmosphere Rendering Technique").
+	* Transmittance and multiple scattering LUTs only depend on the atmosphere and are computed once; the small sky view LUT
+	* depends on the sun and is rendered again whenever it moves, then expanded to an environment cubemap with a full mip chain.
+	* That cubemap is a drop in replacement of the HDRI one: skybox, IBL bakes and probe captures consume it unchanged.
+	* All four kernels are variants of SkyAtmosphere.comp and share one descriptor layout:
+	* binding 0 transmittance LUT, binding 1 storage target, binding 2 second input (multiple scattering or sky view LUT).
+	*/
+	class SkyAtmosphere {
+	public:
+		using Ptr = std::shared_ptr<SkyAtmosphere>;
+
+		// Earth like defaults, distances in km and coefficients per km. Pushed as is, layout of Atmosphere in SkyAtmosphere.comp
+		struct Parameters {
+			glm::vec3 mRayleighScattering{ 0.005802f, 0.013558f, 0.033100f };
+			float mRayleighScaleHeight{ 8.0f };
+			glm::vec3 mMieScattering{ 0.003996f };
+			float mMieScaleHeight{ 1.2f };
+			glm::vec3 mMieExtinction{ 0.004440f };
+			float mMieAnisotropy{ 0.8f };
+			glm::vec3 mOzoneAbsorption{ 0.000650f, 0.001881f, 0.000085f };
+			float mGroundRadius{ 6360.0f };
+			glm::vec3 mGroundAlbedo{ 0.3f };
+			float mAtmosphereRadius{ 6460.0f };
+			glm::vec3 mSunDirection{ 0.0f, 0.5f, 0.866f }; // towards the sun, normalized
+			float mSunIlluminance{ 10.0f }; // scene units, the HDRIs of the assets folder sit around this range
+			float mSunAngularRadius{ 0.004675f };
+			float mViewHeight{ 0.2f }; // camera height above the ground
+			float mSunDiskRadianceCap{ 100.0f };
+			float mPadding{ 0.0f };
+		};
+
+		struct Settings {
+			uint32_t mEnvironmentSize{ 128 }; // the sky is smooth, the sun disk is the only high frequency
+			uint32_t mTransmittanceWidth{ 256 };
+			uint32_t mTransmittanceHeight{ 64 };
+			uint32_t mMultiScatteringSize{ 32 };
+			uint32_t mSkyViewWidth{ 192 };
+			uint32_t mSkyViewHeight{ 108 };
+		};
+
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings = {}, const Parameters& parameters = {}) {
+			return std::make_shared<SkyAtmosphere>(device, commandPool, settings, parameters);
+		}
+
+		SkyAtmosphere(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const Settings& settings, const Parameters& parameters);
+		~SkyAtmosphere();
+
+		// Atmosphere changes recompute every LUT at the next render, sun changes only the sky view
+		void setParameters(const Parameters& parameters);
+		void setSunDirection(const glm::vec3& sunDirection);
+		// Elevation above the horizon and azimuth around +Y, in degrees
+		void setSunAngles(float elevationDegrees, float azimuthDegrees);
+
+		/// @brief Record the dirty LUTs, the sky view LUT and the environment cubemap (mip 0 then blitted mips).
+		/// The environment ends in SHADER_READ_ONLY layout. Nothing may read it while the commands run.
+		void recordEnvironment(const Wrapper::CommandBuffer::Ptr& commandBuffer);
+
+		/// @brief recordEnvironment in its own submission without waiting for it, later submissions on the graphics queue
+		/// may read getEnvironment. Nothing may read the environment any more when this is called, IBLRebaker::requestCubeMap copies it.
+		void submitEnvironment();
+
+		/// @brief recordEnvironment and a copy of the environment in its own submission, waits for it.
+		/// Returns the copy, in SHADER_READ_ONLY layout: later renders never write it, so it can stay bound.
+		Wrapper::Image::Ptr renderEnvironment();
+
+		// Cache key inputs: every parameter as raw bits plus the resolutions
+		[[nodiscard]] std::vector<uint32_t> getKeyParameters() const;
+
+		[[nodiscard]] const Parameters& getParameters() const { return mParameters; }
+		[[nodiscard]] Wrapper::Image::Ptr getEnvironment() const { return mEnvironment; }
+		[[nodiscard]] Wrapper::Image::Ptr getTransmittanceLUT() const { return mTransmittanceLUT; }
+		[[nodiscard]] Wrapper::Image::Ptr getSkyViewLUT() const { return mSkyViewLUT; }
+
+		static constexpr const char* ShaderPaths[4] = {
+			"shaders/SkyTransmittanceComp.spv",
+			"shaders/SkyMultiScatteringComp.spv",
+			"shaders/SkyViewComp.spv",
+			"shaders/SkyCubeMapComp.spv"
+		};
+
+	private:
+		enum Kernel : uint32_t {
+			Transmittance = 0,
+			MultiScattering,
+			SkyView,
+			CubeMap,
+			KernelCount
+		};
+
+		Wrapper::Image::Ptr createLUT(uint32_t width, uint32_t height) const;
+		Wrapper::Image::Ptr createEnvironmentImage() const;
+		void buildKernels();
+		void dispatchKernel(const Wrapper::CommandBuffer::Ptr& commandBuffer, Kernel kernel, const Wrapper::Image::Ptr& target);
+		// GENERAL for a kernel to write, SHADER_READ_ONLY for the next one to sample
+		void transitionImage(const Wrapper::CommandBuffer::Ptr& commandBuffer, const Wrapper::Image::Ptr& image, VkImageLayout newLayout, uint32_t levelCount) const;
+
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		Settings mSettings{};
+		Parameters mParameters{};
+		bool mLUTsDirty{ true };
+
+		Wrapper::Image::Ptr mTransmittanceLUT{ nullptr };
+		Wrapper::Image::Ptr mMultiScatteringLUT{ nullptr };
+		Wrapper::Image::Ptr mSkyViewLUT{ nullptr };
+		// Target of every render, never bound for drawing: renderEnvironment and the rebaker sample copies of it
+		Wrapper::Image::Ptr mEnvironment{ nullptr };
+		// Storage view of mip 0 of the environment, a 2D array over the faces
+		VkImageView mEnvironmentStorageView{ VK_NULL_HANDLE };
+		Wrapper::Sampler::Ptr mSampler{ nullptr };
+
+		// One set per kernel, same layout
+		std::vector<Wrapper::UniformParameter::Ptr> mUniformParameters{};
+		Wrapper::DescriptorSetLayout::Ptr mDescriptorLayout{ nullptr };
+		Wrapper::DescriptorPool::Ptr mDescriptorPool{ nullptr };
+		Wrapper::DescriptorSet::Ptr mDescriptorSet{ nullptr };
+		std::vector<Wrapper::ComputePipeline::Ptr> mPipelines{};
+
+		// Of submitEnvironment, only waited for before it is recorded again
+		Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+		Wrapper::Fence::Ptr mFence{ nullptr };
+	};
+}
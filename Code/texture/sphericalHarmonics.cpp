@@ -0,0 +1,279 @@
+#include "sphericalHarmonics.h"
+#include "../vulkanWrapper/cpuProfiler.h"
+#include "../stb_image.h"
+#include <thread>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FF_SH_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace FF {
+
+	namespace {
+		const float PI = 3.14159265359f;
+
+		// Real SH basis constants
+		const float Y00 = 0.282095f;
+		const float Y1 = 0.488603f;
+		const float Y2 = 1.092548f;
+		const float Y20 = 0.315392f;
+		const float Y22 = 0.546274f;
+
+		// Clamped cosine convolution per band divided by PI: (PI, 2PI/3, PI/4) / PI
+		const float BandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+		void evaluateBasis(float x, float y, float z, float basis[9]) {
+			basis[0] = Y00;
+			basis[1] = Y1 * y;
+			basis[2] = Y1 * z;
+			basis[3] = Y1 * x;
+			basis[4] = Y2 * x * y;
+			basis[5] = Y2 * y * z;
+			basis[6] = Y20 * (3.0f * z * z - 1.0f);
+			basis[7] = Y2 * x * z;
+			basis[8] = Y22 * (x * x - y * y);
+		}
+
+		// CubeFaceDirection of the bake kernels
+		void cubeFaceDirection(uint32_t face, float s, float t, float direction[3]) {
+			switch (face) {
+			case 0: direction[0] = 1.0f; direction[1] = -t; direction[2] = -s; break; // +X
+			case 1: direction[0] = -1.0f; direction[1] = -t; direction[2] = s; break; // -X
+			case 2: direction[0] = s; direction[1] = 1.0f; direction[2] = t; break; // +Y
+			case 3: direction[0] = s; direction[1] = -1.0f; direction[2] = -t; break; // -Y
+			case 4: direction[0] = s; direction[1] = -t; direction[2] = 1.0f; break; // +Z
+			default: direction[0] = -s; direction[1] = -t; direction[2] = -1.0f; break; // -Z
+			}
+		}
+
+		// Solid angle of the face region [0,0]-[x,y] in [-1,1] face coordinates
+		float cubeAreaElement(float x, float y) {
+			return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+		}
+
+		// Radiance * basis summed over rows, double so millions of texels do not lose precision
+		struct SH9Sum {
+			double mRGB[9][3]{};
+		};
+
+		void projectRows(const float* pixelsRGBA, uint32_t width, uint32_t height,
+			const std::vector<float>& cosPhi, const std::vector<float>& sinPhi,
+			uint32_t firstRow, uint32_t lastRow, SH9Sum& sum) {
+
+			const float texelArea = (2.0f * PI / width) * (PI / height);
+
+			for (uint32_t row = firstRow; row < lastRow; row++) {
+				// HDRI2Cubemap.frag: v = asin(y) / PI + 0.5
+				const float elevation = ((row + 0.5f) / height - 0.5f) * PI;
+				const float y = std::sin(elevation);
+				const float cosElevation = std::cos(elevation);
+				const float* rowPixels = pixelsRGBA + static_cast<size_t>(row) * width * 4;
+
+				float rowSum[9][3]{};
+				uint32_t column = 0;
+
+#ifdef FF_SH_USE_SSE
+				__m128 accR[9], accG[9], accB[9];
+				for (int k = 0; k < 9; k++) {
+					accR[k] = _mm_setzero_ps();
+					accG[k] = _mm_setzero_ps();
+					accB[k] = _mm_setzero_ps();
+				}
+				const __m128 vY = _mm_set1_ps(y);
+				const __m128 vCosElevation = _mm_set1_ps(cosElevation);
+				const __m128 vBasis0 = _mm_set1_ps(Y00);
+				const __m128 vBasis1 = _mm_set1_ps(Y1 * y);
+				const __m128 vY1 = _mm_set1_ps(Y1);
+				const __m128 vY2 = _mm_set1_ps(Y2);
+				const __m128 vY20 = _mm_set1_ps(Y20);
+				const __m128 vY22 = _mm_set1_ps(Y22);
+				const __m128 vThree = _mm_set1_ps(3.0f);
+				const __m128 vOne = _mm_set1_ps(1.0f);
+
+				for (; column + 4 <= width; column += 4) {
+					const __m128 vX = _mm_mul_ps(_mm_loadu_ps(&cosPhi[column]), vCosElevation);
+					const __m128 vZ = _mm_mul_ps(_mm_loadu_ps(&sinPhi[column]), vCosElevation);
+
+					__m128 basis[9];
+					basis[0] = vBasis0;
+					basis[1] = vBasis1;
+					basis[2] = _mm_mul_ps(vY1, vZ);
+					basis[3] = _mm_mul_ps(vY1, vX);
+					basis[4] = _mm_mul_ps(vY2, _mm_mul_ps(vX, vY));
+					basis[5] = _mm_mul_ps(vY2, _mm_mul_ps(vY, vZ));
+					basis[6] = _mm_mul_ps(vY20, _mm_sub_ps(_mm_mul_ps(vThree, _mm_mul_ps(vZ, vZ)), vOne));
+					basis[7] = _mm_mul_ps(vY2, _mm_mul_ps(vX, vZ));
+					basis[8] = _mm_mul_ps(vY22, _mm_sub_ps(_mm_mul_ps(vX, vX), _mm_mul_ps(vY, vY)));
+
+					// 4 RGBA texels -> R, G, B, A lanes
+					__m128 texel0 = _mm_loadu_ps(rowPixels + (column + 0) * 4);
+					__m128 texel1 = _mm_loadu_ps(rowPixels + (column + 1) * 4);
+					__m128 texel2 = _mm_loadu_ps(rowPixels + (column + 2) * 4);
+					__m128 texel3 = _mm_loadu_ps(rowPixels + (column + 3) * 4);
+					_MM_TRANSPOSE4_PS(texel0, texel1, texel2, texel3);
+
+					for (int k = 0; k < 9; k++) {
+						accR[k] = _mm_add_ps(accR[k], _mm_mul_ps(basis[k], texel0));
+						accG[k] = _mm_add_ps(accG[k], _mm_mul_ps(basis[k], texel1));
+						accB[k] = _mm_add_ps(accB[k], _mm_mul_ps(basis[k], texel2));
+					}
+				}
+
+				for (int k = 0; k < 9; k++) {
+					float lanes[4];
+					_mm_storeu_ps(lanes, accR[k]);
+					rowSum[k][0] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+					_mm_storeu_ps(lanes, accG[k]);
+					rowSum[k][1] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+					_mm_storeu_ps(lanes, accB[k]);
+					rowSum[k][2] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+				}
+#endif
+
+				// Remaining texels (or all of them without SSE)
+				for (; column < width; column++) {
+					float basis[9];
+					evaluateBasis(cosPhi[column] * cosElevation, y, sinPhi[column] * cosElevation, basis);
+					const float* texel = rowPixels + column * 4;
+					for (int k = 0; k < 9; k++) {
+						rowSum[k][0] += basis[k] * texel[0];
+						rowSum[k][1] += basis[k] * texel[1];
+						rowSum[k][2] += basis[k] * texel[2];
+					}
+				}
+
+				// Every texel of a row covers the same solid angle
+				const double solidAngle = static_cast<double>(texelArea) * cosElevation;
+				for (int k = 0; k < 9; k++) {
+					for (int c = 0; c < 3; c++) {
+						sum.mRGB[k][c] += rowSum[k][c] * solidAngle;
+					}
+				}
+			}
+		}
+	}
+
+	SH9Irradiance SphericalHarmonics::projectEquirectIrradiance(const float* pixelsRGBA, uint32_t width, uint32_t height, uint32_t threadCount) {
+		FF_CPU_ZONE("SphericalHarmonics::projectEquirectIrradiance");
+		if (pixelsRGBA == nullptr || width == 0 || height == 0) {
+			throw std::runtime_error("Error: invalid image for SH projection!");
+		}
+
+		// HDRI2Cubemap.frag: u = atan(z, x) / (2 PI) + 0.5, constant per column
+		std::vector<float> cosPhi(width);
+		std::vector<float> sinPhi(width);
+		for (uint32_t column = 0; column < width; column++) {
+			const float phi = ((column + 0.5f) / width - 0.5f) * 2.0f * PI;
+			cosPhi[column] = std::cos(phi);
+			sinPhi[column] = std::sin(phi);
+		}
+
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threadCount = std::min(threadCount, height);
+
+		std::vector<SH9Sum> partialSums(threadCount);
+		std::vector<std::thread> workers;
+		const uint32_t rowsPerThread = (height + threadCount - 1) / threadCount;
+		for (uint32_t t = 0; t < threadCount; t++) {
+			const uint32_t firstRow = t * rowsPerThread;
+			const uint32_t lastRow = std::min(height, firstRow + rowsPerThread);
+			if (firstRow >= lastRow) {
+				break;
+			}
+			workers.emplace_back(projectRows, pixelsRGBA, width, height, std::cref(cosPhi), std::cref(sinPhi), firstRow, lastRow, std::ref(partialSums[t]));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+
+		SH9Irradiance result{};
+		for (int k = 0; k < 9; k++) {
+			double rgb[3]{};
+			for (const auto& partial : partialSums) {
+				for (int c = 0; c < 3; c++) {
+					rgb[c] += partial.mRGB[k][c];
+				}
+			}
+			result.mCoefficients[k] = glm::vec4(
+				static_cast<float>(rgb[0]) * BandScale[k],
+				static_cast<float>(rgb[1]) * BandScale[k],
+				static_cast<float>(rgb[2]) * BandScale[k],
+				0.0f);
+		}
+		return result;
+	}
+
+	SH9Irradiance SphericalHarmonics::projectEquirectIrradianceFromFile(const std::string& filePath, uint32_t threadCount) {
+		int texWidth = 0, texHeight = 0, texChannels = 0;
+		stbi_set_flip_vertically_on_load(0);
+		float* pixels = stbi_loadf(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels || texWidth <= 0 || texHeight <= 0) {
+			throw std::runtime_error("Error: failed to load image for SH projection! Path: " + filePath);
+		}
+
+		SH9Irradiance result = projectEquirectIrradiance(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), threadCount);
+		stbi_image_free(pixels);
+		return result;
+	}
+
+	SH9Irradiance SphericalHarmonics::projectCubeMapIrradiance(const IBLImageData& cubeMap, uint32_t level) {
+		if (!cubeMap.isCubeMap() || level >= cubeMap.mMipLevels) {
+			throw std::runtime_error("Error: invalid cubemap for SH projection!");
+		}
+
+		// Probe captures are small, a single thread is enough
+		const uint32_t faceSize = cubeMap.getLevelWidth(level);
+		const float invSize = 1.0f / faceSize;
+		SH9Sum sum{};
+		for (uint32_t face = 0; face < 6; face++) {
+			for (uint32_t y = 0; y < faceSize; y++) {
+				for (uint32_t x = 0; x < faceSize; x++) {
+					const float s = (x + 0.5f) * 2.0f * invSize - 1.0f;
+					const float t = (y + 0.5f) * 2.0f * invSize - 1.0f;
+					const float x0 = x * 2.0f * invSize - 1.0f;
+					const float y0 = y * 2.0f * invSize - 1.0f;
+					const float x1 = x0 + 2.0f * invSize;
+					const float y1 = y0 + 2.0f * invSize;
+					const double solidAngle = cubeAreaElement(x0, y0) - cubeAreaElement(x0, y1) - cubeAreaElement(x1, y0) + cubeAreaElement(x1, y1);
+
+					float direction[3];
+					cubeFaceDirection(face, s, t, direction);
+					const float invLength = 1.0f / std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+					float basis[9];
+					evaluateBasis(direction[0] * invLength, direction[1] * invLength, direction[2] * invLength, basis);
+
+					const float* texel = cubeMap.getTexel(level, face, x, y);
+					for (int k = 0; k < 9; k++) {
+						for (int c = 0; c < 3; c++) {
+							sum.mRGB[k][c] += basis[k] * texel[c] * solidAngle;
+						}
+					}
+				}
+			}
+		}
+
+		SH9Irradiance result{};
+		for (int k = 0; k < 9; k++) {
+			result.mCoefficients[k] = glm::vec4(
+				static_cast<float>(sum.mRGB[k][0]) * BandScale[k],
+				static_cast<float>(sum.mRGB[k][1]) * BandScale[k],
+				static_cast<float>(sum.mRGB[k][2]) * BandScale[k],
+				0.0f);
+		}
+		return result;
+	}
+
+	glm::vec3 SphericalHarmonics::evaluate(const SH9Irradiance& sh, const glm::vec3& normal) {
+		float basis[9];
+		evaluateBasis(normal.x, normal.y, normal.z, basis);
+		glm::vec3 irradiance(0.0f);
+		for (int k = 0; k < 9; k++) {
+			irradiance += glm::vec3(sh.mCoefficients[k]) * basis[k];
+		}
+		return glm::max(irradiance, glm::vec3(0.0f));
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "../base.h"
+#include "iblImageData.h"
+
+namespace FF {
+	/*
+	* Diffuse irradiance as 9 spherical harmonics coefficients (bands 0-2), already convolved with the clamped cosine lobe
+	* and divided by PI, so evaluating it gives the same value CaptureDiffuseIrradiance.frag stores in the irradiance cubemap.
+	* std140 layout: one vec4 per coefficient, rgb used.
+	*/
+	struct SH9Irradiance {
+		glm::vec4 mCoefficients[9]{};
+	};
+
+	class SphericalHarmonics {
+	public:
+		/// @brief Project an equirectangular RGBA32F image, mapped the same way HDRI2Cubemap.frag samples it.
+		/// Rows are split across threads, each row is accumulated 4 texels at a time with SSE when available.
+		/// @param threadCount 0 uses every hardware thread.
+		static SH9Irradiance projectEquirectIrradiance(const float* pixelsRGBA, uint32_t width, uint32_t height, uint32_t threadCount = 0);
+
+		static SH9Irradiance projectEquirectIrradianceFromFile(const std::string& filePath, uint32_t threadCount = 0);
+
+		/// @brief Project one mip level of an RGBA32F cubemap, every texel weighted by its exact solid angle.
+		/// Faces follow the Vulkan cube face table, like the captures and the bake kernels.
+		static SH9Irradiance projectCubeMapIrradiance(const IBLImageData& cubeMap, uint32_t level = 0);
+
+		// CPU reference of EvaluateIrradianceSH in pbr1.frag
+		static glm::vec3 evaluate(const SH9Irradiance& sh, const glm::vec3& normal);
+	};
+}
@@ -1,4 +1,5 @@
 #include "texture.h"
+#include "../vulkanWrapper/cpuProfiler.h"
 
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -8,6 +9,7 @@
 namespace FF {
 	Texture::Texture(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& filePath)
 		: mDevice(device),mCommandPool(commandPool), mFilePath(filePath) {
+		FF_CPU_ZONE("Texture::load");
 
 		int texWidth, texHeight, texSize, texChannels;
 		//stbi_set_flip_vertically_on_load(true); // Flip the image vertically to match Vulkan's coordinate system
@@ -69,6 +71,7 @@ namespace FF {
 	}
     Texture::Texture(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& filePath, VkFormat format)
 		: mDevice(device), mCommandPool(commandPool), mFilePath(filePath) {
+		FF_CPU_ZONE("Texture::loadHDR");
 		int texWidth, texHeight, texSize, texChannels;
 		//stbi_set_flip_vertically_on_load(true); // Flip the image vertically to match Vulkan's coordinate system
 		float* pixels = stbi_loadf(filePath.c_str(), &texWidth, &texHeight, &texChannels, 0);
@@ -134,6 +137,7 @@ namespace FF {
         const Wrapper::CommandPool::Ptr& commandPool,
         const std::array<std::string, 6>& cubemapPaths)
         : mDevice(device), mCommandPool(commandPool) {
+        FF_CPU_ZONE("Texture::loadCubeMap");
 
         int texWidth = 0, texHeight = 0, texChannels = 0;
         std::vector<stbi_uc*> facePixels(6);
@@ -0,0 +1,96 @@
+#include "threadPool.h"
+#include "vulkanWrapper/cpuProfiler.h"
+#include <atomic>
+
+namespace FF {
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (uint32_t i = 1; i < threadCount; i++) {
+			mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mCondition.notify_all();
+		for (auto& worker : mWorkers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::enqueue(Task task) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mTasks.push_back(std::move(task));
+		}
+		mCondition.notify_one();
+	}
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+				if (mStopping && mTasks.empty()) {
+					return;
+				}
+				task = std::move(mTasks.front());
+				mTasks.pop_front();
+			}
+			FF_CPU_ZONE("ThreadPool::task");
+			task();
+		}
+	}
+
+	void ThreadPool::parallelFor(uint32_t count, const RangeTask& task, uint32_t grainSize) {
+		if (count == 0) {
+			return;
+		}
+		if (grainSize == 0) {
+			grainSize = std::max(1u, count / (getThreadCount() * 4));
+		}
+		const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+		if (chunkCount == 1 || mWorkers.empty()) {
+			task(0, count);
+			return;
+		}
+
+		// Chunks are claimed through a shared counter so fast threads pick up more of them
+		struct SharedState {
+			std::atomic<uint32_t> mNextChunk{ 0 };
+			std::atomic<uint32_t> mDoneChunks{ 0 };
+			std::mutex mMutex;
+			std::condition_variable mDone;
+		};
+		auto state = std::make_shared<SharedState>();
+
+		auto runChunks = [state, &task, count, grainSize, chunkCount]() {
+			uint32_t chunk;
+			while ((chunk = state->mNextChunk.fetch_add(1)) < chunkCount) {
+				const uint32_t begin = chunk * grainSize;
+				task(begin, std::min(count, begin + grainSize));
+				if (state->mDoneChunks.fetch_add(1) + 1 == chunkCount) {
+					std::lock_guard<std::mutex> lock(state->mMutex);
+					state->mDone.notify_all();
+				}
+			}
+		};
+
+		const uint32_t helperCount = std::min(static_cast<uint32_t>(mWorkers.size()), chunkCount - 1);
+		for (uint32_t i = 0; i < helperCount; i++) {
+			enqueue(runChunks);
+		}
+		runChunks();
+
+		// Helpers that never got scheduled exit immediately, so only wait for chunks that are still running
+		std::unique_lock<std::mutex> lock(state->mMutex);
+		state->mDone.wait(lock, [&]() { return state->mDoneChunks.load() == chunkCount; });
+	}
+}
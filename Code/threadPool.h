@@ -0,0 +1,48 @@
+#pragma once
+#include "base.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+namespace FF {
+	/*
+	* Fixed set of worker threads fed from one task queue.
+	* parallelFor splits [0, count) into chunks and blocks until every chunk ran, the calling thread helps with the work.
+	*/
+	class ThreadPool {
+	public:
+		using Ptr = std::shared_ptr<ThreadPool>;
+		using Task = std::function<void()>;
+		using RangeTask = std::function<void(uint32_t begin, uint32_t end)>;
+
+		/// @param threadCount 0 uses every hardware thread (the caller counts as one of them).
+		static Ptr create(uint32_t threadCount = 0) {
+			return std::make_shared<ThreadPool>(threadCount);
+		}
+
+		ThreadPool(uint32_t threadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void enqueue(Task task);
+
+		/// @param grainSize smallest chunk handed to one task, 0 picks about 4 chunks per thread.
+		void parallelFor(uint32_t count, const RangeTask& task, uint32_t grainSize = 0);
+
+		[[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(mWorkers.size()) + 1; }
+
+	private:
+		void workerLoop();
+
+	private:
+		std::vector<std::thread> mWorkers{};
+		std::deque<Task> mTasks{};
+		std::mutex mMutex{};
+		std::condition_variable mCondition{};
+		bool mStopping{ false };
+	};
+}
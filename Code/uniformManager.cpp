@@ -71,7 +71,7 @@ void UniformManager::init(const Wrapper::Device::Ptr& device, const Wrapper::Com
 
 }
 
-void UniformManager::attachCubeMap(Wrapper::Image::Ptr& inImage) {
+void UniformManager::attachCubeMap(const Wrapper::Image::Ptr& inImage) {
 	auto textureParam = Wrapper::UniformParameter::create();
 	textureParam->mBinding = mUniformParameters.size(); // Use the next binding index
 	textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -88,7 +88,7 @@ void UniformManager::attachCubeMap(Wrapper::Image::Ptr& inImage) {
 	mUniformParameters.push_back(textureParam);
 }
 
-void UniformManager::attachImage(Wrapper::Image::Ptr& inImage) {
+void UniformManager::attachImage(const Wrapper::Image::Ptr& inImage) {
 	auto textureParam = Wrapper::UniformParameter::create();
 	textureParam->mBinding = mUniformParameters.size(); // Use the next binding index
 	textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -105,7 +105,7 @@ void UniformManager::attachImage(Wrapper::Image::Ptr& inImage) {
 	mUniformParameters.push_back(textureParam);
 }
 
-void UniformManager::attachMapImage(Wrapper::Image::Ptr& inImage) {
+void UniformManager::attachMapImage(const Wrapper::Image::Ptr& inImage) {
 	auto textureParam = Wrapper::UniformParameter::create();
 	textureParam->mBinding = mUniformParameters.size(); // Use the next binding index
 	textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -122,6 +122,64 @@ void UniformManager::attachMapImage(Wrapper::Image::Ptr& inImage) {
 	mUniformParameters.push_back(textureParam);
 }
 
+void UniformManager::reserveImageBinding() {
+	auto textureParam = Wrapper::UniformParameter::create();
+	textureParam->mBinding = mUniformParameters.size(); // Use the next binding index
+	textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	textureParam->mCount = 1;
+	textureParam->mStageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	if (mDevice->isDescriptorIndexingSupported()) {
+		// No texture: DescriptorSet skips the write, valid as long as the descriptor is never dynamically used
+		textureParam->mBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+		mUniformParameters.push_back(textureParam);
+		return;
+	}
+
+	// Without partially bound bindings every descriptor must be written: a 1x1 texture the shader never samples
+	auto dummyImage = Wrapper::Image::create(
+		mDevice, 1, 1,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_TYPE_2D,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VK_SAMPLE_COUNT_1_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT);
+	VkImageSubresourceRange subresourceRange{};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = 1;
+	subresourceRange.baseArrayLayer = 0;
+	subresourceRange.layerCount = 1;
+	dummyImage->setImageLayout(
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		subresourceRange,
+		mcommandpool);
+	auto image2DSampler = Wrapper::Sampler::create(mDevice);
+
+	textureParam->mTextures.resize(mFrameCount);
+	for (int i = 0; i < mFrameCount; i++) {
+		textureParam->mTextures[i].push_back(Texture::createFromImage(mDevice, dummyImage, image2DSampler));
+	}
+	mUniformParameters.push_back(textureParam);
+}
+
+void UniformManager::attachUniformData(const void* pData, size_t size, VkShaderStageFlags stageFlags) {
+	auto uniformParam = Wrapper::UniformParameter::create();
+	uniformParam->mBinding = mUniformParameters.size(); // Use the next binding index
+	uniformParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uniformParam->mCount = 1;
+	uniformParam->mStageFlags = stageFlags;
+	uniformParam->mSize = size;
+
+	for (int i = 0; i < mFrameCount; i++) {
+		auto buffer = Wrapper::Buffer::createUniformBuffer(mDevice, uniformParam->mSize, const_cast<void*>(pData));
+		uniformParam->mBuffers.push_back(buffer);
+	}
+	mUniformParameters.push_back(uniformParam);
+}
 
 void UniformManager::build() {
 	mDescriptorLayout = Wrapper::DescriptorSetLayout::create(mDevice);
@@ -137,4 +195,27 @@ void UniformManager::updateUniformBuffer(const NVPMatrices& vpMatrices, const Ob
 	mUniformParameters[1]->mBuffers[frameCount]->updateBufferByMap(reinterpret_cast<const void*>(&objectUniform), sizeof(ObjectUniform));
 
 	mUniformParameters[3]->mBuffers[frameCount]->updateBufferByMap(reinterpret_cast<const void*>(&cameraParams), sizeof(cameraParameters));
-}
\ No newline at end of file
+}
+
+void UniformManager::replaceImage(uint32_t binding, const Wrapper::Image::Ptr& inImage) {
+	for (int i = 0; i < mFrameCount; i++) {
+		replaceImage(binding, inImage, i);
+	}
+}
+
+void UniformManager::replaceImage(uint32_t binding, const Wrapper::Image::Ptr& inImage, int frameIndex) {
+	auto& textureParam = mUniformParameters[binding];
+	auto tex = Texture::createFromImage(mDevice, inImage, textureParam->mTextures[frameIndex][0]->getSampler());
+	textureParam->mTextures[frameIndex][0] = tex;
+	mDescriptorSet->updateImage(frameIndex, binding, 0, tex->getImageInfo());
+}
+
+void UniformManager::updateUniformData(uint32_t binding, const void* pData, size_t size) {
+	for (int i = 0; i < mFrameCount; i++) {
+		updateUniformData(binding, pData, size, i);
+	}
+}
+
+void UniformManager::updateUniformData(uint32_t binding, const void* pData, size_t size, int frameIndex) {
+	mUniformParameters[binding]->mBuffers[frameIndex]->updateBufferByMap(pData, size);
+}
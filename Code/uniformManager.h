@@ -20,10 +20,23 @@ public:
 	~UniformManager();
 	void init(const Wrapper::Device::Ptr &device, const Wrapper::CommandPool::Ptr &commandPool,int frameCount);
 	void build();
-	void attachCubeMap(Wrapper::Image::Ptr &inImage);
-	void attachImage(Wrapper::Image::Ptr& inImage);
-	void attachMapImage(Wrapper::Image::Ptr& inImage);
+	void attachCubeMap(const Wrapper::Image::Ptr& inImage);
+	void attachImage(const Wrapper::Image::Ptr& inImage);
+	void attachMapImage(const Wrapper::Image::Ptr& inImage);
+	// Sampler binding for a resource the shader variant never reads, keeps the following bindings in place.
+	// Left empty (partially bound) with descriptor indexing, bound to a 1x1 texture otherwise
+	void reserveImageBinding();
+	// Uniform buffer at the next binding index, filled once with pData for every frame
+	void attachUniformData(const void* pData, size_t size, VkShaderStageFlags stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT);
 	void updateUniformBuffer(const NVPMatrices &vpMatrices, const ObjectUniform &objectUniform, const cameraParameters& cameraParams, const int frameCount);
+	// Point an image binding of every frame at another image, keeping its sampler.
+	// The sets must not be in use, command buffers that bound them have to be recorded again.
+	void replaceImage(uint32_t binding, const Wrapper::Image::Ptr& inImage);
+	// Rewrite the buffers of an attachUniformData binding for every frame
+	void updateUniformData(uint32_t binding, const void* pData, size_t size);
+	// Same for the set of one frame only, the other frames keep the previous image or data until they are rewritten too
+	void replaceImage(uint32_t binding, const Wrapper::Image::Ptr& inImage, int frameIndex);
+	void updateUniformData(uint32_t binding, const void* pData, size_t size, int frameIndex);
 
 	[[nodiscard]] auto getDescriptorLayout() const {
 		return mDescriptorLayout;
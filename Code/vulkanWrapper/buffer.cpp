@@ -74,6 +74,19 @@ namespace FF::Wrapper {
 		return buffer;
 	}
 
+	// Host visible storage buffer, for small parameter tables that are rewritten from the CPU
+	Buffer::Ptr Buffer::createStorageBuffer(const Device::Ptr& device, VkDeviceSize size, void* pData) {
+		auto buffer = Buffer::create(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (pData != nullptr) {
+			buffer->updateBufferByMap(pData, size);
+		}
+		return buffer;
+	}
+
+	// Host visible transfer destination, used to read gpu results back to the cpu
+	Buffer::Ptr Buffer::createReadbackBuffer(const Device::Ptr& device, VkDeviceSize size) {
+		return Buffer::create(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
 
 	void Buffer::copyBuffer(const VkBuffer& srcBuffer, const VkBuffer& dstBuffer, VkDeviceSize size) {
 		auto commandPool = CommandPool::create(mDevice);
@@ -92,13 +105,20 @@ namespace FF::Wrapper {
 
 	}
 
-	void Buffer::updateBufferByMap(const void* data, VkDeviceSize size) {
+	void Buffer::updateBufferByMap(const void* data, VkDeviceSize size, VkDeviceSize offset) {
 		void* mappedData;
-		vkMapMemory(mDevice->getDevice(), mMemory, 0, size, 0, &mappedData);
+		vkMapMemory(mDevice->getDevice(), mMemory, offset, size, 0, &mappedData);
 		memcpy(mappedData, data, static_cast<size_t>(size));
 		vkUnmapMemory(mDevice->getDevice(), mMemory);
 	}
 
+	void Buffer::readBufferByMap(void* data, VkDeviceSize size) {
+		void* mappedData;
+		vkMapMemory(mDevice->getDevice(), mMemory, 0, size, 0, &mappedData);
+		memcpy(data, mappedData, static_cast<size_t>(size));
+		vkUnmapMemory(mDevice->getDevice(), mMemory);
+	}
+
 	void Buffer::updateBufferByStage(void* data, VkDeviceSize size) {
 		// Create a staging buffer
 		auto stagingBuffer = Buffer::createStageBuffer(mDevice, size, nullptr);
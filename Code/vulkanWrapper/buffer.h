@@ -17,13 +17,16 @@ namespace FF::Wrapper {
 		static Ptr createIndexBuffer(const Device::Ptr& device, VkDeviceSize size, void* pData);
 		static Ptr createUniformBuffer(const Device::Ptr& device, VkDeviceSize size, void* pData = nullptr);
 		static Ptr createStageBuffer(const Device::Ptr& device, VkDeviceSize size, void* pData = nullptr);
+		static Ptr createStorageBuffer(const Device::Ptr& device, VkDeviceSize size, void* pData = nullptr);
+		static Ptr createReadbackBuffer(const Device::Ptr& device, VkDeviceSize size);
 
 
 		Buffer(const Device::Ptr& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 		~Buffer();
 
 		//change memory by Mapping, suitable for Host visible memory
-		void updateBufferByMap(const void* data, VkDeviceSize size);
+		void updateBufferByMap(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		void readBufferByMap(void* data, VkDeviceSize size);
 		//If memory is Local optimal, should create StageBuffer, first copy to stage buffer, then copy to this buffer'
 		void updateBufferByStage(void* data, VkDeviceSize size);
 		void copyBuffer(const VkBuffer& srcBuffer, const VkBuffer& dstBuffer, VkDeviceSize size);
@@ -42,6 +42,30 @@ namespace FF::Wrapper {
 		vkCmdBindPipeline(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
 	}
 
+	void CommandBuffer::setViewport(const VkViewport& viewport) {
+		vkCmdSetViewport(mCommandBuffer, 0, 1, &viewport);
+	}
+
+	void CommandBuffer::setScissor(const VkRect2D& scissor) {
+		vkCmdSetScissor(mCommandBuffer, 0, 1, &scissor);
+	}
+
+	void CommandBuffer::setViewportAndScissor(uint32_t width, uint32_t height, bool flipViewport) {
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = flipViewport ? static_cast<float>(height) : 0.0f;
+		viewport.width = static_cast<float>(width);
+		viewport.height = flipViewport ? -static_cast<float>(height) : static_cast<float>(height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		setViewport(viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = { width, height };
+		setScissor(scissor);
+	}
+
 	void CommandBuffer::bindVertexBuffer(const std::vector<VkBuffer>& buffers, uint32_t binding, std::vector<VkDeviceSize> offsets) {
 		offsets.resize(buffers.size(), 0);
 		vkCmdBindVertexBuffers(mCommandBuffer, binding, static_cast<uint32_t>(buffers.size()), buffers.data(), offsets.data());
@@ -55,23 +79,52 @@ namespace FF::Wrapper {
 		vkCmdBindDescriptorSets(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &descriptorSet, 0, nullptr);
 	}
 
-	void CommandBuffer::bindDescriptorSets(const VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets) {
-		vkCmdBindDescriptorSets(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet, descriptorSetCount, pDescriptorSets, 0, nullptr);
+	void CommandBuffer::bindDescriptorSets(const VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, VkPipelineBindPoint bindPoint) {
+		vkCmdBindDescriptorSets(mCommandBuffer, bindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, 0, nullptr);
 	}
 
 	void CommandBuffer::pushConstants(const VkPipelineLayout layout,VkShaderStageFlagBits flags,uint32_t offset,uint32_t size, void* pData) {
-		vkCmdPushConstants(mCommandBuffer,layout,flags,0,sizeof(NVPMatrices),pData);
+		vkCmdPushConstants(mCommandBuffer,layout,flags,offset,size,pData);
 	}
 
 	void CommandBuffer::draw(uint32_t vertexCount) {
 		vkCmdDraw(mCommandBuffer, vertexCount, 1, 0, 0);
 	}
+
+	void CommandBuffer::bindComputePipeline(const ComputePipeline::Ptr& pipeline) {
+		vkCmdBindPipeline(mCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	}
+
+	void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+		vkCmdDispatch(mCommandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+	void CommandBuffer::dispatchBase(uint32_t baseGroupX, uint32_t baseGroupY, uint32_t baseGroupZ, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+		vkCmdDispatchBase(mCommandBuffer, baseGroupX, baseGroupY, baseGroupZ, groupCountX, groupCountY, groupCountZ);
+	}
+	void CommandBuffer::resetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) {
+		vkCmdResetQueryPool(mCommandBuffer, queryPool, firstQuery, queryCount);
+	}
+	void CommandBuffer::writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool queryPool, uint32_t query) {
+		vkCmdWriteTimestamp(mCommandBuffer, stage, queryPool, query);
+	}
+	void CommandBuffer::beginQuery(VkQueryPool queryPool, uint32_t query) {
+		vkCmdBeginQuery(mCommandBuffer, queryPool, query, 0);
+	}
+	void CommandBuffer::endQuery(VkQueryPool queryPool, uint32_t query) {
+		vkCmdEndQuery(mCommandBuffer, queryPool, query);
+	}
 	void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
 		vkCmdDrawIndexed(mCommandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 	}
 	void CommandBuffer::endRenderPass() {
 		vkCmdEndRenderPass(mCommandBuffer);
 	}
+	void CommandBuffer::executeCommands(const std::vector<VkCommandBuffer>& commandBuffers) {
+		if (commandBuffers.empty()) {
+			return;
+		}
+		vkCmdExecuteCommands(mCommandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	}
 	void CommandBuffer::endCommandBuffer() {
 		if (vkEndCommandBuffer(mCommandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("Error: Failed to end command buffer!");
@@ -120,6 +173,16 @@ namespace FF::Wrapper {
 		}
 	}
 
+	void CommandBuffer::copyBufferToImage(const VkBuffer& srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkBufferImageCopy>& regions) {
+		vkCmdCopyBufferToImage(mCommandBuffer, srcBuffer, dstImage, dstImageLayout,
+			static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	void CommandBuffer::copyImageToBuffer(const VkImage& srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer, const std::vector<VkBufferImageCopy>& regions) {
+		vkCmdCopyImageToBuffer(mCommandBuffer, srcImage, srcImageLayout, dstBuffer,
+			static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
 	void CommandBuffer::CopyRTImageToCubeMap(const VkImage& inSrcImage, VkImage inDstCubeMap, size_t inWidth, size_t inHeight, int inFace, int inMipmapLevel) {
 		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT ,0,1,0,1 };
 		
@@ -178,6 +241,14 @@ namespace FF::Wrapper {
 			&copyRegion);
 	}
 
+	void CommandBuffer::blitImage(const VkImage& srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageBlit>& regions, VkFilter filter) {
+		vkCmdBlitImage(mCommandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, static_cast<uint32_t>(regions.size()), regions.data(), filter);
+	}
+
+	void CommandBuffer::copyImage(const VkImage& srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageCopy>& regions) {
+		vkCmdCopyImage(mCommandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
 	void CommandBuffer::submitCommandBuffer(VkQueue queue, VkFence fence) {
 		if (fence == VK_NULL_HANDLE) {
 			VkFenceCreateInfo fenceInfo{};
@@ -209,4 +280,31 @@ namespace FF::Wrapper {
 			1, &imageMemoryBarrier);
 	}
 
+	void CommandBuffer::transferImageLayouts(const std::vector<VkImageMemoryBarrier>& imageMemoryBarriers, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+		if (imageMemoryBarriers.empty()) {
+			return;
+		}
+		vkCmdPipelineBarrier(mCommandBuffer,
+			srcStageMask,
+			dstStageMask,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(imageMemoryBarriers.size()), imageMemoryBarriers.data());
+	}
+
+	void CommandBuffer::memoryBarrier(VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		vkCmdPipelineBarrier(mCommandBuffer,
+			srcStageMask,
+			dstStageMask,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
 }
\ No newline at end of file
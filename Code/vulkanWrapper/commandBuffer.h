@@ -4,6 +4,7 @@
 #include "device.h"
 #include "commandPool.h"
 #include "pipeline.h"
+#include "computePipeline.h"
 
 
 namespace FF::Wrapper {
@@ -37,15 +38,35 @@ namespace FF::Wrapper {
 
 		void bindGraphicPipeline(const Pipeline::Ptr& pipeline);
 
+		// Dynamic viewport/scissor of the bound pipeline
+		void setViewport(const VkViewport& viewport);
+		void setScissor(const VkRect2D& scissor);
+		// Viewport and scissor covering width x height, flipViewport uses a negative height so +Y points up
+		void setViewportAndScissor(uint32_t width, uint32_t height, bool flipViewport = false);
+
 		void bindVertexBuffer(const std::vector<VkBuffer>& buffers, uint32_t binding = 0, std::vector<VkDeviceSize> offsets = { 0 });
 		void bindIndexBuffer(VkBuffer buffer, uint32_t offset = 0, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
 		void bindDescriptorSet(const VkPipelineLayout layout, const VkDescriptorSet& descriptorSet);
-		void bindDescriptorSets(const VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets);
+		void bindDescriptorSets(const VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 		void pushConstants(const VkPipelineLayout layout, VkShaderStageFlagBits flags, uint32_t offset, uint32_t size, void* pData);
 		void draw(uint32_t vertexCount);
 
+		void bindComputePipeline(const ComputePipeline::Ptr& pipeline);
+		void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+		// gl_WorkGroupID starts at the base group, the pipeline needs VK_PIPELINE_CREATE_DISPATCH_BASE_BIT
+		void dispatchBase(uint32_t baseGroupX, uint32_t baseGroupY, uint32_t baseGroupZ, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+		void resetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount);
+		void writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool queryPool, uint32_t query);
+		// Begin and end in the same subpass, or both outside of a render pass
+		void beginQuery(VkQueryPool queryPool, uint32_t query);
+		void endQuery(VkQueryPool queryPool, uint32_t query);
+
 		void endRenderPass();
 
+		// Run secondary command buffers, inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		void executeCommands(const std::vector<VkCommandBuffer>& commandBuffers);
+
 		void endCommandBuffer();
 
 		void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
@@ -54,8 +75,16 @@ namespace FF::Wrapper {
 		
 		void copyBufferToImage(const VkBuffer& srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, size_t width, size_t height, bool isCubeMap = false);
 
+		void copyBufferToImage(const VkBuffer& srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkBufferImageCopy>& regions);
+
+		void copyImageToBuffer(const VkImage& srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer, const std::vector<VkBufferImageCopy>& regions);
+
 		void CopyImageToImage(const VkImage& inSrcImage, VkImage inDstImage, size_t inWidth, size_t inHeight, int inMipmapLevel);
 
+		void blitImage(const VkImage& srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageBlit>& regions, VkFilter filter);
+
+		void copyImage(const VkImage& srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageCopy>& regions);
+
 		void CopyRTImageToCubeMap(const VkImage& inSrcImage,VkImage inDstCubeMap, size_t inWidth, size_t inHeight, int inFace, int inMipmapLevel);
 
 		void submitCommandBuffer(VkQueue queue, VkFence fence = VK_NULL_HANDLE);
@@ -64,6 +93,12 @@ namespace FF::Wrapper {
 
 		void transferImageLayout(const VkImageMemoryBarrier &imageMemoryBarrier, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
 
+		// Several image barriers in one vkCmdPipelineBarrier, the stage masks are the union of theirs
+		void transferImageLayouts(const std::vector<VkImageMemoryBarrier>& imageMemoryBarriers, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+
+		// Global memory barrier, for buffers written by one command and read by the next
+		void memoryBarrier(VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+
 	private:
 		VkFence mFence = VK_NULL_HANDLE;
 		VkCommandBuffer mCommandBuffer{ VK_NULL_HANDLE };
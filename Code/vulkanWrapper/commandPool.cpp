@@ -24,4 +24,10 @@ namespace FF::Wrapper {
 			vkDestroyCommandPool(mDevice->getDevice(), mCommandPool, nullptr);
 		}
 	}
+
+	void CommandPool::reset(VkCommandPoolResetFlags flags) {
+		if (vkResetCommandPool(mDevice->getDevice(), mCommandPool, flags) != VK_SUCCESS) {
+			throw std::runtime_error("Error: Failed to reset command pool!");
+		}
+	}
 }
\ No newline at end of file
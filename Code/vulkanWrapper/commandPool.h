@@ -19,6 +19,9 @@ namespace FF ::Wrapper {
 		void beginCommandBuffer();
 		void endCommandBuffer();
 
+		// Return every command buffer allocated from this pool to the initial state at once, none of them may be pending
+		void reset(VkCommandPoolResetFlags flags = 0);
+
 		[[nodiscard]] auto getCommandPool() const { return mCommandPool; }
 
 	private:
@@ -0,0 +1,58 @@
+#include "computePipeline.h"
+
+namespace FF::Wrapper {
+
+	ComputePipeline::ComputePipeline(const Device::Ptr& device)
+		: mDevice(device) {
+		mPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	}
+	ComputePipeline::~ComputePipeline() {
+		if (mLayout != VK_NULL_HANDLE) {
+			vkDestroyPipelineLayout(mDevice->getDevice(), mLayout, nullptr);
+			mLayout = VK_NULL_HANDLE;
+		}
+		if (mPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(mDevice->getDevice(), mPipeline, nullptr);
+			mPipeline = VK_NULL_HANDLE;
+		}
+		mShader.reset();
+		mDevice.reset();
+	}
+	void ComputePipeline::build() {
+		if (mShader == nullptr || mShader->getShaderStage() != VK_SHADER_STAGE_COMPUTE_BIT) {
+			throw std::runtime_error("Error: compute pipeline needs a compute shader!");
+		}
+
+		// Create pipeline layout
+		if (mLayout != VK_NULL_HANDLE) {
+			vkDestroyPipelineLayout(mDevice->getDevice(), mLayout, nullptr);
+			mLayout = VK_NULL_HANDLE;
+		}
+		if (vkCreatePipelineLayout(mDevice->getDevice(), &mPipelineLayoutInfo, nullptr, &mLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to create compute pipeline layout!");
+		}
+
+		VkPipelineShaderStageCreateInfo shaderCreateInfo{};
+		shaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderCreateInfo.module = mShader->getShaderModule();
+		shaderCreateInfo.pName = mShader->getEntryPoint().c_str();
+		shaderCreateInfo.pSpecializationInfo = mShader->getSpecializationInfo();
+
+		VkComputePipelineCreateInfo pipelineCreateInfo{};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.flags = mCreateFlags;
+		pipelineCreateInfo.stage = shaderCreateInfo;
+		pipelineCreateInfo.layout = mLayout;
+		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCreateInfo.basePipelineIndex = -1;
+
+		if (mPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(mDevice->getDevice(), mPipeline, nullptr);
+			mPipeline = VK_NULL_HANDLE;
+		}
+		if (vkCreateComputePipelines(mDevice->getDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &mPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to create compute pipeline!");
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+
+#include "../base.h"
+#include "device.h"
+#include "shader.h"
+
+namespace FF::Wrapper {
+	// Compute counterpart of Pipeline: one compute shader stage plus its layout, no render pass
+	class ComputePipeline {
+	public:
+		using Ptr = std::shared_ptr<ComputePipeline>;
+		static Ptr create(const Device::Ptr& device) {
+			return std::make_shared<ComputePipeline>(device);
+		}
+		ComputePipeline(const Device::Ptr& device);
+		~ComputePipeline();
+		[[nodiscard]] VkPipeline getPipeline() const { return mPipeline; }
+		[[nodiscard]] VkPipelineLayout getPipelineLayout() const { return mLayout; }
+
+		void setShader(const Shader::Ptr& shader) { mShader = shader; }
+
+		// VK_PIPELINE_CREATE_DISPATCH_BASE_BIT is needed for CommandBuffer::dispatchBase
+		void setCreateFlags(VkPipelineCreateFlags flags) { mCreateFlags = flags; }
+
+		void build();
+	public:
+		VkPipelineLayoutCreateInfo mPipelineLayoutInfo{};
+
+	private:
+		VkPipeline mPipeline{ VK_NULL_HANDLE };
+		VkPipelineLayout mLayout{ VK_NULL_HANDLE };
+		Device::Ptr mDevice{ nullptr };
+		Shader::Ptr mShader{ nullptr };
+		VkPipelineCreateFlags mCreateFlags{ 0 };
+	};
+}
@@ -0,0 +1,98 @@
+#include "cpuProfiler.h"
+#include <iomanip>
+
+namespace FF::Wrapper {
+
+	std::atomic<bool> CPUProfiler::sEnabled{ false };
+	CPUProfiler::Clock::time_point CPUProfiler::sOrigin = CPUProfiler::Clock::now();
+	std::mutex CPUProfiler::sThreadsMutex{};
+	std::vector<std::unique_ptr<CPUProfiler::ThreadBuffer>> CPUProfiler::sThreads{};
+
+	static std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+		}
+		return escaped;
+	}
+
+	void CPUProfiler::setEnabled(bool enabled) {
+		sEnabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	CPUProfiler::ThreadBuffer& CPUProfiler::getThreadBuffer() {
+		// The lock is only taken the first time a thread records
+		thread_local ThreadBuffer* threadBuffer = nullptr;
+		if (threadBuffer == nullptr) {
+			auto buffer = std::make_unique<ThreadBuffer>();
+			buffer->mEvents = std::make_unique<Event[]>(ThreadCapacity);
+
+			std::lock_guard<std::mutex> lock(sThreadsMutex);
+			buffer->mThreadIndex = static_cast<uint32_t>(sThreads.size());
+			buffer->mName = "Thread " + std::to_string(buffer->mThreadIndex);
+			threadBuffer = buffer.get();
+			sThreads.push_back(std::move(buffer));
+		}
+		return *threadBuffer;
+	}
+
+	void CPUProfiler::setThreadName(const std::string& name) {
+		ThreadBuffer& buffer = getThreadBuffer();
+		std::lock_guard<std::mutex> lock(sThreadsMutex);
+		buffer.mName = name;
+	}
+
+	void CPUProfiler::addZone(const char* name, Clock::time_point begin, Clock::time_point end) {
+		ThreadBuffer& buffer = getThreadBuffer();
+		// Single writer: the count is only stored by this thread
+		const uint64_t writeCount = buffer.mWriteCount.load(std::memory_order_relaxed);
+		Event& event = buffer.mEvents[writeCount % ThreadCapacity];
+		event.mName = name;
+		event.mBegin = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - sOrigin).count();
+		event.mEnd = std::chrono::duration_cast<std::chrono::nanoseconds>(end - sOrigin).count();
+		buffer.mWriteCount.store(writeCount + 1, std::memory_order_release);
+	}
+
+	bool CPUProfiler::exportChromeTrace(const std::string& path) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write cpu trace " << path << std::endl;
+			return false;
+		}
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}}";
+
+		std::lock_guard<std::mutex> lock(sThreadsMutex);
+		std::vector<Event> events{};
+		for (const auto& buffer : sThreads) {
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->mThreadIndex
+				<< ",\"args\":{\"name\":\"" << escapeJson(buffer->mName) << "\"}}";
+
+			// Copy the ring, then drop what the owner may have overwritten while it was copied
+			const uint64_t writeCount = buffer->mWriteCount.load(std::memory_order_acquire);
+			const uint64_t first = writeCount > ThreadCapacity ? writeCount - ThreadCapacity : 0;
+			events.clear();
+			for (uint64_t i = first; i < writeCount; i++) {
+				events.push_back(buffer->mEvents[i % ThreadCapacity]);
+			}
+			const uint64_t writeCountAfter = buffer->mWriteCount.load(std::memory_order_acquire);
+			const uint64_t firstValid = writeCountAfter > ThreadCapacity ? writeCountAfter - ThreadCapacity : 0;
+			const size_t skipped = static_cast<size_t>(std::min(std::max(firstValid, first) - first, static_cast<uint64_t>(events.size())));
+
+			for (size_t i = skipped; i < events.size(); i++) {
+				const Event& event = events[i];
+				file << ",\n{\"name\":\"" << escapeJson(event.mName) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->mThreadIndex
+					<< ",\"ts\":" << event.mBegin * 1e-3 << ",\"dur\":" << (event.mEnd - event.mBegin) * 1e-3 << "}";
+			}
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		std::cout << "CPU trace written to " << path << std::endl;
+		return true;
+	}
+}
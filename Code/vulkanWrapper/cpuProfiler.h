@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../base.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// 0 compiles every FF_CPU_ZONE out, the profiler then records nothing
+#ifndef FF_CPU_PROFILER
+#define FF_CPU_PROFILER 1
+#endif
+
+namespace FF::Wrapper {
+	/*
+	* Scoped cpu zones, recorded per thread. Every thread writes its zones into its own ring buffer without locking:
+	* only the owning thread writes, the write count is published with a release store and the exporter reads it back
+	* with an acquire load. When a buffer wraps the oldest zones are dropped, so a trace holds the last few seconds.
+	* Zones take string literals as names, nothing is copied or allocated while recording.
+	* Recording stays off until setEnabled, a disabled zone costs one relaxed atomic load.
+	*/
+	class CPUProfiler {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// Zones kept per thread
+		static constexpr uint32_t ThreadCapacity = 1u << 15;
+
+		static void setEnabled(bool enabled);
+		[[nodiscard]] static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+		// Names the calling thread in the trace, threads without a name show as "Thread N"
+		static void setThreadName(const std::string& name);
+
+		static void addZone(const char* name, Clock::time_point begin, Clock::time_point end);
+
+		// Complete events of every thread, for chrome://tracing or ui.perfetto.dev. Safe while other threads record
+		static bool exportChromeTrace(const std::string& path);
+
+	private:
+		struct Event {
+			const char* mName{ nullptr };
+			int64_t mBegin{ 0 }; // nanoseconds from the first zone
+			int64_t mEnd{ 0 };
+		};
+
+		struct ThreadBuffer {
+			uint32_t mThreadIndex{ 0 };
+			std::string mName;
+			std::unique_ptr<Event[]> mEvents{};
+			std::atomic<uint64_t> mWriteCount{ 0 };
+		};
+
+		static ThreadBuffer& getThreadBuffer();
+
+	private:
+		static std::atomic<bool> sEnabled;
+		static Clock::time_point sOrigin;
+
+		// Buffers are never freed: a thread that exited still shows in the next export
+		static std::mutex sThreadsMutex;
+		static std::vector<std::unique_ptr<ThreadBuffer>> sThreads;
+	};
+
+	class CPUZone {
+	public:
+		explicit CPUZone(const char* name) {
+			if (CPUProfiler::isEnabled()) {
+				mName = name;
+				mBegin = CPUProfiler::Clock::now();
+			}
+		}
+
+		~CPUZone() {
+			if (mName != nullptr) {
+				CPUProfiler::addZone(mName, mBegin, CPUProfiler::Clock::now());
+			}
+		}
+
+		CPUZone(const CPUZone&) = delete;
+		CPUZone& operator=(const CPUZone&) = delete;
+
+	private:
+		const char* mName{ nullptr };
+		CPUProfiler::Clock::time_point mBegin{};
+	};
+}
+
+#define FF_CPU_ZONE_CONCAT_IMPL(a, b) a##b
+#define FF_CPU_ZONE_CONCAT(a, b) FF_CPU_ZONE_CONCAT_IMPL(a, b)
+
+#if FF_CPU_PROFILER
+// Measures the rest of the enclosing scope, name has to be a string literal
+#define FF_CPU_ZONE(name) ::FF::Wrapper::CPUZone FF_CPU_ZONE_CONCAT(ffCpuZone, __LINE__)(name)
+#define FF_CPU_THREAD_NAME(name) ::FF::Wrapper::CPUProfiler::setThreadName(name)
+#else
+#define FF_CPU_ZONE(name) ((void)0)
+#define FF_CPU_THREAD_NAME(name) ((void)0)
+#endif
@@ -14,8 +14,10 @@ namespace FF::Wrapper {
 		uint32_t mCount{ 1 }; // number of descriptors,might be more than one, count refers to the number of descriptors in the array,need to use indexedDescriptor
 		VkDescriptorType mDescriptorType{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER }; // type of the descriptor
 		VkShaderStageFlags mStageFlags{ VK_SHADER_STAGE_ALL }; // stage flags, which shader stages will use this descriptor
+		VkDescriptorBindingFlags mBindingFlags{ 0 }; // descriptor indexing flags, e.g. partially bound / update after bind / variable count for bindless arrays
 
 		std::vector<Buffer::Ptr> mBuffers{};
 		std::vector<std::vector<Texture::Ptr>> mTextures{}; //Each Parameter can have multiple textures
+		std::vector<VkDescriptorImageInfo> mStorageImageInfos{}; // one per set for storage images, view in VK_IMAGE_LAYOUT_GENERAL
 	};
 }
@@ -12,15 +12,25 @@ namespace FF::Wrapper {
 
 
 		int uniformBufferCount = 0;
+		int storageBufferCount = 0;
 		int textureCount = 0;
+		int storageImageCount = 0;
+		bool updateAfterBind = false;
 		for (const auto& param : params) {
 			if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
 				uniformBufferCount += param->mCount;
 			}
+			if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+				storageBufferCount += param->mCount;
+			}
+			if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) {
+				storageImageCount += param->mCount;
+			}
 			//TODO: add other types of descriptors
 			if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
 				textureCount += param->mCount;
 			}
+			updateAfterBind |= (param->mBindingFlags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
 		}
 
 
@@ -40,6 +50,13 @@ namespace FF::Wrapper {
 		}
 
 
+		VkDescriptorPoolSize storageDescriptorSize{};
+		storageDescriptorSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		storageDescriptorSize.descriptorCount = storageBufferCount * frameCount;
+		if (storageDescriptorSize.descriptorCount != 0) {
+			poolSizes.push_back(storageDescriptorSize);
+		}
+
 		VkDescriptorPoolSize textureDescriptorSize{};
 		textureDescriptorSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		textureDescriptorSize.descriptorCount = textureCount * frameCount; // how much descriptor we need, should be the same as the number of images in the swapchain
@@ -47,6 +64,13 @@ namespace FF::Wrapper {
 			poolSizes.push_back(textureDescriptorSize);
 		}
 
+		VkDescriptorPoolSize storageImageDescriptorSize{};
+		storageImageDescriptorSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		storageImageDescriptorSize.descriptorCount = storageImageCount * frameCount;
+		if (storageImageDescriptorSize.descriptorCount != 0) {
+			poolSizes.push_back(storageImageDescriptorSize);
+		}
+
 		mPoolSizes = poolSizes;
 
 
@@ -56,6 +80,10 @@ namespace FF::Wrapper {
 		poolInfo.poolSizeCount = static_cast<uint32_t>(mPoolSizes.size());
 		poolInfo.pPoolSizes = mPoolSizes.data();
 		poolInfo.maxSets = static_cast<uint32_t>(frameCount);
+		// Sets allocated from a layout with update-after-bind bindings need a matching pool
+		if (updateAfterBind) {
+			poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		}
 
 		if (vkCreateDescriptorPool(mDevice->getDevice(), &poolInfo, nullptr, &mPool) != VK_SUCCESS) {
 			throw std::runtime_error("Error: Failed to create descriptor pool!");
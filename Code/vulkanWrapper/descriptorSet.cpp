@@ -10,6 +10,21 @@ namespace FF::Wrapper {
 		allocInfo.descriptorPool = pool->getDescriptorPool();
 		allocInfo.descriptorSetCount = frameCount;
 		allocInfo.pSetLayouts = layouts.data();
+
+		// A variable sized (bindless) array is always the last binding, allocate it with its full count
+		std::vector<uint32_t> variableCounts{};
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+		for (const auto& param : params) {
+			if (param->mBindingFlags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT) {
+				variableCounts.assign(frameCount, param->mCount);
+			}
+		}
+		if (!variableCounts.empty()) {
+			variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+			variableCountInfo.descriptorSetCount = static_cast<uint32_t>(variableCounts.size());
+			variableCountInfo.pDescriptorCounts = variableCounts.data();
+			allocInfo.pNext = &variableCountInfo;
+		}
 		
 		if (vkAllocateDescriptorSets(mDevice->getDevice(), &allocInfo, mDescriptorSets.data()) != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to allocate descriptor sets!");
@@ -30,15 +45,27 @@ namespace FF::Wrapper {
 				descriptorWrite.descriptorType = param->mDescriptorType;
 				descriptorWrite.descriptorCount = param->mCount;
 				if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+					// Partially bound arrays only write the textures that already exist, the rest is filled by updateImage
+					uint32_t textureCount = param->mCount;
+					if (param->mBindingFlags & VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT) {
+						textureCount = param->mTextures.empty() ? 0 : std::min(param->mCount, static_cast<uint32_t>(param->mTextures[i].size()));
+						if (textureCount == 0) {
+							continue;
+						}
+						descriptorWrite.descriptorCount = textureCount;
+					}
 					// For combined image sampler, we need to create a vector of VkDescriptorImageInfo
-					std::vector<VkDescriptorImageInfo> infos(param->mCount);
-					for (size_t j = 0; j < param->mCount; ++j) {
+					std::vector<VkDescriptorImageInfo> infos(textureCount);
+					for (size_t j = 0; j < textureCount; ++j) {
 						infos[j] = param->mTextures[i][j]->getImageInfo();
 					}
 					imageInfoArrays.push_back(std::move(infos));// Need to ensure infos live until the end of vkUpdateDescriptorSets
 					descriptorWrite.pImageInfo = imageInfoArrays.back().data();
 				}
-				else if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+				else if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) {
+					descriptorWrite.pImageInfo = &param->mStorageImageInfos[i];
+				}
+				else if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || param->mDescriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
 					descriptorWrite.pBufferInfo = &param->mBuffers[i]->getBufferInfo();
 				}
 				descriptorWrites.push_back(descriptorWrite);
@@ -47,6 +74,19 @@ namespace FF::Wrapper {
 			vkUpdateDescriptorSets(mDevice->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 		}
 	}
+	void DescriptorSet::updateImage(int frameCount, uint32_t binding, uint32_t arrayElement, const VkDescriptorImageInfo& imageInfo) {
+		// Single element write, used by bindless tables to fill slots after the set has been bound
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = mDescriptorSets[frameCount];
+		descriptorWrite.dstBinding = binding;
+		descriptorWrite.dstArrayElement = arrayElement;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(mDevice->getDevice(), 1, &descriptorWrite, 0, nullptr);
+	}
+
 	DescriptorSet::~DescriptorSet() {// Descriptor set will be destroyed by descriptor pool, not need to free it here
 		
 	}
@@ -26,6 +26,7 @@ namespace FF::Wrapper {
 		}
 
 		void updateBuffer(const UniformParameter::Ptr& param, const Buffer::Ptr& buffer);
+		void updateImage(int frameCount, uint32_t binding, uint32_t arrayElement, const VkDescriptorImageInfo& imageInfo);
 
 	private:
 		std::vector<VkDescriptorSet> mDescriptorSets{};
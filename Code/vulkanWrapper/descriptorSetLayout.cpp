@@ -20,6 +20,9 @@ namespace FF::Wrapper {
 		}
 
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorBindingFlags> bindingFlags;
+		bool hasBindingFlags = false;
+		bool updateAfterBind = false;
 		for (const auto& param : mBindingParameters) {
 			VkDescriptorSetLayoutBinding binding{};
 			binding.binding = param->mBinding;
@@ -28,11 +31,28 @@ namespace FF::Wrapper {
 			binding.stageFlags = param->mStageFlags;
 			binding.pImmutableSamplers = nullptr; // Only needed for sampler types
 			bindings.push_back(binding);
+
+			bindingFlags.push_back(param->mBindingFlags);
+			hasBindingFlags |= param->mBindingFlags != 0;
+			updateAfterBind |= (param->mBindingFlags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
 		}
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 		layoutInfo.pBindings = bindings.data();
+
+		// Descriptor indexing: the flags array must match the bindings array one to one
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		if (hasBindingFlags) {
+			bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+			bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+			layoutInfo.pNext = &bindingFlagsInfo;
+		}
+		// Update-after-bind bindings can only live in layouts (and pools) created with this flag
+		if (updateAfterBind) {
+			layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		}
 		if (vkCreateDescriptorSetLayout(mDevice->getDevice(), &layoutInfo, nullptr, &mLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Error: Failed to create descriptor set layout!");
 		}
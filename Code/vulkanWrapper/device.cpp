@@ -1,4 +1,5 @@
 #include "device.h"
+#include <cstring>
 
 
 namespace FF::Wrapper {
@@ -77,13 +78,16 @@ namespace FF::Wrapper {
 				break;
 			}
 		}
-		for (int i = 0; i < queueFamilyCount; ++i) {
+		for (int i = 0; i < queueFamilyCount && !isHeadless(); ++i) {
 			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface->getSurface(), &presentQueueFound);
 			if (presentQueueFound) {
 				score += 100; // Add score for having a present queue
 				break;
 			}
 		}
+		if (isHeadless()) {
+			presentQueueFound = true;
+		}
 
 		deviceValid = graphicsQueueFound && presentQueueFound;
 
@@ -105,7 +109,8 @@ namespace FF::Wrapper {
 		vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
 
-		return deviceProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+		// Headless runs go to CI and render farm machines: integrated or software (lavapipe) devices are fine
+		return (deviceProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || isHeadless()) &&
 			deviceFeatures.geometryShader&&
 			deviceFeatures.samplerAnisotropy;
 	}
@@ -130,7 +135,12 @@ namespace FF::Wrapper {
 				mGraphicQueueFamily = i;
 			}
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface->getSurface(), &presentSupport);
+			if (isHeadless()) {
+				presentSupport = mGraphicQueueFamily.has_value() && mGraphicQueueFamily.value() == i;
+			}
+			else {
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface->getSurface(), &presentSupport);
+			}
 			if (presentSupport) {
 				mPresentQueueFamily = i;
 			}
@@ -157,13 +167,90 @@ namespace FF::Wrapper {
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		// Optional extensions, their feature structures may only be queried when the device exposes them
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+		auto hasExtension = [&availableExtensions](const char* name) {
+			return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+				[name](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, name) == 0; });
+		};
+		mMemoryBudgetSupported = hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		const bool presentWaitExtensions = !isHeadless() && hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+		// Query descriptor indexing support (promoted from VK_EXT_descriptor_indexing to core in 1.2)
+		VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexingFeatures = {};
+		supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		VkPhysicalDevicePresentIdFeaturesKHR supportedPresentIdFeatures = {};
+		supportedPresentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWaitFeatures = {};
+		supportedPresentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		if (presentWaitExtensions) {
+			supportedIndexingFeatures.pNext = &supportedPresentIdFeatures;
+			supportedPresentIdFeatures.pNext = &supportedPresentWaitFeatures;
+		}
+		VkPhysicalDeviceFeatures2 supportedFeatures = {};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supportedIndexingFeatures;
+		vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &supportedFeatures);
+		mPresentWaitSupported = presentWaitExtensions && supportedPresentIdFeatures.presentId && supportedPresentWaitFeatures.presentWait;
+
+		mDescriptorIndexingSupported =
+			supportedFeatures.features.shaderSampledImageArrayDynamicIndexing &&
+			supportedIndexingFeatures.runtimeDescriptorArray &&
+			supportedIndexingFeatures.descriptorBindingPartiallyBound &&
+			supportedIndexingFeatures.descriptorBindingVariableDescriptorCount &&
+			supportedIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+			supportedIndexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE; // Enable anisotropic filtering
-
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = mDescriptorIndexingSupported ? VK_TRUE : VK_FALSE;
+		mImageCubeArraySupported = supportedFeatures.features.imageCubeArray == VK_TRUE;
+		deviceFeatures.imageCubeArray = mImageCubeArraySupported ? VK_TRUE : VK_FALSE;
+		mTextureCompressionBCSupported = supportedFeatures.features.textureCompressionBC == VK_TRUE;
+		deviceFeatures.textureCompressionBC = mTextureCompressionBCSupported ? VK_TRUE : VK_FALSE;
+		mPipelineStatisticsSupported = supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+		deviceFeatures.pipelineStatisticsQuery = mPipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+
+		// Bindless texture table: one big sampler array, only the used slots need to be valid
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		if (mDescriptorIndexingSupported) {
+			descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		}
 
 		VkPhysicalDeviceNonSeamlessCubeMapFeaturesEXT nonSeamlessCubeMapFeatures = {};
 		nonSeamlessCubeMapFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_NON_SEAMLESS_CUBE_MAP_FEATURES_EXT;
 		nonSeamlessCubeMapFeatures.nonSeamlessCubeMap = VK_TRUE;
+		nonSeamlessCubeMapFeatures.pNext = &descriptorIndexingFeatures;
+
+		// Present pacing: ids on the presents and a wait on them
+		std::vector<const char*> enabledExtensions = deviceRequiredExtensions;
+		if (isHeadless()) {
+			enabledExtensions.erase(std::remove_if(enabledExtensions.begin(), enabledExtensions.end(),
+				[](const char* name) { return std::strcmp(name, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; }), enabledExtensions.end());
+		}
+		if (mMemoryBudgetSupported) {
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		if (mPresentWaitSupported) {
+			enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentIdFeatures.presentId = VK_TRUE;
+			presentWaitFeatures.presentWait = VK_TRUE;
+			presentIdFeatures.pNext = &presentWaitFeatures;
+			descriptorIndexingFeatures.pNext = &presentIdFeatures;
+		}
 
 
 		//Logical Device Create Info
@@ -174,8 +261,8 @@ namespace FF::Wrapper {
 
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
-		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceRequiredExtensions.size());
-		deviceCreateInfo.ppEnabledExtensionNames = deviceRequiredExtensions.data();
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 		deviceCreateInfo.pNext = &nonSeamlessCubeMapFeatures; // Add non-seamless cube map features
 
 		//Layer
@@ -194,6 +281,53 @@ namespace FF::Wrapper {
 
 		vkGetDeviceQueue(mDevice, mGraphicQueueFamily.value(), 0, &mGraphicQueue);
 		vkGetDeviceQueue(mDevice, mPresentQueueFamily.value(), 0, &mPresentQueue);
+
+		if (mPresentWaitSupported) {
+			mWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(mDevice, "vkWaitForPresentKHR"));
+			mPresentWaitSupported = mWaitForPresent != nullptr;
+		}
+
+		// Timestamps written on the graphics queue, period converts ticks to nanoseconds
+		VkPhysicalDeviceProperties deviceProp{};
+		vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProp);
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+		mTimestampPeriod = deviceProp.limits.timestampPeriod;
+		mTimestampSupported = deviceProp.limits.timestampPeriod > 0.0f && queueFamilies[mGraphicQueueFamily.value()].timestampValidBits > 0;
+	}
+
+	VkResult Device::waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) const {
+		if (!mPresentWaitSupported) {
+			throw std::runtime_error("Error: VK_KHR_present_wait is not enabled!");
+		}
+		return mWaitForPresent(mDevice, swapChain, presentId, timeout);
+	}
+
+	Device::MemoryUsage Device::getDeviceLocalMemoryUsage() const {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+		memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties.pNext = mMemoryBudgetSupported ? &budgetProperties : nullptr;
+		vkGetPhysicalDeviceMemoryProperties2(mPhysicalDevice, &memoryProperties);
+
+		MemoryUsage usage{};
+		const VkPhysicalDeviceMemoryProperties& properties = memoryProperties.memoryProperties;
+		for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+			if ((properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+				continue;
+			}
+			if (mMemoryBudgetSupported) {
+				usage.mUsage += budgetProperties.heapUsage[heap];
+				usage.mBudget += budgetProperties.heapBudget[heap];
+			}
+			else {
+				usage.mBudget += properties.memoryHeaps[heap].size;
+			}
+		}
+		return usage;
 	}
 
 	VkSampleCountFlagBits Device::getMaxUsableSampleCount() {
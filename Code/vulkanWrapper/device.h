@@ -19,6 +19,7 @@ namespace FF::Wrapper {
 
 
 
+		// A nullptr surface creates a headless device: any device type, no present support or swap chain extension needed
 		Device(Instance::Ptr instance, WindowSurface::Ptr surface);
 		~Device();
 
@@ -36,6 +37,40 @@ namespace FF::Wrapper {
 
 		VkSampleCountFlagBits getMaxUsableSampleCount();
 
+		// No surface: the present queue is the graphics queue and nothing may be presented
+		[[nodiscard]] bool isHeadless() const { return mSurface == nullptr; }
+
+		// Descriptor indexing (bindless) is only enabled when every feature we rely on is available
+		[[nodiscard]] bool isDescriptorIndexingSupported() const { return mDescriptorIndexingSupported; }
+
+		// Graphics queue timestamps, getTimestampPeriod is in nanoseconds per tick
+		[[nodiscard]] bool isTimestampSupported() const { return mTimestampSupported; }
+		[[nodiscard]] float getTimestampPeriod() const { return mTimestampPeriod; }
+
+		// samplerCubeArray, used by the reflection probe array
+		[[nodiscard]] bool isImageCubeArraySupported() const { return mImageCubeArraySupported; }
+
+		// BC1-7 sampling, the compressed IBL maps use BC6H
+		[[nodiscard]] bool isTextureCompressionBCSupported() const { return mTextureCompressionBCSupported; }
+
+		// VK_QUERY_TYPE_PIPELINE_STATISTICS queries, used by the gpu profiler
+		[[nodiscard]] bool isPipelineStatisticsSupported() const { return mPipelineStatisticsSupported; }
+
+		// VK_KHR_present_id and VK_KHR_present_wait, enabled when both are available: presents carry an id the cpu can wait on
+		[[nodiscard]] bool isPresentWaitSupported() const { return mPresentWaitSupported; }
+		// Blocks until the present with presentId (or a later one) is visible, VK_TIMEOUT when timeout (ns) ran out first
+		VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) const;
+
+
+		struct MemoryUsage {
+			VkDeviceSize mUsage{ 0 };
+			VkDeviceSize mBudget{ 0 };
+		};
+		// Summed over the device local heaps. With VK_EXT_memory_budget the usage of this process and its budget,
+		// without it the usage stays 0 and the budget is the heap size
+		[[nodiscard]] MemoryUsage getDeviceLocalMemoryUsage() const;
+		[[nodiscard]] bool isMemoryBudgetSupported() const { return mMemoryBudgetSupported; }
+
 
 		[[nodiscard]] auto getDevice() const { return mDevice; }
 		[[nodiscard]] auto getPhysicalDevice() const { return mPhysicalDevice; }
@@ -62,5 +97,21 @@ namespace FF::Wrapper {
 		//Anti-aliasing
 		VkSampleCountFlagBits mSampleCounts{ VK_SAMPLE_COUNT_1_BIT }; // Default to 1 sample per pixel
 
+		// Partially bound, update-after-bind and variable sized sampler arrays
+		bool mDescriptorIndexingSupported{ false };
+
+		bool mTimestampSupported{ false };
+		float mTimestampPeriod{ 0.0f };
+
+		bool mImageCubeArraySupported{ false };
+
+		bool mTextureCompressionBCSupported{ false };
+		bool mPipelineStatisticsSupported{ false };
+
+		bool mMemoryBudgetSupported{ false };
+
+		bool mPresentWaitSupported{ false };
+		PFN_vkWaitForPresentKHR mWaitForPresent{ nullptr };
+
 	};
 }
\ No newline at end of file
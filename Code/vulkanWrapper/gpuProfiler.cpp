@@ -0,0 +1,372 @@
+#include "gpuProfiler.h"
+#include <iomanip>
+#include <sstream>
+
+namespace FF::Wrapper {
+
+	// Order of the results follows the bit order of the flags
+	static constexpr VkQueryPipelineStatisticFlags StatisticsFlags = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	static constexpr uint32_t StatisticsCount = 3;
+
+	static std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (char c : text) {
+			switch (c) {
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char code[8];
+					snprintf(code, sizeof(code), "\\u%04x", c);
+					escaped += code;
+				}
+				else {
+					escaped += c;
+				}
+			}
+		}
+		return escaped;
+	}
+
+	GPUProfiler::GPUProfiler(const Device::Ptr& device, uint32_t slotCount, const Settings& settings)
+		: mDevice(device), mSettings(settings) {
+		mSlots.resize(slotCount);
+		if (!mDevice->isTimestampSupported() || mSettings.mMaxZones == 0) {
+			std::cout << "GPU profiler: the graphics queue has no timestamps, nothing is measured" << std::endl;
+			return;
+		}
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2 * mSettings.mMaxZones;
+
+			VkQueryPool queryPool{ VK_NULL_HANDLE };
+			if (vkCreateQueryPool(mDevice->getDevice(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to create gpu profiler timestamp query pool!");
+			}
+			mTimestampPools.push_back(queryPool);
+		}
+
+		if (!mSettings.mPipelineStatistics || !mDevice->isPipelineStatisticsSupported()) {
+			return;
+		}
+		for (uint32_t i = 0; i < slotCount; i++) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.queryCount = mSettings.mMaxZones;
+			queryPoolInfo.pipelineStatistics = StatisticsFlags;
+
+			VkQueryPool queryPool{ VK_NULL_HANDLE };
+			if (vkCreateQueryPool(mDevice->getDevice(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("Error: failed to create gpu profiler statistics query pool!");
+			}
+			mStatisticsPools.push_back(queryPool);
+		}
+	}
+
+	GPUProfiler::~GPUProfiler() {
+		for (auto queryPool : mTimestampPools) {
+			vkDestroyQueryPool(mDevice->getDevice(), queryPool, nullptr);
+		}
+		for (auto queryPool : mStatisticsPools) {
+			vkDestroyQueryPool(mDevice->getDevice(), queryPool, nullptr);
+		}
+		mTimestampPools.clear();
+		mStatisticsPools.clear();
+		mDevice = nullptr;
+	}
+
+	void GPUProfiler::beginFrame(const CommandBuffer::Ptr& commandBuffer, uint32_t slot) {
+		mCurrentSlot = slot;
+		if (!isEnabled()) {
+			return;
+		}
+		collect(slot);
+
+		commandBuffer->resetQueryPool(mTimestampPools[slot], 0, 2 * mSettings.mMaxZones);
+		if (isStatisticsEnabled()) {
+			commandBuffer->resetQueryPool(mStatisticsPools[slot], 0, mSettings.mMaxZones);
+		}
+		mSlots[slot].mPending = true;
+	}
+
+	void GPUProfiler::collect(uint32_t slot) {
+		Slot& state = mSlots[slot];
+		const bool pending = state.mPending;
+		std::vector<ZoneRecord> zones = std::move(state.mZones);
+		const uint32_t statisticsCount = state.mStatisticsCount;
+		state = Slot{};
+		if (!pending || zones.empty()) {
+			return;
+		}
+
+		// A zone left open would never get its second timestamp, the frame is dropped instead of waiting on it
+		for (const auto& zone : zones) {
+			if (!zone.mEnded) {
+				return;
+			}
+		}
+
+		const uint32_t zoneCount = static_cast<uint32_t>(zones.size());
+		std::vector<uint64_t> timestamps(2 * zoneCount);
+		if (vkGetQueryPoolResults(mDevice->getDevice(), mTimestampPools[slot], 0, 2 * zoneCount, timestamps.size() * sizeof(uint64_t),
+			timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+		std::vector<uint64_t> statistics(statisticsCount * StatisticsCount);
+		if (statisticsCount > 0 && vkGetQueryPoolResults(mDevice->getDevice(), mStatisticsPools[slot], 0, statisticsCount,
+			statistics.size() * sizeof(uint64_t), statistics.data(), StatisticsCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+
+		const double period = mDevice->getTimestampPeriod();
+		if (!mHasTraceOrigin) {
+			mTraceOrigin = timestamps[0];
+			mHasTraceOrigin = true;
+		}
+
+		// A name measured several times in a frame (a state bound twice) adds up to one sample for that frame
+		std::vector<TraceEvent> frame{};
+		std::vector<std::pair<uint32_t, Sample>> frameSamples{};
+		for (uint32_t i = 0; i < zoneCount; i++) {
+			const ZoneRecord& zone = zones[i];
+			const uint64_t begin = timestamps[2 * i];
+			const uint64_t end = std::max(timestamps[2 * i + 1], begin);
+
+			TraceEvent event{};
+			event.mBegin = begin;
+			event.mEnd = end;
+			event.mSample.mMs = static_cast<double>(end - begin) * period * 1e-6;
+			if (zone.mStatisticsQuery != InvalidZone) {
+				const uint64_t* values = &statistics[zone.mStatisticsQuery * StatisticsCount];
+				event.mSample.mHasStatistics = true;
+				event.mSample.mVertexInvocations = values[0];
+				event.mSample.mFragmentInvocations = values[1];
+				event.mSample.mComputeInvocations = values[2];
+			}
+			getHistory(zone.mName, zone.mDepth, event.mHistory);
+			frame.push_back(event);
+
+			auto sample = std::find_if(frameSamples.begin(), frameSamples.end(), [&](const auto& item) { return item.first == event.mHistory; });
+			if (sample == frameSamples.end()) {
+				frameSamples.push_back({ event.mHistory, event.mSample });
+				continue;
+			}
+			sample->second.mMs += event.mSample.mMs;
+			sample->second.mHasStatistics |= event.mSample.mHasStatistics;
+			sample->second.mVertexInvocations += event.mSample.mVertexInvocations;
+			sample->second.mFragmentInvocations += event.mSample.mFragmentInvocations;
+			sample->second.mComputeInvocations += event.mSample.mComputeInvocations;
+		}
+
+		for (const auto& [index, sample] : frameSamples) {
+			auto& samples = mHistories[index].mSamples;
+			samples.push_back(sample);
+			while (samples.size() > std::max(mSettings.mAverageFrames, 1u)) {
+				samples.pop_front();
+			}
+		}
+		mTraceFrames.push_back(std::move(frame));
+		while (mTraceFrames.size() > mSettings.mTraceFrames) {
+			mTraceFrames.pop_front();
+		}
+	}
+
+	uint32_t GPUProfiler::beginZone(const CommandBuffer::Ptr& commandBuffer, const std::string& name, bool statistics) {
+		if (!isEnabled()) {
+			return InvalidZone;
+		}
+		Slot& state = mSlots[mCurrentSlot];
+		if (!state.mPending || state.mZones.size() >= mSettings.mMaxZones) {
+			return InvalidZone;
+		}
+
+		const uint32_t zone = static_cast<uint32_t>(state.mZones.size());
+		ZoneRecord record{};
+		record.mName = name;
+		record.mDepth = state.mDepth++;
+		commandBuffer->writeTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mTimestampPools[mCurrentSlot], 2 * zone);
+
+		if (statistics && isStatisticsEnabled() && !state.mStatisticsActive) {
+			record.mStatisticsQuery = state.mStatisticsCount++;
+			state.mStatisticsActive = true;
+			commandBuffer->beginQuery(mStatisticsPools[mCurrentSlot], record.mStatisticsQuery);
+		}
+		state.mZones.push_back(record);
+		return zone;
+	}
+
+	void GPUProfiler::endZone(const CommandBuffer::Ptr& commandBuffer, uint32_t zone) {
+		if (zone == InvalidZone) {
+			return;
+		}
+		Slot& state = mSlots[mCurrentSlot];
+		ZoneRecord& record = state.mZones[zone];
+		if (record.mStatisticsQuery != InvalidZone) {
+			commandBuffer->endQuery(mStatisticsPools[mCurrentSlot], record.mStatisticsQuery);
+			state.mStatisticsActive = false;
+		}
+		commandBuffer->writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestampPools[mCurrentSlot], 2 * zone + 1);
+		record.mEnded = true;
+		state.mDepth--;
+	}
+
+	GPUProfiler::ZoneHistory& GPUProfiler::getHistory(const std::string& name, uint32_t depth, uint32_t& index) {
+		auto it = mHistoryIndices.find(name);
+		if (it != mHistoryIndices.end()) {
+			index = it->second;
+			return mHistories[index];
+		}
+		index = static_cast<uint32_t>(mHistories.size());
+		mHistoryIndices[name] = index;
+		ZoneHistory history{};
+		history.mName = name;
+		history.mDepth = depth;
+		mHistories.push_back(history);
+		return mHistories.back();
+	}
+
+	std::vector<GPUProfiler::ZoneStats> GPUProfiler::getZoneStats() const {
+		std::vector<ZoneStats> zoneStats{};
+		for (const auto& history : mHistories) {
+			if (history.mSamples.empty()) {
+				continue;
+			}
+			ZoneStats stats{};
+			stats.mName = history.mName;
+			stats.mDepth = history.mDepth;
+			stats.mSampleCount = static_cast<uint32_t>(history.mSamples.size());
+			stats.mMinMs = history.mSamples.front().mMs;
+			stats.mMaxMs = history.mSamples.front().mMs;
+			stats.mLastMs = history.mSamples.back().mMs;
+
+			uint32_t statisticsSamples = 0;
+			for (const auto& sample : history.mSamples) {
+				stats.mAverageMs += sample.mMs;
+				stats.mMinMs = std::min(stats.mMinMs, sample.mMs);
+				stats.mMaxMs = std::max(stats.mMaxMs, sample.mMs);
+				if (sample.mHasStatistics) {
+					stats.mVertexInvocations += static_cast<double>(sample.mVertexInvocations);
+					stats.mFragmentInvocations += static_cast<double>(sample.mFragmentInvocations);
+					stats.mComputeInvocations += static_cast<double>(sample.mComputeInvocations);
+					statisticsSamples++;
+				}
+			}
+			stats.mAverageMs /= stats.mSampleCount;
+			if (statisticsSamples > 0) {
+				stats.mHasStatistics = true;
+				stats.mVertexInvocations /= statisticsSamples;
+				stats.mFragmentInvocations /= statisticsSamples;
+				stats.mComputeInvocations /= statisticsSamples;
+			}
+			zoneStats.push_back(stats);
+		}
+		return zoneStats;
+	}
+
+	std::vector<double> GPUProfiler::getZoneSamples(const std::string& name) const {
+		std::vector<double> samples{};
+		auto history = mHistoryIndices.find(name);
+		if (history == mHistoryIndices.end()) {
+			return samples;
+		}
+		for (const auto& sample : mHistories[history->second].mSamples) {
+			samples.push_back(sample.mMs);
+		}
+		return samples;
+	}
+
+	void GPUProfiler::printZoneStats() const {
+		const auto zoneStats = getZoneStats();
+		if (zoneStats.empty()) {
+			return;
+		}
+		std::cout << "GPU zones (average over the last " << mSettings.mAverageFrames << " frames):" << std::endl;
+		for (const auto& stats : zoneStats) {
+			std::cout << std::string(2 * (stats.mDepth + 1), ' ') << stats.mName << ": " << std::fixed << std::setprecision(3)
+				<< stats.mAverageMs << " ms (min " << stats.mMinMs << ", max " << stats.mMaxMs << ")";
+			if (stats.mHasStatistics) {
+				std::cout << std::setprecision(0) << ", " << stats.mVertexInvocations << " vertex, " << stats.mFragmentInvocations
+					<< " fragment, " << stats.mComputeInvocations << " compute invocations";
+			}
+			std::cout << std::defaultfloat << std::endl;
+		}
+	}
+
+	bool GPUProfiler::exportCSV(const std::string& path) const {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write gpu profile " << path << std::endl;
+			return false;
+		}
+		file << "zone,depth,samples,average_ms,min_ms,max_ms,last_ms,vertex_invocations,fragment_invocations,compute_invocations\n";
+		for (const auto& stats : getZoneStats()) {
+			// Names are quoted, a comma in one does not shift the columns
+			std::string name = stats.mName;
+			for (size_t i = 0; (i = name.find('"', i)) != std::string::npos; i += 2) {
+				name.insert(i, 1, '"');
+			}
+			file << '"' << name << "\"," << stats.mDepth << ',' << stats.mSampleCount << ',' << stats.mAverageMs << ',' << stats.mMinMs << ','
+				<< stats.mMaxMs << ',' << stats.mLastMs << ',';
+			if (stats.mHasStatistics) {
+				file << static_cast<uint64_t>(stats.mVertexInvocations) << ',' << static_cast<uint64_t>(stats.mFragmentInvocations) << ','
+					<< static_cast<uint64_t>(stats.mComputeInvocations);
+			}
+			else {
+				file << ",,";
+			}
+			file << '\n';
+		}
+		return true;
+	}
+
+	bool GPUProfiler::exportChromeTrace(const std::string& path) const {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Error: failed to write gpu trace " << path << std::endl;
+			return false;
+		}
+		// Timestamps in microseconds from the first measured zone, on the timeline of the gpu clock
+		const double microsecondsPerTick = mDevice->getTimestampPeriod() * 1e-3;
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+		uint32_t frameIndex = 0;
+		for (const auto& frame : mTraceFrames) {
+			for (const auto& event : frame) {
+				const double begin = (static_cast<double>(event.mBegin) - static_cast<double>(mTraceOrigin)) * microsecondsPerTick;
+				const double duration = static_cast<double>(event.mEnd - event.mBegin) * microsecondsPerTick;
+				file << ",\n{\"name\":\"" << escapeJson(mHistories[event.mHistory].mName) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+					<< "\"ts\":" << begin << ",\"dur\":" << duration << ",\"args\":{\"frame\":" << frameIndex;
+				if (event.mSample.mHasStatistics) {
+					file << ",\"vertexInvocations\":" << event.mSample.mVertexInvocations << ",\"fragmentInvocations\":" << event.mSample.mFragmentInvocations
+						<< ",\"computeInvocations\":" << event.mSample.mComputeInvocations;
+				}
+				file << "}}";
+			}
+			frameIndex++;
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return true;
+	}
+
+	GPUZone::GPUZone(const GPUProfiler::Ptr& profiler, const CommandBuffer::Ptr& commandBuffer, const std::string& name, bool statistics)
+		: mProfiler(profiler), mCommandBuffer(commandBuffer) {
+		if (mProfiler != nullptr) {
+			mZone = mProfiler->beginZone(mCommandBuffer, name, statistics);
+		}
+	}
+
+	GPUZone::~GPUZone() {
+		if (mProfiler != nullptr) {
+			mProfiler->endZone(mCommandBuffer, mZone);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../base.h"
+#include "device.h"
+#include "commandBuffer.h"
+#include <deque>
+
+namespace FF::Wrapper {
+	/*
+	* GPU zones measured with timestamp queries, optionally with pipeline statistics (vertex, fragment and compute invocations).
+	* Each slot owns its query pools. A frame in flight records into the slot of its index, and beginFrame reads what the slot
+	* measured the last time it was used: that submission was already waited on through its fence, so reading never stalls.
+	* Zones nest. A statistics query cannot be nested in another one, so an inner zone asking for statistics only gets timestamps.
+	* Every zone name keeps its last mAverageFrames samples for the averages, and the last mTraceFrames frames are kept for the trace.
+	*/
+	class GPUProfiler {
+	public:
+		using Ptr = std::shared_ptr<GPUProfiler>;
+		static constexpr uint32_t InvalidZone = ~0u;
+
+		struct Settings {
+			uint32_t mMaxZones{ 64 }; // per slot and frame, the zones past it are not measured
+			bool mPipelineStatistics{ true }; // needs the pipelineStatisticsQuery feature
+			uint32_t mAverageFrames{ 120 };
+			uint32_t mTraceFrames{ 300 };
+		};
+
+		struct ZoneStats {
+			std::string mName;
+			uint32_t mDepth{ 0 };
+			uint32_t mSampleCount{ 0 }; // samples in the average
+			double mAverageMs{ 0.0 };
+			double mMinMs{ 0.0 };
+			double mMaxMs{ 0.0 };
+			double mLastMs{ 0.0 };
+			bool mHasStatistics{ false };
+			// Averaged like the times, 0 without statistics
+			double mVertexInvocations{ 0.0 };
+			double mFragmentInvocations{ 0.0 };
+			double mComputeInvocations{ 0.0 };
+		};
+
+		static Ptr create(const Device::Ptr& device, uint32_t slotCount, const Settings& settings = {}) {
+			return std::make_shared<GPUProfiler>(device, slotCount, settings);
+		}
+
+		GPUProfiler(const Device::Ptr& device, uint32_t slotCount, const Settings& settings);
+		~GPUProfiler();
+
+		/// @brief Collect the previous results of slot, then reset its queries for the zones that follow.
+		/// Record it outside of a render pass. The previous submission of the slot must have completed.
+		void beginFrame(const CommandBuffer::Ptr& commandBuffer, uint32_t slot);
+		// Read the results of slot right away, after waiting on a one time submission (bakes)
+		void collect(uint32_t slot);
+
+		/// @return the zone to end, InvalidZone when nothing is measured.
+		uint32_t beginZone(const CommandBuffer::Ptr& commandBuffer, const std::string& name, bool statistics = false);
+		void endZone(const CommandBuffer::Ptr& commandBuffer, uint32_t zone);
+
+		[[nodiscard]] bool isEnabled() const { return mTimestampPools.size() > 0; }
+		[[nodiscard]] bool isStatisticsEnabled() const { return mStatisticsPools.size() > 0; }
+
+		// In the order the zones were first measured
+		[[nodiscard]] std::vector<ZoneStats> getZoneStats() const;
+		void printZoneStats() const;
+		// Times in ms of the samples a zone keeps, oldest first, empty for an unknown name
+		[[nodiscard]] std::vector<double> getZoneSamples(const std::string& name) const;
+
+		bool exportCSV(const std::string& path) const;
+		// Complete events on one GPU track, for chrome://tracing or ui.perfetto.dev
+		bool exportChromeTrace(const std::string& path) const;
+
+	private:
+		struct ZoneRecord {
+			std::string mName;
+			uint32_t mDepth{ 0 };
+			uint32_t mStatisticsQuery{ InvalidZone };
+			bool mEnded{ false };
+		};
+
+		struct Slot {
+			std::vector<ZoneRecord> mZones{};
+			uint32_t mStatisticsCount{ 0 };
+			uint32_t mDepth{ 0 };
+			bool mStatisticsActive{ false };
+			bool mPending{ false };
+		};
+
+		struct Sample {
+			double mMs{ 0.0 };
+			bool mHasStatistics{ false };
+			uint64_t mVertexInvocations{ 0 };
+			uint64_t mFragmentInvocations{ 0 };
+			uint64_t mComputeInvocations{ 0 };
+		};
+
+		struct ZoneHistory {
+			std::string mName;
+			uint32_t mDepth{ 0 };
+			std::deque<Sample> mSamples{};
+		};
+
+		struct TraceEvent {
+			uint32_t mHistory{ 0 };
+			uint64_t mBegin{ 0 };
+			uint64_t mEnd{ 0 };
+			Sample mSample{};
+		};
+
+		ZoneHistory& getHistory(const std::string& name, uint32_t depth, uint32_t& index);
+
+	private:
+		Device::Ptr mDevice{ nullptr };
+		Settings mSettings{};
+
+		// One pool of each type per slot, timestamps 2 * zone and 2 * zone + 1
+		std::vector<VkQueryPool> mTimestampPools{};
+		std::vector<VkQueryPool> mStatisticsPools{};
+		std::vector<Slot> mSlots{};
+		uint32_t mCurrentSlot{ 0 };
+
+		std::vector<ZoneHistory> mHistories{};
+		std::unordered_map<std::string, uint32_t> mHistoryIndices{};
+		std::deque<std::vector<TraceEvent>> mTraceFrames{};
+		uint64_t mTraceOrigin{ 0 };
+		bool mHasTraceOrigin{ false };
+	};
+
+	// Measures its scope, does nothing without a profiler
+	class GPUZone {
+	public:
+		GPUZone(const GPUProfiler::Ptr& profiler, const CommandBuffer::Ptr& commandBuffer, const std::string& name, bool statistics = false);
+		~GPUZone();
+
+		GPUZone(const GPUZone&) = delete;
+		GPUZone& operator=(const GPUZone&) = delete;
+
+	private:
+		GPUProfiler::Ptr mProfiler{ nullptr };
+		CommandBuffer::Ptr mCommandBuffer{ nullptr };
+		uint32_t mZone{ GPUProfiler::InvalidZone };
+	};
+}
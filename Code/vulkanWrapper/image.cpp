@@ -106,38 +106,51 @@ namespace FF::Wrapper {
 		const VkSampleCountFlagBits& sample,
 		const VkImageAspectFlags &aspectFlags,
 		const bool& isCubeMap,
-		const int mipmapLevels):mDevice(device),mFormat(format),mImageLayout(VK_IMAGE_LAYOUT_UNDEFINED){
-		if (width == 0 || height == 0) {
-			throw std::runtime_error("Image width or height is zero!");
+		const int mipmapLevels,
+		const uint32_t cubeArrayCount,
+		const uint32_t depth,
+		const bool allocateMemory):mDevice(device),mFormat(format),mImageLayout(VK_IMAGE_LAYOUT_UNDEFINED){
+		if (width == 0 || height == 0 || depth == 0) {
+			throw std::runtime_error("Image width, height or depth is zero!");
 		}
 		mExtent.width = width;
 		mExtent.height = height;
-		mExtent.depth = 1;
+		mExtent.depth = imageType == VK_IMAGE_TYPE_3D ? depth : 1;
 		mSize = width * height * 4;
 		mAlignment = 4;
 		mOffset = 0;
 		mUsage = usage;
 		mProperties = properties;
+		mMipLevels = static_cast<uint32_t>(mipmapLevels);
+		mCubeArrayCount = cubeArrayCount;
+		mLayerCount = cubeArrayCount > 0 ? 6 * cubeArrayCount : (isCubeMap ? 6 : 1);
+		const bool cubeCompatible = isCubeMap || cubeArrayCount > 0;
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = imageType;
 		imageInfo.extent = mExtent;
 		imageInfo.mipLevels = mipmapLevels;
-		imageInfo.arrayLayers = isCubeMap ? 6 : 1;
+		imageInfo.arrayLayers = mLayerCount;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageInfo.usage = usage;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.samples = sample;
-		imageInfo.flags = isCubeMap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT:0;
+		imageInfo.flags = cubeCompatible ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT:0;
 		if (vkCreateImage(mDevice->getDevice(), &imageInfo, nullptr, &mImage) != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to create image!");
 		}
 
+		mAspectFlags = aspectFlags;
+		mViewType = cubeArrayCount > 0 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : (isCubeMap ? VK_IMAGE_VIEW_TYPE_CUBE : ((imageType & VK_IMAGE_TYPE_2D) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_3D));
+		if (!allocateMemory) {
+			// The owner of the memory binds it, the view is created then
+			return;
+		}
+
 		//Allocate memory space
-		VkMemoryRequirements memRequirements{};
-		vkGetImageMemoryRequirements(mDevice->getDevice(), mImage, &memRequirements);
+		VkMemoryRequirements memRequirements = getMemoryRequirements();
 		VkMemoryAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocInfo.allocationSize = memRequirements.size;
@@ -147,28 +160,46 @@ namespace FF::Wrapper {
 		}
 
 		vkBindImageMemory(mDevice->getDevice(), mImage, mImageMemory, 0);
+		createDefaultImageView();
+	}
+
+	VkMemoryRequirements Image::getMemoryRequirements() const {
+		VkMemoryRequirements memRequirements{};
+		vkGetImageMemoryRequirements(mDevice->getDevice(), mImage, &memRequirements);
+		return memRequirements;
+	}
+
+	void Image::bindMemory(VkDeviceMemory memory, VkDeviceSize offset) {
+		if (mImageMemory != VK_NULL_HANDLE || mImageView != VK_NULL_HANDLE) {
+			throw std::runtime_error("Error: image memory is already bound!");
+		}
+		if (vkBindImageMemory(mDevice->getDevice(), mImage, memory, offset) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to bind image memory!");
+		}
+		mOffset = offset;
+		createDefaultImageView();
+	}
 
+	void Image::createDefaultImageView() {
 		//Create image view
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = mImage;
-        viewInfo.viewType = isCubeMap ? VK_IMAGE_VIEW_TYPE_CUBE : ((imageType & VK_IMAGE_TYPE_2D) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_3D);
-		viewInfo.format = format;
+		viewInfo.viewType = mViewType;
+		viewInfo.format = mFormat;
 		viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-		viewInfo.subresourceRange.aspectMask = aspectFlags;
+		viewInfo.subresourceRange.aspectMask = mAspectFlags;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = mipmapLevels;
+		viewInfo.subresourceRange.levelCount = mMipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = isCubeMap ? 6 : 1;
+		viewInfo.subresourceRange.layerCount = mLayerCount;
 
 		if (vkCreateImageView(mDevice->getDevice(), &viewInfo, nullptr, &mImageView) != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to create image view!");
 		}
-
-
 	}
 
 
@@ -211,6 +242,15 @@ namespace FF::Wrapper {
 		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
 			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			break;
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+			barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			break;
+		case VK_IMAGE_LAYOUT_GENERAL:
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			break;
 		default:
 			break;
 		}
@@ -219,6 +259,9 @@ namespace FF::Wrapper {
 		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
 			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 			break;
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			break;
 		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: {
 			//As a texture, the source has two options: one is from staging buffer, the other is from cpu copy.
 			if (barrier.srcAccessMask == 0) {
@@ -235,6 +278,10 @@ namespace FF::Wrapper {
 			barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			break;
 
+		case VK_IMAGE_LAYOUT_GENERAL:
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			break;
+
 		default:
 			break;
 
@@ -257,6 +304,90 @@ namespace FF::Wrapper {
 		mImageLayout = newLayout;
 	}
 
+	void Image::generateMipmaps(const CommandPool::Ptr& commandPool, const CommandBuffer::Ptr& inCommandBuffer) {
+		if (mMipLevels <= 1) {
+			return;
+		}
+		const VkImageUsageFlags blitUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if ((mUsage & blitUsage) != blitUsage) {
+			throw std::runtime_error("Error: generating mipmaps needs an image with transfer src and dst usage!");
+		}
+
+		// Linear filtering of blits is optional for float formats
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(mDevice->getPhysicalDevice(), mFormat, &formatProperties);
+		const VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+		CommandBuffer::Ptr commandBuffer = inCommandBuffer;
+		if (commandBuffer == nullptr) {
+			commandBuffer = CommandBuffer::create(mDevice, commandPool);
+			commandBuffer->beginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = mImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = mLayerCount;
+		barrier.subresourceRange.levelCount = 1;
+
+		// Mip 0 may have been written by a render pass, a compute shader or a copy
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.oldLayout = mImageLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		commandBuffer->transferImageLayout(barrier, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		for (uint32_t mipLevel = 1; mipLevel < mMipLevels; mipLevel++) {
+			// Previous contents of the level are discarded
+			barrier.subresourceRange.baseMipLevel = mipLevel;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			commandBuffer->transferImageLayout(barrier, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			VkImageBlit blit{};
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = mipLevel - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = mLayerCount;
+			blit.srcOffsets[1] = { static_cast<int32_t>(std::max(1u, mExtent.width >> (mipLevel - 1))), static_cast<int32_t>(std::max(1u, mExtent.height >> (mipLevel - 1))), 1 };
+			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.dstSubresource.mipLevel = mipLevel;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = mLayerCount;
+			blit.dstOffsets[1] = { static_cast<int32_t>(std::max(1u, mExtent.width >> mipLevel)), static_cast<int32_t>(std::max(1u, mExtent.height >> mipLevel)), 1 };
+			commandBuffer->blitImage(mImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, { blit }, filter);
+
+			// This level is the source of the next blit
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			commandBuffer->transferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mMipLevels;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		commandBuffer->transferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		mImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		if (inCommandBuffer == nullptr) {
+			commandBuffer->endCommandBuffer();
+			commandBuffer->submitCommandBuffer(mDevice->getGraphicQueue());
+			commandBuffer->waitCommandBuffer(mDevice->getGraphicQueue());
+		}
+	}
+
 	void Image::fillImageData(size_t size, const void* pData, const CommandPool::Ptr& commandPool,const bool& isCubeMap) {
 		assert(pData != nullptr);
 		assert(size > 0);
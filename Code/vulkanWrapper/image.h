@@ -60,6 +60,15 @@ namespace FF::Wrapper {
 
 		bool hasStencilComponent(VkFormat format);
 
+		// Length of a full mip chain down to 1x1
+		static uint32_t getMaxMipLevels(uint32_t width, uint32_t height) {
+			uint32_t mipLevels = 1;
+			while ((std::max(width, height) >> mipLevels) > 0) {
+				mipLevels++;
+			}
+			return mipLevels;
+		}
+
 
 	public:
 		
@@ -74,8 +83,11 @@ namespace FF::Wrapper {
 			const VkSampleCountFlagBits& sample,
 			const VkImageAspectFlags& aspectFlag,
 			const bool& isCubeMap = false,
-			const int mimapLevels = 1) {
-			return std::make_shared<Image>(device, width, height, format, imageType, tiling, usage, properties,sample, aspectFlag, isCubeMap,mimapLevels);
+			const int mimapLevels = 1,
+			const uint32_t cubeArrayCount = 0,
+			const uint32_t depth = 1,
+			const bool allocateMemory = true) {
+			return std::make_shared<Image>(device, width, height, format, imageType, tiling, usage, properties,sample, aspectFlag, isCubeMap,mimapLevels, cubeArrayCount, depth, allocateMemory);
 		}
 		Image(const Device::Ptr& device, 
 			const int& width,
@@ -88,7 +100,10 @@ namespace FF::Wrapper {
 			const VkSampleCountFlagBits& sample,
 			const VkImageAspectFlags& aspectFlag,
 			const bool& isCubeMap = false,
-			const int mipmapLevels = 1);
+			const int mipmapLevels = 1,
+			const uint32_t cubeArrayCount = 0, // > 0: cubeArrayCount cubemaps behind one CUBE_ARRAY view, needs the imageCubeArray feature
+			const uint32_t depth = 1, // slices of a VK_IMAGE_TYPE_3D image
+			const bool allocateMemory = true); // false: no memory and no view until bindMemory, for memory shared by several images
 		~Image();
 		void createImageView(VkImageViewType viewType);
 		void destroyImageView();
@@ -108,9 +123,19 @@ namespace FF::Wrapper {
 		[[nodiscard]] auto getOffset() const { return mOffset; }
 		[[nodiscard]] auto getUsage() const { return mUsage; }
 		[[nodiscard]] auto getProperties() const { return mProperties; }
+		[[nodiscard]] auto getMipLevels() const { return mMipLevels; }
+		[[nodiscard]] auto getLayerCount() const { return mLayerCount; }
+		[[nodiscard]] bool isCubeMap() const { return mLayerCount == 6; }
+		[[nodiscard]] bool isCubeArray() const { return mCubeArrayCount > 0; }
+		[[nodiscard]] auto getCubeArrayCount() const { return mCubeArrayCount; }
 
 		VkDeviceMemory getMemory() const { return mImageMemory; }
 
+		[[nodiscard]] VkMemoryRequirements getMemoryRequirements() const;
+		/// @brief Bind memory owned by the caller and create the view, for an image created without allocateMemory.
+		/// The memory is not freed with the image, several images with disjoint lifetimes may alias it.
+		void bindMemory(VkDeviceMemory memory, VkDeviceSize offset);
+
 		/// @brief Transfer Image Layout from old layout to new layout and insert necessary pipeline barrier.
 		/// @param newLayout new layout to transfer to.
 		/// @param srcStageMask source stage that needs to be finished before layout transition (producer).
@@ -127,9 +152,15 @@ namespace FF::Wrapper {
 			const CommandBuffer::Ptr& commandBUffer = nullptr);
 
 		void fillImageData(size_t size, const void* pData, const CommandPool::Ptr& commandPool,const bool& isCubeMap = false);
+
+		/// @brief Fill mips 1..N-1 of every layer by blitting each level down from the previous one.
+		/// Mip 0 must already hold the data, the whole image ends in SHADER_READ_ONLY_OPTIMAL.
+		/// Needs TRANSFER_SRC and TRANSFER_DST usage, falls back to nearest filtering when linear blits are not supported.
+		void generateMipmaps(const CommandPool::Ptr& commandPool, const CommandBuffer::Ptr& commandBuffer = nullptr);
 		void CopyImageToCubeMap(const CommandPool::Ptr& commandPool, const VkImage& inSrcImage, VkImage inDstCubeMap, size_t inWidth, size_t inHeight, int inFace, int inMipmapLevel);
 	private:
 		uint32_t findMemoryType(Device::Ptr device, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		void createDefaultImageView();
 
 
 
@@ -151,6 +182,12 @@ namespace FF::Wrapper {
 
 		VkMemoryPropertyFlags mProperties{ 0 };
 
+		uint32_t mMipLevels{ 1 };
+		uint32_t mLayerCount{ 1 };
+		uint32_t mCubeArrayCount{ 0 };
+		VkImageAspectFlags mAspectFlags{ 0 };
+		VkImageViewType mViewType{ VK_IMAGE_VIEW_TYPE_2D };
+
 
 	};
 }
\ No newline at end of file
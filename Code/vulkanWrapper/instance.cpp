@@ -62,11 +62,16 @@ namespace FF::Wrapper {
 	}
 	std::vector<const char*> Instance::getRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions{};
+		if (!mHeadless) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
-		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		if (mEnableValidationLayer || !mHeadless) {
+			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
 		//extensions.push_back(VK_EXT_NON_SEAMLESS_CUBE_MAP_EXTENSION_NAME);
 		//for (const auto& extension : extensions) {
 		//	std::cout << "Required extension: " << extension << std::endl;
@@ -114,11 +119,17 @@ namespace FF::Wrapper {
 		}
 		
 	}
-	Instance::Instance(bool enableValidationLayer) {
+	Instance::Instance(bool enableValidationLayer, bool headless) {
 		mEnableValidationLayer = enableValidationLayer;
+		mHeadless = headless;
 
 		if (enableValidationLayer && !checkValidationLayerSupport()) {
-			throw std::runtime_error("Error: validation layer is not supported.");
+			// Build and render farm machines often only have the loader and a driver
+			if (!mHeadless) {
+				throw std::runtime_error("Error: validation layer is not supported.");
+			}
+			std::cout << "Validation layer not available, running without it" << std::endl;
+			mEnableValidationLayer = false;
 		}
 
 
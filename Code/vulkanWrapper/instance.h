@@ -6,9 +6,10 @@ namespace FF::Wrapper {
 	class Instance {
 	public:
 		using Ptr = std::shared_ptr<Instance>;
-		static Ptr create(bool enableValidationLayer) { return std::make_shared<Instance>(enableValidationLayer); }
+		/// @param headless no window system extensions (no glfwInit needed), and validation is skipped when the layer is missing.
+		static Ptr create(bool enableValidationLayer, bool headless = false) { return std::make_shared<Instance>(enableValidationLayer, headless); }
 
-		Instance(bool enableValidationLayer);
+		Instance(bool enableValidationLayer, bool headless = false);
 
 		~Instance();
 
@@ -21,10 +22,12 @@ namespace FF::Wrapper {
 
 		[[nodiscard]] VkInstance getInstance() const { return mInstance; }
 		[[nodiscard]] bool getEnableValidationLayer() const { return mEnableValidationLayer; }
+		[[nodiscard]] bool isHeadless() const { return mHeadless; }
 
 	private:
 		VkInstance mInstance{VK_NULL_HANDLE};
 		bool mEnableValidationLayer{ false };
+		bool mHeadless{ false };
 		VkDebugUtilsMessengerEXT mDebugger{ VK_NULL_HANDLE };
 	};
 }
\ No newline at end of file
@@ -30,6 +30,7 @@ namespace FF::Wrapper {
 			shaderCreateInfo.stage = shader->getShaderStage();
 			shaderCreateInfo.module = shader->getShaderModule();
 			shaderCreateInfo.pName = shader->getEntryPoint().c_str();
+			shaderCreateInfo.pSpecializationInfo = shader->getSpecializationInfo();
 
 			shaderCreateInfos.push_back(shaderCreateInfo);
 		}
@@ -46,6 +47,23 @@ namespace FF::Wrapper {
 		//mBlendState.attachmentCount = static_cast<uint32_t>(mBlendAttachmentStates.size());
 		//mBlendState.pAttachments = mBlendAttachmentStates.data();
 
+		if (mDynamicViewport) {
+			for (VkDynamicState state : { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR }) {
+				if (std::find(dynamicStates.begin(), dynamicStates.end(), state) == dynamicStates.end()) {
+					dynamicStates.push_back(state);
+				}
+			}
+			// Only the counts matter, the values come from the command buffer
+			mViewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			mViewportState.viewportCount = std::max(1u, static_cast<uint32_t>(mViewports.size()));
+			mViewportState.pViewports = nullptr;
+			mViewportState.scissorCount = std::max(1u, static_cast<uint32_t>(mScissors.size()));
+			mViewportState.pScissors = nullptr;
+		}
+		mDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		mDynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		mDynamicState.pDynamicStates = dynamicStates.empty() ? nullptr : dynamicStates.data();
+
 		// Create pipeline layout
 		if (mLayout != VK_NULL_HANDLE) {
 			vkDestroyPipelineLayout(mDevice->getDevice(), mLayout, nullptr);
@@ -22,6 +22,10 @@ namespace FF::Wrapper {
 		void setShaderGroup(const std::vector<Shader::Ptr>& shaderGroup);
 		void inline setViewports(const std::vector<VkViewport>& viewports) { mViewports = viewports; }
 		void inline setScissors(const std::vector<VkRect2D>& scissors) { mScissors = scissors; }
+		// Dynamic by default: viewport and scissor are set at record time (CommandBuffer::setViewport/setScissor),
+		// so one pipeline serves every framebuffer size. When disabled, mViewports/mScissors are baked in.
+		void inline setDynamicViewport(bool dynamicViewport) { mDynamicViewport = dynamicViewport; }
+		[[nodiscard]] bool isDynamicViewport() const { return mDynamicViewport; }
 
 		void pushBlendAttachment(const VkPipelineColorBlendAttachmentState& blendAttachment) {
 			mBlendAttachmentStates.push_back(blendAttachment);
@@ -51,5 +55,6 @@ namespace FF::Wrapper {
 		Device::Ptr mDevice{ nullptr };
 		RenderPass::Ptr mRenderPass{ nullptr };
 		std::vector<Shader::Ptr> mShaders{};
+		bool mDynamicViewport{ true };
 	};
 }
\ No newline at end of file
@@ -42,7 +42,7 @@ namespace FF::Wrapper {
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // every mip of the view is reachable, textureLod on prefiltered maps relies on it
 
 		if (vkCreateSampler(mDevice->getDevice(), &samplerInfo, nullptr, &mSampler) != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to create sampler!");
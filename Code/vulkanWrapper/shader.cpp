@@ -20,6 +20,30 @@ namespace FF::Wrapper {
 		: mDevice(device), mEntryPoint(entryPoint), mShaderStage(shaderStage) {
 		createShaderModule(fileName);
 	}
+	void Shader::setSpecializationConstant(uint32_t constantID, uint32_t value) {
+		for (size_t i = 0; i < mSpecializationEntries.size(); i++) {
+			if (mSpecializationEntries[i].constantID == constantID) {
+				mSpecializationData[i] = value;
+				return;
+			}
+		}
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantID;
+		entry.offset = static_cast<uint32_t>(mSpecializationData.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		mSpecializationEntries.push_back(entry);
+		mSpecializationData.push_back(value);
+
+		mSpecializationInfo.mapEntryCount = static_cast<uint32_t>(mSpecializationEntries.size());
+		mSpecializationInfo.pMapEntries = mSpecializationEntries.data();
+		mSpecializationInfo.dataSize = mSpecializationData.size() * sizeof(uint32_t);
+		mSpecializationInfo.pData = mSpecializationData.data();
+	}
+
+	const VkSpecializationInfo* Shader::getSpecializationInfo() const {
+		return mSpecializationEntries.empty() ? nullptr : &mSpecializationInfo;
+	}
+
 	Shader::~Shader() {
 		if (mShaderModule != VK_NULL_HANDLE) {
 			vkDestroyShaderModule(mDevice->getDevice(), mShaderModule, nullptr);
@@ -18,6 +18,11 @@ namespace FF::Wrapper {
 		[[nodiscard]] const std::string& getEntryPoint() const { return mEntryPoint; }
 		[[nodiscard]] VkShaderStageFlagBits getShaderStage() const { return mShaderStage; }
 
+		// 32 bit specialization constant (bool, int, uint or float bits), applied when a pipeline is built from this shader
+		void setSpecializationConstant(uint32_t constantID, uint32_t value);
+		// nullptr when no constant was set
+		[[nodiscard]] const VkSpecializationInfo* getSpecializationInfo() const;
+
 	private:
 		void createShaderModule(const std::string& fileName);
 		// Read the binary file and return the contents as a vector of chars
@@ -39,5 +44,9 @@ namespace FF::Wrapper {
 		VkShaderModule mShaderModule{ VK_NULL_HANDLE };
 		std::string mEntryPoint{ "main" };
 		VkShaderStageFlagBits mShaderStage{ VK_SHADER_STAGE_VERTEX_BIT };
+
+		std::vector<VkSpecializationMapEntry> mSpecializationEntries{};
+		std::vector<uint32_t> mSpecializationData{};
+		VkSpecializationInfo mSpecializationInfo{};
 	};
 }
\ No newline at end of file
@@ -2,14 +2,15 @@
 #include "swapChain.h"
 
 namespace FF::Wrapper {
-	SwapChain::SwapChain(const Device::Ptr& device, const Window::Ptr& window, const WindowSurface::Ptr& surface, const CommandPool::Ptr& commandPool)
+	SwapChain::SwapChain(const Device::Ptr& device, const Window::Ptr& window, const WindowSurface::Ptr& surface, const CommandPool::Ptr& commandPool, VkPresentModeKHR preferredPresentMode)
 		: mDevice(device), mWindow(window), mSurface(surface),mCommandPool(commandPool) {
 		// Initialize swap chain here
 		auto swapChainSupportInfo = querySwapChainSupportInfo();
 		// Choose the best surface format
 		VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(swapChainSupportInfo.mFormats);
 		// Choose the best present mode
-		VkPresentModeKHR presentMode = choosePresentMode(swapChainSupportInfo.mPresentModes);
+		VkPresentModeKHR presentMode = choosePresentMode(swapChainSupportInfo.mPresentModes, preferredPresentMode);
+		mPresentMode = presentMode;
 		// Choose the swap extent
 		VkExtent2D extent = chooseSwapExtent(swapChainSupportInfo.mCapabilities);
 		// Set the number of images in the swap chain
@@ -81,6 +82,10 @@ namespace FF::Wrapper {
 			mSwapChainImageViews[i] = createImageView(mSwapChainImages[i], mSwapChainFormat, VK_IMAGE_ASPECT_COLOR_BIT,1); // Create image views for the swap chain images
 		}
 
+	}
+
+	void SwapChain::createAttachmentImages() {
+		// Only the framebuffers of the swap chain use them, a frame rendered through a render graph never creates them
 		// Create depth image
 		mDepthImages.resize(mImageCount); // Resize the depth images vector to hold the depth images
 
@@ -93,7 +98,7 @@ namespace FF::Wrapper {
 
 
 		for (size_t i = 0; i < mImageCount; i++) {
-			mDepthImages[i] = Image::createDepthImage(mDevice, extent.width, extent.height);
+			mDepthImages[i] = Image::createDepthImage(mDevice, mSwapChainExtent.width, mSwapChainExtent.height);
 			mDepthImages[i]->setImageLayout(
 				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -127,10 +132,12 @@ namespace FF::Wrapper {
 				multisampleSubresourceRange,
 				mCommandPool); // Set the image layout for the multisample image
 		}
-
 	}
 
 	void SwapChain::createFrameBuffers(const RenderPass::Ptr& renderPass) {
+		if (mDepthImages.empty()) {
+			createAttachmentImages();
+		}
 		// Create framebuffers for the swap chain images
 		mSwapChainFramebuffers.resize(mImageCount); // Resize the swap chain framebuffers vector to hold the framebuffers
 		for (size_t i = 0; i < mImageCount; i++) {
@@ -234,16 +241,21 @@ namespace FF::Wrapper {
 
 	}
 	// Choose the best present mode from the available present modes
-	VkPresentModeKHR SwapChain::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+	VkPresentModeKHR SwapChain::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferredPresentMode)
 	{
 		// In devices, only FIFO is guaranteed to be available, in mobile devices, for battery saving, FIFO is preferred
-		VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR; // Default to FIFO mode
-		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				return availablePresentMode;
+		// IMMEDIATE may tear, so it is only taken when asked for: MAILBOX and FIFO_RELAXED fall back to FIFO
+		std::vector<VkPresentModeKHR> candidates{ preferredPresentMode };
+		if (preferredPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+			// Keeps the latency without the tearing
+			candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+		}
+		for (const auto& candidate : candidates) {
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), candidate) != availablePresentModes.end()) {
+				return candidate;
 			}
 		}
-		return bestMode;
+		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
 	VkExtent2D SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -19,17 +19,20 @@ namespace FF::Wrapper {
 	class SwapChain {
 	public:
 		using Ptr = std::shared_ptr<SwapChain>;
-		static Ptr create(const Device::Ptr& device, const Window::Ptr& window, const WindowSurface::Ptr& surface, const CommandPool::Ptr &commandPool) { return std::make_shared<SwapChain>(device, window, surface, commandPool); }
-		SwapChain(const Device::Ptr &device,const Window::Ptr &window, const WindowSurface::Ptr &surface, const CommandPool::Ptr& commandPool);
+		// preferredPresentMode: FIFO / FIFO_RELAXED pace to the display, MAILBOX / IMMEDIATE trade tearing or wasted frames for latency
+		static Ptr create(const Device::Ptr& device, const Window::Ptr& window, const WindowSurface::Ptr& surface, const CommandPool::Ptr &commandPool, VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR) { return std::make_shared<SwapChain>(device, window, surface, commandPool, preferredPresentMode); }
+		SwapChain(const Device::Ptr &device,const Window::Ptr &window, const WindowSurface::Ptr &surface, const CommandPool::Ptr& commandPool, VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR);
 		~SwapChain();
 
 		SwapChainSupportInfo querySwapChainSupportInfo();
 
 		VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
-		VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+		// The preferred mode when the surface offers it, otherwise the closest one in latency, FIFO as the last resort (always available)
+		VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferredPresentMode);
 
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+		// Framebuffers of a render pass with the swap chain image, a multisampled color image and a depth image, in that order
 		void createFrameBuffers(const RenderPass::Ptr& renderPass);
 
 	public:
@@ -41,6 +44,7 @@ namespace FF::Wrapper {
 		[[nodiscard]] auto getSwapChain() const { return mSwapChain; }
 		[[nodiscard]] auto getSwapChainFramebuffers() const { return mSwapChainFramebuffers; }
 		[[nodiscard]] auto getImageCount() const { return mImageCount; }
+		[[nodiscard]] auto getPresentMode() const { return mPresentMode; }
 
 		uint32_t acquireNextImage(VkSemaphore semaphore, VkFence fence = VK_NULL_HANDLE) {
 			uint32_t imageIndex;
@@ -50,6 +54,7 @@ namespace FF::Wrapper {
 
 	private:
 		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+		void createAttachmentImages();
 	private:
 		Device::Ptr mDevice{ nullptr };
 		Window::Ptr mWindow{ nullptr };
@@ -59,6 +64,7 @@ namespace FF::Wrapper {
 		VkFormat mSwapChainFormat;
 		VkExtent2D mSwapChainExtent;
 		uint32_t mImageCount{ 0 };
+		VkPresentModeKHR mPresentMode{ VK_PRESENT_MODE_FIFO_KHR };
 
 		// Swap chain images and image views
 		// The swapchain is incharge of creating and destroying the image 
@@ -21,6 +21,24 @@ namespace FF::Wrapper {
 		}
 	}
 
+	static void keyCallBack(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		// One shot actions, held keys (camera movement) are polled in processEvents
+		auto pUserData = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
+		if (action != GLFW_PRESS || pUserData->mApplication.expired()) {
+			return;
+		}
+		auto application = pUserData->mApplication.lock();
+		if (key == GLFW_KEY_E) {
+			application->cycleEnvironment();
+		}
+		else if (key == GLFW_KEY_T) {
+			application->stepTimeOfDay(10.0f);
+		}
+		else if (key == GLFW_KEY_P) {
+			application->dumpProfile();
+		}
+	}
+
 	Window::Window(const int& width, const int& height)
 	{
 		mWidth = width;
@@ -42,6 +60,7 @@ namespace FF::Wrapper {
 		glfwSetWindowUserPointer(mWindow, this);
 		glfwSetFramebufferSizeCallback(mWindow, windowResized);
 		glfwSetCursorPosCallback(mWindow, cursorPosCallBack);
+		glfwSetKeyCallback(mWindow, keyCallBack);
 	}
 
 	Window::~Window()